@@ -166,6 +166,7 @@ function Microbe:addOrganelle(q, r, organelle)
     organelle.sceneNode.transform:touch()
     organelle:onAddedToMicrobe(self, q, r)
     self:_updateAllHexColours()
+    self.microbe:markUnsavedChange()
     return true
 end
 
@@ -245,6 +246,7 @@ function Microbe:removeOrganelle(q, r)
     organelle.position.r = 0
     organelle:onRemovedFromMicrobe(self)
     self:_updateAllHexColours()
+    self.microbe:markUnsavedChange()
     return true
 end
 
@@ -361,7 +363,8 @@ function Microbe:update(milliseconds)
     end
     
     self.stored = amountStored
-    
+    -- Organelles keep their own state, which the microbe component saves
+    self.microbe:markUnsavedChange()
 end
 
 
@@ -39,6 +39,10 @@ end
 
 
 function MicrobeControlSystem:update(milliseconds)
+    -- Without a window, there is no camera to aim with
+    if Engine:isHeadless() then
+        return
+    end
     local player = Entity("player")
     local microbe = player:getComponent(MicrobeComponent.TYPE_ID)
     local targetPoint = getTargetPoint()
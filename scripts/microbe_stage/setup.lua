@@ -41,90 +41,68 @@ local function setupCompounds()
     CompoundRegistry.registerCompoundType("oxytoxy", "OxyToxy NT", "molecule.mesh")
 end
 
+-- Builds the template for entities that emit a compound at regular intervals
+local function createEmitterPrefab(compoundName, potencyPerParticle, emitInterval)
+    local prefab = Prefab(Engine.componentFactory)
+    -- Rigid body
+    local rigidBody = RigidBodyComponent()
+    rigidBody.properties.friction = 0.2
+    rigidBody.properties.linearDamping = 0.8
+    rigidBody.properties.shape = CylinderShape(
+        CollisionShape.AXIS_X, 
+        0.4,
+        2.0
+    )
+    prefab:addComponent(rigidBody)
+    -- Scene node
+    local sceneNode = OgreSceneNodeComponent()
+    sceneNode.meshName = "molecule.mesh"
+    prefab:addComponent(sceneNode)
+    -- Emitter
+    local emitter = CompoundEmitterComponent()
+    emitter.emissionRadius = 1
+    emitter.maxInitialSpeed = 10
+    emitter.minInitialSpeed = 2
+    emitter.minEmissionAngle = Degree(0)
+    emitter.maxEmissionAngle = Degree(360)
+    emitter.particleLifeTime = 5000
+    prefab:addComponent(emitter)
+    local timedEmitter = TimedCompoundEmitterComponent()
+    timedEmitter.compoundId = CompoundRegistry.getCompoundId(compoundName)
+    timedEmitter.particlesPerEmission = 1
+    timedEmitter.potencyPerParticle = potencyPerParticle
+    timedEmitter.emitInterval = emitInterval
+    prefab:addComponent(timedEmitter)
+    return prefab
+end
+
 local function createSpawnSystem()
     local spawnSystem = SpawnSystem()
-    
+    local oxygenEmitterPrefab = createEmitterPrefab("oxygen", 2.0, 1000)
+    local glucoseEmitterPrefab = createEmitterPrefab("glucose", 1.0, 2000)
+    local spawnEmitter = function(prefab, pos)
+        local ids = prefab:instantiate(
+            Engine:currentGameState():commandBuffer(),
+            1,
+            function(index, instance)
+                local rigidBody = instance:getComponent(RigidBodyComponent.TYPE_ID)
+                rigidBody:setDynamicProperties(
+                    pos,
+                    Quaternion(Radian(Degree(math.random()*360)), Vector3(0, 0, 1)),
+                    Vector3(0, 0, 0),
+                    Vector3(0, 0, 0)
+                )
+            end
+        )
+        return Entity(ids[1])
+    end
     local testFunction = function(pos)
         -- Setting up an emitter for oxygen
-        local entity = Entity()
-        -- Rigid body
-        local rigidBody = RigidBodyComponent()
-        rigidBody.properties.friction = 0.2
-        rigidBody.properties.linearDamping = 0.8
-        rigidBody.properties.shape = CylinderShape(
-            CollisionShape.AXIS_X, 
-            0.4,
-            2.0
-        )
-        rigidBody:setDynamicProperties(
-            pos,
-            Quaternion(Radian(Degree(math.random()*360)), Vector3(0, 0, 1)),
-            Vector3(0, 0, 0),
-            Vector3(0, 0, 0)
-        )
-        rigidBody.properties:touch()
-        entity:addComponent(rigidBody)
-        -- Scene node
-        local sceneNode = OgreSceneNodeComponent()
-        sceneNode.meshName = "molecule.mesh"
-        entity:addComponent(sceneNode)
-        -- Emitter oxygen
-        local oxygenEmitter = CompoundEmitterComponent()
-        entity:addComponent(oxygenEmitter)
-        oxygenEmitter.emissionRadius = 1
-        oxygenEmitter.maxInitialSpeed = 10
-        oxygenEmitter.minInitialSpeed = 2
-        oxygenEmitter.minEmissionAngle = Degree(0)
-        oxygenEmitter.maxEmissionAngle = Degree(360)
-        oxygenEmitter.particleLifeTime = 5000
-        local timedEmitter = TimedCompoundEmitterComponent()
-        timedEmitter.compoundId = CompoundRegistry.getCompoundId("oxygen")
-        timedEmitter.particlesPerEmission = 1
-        timedEmitter.potencyPerParticle = 2.0
-        timedEmitter.emitInterval = 1000
-        entity:addComponent(timedEmitter)
-        return entity
+        return spawnEmitter(oxygenEmitterPrefab, pos)
     end
     local testFunction2 = function(pos)
         -- Setting up an emitter for glucose
-        local entity = Entity()
-        -- Rigid body
-        local rigidBody = RigidBodyComponent()
-        rigidBody.properties.friction = 0.2
-        rigidBody.properties.linearDamping = 0.8
-        rigidBody.properties.shape = CylinderShape(
-            CollisionShape.AXIS_X, 
-            0.4,
-            2.0
-        )
-        rigidBody:setDynamicProperties(
-            pos,
-            Quaternion(Radian(Degree(math.random()*360)), Vector3(0, 0, 1)),
-            Vector3(0, 0, 0),
-            Vector3(0, 0, 0)
-        )
-        rigidBody.properties:touch()
-        entity:addComponent(rigidBody)
-        -- Scene node
-        local sceneNode = OgreSceneNodeComponent()
-        sceneNode.meshName = "molecule.mesh"
-        entity:addComponent(sceneNode)
-        -- Emitter glucose
-        local glucoseEmitter = CompoundEmitterComponent()
-        entity:addComponent(glucoseEmitter)
-        glucoseEmitter.emissionRadius = 1
-        glucoseEmitter.maxInitialSpeed = 10
-        glucoseEmitter.minInitialSpeed = 2
-        glucoseEmitter.minEmissionAngle = Degree(0)
-        glucoseEmitter.maxEmissionAngle = Degree(360)
-        glucoseEmitter.particleLifeTime = 5000
-        local timedEmitter = TimedCompoundEmitterComponent()
-        timedEmitter.compoundId = CompoundRegistry.getCompoundId("glucose")
-        timedEmitter.particlesPerEmission = 1
-        timedEmitter.potencyPerParticle = 1.0
-        timedEmitter.emitInterval = 2000
-        entity:addComponent(timedEmitter)
-        return entity
+        return spawnEmitter(glucoseEmitterPrefab, pos)
     end
     
     --Spawn one emitter on average once in every square of sidelength 10
@@ -275,6 +253,8 @@ local function createMicrobeStage(name)
         {
             SwitchGameStateSystem(),
             QuickSaveSystem(),
+            AutosaveSystem(),
+            StatisticsPanelSystem(),
             -- Microbe specific
             MicrobeSystem(),
             MicrobeCameraSystem(),
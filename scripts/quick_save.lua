@@ -12,7 +12,17 @@ function QuickSaveSystem:update(milliseconds)
     local loadDown = Engine.keyboard:isKeyDown(Keyboard.KC_F10)
     if saveDown and not self.saveDown then
         print("Saving")
-        Engine:save("quick.sav")
+        Engine:save(
+            "quick.sav",
+            nil,
+            function(filename, success, error)
+                if success then
+                    print("Saved " .. filename)
+                else
+                    print(error)
+                end
+            end
+        )
     end
     if loadDown and not self.loadDown then
         Engine:load("quick.sav")
@@ -21,3 +31,27 @@ function QuickSaveSystem:update(milliseconds)
     self.loadDown = loadDown
 end
 
+
+
+class 'AutosaveSystem' (System)
+
+-- Autosaves only append what changed to a journal, so they are cheap
+-- enough to run every few seconds
+local AUTOSAVE_INTERVAL = 5000
+
+function AutosaveSystem:__init()
+    System.__init(self)
+    self.sinceSave = 0
+end
+
+
+function AutosaveSystem:update(milliseconds)
+    self.sinceSave = self.sinceSave + milliseconds
+    if self.sinceSave >= AUTOSAVE_INTERVAL then
+        self.sinceSave = 0
+        Engine:autosave("auto.sav")
+    end
+    if Engine.keyboard:wasKeyPressed(Keyboard.KC_F9) then
+        Engine:load("auto.sav")
+    end
+end
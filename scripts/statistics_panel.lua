@@ -0,0 +1,110 @@
+-- Shows the entity and memory statistics of Engine:statistics()
+--
+-- Press F3 to toggle the panel. Useful for spotting leaks, like entities
+-- that are never removed.
+class 'StatisticsPanelSystem' (System)
+
+local PANEL_WIDTH = 420
+local PANEL_HEIGHT = 600
+local REFRESH_INTERVAL = 1000
+-- Only the largest collections and queries are listed
+local MAX_ROWS = 12
+
+local function formatBytes(bytes)
+    if bytes >= 1024 * 1024 then
+        return string.format("%.1f MiB", bytes / (1024 * 1024))
+    else
+        return string.format("%.1f KiB", bytes / 1024)
+    end
+end
+
+
+local function sortByBytes(list)
+    table.sort(list, function(a, b) return a.bytes > b.bytes end)
+end
+
+
+function StatisticsPanelSystem:__init()
+    System.__init(self)
+    self.isVisible = false
+    self.sinceRefresh = 0
+end
+
+
+function StatisticsPanelSystem:overlay()
+    local entity = Entity("debug.statistics")
+    local overlay = entity:getComponent(TextOverlayComponent.TYPE_ID)
+    if overlay == nil then
+        overlay = TextOverlayComponent("debug.statistics")
+        entity:addComponent(overlay)
+        overlay.properties.horizontalAlignment = TextOverlayComponent.Left
+        overlay.properties.verticalAlignment = TextOverlayComponent.Top
+        overlay.properties.width = PANEL_WIDTH
+        overlay.properties.height = PANEL_HEIGHT
+        overlay.properties.left = 10
+        overlay.properties.top = 10
+    end
+    return overlay
+end
+
+
+function StatisticsPanelSystem:refresh()
+    local statistics = Engine:statistics()
+    local lines = {}
+    table.insert(lines, string.format("Entities: %d", statistics.entities or 0))
+    table.insert(lines, string.format("Lua heap: %s", formatBytes(statistics.luaHeap)))
+    if statistics.physicsBodies then
+        table.insert(lines, string.format(
+            "Physics bodies: %d (at least %s)",
+            statistics.physicsBodies,
+            formatBytes(statistics.physicsMinBytes)
+        ))
+    end
+    table.insert(lines, "Components:")
+    sortByBytes(statistics.components)
+    for i = 1, math.min(MAX_ROWS, #statistics.components) do
+        local collection = statistics.components[i]
+        table.insert(lines, string.format(
+            "  %-28s %6d  %s",
+            collection.name,
+            collection.count,
+            formatBytes(collection.bytes)
+        ))
+    end
+    table.insert(lines, "Queries:")
+    sortByBytes(statistics.queries)
+    for i = 1, math.min(MAX_ROWS, #statistics.queries) do
+        local query = statistics.queries[i]
+        table.insert(lines, string.format(
+            "  %-28s %6d  %s",
+            query.name,
+            query.entities,
+            formatBytes(query.bytes)
+        ))
+    end
+    local overlay = self:overlay()
+    overlay.properties.text = table.concat(lines, "\n")
+    overlay.properties:touch()
+end
+
+
+function StatisticsPanelSystem:update(milliseconds)
+    if Engine.keyboard:wasKeyPressed(Keyboard.KC_F3) then
+        self.isVisible = not self.isVisible
+        if self.isVisible then
+            self.sinceRefresh = REFRESH_INTERVAL
+        else
+            local overlay = self:overlay()
+            overlay.properties.text = ""
+            overlay.properties:touch()
+        end
+    end
+    if not self.isVisible then
+        return
+    end
+    self.sinceRefresh = self.sinceRefresh + milliseconds
+    if self.sinceRefresh >= REFRESH_INTERVAL then
+        self.sinceRefresh = 0
+        self:refresh()
+    end
+end
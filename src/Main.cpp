@@ -21,7 +21,11 @@ extern "C" {
     {
         using namespace thrive;
         Game& game = Game::instance();
-        game.run();
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+        game.run(__argc, __argv);
+#else
+        game.run(argc, argv);
+#endif
         return 0;
     }
  
@@ -1,8 +1,9 @@
 #include "bullet/bullet_to_ogre_system.h"
 
 #include "bullet/rigid_body_system.h"
-#include "engine/game_state.h"
 #include "engine/entity_filter.h"
+#include "engine/entity_manager.h"
+#include "engine/game_state.h"
 #include "ogre/scene_node_system.h"
 #include "scripting/luabind.h"
 
@@ -30,6 +31,13 @@ struct BulletToOgreSystem::Implementation {
 BulletToOgreSystem::BulletToOgreSystem()
   : m_impl(new Implementation())
 {
+    // Only copies transforms into the components, the scene nodes are
+    // updated by OgreUpdateSceneNodeSystem
+    this->setComponentAccess(
+        {RigidBodyComponent::TYPE_ID},
+        {OgreSceneNodeComponent::TYPE_ID}
+    );
+    this->setRequiresMainThread(false);
 }
 
 
@@ -54,15 +62,44 @@ BulletToOgreSystem::shutdown() {
 
 void
 BulletToOgreSystem::update(int) {
-    for (auto& value : m_impl->m_entities) {
-        RigidBodyComponent* rigidBodyComponent = std::get<0>(value.second);
-        OgreSceneNodeComponent* sceneNodeComponent = std::get<1>(value.second);
-        auto& sceneNodeTransform = sceneNodeComponent->m_transform;
-        auto& rigidBodyProperties = rigidBodyComponent->m_dynamicProperties;
-        sceneNodeTransform.orientation = rigidBodyProperties.rotation;
-        sceneNodeTransform.position = rigidBodyProperties.position;
-        sceneNodeTransform.touch();
-    }
+    m_impl->m_entities.parallelForEach(
+        [] (EntityId, const EntityFilter<RigidBodyComponent, OgreSceneNodeComponent>::ComponentGroup& group) {
+            RigidBodyComponent* rigidBodyComponent = std::get<0>(group);
+            OgreSceneNodeComponent* sceneNodeComponent = std::get<1>(group);
+            auto& sceneNodeTransform = sceneNodeComponent->m_transform;
+            auto& rigidBodyProperties = rigidBodyComponent->m_dynamicProperties;
+            const btRigidBody* body = rigidBodyComponent->m_body;
+            if (body and not body->isActive()) {
+                // Sleeping bodies don't move. Touch them once more so that the
+                // interpolation settles on the final transform, then leave them
+                // out of the scene node system's change list.
+                if (
+                    sceneNodeTransform.isInterpolated and (
+                        sceneNodeTransform.previousPosition != sceneNodeTransform.position or
+                        sceneNodeTransform.previousOrientation != sceneNodeTransform.orientation
+                    )
+                ) {
+                    sceneNodeTransform.previousOrientation = sceneNodeTransform.orientation;
+                    sceneNodeTransform.previousPosition = sceneNodeTransform.position;
+                    sceneNodeTransform.touch();
+                }
+                return;
+            }
+            if (sceneNodeTransform.isInterpolated) {
+                sceneNodeTransform.previousOrientation = sceneNodeTransform.orientation;
+                sceneNodeTransform.previousPosition = sceneNodeTransform.position;
+            }
+            else {
+                // Don't interpolate from wherever the scene node was before
+                sceneNodeTransform.previousOrientation = rigidBodyProperties.rotation;
+                sceneNodeTransform.previousPosition = rigidBodyProperties.position;
+                sceneNodeTransform.isInterpolated = true;
+            }
+            sceneNodeTransform.orientation = rigidBodyProperties.rotation;
+            sceneNodeTransform.position = rigidBodyProperties.position;
+            sceneNodeTransform.touch();
+        }
+    );
 }
 
 
@@ -12,12 +12,18 @@ struct CollisionFilter::Implementation {
     Implementation(
         const std::string& collisionGroup1,
         const std::string& collisionGroup2
-    ) : m_signature(collisionGroup1, collisionGroup2)
+    ) : m_groupIds(
+            CollisionComponent::collisionGroupId(collisionGroup1),
+            CollisionComponent::collisionGroupId(collisionGroup2)
+        ),
+        m_signature(collisionGroup1, collisionGroup2)
     {
     }
 
     CollisionMap m_collisions;
 
+    std::pair<unsigned int, unsigned int> m_groupIds;
+
     Signature m_signature;
 
     CollisionSystem* m_collisionSystem = nullptr;
@@ -101,6 +107,12 @@ CollisionFilter::clearCollisions() {
 }
 
 
+const std::pair<unsigned int, unsigned int>&
+CollisionFilter::getCollisionGroupIds() const {
+    return m_impl->m_groupIds;
+}
+
+
 const CollisionFilter::Signature&
 CollisionFilter::getCollisionSignature() const {
     return m_impl->m_signature;
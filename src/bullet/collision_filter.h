@@ -153,6 +153,16 @@ public:
     typename CollisionIterator::iterator
     end() const;
 
+    /**
+    * @brief Returns the ids of the filter's collision groups
+    *
+    * @return
+    *   The ids of the first and second collision group, see
+    *   CollisionComponent::collisionGroupId()
+    */
+    const std::pair<unsigned int, unsigned int>&
+    getCollisionGroupIds() const;
+
     /**
     * @brief Returns the signature of the collision filter
     *
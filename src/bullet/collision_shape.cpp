@@ -337,9 +337,9 @@ CompoundShape::storage() const {
             "compoundRotation", 
             childShape.rotation
         );
-        childShapes.push_back(childStorage);
+        childShapes.append(std::move(childStorage));
     }
-    storage.set<StorageList>("childShapes", childShapes);
+    storage.set<StorageList>("childShapes", std::move(childShapes));
     return storage;
 }
 
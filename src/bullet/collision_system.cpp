@@ -9,6 +9,10 @@
 #include "engine/entity_manager.h"
 #include "engine/serialization.h"
 #include "bullet/rigid_body_system.h"
+#include <algorithm>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <stdexcept>
 #include <unordered_map>
 
 #include "util/pair_hash.h"
@@ -25,8 +29,8 @@ CollisionComponent::CollisionComponent(){}
 
 CollisionComponent::CollisionComponent(
     const std::string& collisionGroup
-) : m_collisionGroups({collisionGroup})
-{
+) {
+    this->addCollisionGroup(collisionGroup);
 }
 
 luabind::scope
@@ -45,17 +49,47 @@ CollisionComponent::luaBindings() {
     ;
 }
 
+unsigned int
+CollisionComponent::collisionGroupId(
+    const std::string& group
+) {
+    static boost::mutex mutex;
+    static std::unordered_map<std::string, unsigned int> groupIds;
+    boost::lock_guard<boost::mutex> lock(mutex);
+    auto iter = groupIds.find(group);
+    if (iter != groupIds.end()) {
+        return iter->second;
+    }
+    if (groupIds.size() >= MAX_COLLISION_GROUPS) {
+        throw std::runtime_error("Too many collision groups: " + group);
+    }
+    unsigned int groupId = groupIds.size();
+    groupIds.emplace(group, groupId);
+    return groupId;
+}
+
 void
 CollisionComponent::addCollisionGroup(
     const std::string& group
 ) {
+    CollisionGroupMask bit = CollisionGroupMask(1) << collisionGroupId(group);
+    if (m_collisionGroupMask & bit) {
+        return;
+    }
+    m_collisionGroupMask |= bit;
     m_collisionGroups.push_back(group);
 }
 
+CollisionComponent::CollisionGroupMask
+CollisionComponent::collisionGroupMask() const {
+    return m_collisionGroupMask;
+}
+
 void
 CollisionComponent::removeCollisionGroup(
     const std::string& group
 ) {
+    m_collisionGroupMask &= ~(CollisionGroupMask(1) << collisionGroupId(group));
     m_collisionGroups.erase(std::remove(m_collisionGroups.begin(), m_collisionGroups.end(), group), m_collisionGroups.end());
 }
 
@@ -72,8 +106,9 @@ CollisionComponent::load(
     StorageList collisionGroups = storage.get<StorageList>("collisionGroups");
     m_collisionGroups.reserve(collisionGroups.size());
     for (const StorageContainer& container : collisionGroups) {
-        std::string collisionGroup = container.get<std::string>("collisionGroup");
-        m_collisionGroups.push_back(collisionGroup);
+        this->addCollisionGroup(
+            container.get<std::string>("collisionGroup")
+        );
     }
 }
 
@@ -87,13 +122,14 @@ CollisionComponent::storage() const {
     for (std::string collisionGroup : m_collisionGroups) {
         StorageContainer container;
         container.set<std::string>("collisionGroup", collisionGroup);
-        collisionGroups.append(container);
+        collisionGroups.append(std::move(container));
     }
-    storage.set<StorageList>("collisionGroups", collisionGroups);
+    storage.set<StorageList>("collisionGroups", std::move(collisionGroups));
     return storage;
 }
 
 REGISTER_COMPONENT(CollisionComponent)
+REGISTER_COMPONENT_CLONER(CollisionComponent)
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -130,9 +166,30 @@ Collision::luaBindings() {
 
 struct CollisionSystem::Implementation {
 
-    btDiscreteDynamicsWorld* m_world = nullptr;
+    Implementation()
+      : m_filteredPartners(CollisionComponent::MAX_COLLISION_GROUPS, 0),
+        m_filters(CollisionComponent::MAX_COLLISION_GROUPS * CollisionComponent::MAX_COLLISION_GROUPS)
+    {
+    }
+
+    std::vector<CollisionFilter*>&
+    filters(
+        unsigned int groupId1,
+        unsigned int groupId2
+    ) {
+        return m_filters[groupId1 * CollisionComponent::MAX_COLLISION_GROUPS + groupId2];
+    }
+
+    // Bit g is set if there is a filter with g as its first group
+    CollisionComponent::CollisionGroupMask m_filteredGroups = 0;
+
+    // Bit i of entry g is set if there is a filter for groups (g, i)
+    std::vector<CollisionComponent::CollisionGroupMask> m_filteredPartners;
 
-    std::unordered_multimap<CollisionFilter::Signature, CollisionFilter&>  m_collisionFilterMap;
+    // Filters by the ids of their two groups
+    std::vector<std::vector<CollisionFilter*>> m_filters;
+
+    btDiscreteDynamicsWorld* m_world = nullptr;
 
 };
 
@@ -191,26 +248,21 @@ CollisionSystem::update(int milliseconds) {
                                         );
         if (collisionComponent1 && collisionComponent2)
         {
-            std::vector<std::string> collisionGroups1 = collisionComponent1->getCollisionGroups();
-            std::vector<std::string> collisionGroups2 = collisionComponent2->getCollisionGroups();
-            std::vector<CollisionFilter::Signature> collisionGroupCombinations(collisionGroups1.size() * collisionGroups2.size());
-            for(std::string collisionGroup1 : collisionGroups1)
-            {
-                for(std::string collisionGroup2 : collisionGroups2)
-                {
-                    collisionGroupCombinations.emplace_back(
-                        collisionGroup1,
-                        collisionGroup2
-                    );
+            CollisionComponent::CollisionGroupMask groups1 =
+                collisionComponent1->collisionGroupMask() & m_impl->m_filteredGroups;
+            CollisionComponent::CollisionGroupMask groups2 = collisionComponent2->collisionGroupMask();
+            for (unsigned int groupId1 = 0; groups1; ++groupId1, groups1 >>= 1) {
+                if (not (groups1 & 1)) {
+                    continue;
                 }
-            }
-            for(CollisionFilter::Signature collisionSignature : collisionGroupCombinations)
-            {
-                auto filterIterators = m_impl->m_collisionFilterMap.equal_range(collisionSignature);//Get iterators for group of relevant CollisionFilters
-                for(auto it = filterIterators.first; it != filterIterators.second; ++it)        // Foreach CollisionFilter object
-                {
-                    Collision collision = Collision(entityId1, entityId2, milliseconds);
-                    it->second.addCollision(collision);
+                CollisionComponent::CollisionGroupMask partners = m_impl->m_filteredPartners[groupId1] & groups2;
+                for (unsigned int groupId2 = 0; partners; ++groupId2, partners >>= 1) {
+                    if (not (partners & 1)) {
+                        continue;
+                    }
+                    for (CollisionFilter* filter : m_impl->filters(groupId1, groupId2)) {
+                        filter->addCollision(Collision(entityId1, entityId2, milliseconds));
+                    }
                 }
             }
         }
@@ -223,15 +275,24 @@ void
 CollisionSystem::registerCollisionFilter(
     CollisionFilter& collisionFilter
 ) {
-    m_impl->m_collisionFilterMap.emplace(
-        collisionFilter.getCollisionSignature(),
-        collisionFilter
-    );
+    auto groupIds = collisionFilter.getCollisionGroupIds();
+    m_impl->filters(groupIds.first, groupIds.second).push_back(&collisionFilter);
+    m_impl->m_filteredPartners[groupIds.first] |= CollisionComponent::CollisionGroupMask(1) << groupIds.second;
+    m_impl->m_filteredGroups |= CollisionComponent::CollisionGroupMask(1) << groupIds.first;
 }
 
 void
 CollisionSystem::unregisterCollisionFilter(
     CollisionFilter& collisionFilter
 ) {
-    m_impl->m_collisionFilterMap.erase(collisionFilter.getCollisionSignature());
+    auto groupIds = collisionFilter.getCollisionGroupIds();
+    auto& filters = m_impl->filters(groupIds.first, groupIds.second);
+    filters.erase(std::remove(filters.begin(), filters.end(), &collisionFilter), filters.end());
+    if (filters.empty()) {
+        auto& partners = m_impl->m_filteredPartners[groupIds.first];
+        partners &= ~(CollisionComponent::CollisionGroupMask(1) << groupIds.second);
+        if (not partners) {
+            m_impl->m_filteredGroups &= ~(CollisionComponent::CollisionGroupMask(1) << groupIds.first);
+        }
+    }
 }
@@ -4,7 +4,9 @@
 #include "engine/system.h"
 #include "engine/typedefs.h"
 
+#include <cstdint>
 #include <iostream>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -18,12 +20,46 @@ class CollisionFilter;
 
 /**
 * @brief A component for a collision reactive entity
+*
+* Collision group names are interned to small ids when they are first used,
+* and each component keeps its groups as a bitmask, so that the
+* CollisionSystem can match contacts against filters without comparing
+* strings.
 */
 class CollisionComponent : public Component {
     COMPONENT(CollisionComponent)
 
 public:
 
+    /**
+    * @brief Bit \c i is set if the component is in the group with id \c i
+    */
+    using CollisionGroupMask = uint64_t;
+
+    /**
+    * @brief The maximum number of distinct collision group names
+    */
+    static const unsigned int MAX_COLLISION_GROUPS = 64;
+
+    /**
+    * @brief Returns the id of a collision group name
+    *
+    * Ids are assigned on first use and shared by all game states.
+    *
+    * @param group
+    *   The collision group's name
+    *
+    * @return
+    *   The group's id, smaller than MAX_COLLISION_GROUPS
+    *
+    * @throws std::runtime_error
+    *   If there are too many collision groups
+    */
+    static unsigned int
+    collisionGroupId(
+        const std::string& group
+    );
+
     /**
     * @brief Constructor
     */
@@ -78,6 +114,17 @@ public:
         const std::string& group
     );
 
+    /**
+    * @brief The component's collision groups as a bitmask
+    *
+    * @see collisionGroupId()
+    */
+    CollisionGroupMask
+    collisionGroupMask() const;
+
+    /**
+    * @brief The names of the component's collision groups
+    */
     const std::vector<std::string>&
     getCollisionGroups();
 
@@ -102,6 +149,8 @@ public:
 
 private:
 
+    CollisionGroupMask m_collisionGroupMask = 0;
+
     std::vector<std::string> m_collisionGroups;
 
 };
@@ -286,6 +286,7 @@ struct BulletDebugDrawSystem::Implementation {
 BulletDebugDrawSystem::BulletDebugDrawSystem()
   : m_impl(new Implementation())
 {
+    this->setPhase(System::Phase::Render);
 }
 
 
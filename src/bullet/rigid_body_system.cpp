@@ -1,9 +1,11 @@
 #include "bullet/rigid_body_system.h"
 
 #include "bullet/bullet_ogre_conversion.h"
+#include "engine/component_collection.h"
 #include "engine/component_factory.h"
 #include "engine/game_state.h"
 #include "engine/entity_filter.h"
+#include "engine/entity_manager.h"
 #include "scripting/luabind.h"
 #include "engine/serialization.h"
 
@@ -45,6 +47,7 @@ RigidBodyComponent::applyImpulse(
     m_impulseQueue.push_back(
         std::make_pair(impulse, relativePosition)
     );
+    this->touch();
 }
 
 
@@ -53,6 +56,7 @@ RigidBodyComponent::applyTorque(
     const Ogre::Vector3& torque
 ) {
     m_torque += torque;
+    this->touch();
 }
 
 luabind::scope
@@ -133,6 +137,8 @@ RigidBodyComponent::setWorldTransform(
 ) {
     m_dynamicProperties.position = bulletToOgre(transform.getOrigin());
     m_dynamicProperties.rotation = bulletToOgre(transform.getRotation());
+    // Not touched, that would feed Bullet's own result back into it
+    this->markUnsavedChange();
 }
 
 
@@ -159,6 +165,7 @@ RigidBodyComponent::storage() const {
 }
 
 REGISTER_COMPONENT(RigidBodyComponent)
+REGISTER_COMPONENT_CLONER(RigidBodyComponent)
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -176,6 +183,8 @@ RigidBodyInputSystem::luaBindings() {
 
 struct RigidBodyInputSystem::Implementation {
 
+    unsigned int m_changeTracker = 0;
+
     EntityFilter<
         RigidBodyComponent
     > m_entities = {true};
@@ -204,11 +213,17 @@ RigidBodyInputSystem::init(
     assert(m_impl->m_world == nullptr && "Double init of system");
     m_impl->m_world = gameState->physicsWorld();
     m_impl->m_entities.setEntityManager(&gameState->entityManager());
+    m_impl->m_changeTracker = this->entityManager()->getComponentCollection(
+        RigidBodyComponent::TYPE_ID
+    ).enableChangeTracking();
 }
 
 
 void
 RigidBodyInputSystem::shutdown() {
+    this->entityManager()->getComponentCollection(
+        RigidBodyComponent::TYPE_ID
+    ).disableChangeTracking(m_impl->m_changeTracker);
     m_impl->m_entities.setEntityManager(nullptr);
     m_impl->m_world = nullptr;
     System::shutdown();
@@ -248,11 +263,20 @@ RigidBodyInputSystem::update(int milliseconds) {
             rigidBodyComponent->m_collisionFilterMask
         );
         m_impl->m_bodies[entityId] = std::move(rigidBody);
+        // Apply the properties below
+        rigidBodyComponent->touch();
     }
     m_impl->m_entities.clearChanges();
-    for (const auto& value : m_impl->m_entities) {
-        RigidBodyComponent* rigidBodyComponent = std::get<0>(value.second);
+    auto& collection = this->entityManager()->getComponentCollection(
+        RigidBodyComponent::TYPE_ID
+    );
+    for (Component* component : collection.takeChangedComponents(m_impl->m_changeTracker)) {
+        RigidBodyComponent* rigidBodyComponent = static_cast<RigidBodyComponent*>(component);
         btRigidBody* body = rigidBodyComponent->m_body;
+        // Components without a body yet are touched when it is created
+        if (not body) {
+            continue;
+        }
         auto& properties = rigidBodyComponent->m_properties;
         if (properties.hasChanges()) {
             btVector3 localInertia;
@@ -320,7 +344,15 @@ RigidBodyInputSystem::update(int milliseconds) {
             );
             rigidBodyComponent->m_torque = Ogre::Vector3::ZERO;
         }
-        body->applyDamping(milliseconds / 1000.0f);
+    }
+    // Sleeping and static bodies have no velocity to damp, so only the
+    // active ones need to be visited
+    const btCollisionObjectArray& objects = m_impl->m_world->getCollisionObjectArray();
+    for (int i = 0; i < objects.size(); ++i) {
+        btRigidBody* body = btRigidBody::upcast(objects[i]);
+        if (body and body->isActive()) {
+            body->applyDamping(milliseconds / 1000.0f);
+        }
     }
 }
 
@@ -372,7 +404,7 @@ RigidBodyOutputSystem::shutdown() {
 
 void
 RigidBodyOutputSystem::update(int) {
-    for (auto& value : m_impl->m_entities.entities()) {
+    for (auto& value : m_impl->m_entities) {
         RigidBodyComponent* rigidBodyComponent = std::get<0>(value.second);
         btRigidBody* rigidBody = rigidBodyComponent->m_body;
         auto& dynamicProperties = rigidBodyComponent->m_dynamicProperties;
@@ -380,6 +412,7 @@ RigidBodyOutputSystem::update(int) {
         if (rigidBody->isActive()) {
             dynamicProperties.linearVelocity = bulletToOgre(rigidBody->getLinearVelocity());
             dynamicProperties.angularVelocity = bulletToOgre(rigidBody->getAngularVelocity());
+            rigidBodyComponent->markUnsavedChange();
         }
         else if (
             not dynamicProperties.linearVelocity.isZeroLength()
@@ -387,6 +420,7 @@ RigidBodyOutputSystem::update(int) {
         ) {
             dynamicProperties.linearVelocity = Ogre::Vector3::ZERO;
             dynamicProperties.angularVelocity = Ogre::Vector3::ZERO;
+            rigidBodyComponent->markUnsavedChange();
         }
     }
 }
@@ -164,6 +164,29 @@ public:
     ) : m_collisionFilterGroup(collisionFilterGroup),
         m_collisionFilterMask(collisionFilterMask)
     {
+        m_dynamicProperties.setComponent(this);
+        m_properties.setComponent(this);
+    }
+
+    /**
+    * @brief Copy constructor
+    *
+    * The copy shares the collision shape and gets its own body once it is
+    * added to an entity.
+    */
+    RigidBodyComponent(
+        const RigidBodyComponent& other
+    ) : Component(other),
+        btMotionState(other),
+        m_collisionFilterGroup(other.m_collisionFilterGroup),
+        m_collisionFilterMask(other.m_collisionFilterMask),
+        m_dynamicProperties(other.m_dynamicProperties),
+        m_impulseQueue(other.m_impulseQueue),
+        m_torque(other.m_torque),
+        m_properties(other.m_properties)
+    {
+        m_dynamicProperties.setComponent(this);
+        m_properties.setComponent(this);
     }
 
     /**
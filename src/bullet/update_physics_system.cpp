@@ -1,5 +1,6 @@
 #include "bullet/update_physics_system.h"
 
+#include "engine/engine.h"
 #include "engine/game_state.h"
 #include "scripting/luabind.h"
 
@@ -20,6 +21,8 @@ UpdatePhysicsSystem::luaBindings() {
 
 struct UpdatePhysicsSystem::Implementation {
 
+    const Engine* m_engine = nullptr;
+
     btDiscreteDynamicsWorld* m_world;
 
 };
@@ -39,6 +42,7 @@ UpdatePhysicsSystem::init(
     GameState* gameState
 ) {
     System::init(gameState);
+    m_impl->m_engine = &gameState->engine();
     m_impl->m_world = gameState->physicsWorld();
     assert(m_impl->m_world != nullptr && "World object is null. Initialize the Engine first.");
 }
@@ -46,6 +50,7 @@ UpdatePhysicsSystem::init(
 
 void
 UpdatePhysicsSystem::shutdown() {
+    m_impl->m_engine = nullptr;
     m_impl->m_world = nullptr;
     System::shutdown();
 }
@@ -56,6 +61,14 @@ UpdatePhysicsSystem::update(
     int milliSeconds
 ) {
     assert(m_impl->m_world != nullptr && "UpdatePhysicsSystem not initialized");
-    m_impl->m_world->stepSimulation(milliSeconds/1000.f,10);
+    if (milliSeconds <= 0) {
+        return;
+    }
+    // Take exactly one physics step of the fixed tick duration. The whole
+    // milliseconds passed in vary between ticks, see
+    // Engine::tickDuration(). Bullet's own catch-up substeps would make
+    // slow frames slower still.
+    btScalar seconds = m_impl->m_engine->tickDuration().count() / 1e6;
+    m_impl->m_world->stepSimulation(seconds, 1, seconds);
 }
 
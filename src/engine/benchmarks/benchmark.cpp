@@ -0,0 +1,284 @@
+#include "engine/benchmarks/benchmark.h"
+
+#include "engine/thread_pool.h"
+
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace thrive;
+
+namespace {
+
+struct Benchmark {
+
+    std::string name;
+
+    BenchmarkFunction function;
+
+};
+
+
+struct Result {
+
+    std::map<std::string, double> counters;
+
+    size_t entityCount;
+
+    double meanNanoseconds;
+
+    double medianNanoseconds;
+
+    double minNanoseconds;
+
+    std::string name;
+
+    unsigned int repetitions;
+
+};
+
+
+struct Options {
+
+    std::string filter;
+
+    std::string outputFile;
+
+    unsigned int repetitions = 5;
+
+    std::vector<size_t> sizes = {1000, 10000, 100000, 1000000};
+
+};
+
+
+std::vector<Benchmark>&
+benchmarks() {
+    // Function local, so that registrations in other translation units
+    // find it constructed
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+
+bool
+parseOptions(
+    int argc,
+    char* argv[],
+    Options& options
+) {
+    static const std::string FILTER_OPTION = "--filter=";
+    static const std::string OUTPUT_OPTION = "--output=";
+    static const std::string REPETITIONS_OPTION = "--repetitions=";
+    static const std::string SIZES_OPTION = "--sizes=";
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (boost::starts_with(argument, FILTER_OPTION)) {
+            options.filter = argument.substr(FILTER_OPTION.size());
+        }
+        else if (boost::starts_with(argument, OUTPUT_OPTION)) {
+            options.outputFile = argument.substr(OUTPUT_OPTION.size());
+        }
+        else if (boost::starts_with(argument, REPETITIONS_OPTION)) {
+            int repetitions = std::atoi(argument.c_str() + REPETITIONS_OPTION.size());
+            if (repetitions <= 0) {
+                std::cerr << "Invalid repetitions: " << argument << std::endl;
+                return false;
+            }
+            options.repetitions = repetitions;
+        }
+        else if (boost::starts_with(argument, SIZES_OPTION)) {
+            options.sizes.clear();
+            std::istringstream sizes(argument.substr(SIZES_OPTION.size()));
+            std::string size;
+            while (std::getline(sizes, size, ',')) {
+                long value = std::atol(size.c_str());
+                if (value <= 0) {
+                    std::cerr << "Invalid size: " << size << std::endl;
+                    return false;
+                }
+                options.sizes.push_back(value);
+            }
+        }
+        else {
+            if (argument != "--help") {
+                std::cerr << "Unknown argument: " << argument << std::endl;
+            }
+            std::cerr << "Usage: " << argv[0]
+                << " [--filter=SUBSTRING] [--output=FILE]"
+                << " [--repetitions=N] [--sizes=N,N,...]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+Result
+runBenchmark(
+    const Benchmark& benchmark,
+    size_t entityCount,
+    unsigned int repetitions
+) {
+    Result result;
+    result.entityCount = entityCount;
+    result.name = benchmark.name;
+    result.repetitions = repetitions;
+    std::vector<double> durations;
+    for (unsigned int i = 0; i < repetitions; ++i) {
+        BenchmarkRun run(entityCount);
+        benchmark.function(run);
+        durations.push_back(run.duration().count());
+        result.counters = run.counters();
+    }
+    std::sort(durations.begin(), durations.end());
+    double total = 0.0;
+    for (double duration : durations) {
+        total += duration;
+    }
+    result.meanNanoseconds = total / durations.size();
+    result.medianNanoseconds = durations[durations.size() / 2];
+    result.minNanoseconds = durations.front();
+    return result;
+}
+
+
+void
+writeJson(
+    std::ostream& stream,
+    const std::vector<Result>& results
+) {
+    stream << std::setprecision(15);
+    stream << "{\n  \"threads\": " << ThreadPool::shared().workerCount() + 1
+        << ",\n  \"benchmarks\": [";
+    bool isFirst = true;
+    for (const Result& result : results) {
+        stream << (isFirst ? "\n" : ",\n");
+        isFirst = false;
+        stream << "    {\"name\": \"" << result.name << "\""
+            << ", \"entities\": " << result.entityCount
+            << ", \"repetitions\": " << result.repetitions
+            << ", \"minNs\": " << result.minNanoseconds
+            << ", \"medianNs\": " << result.medianNanoseconds
+            << ", \"meanNs\": " << result.meanNanoseconds
+            << ", \"nsPerEntity\": " << result.medianNanoseconds / result.entityCount
+            << ", \"counters\": {";
+        bool isFirstCounter = true;
+        for (const auto& counter : result.counters) {
+            stream << (isFirstCounter ? "" : ", ");
+            isFirstCounter = false;
+            stream << "\"" << counter.first << "\": " << counter.second;
+        }
+        stream << "}}";
+    }
+    stream << "\n  ]\n}\n";
+}
+
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// BenchmarkRun
+////////////////////////////////////////////////////////////////////////////////
+
+BenchmarkRun::BenchmarkRun(
+    size_t entityCount
+) : m_entityCount(entityCount)
+{
+}
+
+
+const std::map<std::string, double>&
+BenchmarkRun::counters() const {
+    return m_counters;
+}
+
+
+boost::chrono::nanoseconds
+BenchmarkRun::duration() const {
+    return m_duration;
+}
+
+
+size_t
+BenchmarkRun::entityCount() const {
+    return m_entityCount;
+}
+
+
+void
+BenchmarkRun::setCounter(
+    const std::string& name,
+    double value
+) {
+    m_counters[name] = value;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// BenchmarkRegistration
+////////////////////////////////////////////////////////////////////////////////
+
+BenchmarkRegistration::BenchmarkRegistration(
+    const std::string& name,
+    BenchmarkFunction function
+) {
+    benchmarks().push_back(Benchmark{name, function});
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// main
+////////////////////////////////////////////////////////////////////////////////
+
+int
+main(
+    int argc,
+    char* argv[]
+) {
+    Options options;
+    if (not parseOptions(argc, argv, options)) {
+        return EXIT_FAILURE;
+    }
+    std::vector<Benchmark> selected;
+    for (const Benchmark& benchmark : benchmarks()) {
+        if (benchmark.name.find(options.filter) != std::string::npos) {
+            selected.push_back(benchmark);
+        }
+    }
+    std::sort(
+        selected.begin(),
+        selected.end(),
+        [] (const Benchmark& lhs, const Benchmark& rhs) {
+            return lhs.name < rhs.name;
+        }
+    );
+    std::vector<Result> results;
+    for (const Benchmark& benchmark : selected) {
+        for (size_t entityCount : options.sizes) {
+            Result result = runBenchmark(benchmark, entityCount, options.repetitions);
+            // Progress goes to stderr, so stdout stays valid JSON
+            std::cerr << result.name << " [" << entityCount << "]: "
+                << result.medianNanoseconds / 1e6 << " ms, "
+                << result.medianNanoseconds / entityCount << " ns/entity"
+                << std::endl;
+            results.push_back(result);
+        }
+    }
+    if (options.outputFile.empty()) {
+        writeJson(std::cout, results);
+    }
+    else {
+        std::ofstream stream(options.outputFile);
+        writeJson(stream, results);
+        if (not stream) {
+            std::cerr << "Could not write " << options.outputFile << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
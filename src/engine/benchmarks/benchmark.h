@@ -0,0 +1,142 @@
+#pragma once
+
+#include <boost/chrono.hpp>
+#include <functional>
+#include <map>
+#include <string>
+
+namespace thrive {
+
+/**
+* @brief One run of a benchmark at a given entity count
+*
+* The benchmark function sets up its data, then wraps the operation it
+* measures in a call to measure(). Only the time spent inside measure() is
+* reported.
+*/
+class BenchmarkRun {
+
+public:
+
+    /**
+    * @brief Constructor
+    *
+    * @param entityCount
+    *   The number of entities the benchmark should work on
+    */
+    explicit BenchmarkRun(
+        size_t entityCount
+    );
+
+    /**
+    * @brief Additional numbers reported with the result
+    */
+    const std::map<std::string, double>&
+    counters() const;
+
+    /**
+    * @brief The total time spent in measure()
+    */
+    boost::chrono::nanoseconds
+    duration() const;
+
+    /**
+    * @brief The number of entities the benchmark should work on
+    */
+    size_t
+    entityCount() const;
+
+    /**
+    * @brief Runs and times the measured operation
+    *
+    * @param function
+    *   The operation to time
+    */
+    template<typename Function>
+    void
+    measure(
+        Function function
+    ) {
+        auto start = Clock::now();
+        function();
+        m_duration += Clock::now() - start;
+    }
+
+    /**
+    * @brief Attaches a number to the result, e.g. the size of the data
+    *
+    * @param name
+    *   The number's name
+    * @param value
+    *   The number
+    */
+    void
+    setCounter(
+        const std::string& name,
+        double value
+    );
+
+private:
+
+    using Clock = boost::chrono::high_resolution_clock;
+
+    std::map<std::string, double> m_counters;
+
+    boost::chrono::nanoseconds m_duration{0};
+
+    size_t m_entityCount;
+
+};
+
+/**
+* @brief A function that sets up and measures one run
+*/
+using BenchmarkFunction = std::function<void(BenchmarkRun&)>;
+
+/**
+* @brief Adds a benchmark to the \c thrive_bench executable on construction
+*
+* You should probably use the BENCHMARK macro instead of using this
+* directly.
+*/
+class BenchmarkRegistration {
+
+public:
+
+    /**
+    * @brief Constructor
+    *
+    * @param name
+    *   The benchmark's name, usually "Class.operation"
+    * @param function
+    *   The benchmark
+    */
+    BenchmarkRegistration(
+        const std::string& name,
+        BenchmarkFunction function
+    );
+
+};
+
+}
+
+/**
+* @brief Defines and registers a benchmark
+*
+* Usage example:
+* \code
+* BENCHMARK(EntityFilter, iterate) {
+*     // Set up run.entityCount() entities
+*     run.measure([&] () {
+*         // Iterate over them
+*     });
+* }
+* \endcode
+*/
+#define BENCHMARK(group, name) \
+    static void group##_##name##_benchmark(thrive::BenchmarkRun& run); \
+    static thrive::BenchmarkRegistration group##_##name##_registration( \
+        #group "." #name, \
+        group##_##name##_benchmark \
+    ); \
+    static void group##_##name##_benchmark(thrive::BenchmarkRun& run)
@@ -0,0 +1,66 @@
+#include "engine/benchmarks/benchmark_components.h"
+
+#include "engine/component_factory.h"
+#include "engine/entity_manager.h"
+#include "util/make_unique.h"
+
+using namespace thrive;
+
+REGISTER_COMPONENT(BenchmarkPosition)
+
+
+void
+BenchmarkPosition::load(
+    const StorageContainer& storage
+) {
+    Component::load(storage);
+    m_position = storage.get<Ogre::Vector3>("position");
+}
+
+
+StorageContainer
+BenchmarkPosition::storage() const {
+    StorageContainer storage = Component::storage();
+    storage.set<Ogre::Vector3>("position", m_position);
+    return storage;
+}
+
+
+REGISTER_COMPONENT(BenchmarkVelocity)
+
+
+void
+BenchmarkVelocity::load(
+    const StorageContainer& storage
+) {
+    Component::load(storage);
+    m_velocity = storage.get<Ogre::Vector3>("velocity");
+}
+
+
+StorageContainer
+BenchmarkVelocity::storage() const {
+    StorageContainer storage = Component::storage();
+    storage.set<Ogre::Vector3>("velocity", m_velocity);
+    return storage;
+}
+
+
+std::vector<EntityId>
+thrive::populate(
+    EntityManager& entityManager,
+    size_t count
+) {
+    std::vector<EntityId> entities;
+    entities.reserve(count);
+    EntityManager::Batch batch(entityManager);
+    for (size_t i = 0; i < count; ++i) {
+        EntityId entityId = entityManager.generateNewId();
+        entityManager.addComponent(entityId, make_unique<BenchmarkPosition>());
+        if (i % 2 == 0) {
+            entityManager.addComponent(entityId, make_unique<BenchmarkVelocity>());
+        }
+        entities.push_back(entityId);
+    }
+    return entities;
+}
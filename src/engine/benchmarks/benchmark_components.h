@@ -0,0 +1,74 @@
+#pragma once
+
+#include "engine/component.h"
+#include "engine/serialization.h"
+#include "engine/typedefs.h"
+
+#include <OgreVector3.h>
+#include <vector>
+
+namespace thrive {
+
+class EntityManager;
+
+/**
+* @brief A position, the typical component present on every entity
+*/
+class BenchmarkPosition : public Component {
+    COMPONENT(BenchmarkPosition)
+
+public:
+
+    void
+    load(
+        const StorageContainer& storage
+    ) override;
+
+    StorageContainer
+    storage() const override;
+
+    Ogre::Vector3 m_position = Ogre::Vector3::ZERO;
+
+};
+
+/**
+* @brief A velocity, present on every other entity
+*/
+class BenchmarkVelocity : public Component {
+    COMPONENT(BenchmarkVelocity)
+
+public:
+
+    void
+    load(
+        const StorageContainer& storage
+    ) override;
+
+    StorageContainer
+    storage() const override;
+
+    Ogre::Vector3 m_velocity = Ogre::Vector3(1, 0, 0);
+
+};
+
+/**
+* @brief Creates entities for a benchmark
+*
+* Every entity gets a BenchmarkPosition, every other entity a
+* BenchmarkVelocity as well.
+*
+* @param entityManager
+*   The entity manager to add the entities to
+* @param count
+*   The number of entities to create
+*
+* @return
+*   The new entities' ids
+*/
+std::vector<EntityId>
+populate(
+    EntityManager& entityManager,
+    size_t count
+);
+
+}
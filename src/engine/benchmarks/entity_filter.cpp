@@ -0,0 +1,54 @@
+#include "engine/entity_filter.h"
+
+#include "engine/benchmarks/benchmark.h"
+#include "engine/benchmarks/benchmark_components.h"
+#include "engine/entity_manager.h"
+
+using namespace thrive;
+
+
+BENCHMARK(EntityFilter, create) {
+    EntityManager entityManager;
+    populate(entityManager, run.entityCount());
+    EntityFilter<BenchmarkPosition, BenchmarkVelocity> filter;
+    run.measure([&] () {
+        filter.setEntityManager(&entityManager);
+    });
+    run.setCounter("matches", filter.entities().size());
+    filter.setEntityManager(nullptr);
+}
+
+
+BENCHMARK(EntityFilter, iterate) {
+    EntityManager entityManager;
+    populate(entityManager, run.entityCount());
+    EntityFilter<BenchmarkPosition, BenchmarkVelocity> filter;
+    filter.setEntityManager(&entityManager);
+    run.measure([&] () {
+        for (auto& value : filter) {
+            BenchmarkPosition* position = std::get<0>(value.second);
+            BenchmarkVelocity* velocity = std::get<1>(value.second);
+            position->m_position += velocity->m_velocity;
+        }
+    });
+    filter.setEntityManager(nullptr);
+}
+
+
+BENCHMARK(EntityFilter, parallelForEach) {
+    EntityManager entityManager;
+    populate(entityManager, run.entityCount());
+    EntityFilter<BenchmarkPosition, BenchmarkVelocity> filter;
+    filter.setEntityManager(&entityManager);
+    using ComponentGroup = decltype(filter)::ComponentGroup;
+    run.measure([&] () {
+        filter.parallelForEach(
+            [] (EntityId, const ComponentGroup& group) {
+                BenchmarkPosition* position = std::get<0>(group);
+                BenchmarkVelocity* velocity = std::get<1>(group);
+                position->m_position += velocity->m_velocity;
+            }
+        );
+    });
+    filter.setEntityManager(nullptr);
+}
@@ -0,0 +1,85 @@
+#include "engine/entity_manager.h"
+
+#include "engine/benchmarks/benchmark.h"
+#include "engine/benchmarks/benchmark_components.h"
+#include "engine/entity_filter.h"
+#include "util/make_unique.h"
+
+#include <memory>
+#include <vector>
+
+using namespace thrive;
+
+
+static std::vector<std::unique_ptr<Component>>
+createPositions(
+    size_t count
+) {
+    std::vector<std::unique_ptr<Component>> components;
+    components.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        components.emplace_back(make_unique<BenchmarkPosition>());
+    }
+    return components;
+}
+
+
+BENCHMARK(EntityManager, addComponent) {
+    EntityManager entityManager;
+    // Allocate outside of the measurement, only adding is timed
+    auto components = createPositions(run.entityCount());
+    run.measure([&] () {
+        for (auto& component : components) {
+            entityManager.addComponent(
+                entityManager.generateNewId(),
+                std::move(component)
+            );
+        }
+    });
+}
+
+
+BENCHMARK(EntityManager, addComponentFiltered) {
+    EntityManager entityManager;
+    EntityFilter<BenchmarkPosition> filter;
+    filter.setEntityManager(&entityManager);
+    auto components = createPositions(run.entityCount());
+    run.measure([&] () {
+        for (auto& component : components) {
+            entityManager.addComponent(
+                entityManager.generateNewId(),
+                std::move(component)
+            );
+        }
+        // The filter applies the additions when it's accessed
+        filter.entities();
+    });
+    filter.setEntityManager(nullptr);
+}
+
+
+BENCHMARK(EntityManager, processRemovals) {
+    EntityManager entityManager;
+    EntityFilter<BenchmarkPosition, BenchmarkVelocity> filter;
+    filter.setEntityManager(&entityManager);
+    for (EntityId entityId : populate(entityManager, run.entityCount())) {
+        entityManager.removeEntity(entityId);
+    }
+    filter.entities();
+    run.measure([&] () {
+        entityManager.processRemovals();
+        filter.entities();
+    });
+    filter.setEntityManager(nullptr);
+}
+
+
+BENCHMARK(EntityManager, removeEntity) {
+    EntityManager entityManager;
+    std::vector<EntityId> entities = populate(entityManager, run.entityCount());
+    run.measure([&] () {
+        for (EntityId entityId : entities) {
+            entityManager.removeEntity(entityId);
+        }
+    });
+}
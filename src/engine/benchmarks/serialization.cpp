@@ -0,0 +1,31 @@
+#include "engine/serialization.h"
+
+#include "engine/benchmarks/benchmark.h"
+#include "engine/benchmarks/benchmark_components.h"
+#include "engine/component_factory.h"
+#include "engine/entity_manager.h"
+
+#include <sstream>
+
+using namespace thrive;
+
+
+BENCHMARK(StorageContainer, roundTrip) {
+    ComponentFactory factory;
+    EntityManager entityManager;
+    populate(entityManager, run.entityCount());
+    EntityManager restored;
+    size_t bytes = 0;
+    // Same steps as saving and loading a savegame
+    run.measure([&] () {
+        std::ostringstream outputStream(std::ios_base::out | std::ios_base::binary);
+        outputStream << entityManager.storage(factory);
+        std::string data = outputStream.str();
+        bytes = data.size();
+        std::istringstream inputStream(data, std::ios_base::in | std::ios_base::binary);
+        StorageContainer storage;
+        inputStream >> storage;
+        restored.restore(storage, factory);
+    });
+    run.setCounter("bytes", bytes);
+}
@@ -1,5 +1,6 @@
 #include "engine/component.h"
 
+#include "engine/component_collection.h"
 #include "engine/component_factory.h"
 #include "engine/engine.h"
 #include "engine/serialization.h"
@@ -37,6 +38,37 @@ struct ComponentWrapper : Component, luabind::wrap_base {
     {
     }
 
+    // All Lua component classes share the C++ layout of this wrapper, so
+    // they share one pool as well.
+    static ComponentPool&
+    componentPool() {
+        static ComponentPool* pool = ComponentPool::create(
+            "LuaComponent",
+            sizeof(ComponentWrapper)
+        );
+        return *pool;
+    }
+
+    static void*
+    operator new(
+        std::size_t size
+    ) {
+        return componentPool().allocate(size);
+    }
+
+    static void
+    operator delete(
+        void* pointer,
+        std::size_t size
+    ) {
+        componentPool().deallocate(pointer, size);
+    }
+
+    size_t
+    componentSize() const override {
+        return sizeof(ComponentWrapper);
+    }
+
     void
     load(
         const StorageContainer& storage
@@ -90,17 +122,41 @@ Component::luaBindings() {
         .def(constructor<lua_State*>())    
         .def("isVolatile", &Component::isVolatile)
         .def("load", &Component::load, &ComponentWrapper::default_load)
+        .def("markUnsavedChange", &Component::markUnsavedChange)
         .def("setVolatile", &Component::setVolatile)
         .def("storage", &Component::storage, &ComponentWrapper::default_storage)
+        .def("touch", &Component::touch)
         .def("typeId", &Component::typeId)
         .def("typeName", &Component::typeName)
     ;
 }
 
 
+Component::Component(
+    const Component& other
+) : m_isVolatile(other.m_isVolatile)
+{
+}
+
+
 Component::~Component() {}
 
 
+Component&
+Component::operator= (
+    const Component& other
+) {
+    m_isVolatile = other.m_isVolatile;
+    return *this;
+}
+
+
+size_t
+Component::componentSize() const {
+    return sizeof(Component);
+}
+
+
 bool
 Component::isVolatile() const {
     return m_isVolatile;
@@ -115,11 +171,26 @@ Component::load(
 }
 
 
+void
+Component::markUnsavedChange() {
+    ComponentCollection* collection = m_collection.load();
+    if (not collection or not collection->isJournaling()) {
+        return;
+    }
+    // Only the first mark since the last delta lists the component
+    if (not m_hasUnjournaledChanges.exchange(true)) {
+        collection->queueUnsavedChange(this);
+    }
+}
+
+
 void
 Component::setVolatile(
     bool isVolatile
 ) {
     m_isVolatile = isVolatile;
+    // Incremental savegames have to add or remove the component
+    this->markUnsavedChange();
 }
 
 
@@ -131,3 +202,16 @@ Component::storage() const {
 }
 
 
+void
+Component::touch() {
+    ComponentCollection* collection = m_collection.load();
+    if (not collection) {
+        return;
+    }
+    this->markUnsavedChange();
+    if (collection->isTrackingChanges()) {
+        collection->queueChanged(this);
+    }
+}
+
+
@@ -3,8 +3,10 @@
 */
 #pragma once
 
+#include "engine/component_pool.h"
 #include "engine/typedefs.h"
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -15,6 +17,7 @@ class scope;
 
 namespace thrive {
 
+class ComponentCollection;
 class StorageContainer;
 
 /**
@@ -46,11 +49,44 @@ public:
     static luabind::scope
     luaBindings();
 
+    /**
+    * @brief Constructor
+    */
+    Component() = default;
+
+    /**
+    * @brief Copy constructor
+    *
+    * The copy doesn't belong to any entity or collection
+    */
+    Component(
+        const Component& other
+    );
+
     /**
     * @brief Destructor
     */
     virtual ~Component() = 0;
 
+    /**
+    * @brief Copy assignment
+    *
+    * Copies the volatile flag only, the owner stays the same
+    */
+    Component&
+    operator= (
+        const Component& other
+    );
+
+    /**
+    * @brief The size of the component object in bytes
+    *
+    * Doesn't include memory the component allocates itself. Used for
+    * memory statistics, see EntityManager::collectionStatistics().
+    */
+    virtual size_t
+    componentSize() const;
+
     /**
     * @brief A volatile component is not serialized during a save
     *
@@ -69,6 +105,21 @@ public:
         const StorageContainer& storage
     ) = 0;
 
+    /**
+    * @brief Records a change for incremental savegames only
+    *
+    * For changes that systems don't need to react to, like physics
+    * results written back into the component. Unlike touch(), this doesn't
+    * list the component in ComponentCollection::takeChangedComponents().
+    * EntityManager::storageDelta() only saves components that have been
+    * added, touched or marked, so every other change to saved state must
+    * call this.
+    *
+    * This function is thread safe.
+    */
+    void
+    markUnsavedChange();
+
     /**
     * @brief The entity this component belongs to
     *
@@ -116,6 +167,22 @@ public:
     virtual StorageContainer
     storage() const = 0;
 
+    /**
+    * @brief Marks the component as changed
+    *
+    * If the component's collection tracks changes, the component is
+    * returned by the next ComponentCollection::takeChangedComponents() of
+    * every tracker.
+    *
+    * Touching one of the component's touchables calls this, see
+    * Touchable::setComponent(). The touch is also recorded for incremental
+    * savegames, see EntityManager::storageDelta().
+    *
+    * This function is thread safe.
+    */
+    void
+    touch();
+
     /**
     * @brief The component's type id
     */
@@ -132,6 +199,21 @@ protected:
 
 private:
 
+    friend class ComponentCollection;
+
+    // Reads and clears m_hasUnjournaledChanges
+    friend class EntityManager;
+
+    // One past the position of the latest change tracking entry for this
+    // component, 0 if there is none. See ComponentCollection::queueChanged().
+    std::atomic<uint64_t> m_changeSequence{0};
+
+    // Written by the collection under its change lock, read by touch()
+    std::atomic<ComponentCollection*> m_collection{nullptr};
+
+    // Listed in m_collection's unsaved changes, see markUnsavedChange()
+    std::atomic<bool> m_hasUnjournaledChanges{false};
+
     bool m_isVolatile = false;
 
     EntityId m_owner = NULL_ENTITY;
@@ -153,6 +235,13 @@ private:
 *   variable.
 * - \c typeName: Overrides Component::typeName() and returns the name returned
 *   by \c TYPE_NAME.
+* - \c componentSize: Overrides Component::componentSize() and returns the
+*   size of the component class.
+* - \c componentPool: Static function that returns the ComponentPool for this
+*   type. The pool is created by the first allocation, which also determines
+*   the pool's block size.
+* - \c operator \c new and \c operator \c delete: Allocate instances from
+*   the component pool instead of the general purpose heap.
 *
 * @param name 
 *   The component's name
@@ -184,6 +273,23 @@ private:
             return TYPE_NAME(); \
         } \
         \
+        std::size_t componentSize() const override { \
+            return sizeof(*this); \
+        } \
+        \
+        static thrive::ComponentPool& componentPool(std::size_t blockSize) { \
+            static thrive::ComponentPool* pool = thrive::ComponentPool::create(TYPE_NAME(), blockSize); \
+            return *pool; \
+        } \
+        \
+        static void* operator new(std::size_t size) { \
+            return componentPool(size).allocate(size); \
+        } \
+        \
+        static void operator delete(void* pointer, std::size_t size) { \
+            componentPool(size).deallocate(pointer, size); \
+        } \
+        \
     private: \
 
 
@@ -1,38 +1,128 @@
 #include "engine/component_collection.h"
 
+#include "engine/sparse_index.h"
 #include "util/contains.h"
 
+#include <algorithm>
+#include <atomic>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
 #include <unordered_set>
 
 #include <iostream>
 
 using namespace thrive;
 
+namespace {
+
+// Readers may always fall at least this many events behind
+const uint64_t MIN_EVENT_LAG = 4096;
+
+}
+
 struct ComponentCollection::Implementation {
 
     Implementation(
-        ComponentTypeId type
-    ) : m_type(type)
+        ComponentTypeId type,
+        unsigned int maskIndex
+    ) : m_maskIndex(maskIndex),
+        m_type(type)
     {
     }
 
-    std::unordered_map<
-        unsigned int, 
-        std::pair<ChangeCallback, ChangeCallback>
-    > m_changeCallbacks;
+    void
+    detachComponent(
+        Component* component
+    ) {
+        // Under the lock so that a concurrent touch() either logs the
+        // change before the component is removed here or sees it detached
+        boost::lock_guard<boost::mutex> lock(m_changesMutex);
+        component->m_collection = nullptr;
+    }
+
+    bool
+    isChangeUnread(
+        const Component* component
+    ) const {
+        // m_changeSequence is one past the entry's position, so this holds
+        // exactly when the entry is at or after every tracker's cursor
+        return component->m_changeSequence.load() > m_changesReadUpTo.load();
+    }
+
+    void
+    clearUnsavedFlags(
+        const std::vector<EntityId>& owners
+    ) {
+        for (EntityId entityId : owners) {
+            uint32_t position = this->find(entityId);
+            if (position != SparseIndex::NONE) {
+                m_components[position].second->m_hasUnjournaledChanges = false;
+            }
+        }
+    }
+
+    void
+    logEvent(
+        EntityId entityId,
+        Event::Type type
+    ) {
+        if (not m_events.hasReaders()) {
+            return;
+        }
+        // Rather than keeping events forever for a reader that doesn't
+        // read, let it rescan the collection
+        m_events.setMaxLag(std::max<uint64_t>(MIN_EVENT_LAG, 2 * m_components.size()));
+        m_events.append(Event{entityId, type});
+    }
+
+    // Owners of touched components, one reader per change tracker
+    EventLog<EntityId> m_changes;
 
-    std::unordered_map<EntityId, std::unique_ptr<Component>> m_components;
+    // Guards m_changes, m_unsavedChanges and the components' change
+    // sequences against concurrent touches
+    boost::mutex m_changesMutex;
 
-    unsigned int m_nextChangeCallbackId = 0;
+    // The end of m_changes when a tracker last read it or was added
+    std::atomic<uint64_t> m_changesReadUpTo{0};
+
+    std::atomic<unsigned int> m_changeTrackers{0};
+
+    // Trackers whose next take returns all components
+    std::vector<bool> m_needsFullChanges;
+
+    uint32_t
+    find(
+        EntityId entityId
+    ) const {
+        uint32_t position = m_index.get(entityId);
+        if (position < m_components.size() and m_components[position].first == entityId) {
+            return position;
+        }
+        return SparseIndex::NONE;
+    }
+
+    ComponentList m_components;
+
+    EventLog<Event> m_events;
+
+    SparseIndex m_index;
+
+    std::atomic<bool> m_isJournaling{false};
+
+    unsigned int m_maskIndex = 0;
 
     ComponentTypeId m_type = NULL_COMPONENT_TYPE;
 
+    // Owners of components marked since the last takeUnsavedChanges()
+    std::vector<EntityId> m_unsavedChanges;
+
 };
 
 
 ComponentCollection::ComponentCollection(
-    ComponentTypeId type
-) : m_impl(new Implementation(type))
+    ComponentTypeId type,
+    unsigned int maskIndex
+) : m_impl(new Implementation(type, maskIndex))
 {
 }
 
@@ -54,61 +144,117 @@ ComponentCollection::addComponent(
     std::unique_ptr<Component> component
 ) {
     bool isNew = true;
+    Component* rawComponent = component.get();
+    rawComponent->m_collection = this;
+    uint32_t position = m_impl->find(entityId);
     // Check if we are overwriting an old component
-    if (m_impl->m_components.erase(entityId) > 0) {
+    if (position != SparseIndex::NONE) {
         isNew = false;
-        for (auto& value : m_impl->m_changeCallbacks) {
-            value.second.second(entityId, *component);
-        }
+        Component* oldComponent = m_impl->m_components[position].second.get();
+        m_impl->detachComponent(oldComponent);
+        m_impl->m_components[position].second = std::move(component);
+        m_impl->logEvent(entityId, Event::Type::Removed);
     }
-    // Insert new component
-    Component* rawComponent = component.get();
-    m_impl->m_components.insert(std::make_pair(
-        entityId, 
-        std::move(component)
-    ));
-    for (auto& value : m_impl->m_changeCallbacks) {
-        value.second.first(entityId, *rawComponent);
+    else {
+        // Insert new component
+        m_impl->m_index.set(entityId, m_impl->m_components.size());
+        m_impl->m_components.emplace_back(
+            entityId,
+            std::move(component)
+        );
     }
+    m_impl->logEvent(entityId, Event::Type::Added);
     rawComponent->setOwner(entityId);
+    // New components need to be applied like changed ones
+    rawComponent->touch();
     return isNew;
 }
 
 
 void
 ComponentCollection::clear() {
-    auto iter = m_impl->m_components.begin();
-    while (iter != m_impl->m_components.end()) {
-        EntityId entityId = iter->first;
-        std::unique_ptr<Component>& component = iter->second;
-        for (auto& value : m_impl->m_changeCallbacks) {
-            value.second.second(entityId, *component);
-        }
+    while (not m_impl->m_components.empty()) {
+        EntityId entityId = m_impl->m_components.back().first;
+        std::unique_ptr<Component>& component = m_impl->m_components.back().second;
+        m_impl->logEvent(entityId, Event::Type::Removed);
         component->setOwner(NULL_ENTITY);
-        iter = m_impl->m_components.erase(iter);
+        m_impl->detachComponent(component.get());
+        m_impl->m_components.pop_back();
     }
+    m_impl->m_index.clear();
+}
+
+
+void
+ComponentCollection::beginJournal() {
+    m_impl->m_isJournaling = true;
 }
 
 
-const std::unordered_map<EntityId, std::unique_ptr<Component>>&
+unsigned int
+ComponentCollection::addEventReader() {
+    return m_impl->m_events.addReader();
+}
+
+
+const ComponentCollection::ComponentList&
 ComponentCollection::components() const {
     return m_impl->m_components;
 }
 
 
+void
+ComponentCollection::disableChangeTracking(
+    unsigned int tracker
+) {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_changesMutex);
+    m_impl->m_changes.removeReader(tracker);
+    m_impl->m_changeTrackers -= 1;
+}
+
+
 bool
 ComponentCollection::empty() const {
     return m_impl->m_components.empty();
 }
 
 
+unsigned int
+ComponentCollection::enableChangeTracking() {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_changesMutex);
+    unsigned int tracker = m_impl->m_changes.addReader();
+    if (tracker >= m_impl->m_needsFullChanges.size()) {
+        m_impl->m_needsFullChanges.resize(tracker + 1);
+    }
+    m_impl->m_needsFullChanges[tracker] = true;
+    m_impl->m_changesReadUpTo = m_impl->m_changes.eventCount();
+    m_impl->m_changeTrackers += 1;
+    return tracker;
+}
+
+
+void
+ComponentCollection::endJournal() {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_changesMutex);
+    m_impl->m_isJournaling = false;
+    m_impl->clearUnsavedFlags(m_impl->m_unsavedChanges);
+    m_impl->m_unsavedChanges.clear();
+}
+
+
+uint64_t
+ComponentCollection::eventCount() const {
+    return m_impl->m_events.eventCount();
+}
+
+
 Component*
 ComponentCollection::get(
     EntityId entityId
 ) const {
-    auto iter = m_impl->m_components.find(entityId);
-    if (iter != m_impl->m_components.end()) {
-        return iter->second.get();
+    uint32_t position = m_impl->find(entityId);
+    if (position != SparseIndex::NONE) {
+        return m_impl->m_components[position].second.get();
     }
     else {
         return nullptr;
@@ -116,17 +262,85 @@ ComponentCollection::get(
 }
 
 
+bool
+ComponentCollection::isTrackingChanges() const {
+    return m_impl->m_changeTrackers > 0;
+}
+
+
+bool
+ComponentCollection::isJournaling() const {
+    return m_impl->m_isJournaling;
+}
+
+
 unsigned int
-ComponentCollection::registerChangeCallbacks(
-    ChangeCallback onComponentAdded,
-    ChangeCallback onComponentRemoved
+ComponentCollection::maskIndex() const {
+    return m_impl->m_maskIndex;
+}
+
+
+size_t
+ComponentCollection::memoryUsage() const {
+    const auto& components = m_impl->m_components;
+    size_t bytes = components.capacity() * sizeof(ComponentList::value_type);
+    bytes += m_impl->m_index.memoryUsage();
+    bytes += m_impl->m_events.memoryUsage();
+    bytes += m_impl->m_changes.memoryUsage();
+    bytes += m_impl->m_unsavedChanges.capacity() * sizeof(EntityId);
+    for (const auto& pair : components) {
+        bytes += pair.second->componentSize();
+    }
+    return bytes;
+}
+
+
+void
+ComponentCollection::queueChanged(
+    Component* component
 ) {
-    unsigned int id = m_impl->m_nextChangeCallbackId++;
-    m_impl->m_changeCallbacks.insert(std::make_pair(
-        id,
-        std::make_pair(onComponentAdded, onComponentRemoved)
-    ));
-    return id;
+    // Every tracker will see the component's latest entry anyway
+    if (m_impl->isChangeUnread(component)) {
+        return;
+    }
+    boost::lock_guard<boost::mutex> lock(m_impl->m_changesMutex);
+    if (component->m_collection != this) {
+        // Removed while touch() was in flight
+        return;
+    }
+    if (not m_impl->m_changes.hasReaders() or m_impl->isChangeUnread(component)) {
+        return;
+    }
+    uint64_t position = m_impl->m_changes.eventCount();
+    m_impl->m_changes.setMaxLag(std::max<uint64_t>(MIN_EVENT_LAG, 2 * m_impl->m_components.size()));
+    m_impl->m_changes.append(component->owner());
+    component->m_changeSequence = position + 1;
+}
+
+
+void
+ComponentCollection::queueUnsavedChange(
+    Component* component
+) {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_changesMutex);
+    if (component->m_collection != this) {
+        // Removed while markUnsavedChange() was in flight
+        return;
+    }
+    if (not m_impl->m_isJournaling) {
+        // The journal ended while markUnsavedChange() was in flight
+        component->m_hasUnjournaledChanges = false;
+        return;
+    }
+    m_impl->m_unsavedChanges.push_back(component->owner());
+}
+
+
+ComponentCollection::EventRange
+ComponentCollection::readEvents(
+    unsigned int reader
+) {
+    return m_impl->m_events.read(reader);
 }
 
 
@@ -134,29 +348,79 @@ bool
 ComponentCollection::removeComponent(
     EntityId entityId
 ) {
-    auto iter = m_impl->m_components.find(entityId);
-    if (iter != m_impl->m_components.end()) {
-        for (auto& value : m_impl->m_changeCallbacks) {
-            value.second.second(entityId, *iter->second);
+    uint32_t position = m_impl->find(entityId);
+    if (position != SparseIndex::NONE) {
+        auto& components = m_impl->m_components;
+        m_impl->logEvent(entityId, Event::Type::Removed);
+        Component* component = components[position].second.get();
+        m_impl->detachComponent(component);
+        component->setOwner(NULL_ENTITY);
+        m_impl->m_index.erase(entityId);
+        // Fill the gap with the last component
+        if (position + 1 != components.size()) {
+            components[position] = std::move(components.back());
+            m_impl->m_index.set(components[position].first, position);
         }
-        iter->second->setOwner(NULL_ENTITY);
-        m_impl->m_components.erase(iter);
+        components.pop_back();
         return true;
     }
     return false;
 }
 
 
-ComponentTypeId
-ComponentCollection::type() const {
-    return m_impl->m_type;
+void
+ComponentCollection::removeEventReader(
+    unsigned int reader
+) {
+    m_impl->m_events.removeReader(reader);
 }
 
 
-void
-ComponentCollection::unregisterChangeCallbacks(
-    unsigned int id
+std::vector<Component*>
+ComponentCollection::takeChangedComponents(
+    unsigned int tracker
 ) {
-    m_impl->m_changeCallbacks.erase(id);
+    std::vector<Component*> changedComponents;
+    boost::lock_guard<boost::mutex> lock(m_impl->m_changesMutex);
+    auto& changes = m_impl->m_changes;
+    EventLog<EntityId>::Range range = changes.read(tracker);
+    uint64_t end = changes.eventCount();
+    m_impl->m_changesReadUpTo = end;
+    if (m_impl->m_needsFullChanges[tracker] or not range.isComplete) {
+        // New trackers and trackers that fell behind see every component
+        m_impl->m_needsFullChanges[tracker] = false;
+        changedComponents.reserve(m_impl->m_components.size());
+        for (const auto& pair : m_impl->m_components) {
+            changedComponents.push_back(pair.second.get());
+        }
+        return changedComponents;
+    }
+    // Skip entries superseded by a later change of the same component and
+    // entries of removed components
+    uint64_t position = end - (range.end - range.begin);
+    for (const EntityId* entityId = range.begin; entityId != range.end; ++entityId, ++position) {
+        Component* component = this->get(*entityId);
+        if (component and component->m_changeSequence == position + 1) {
+            changedComponents.push_back(component);
+        }
+    }
+    return changedComponents;
 }
 
+
+std::vector<EntityId>
+ComponentCollection::takeUnsavedChanges() {
+    std::vector<EntityId> unsavedChanges;
+    boost::lock_guard<boost::mutex> lock(m_impl->m_changesMutex);
+    unsavedChanges.swap(m_impl->m_unsavedChanges);
+    m_impl->clearUnsavedFlags(unsavedChanges);
+    return unsavedChanges;
+}
+
+
+ComponentTypeId
+ComponentCollection::type() const {
+    return m_impl->m_type;
+}
+
+
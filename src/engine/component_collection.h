@@ -1,9 +1,12 @@
 #pragma once
 
 #include "engine/component.h"
+#include "engine/event_log.h"
 #include "engine/typedefs.h"
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace thrive {
 
@@ -14,20 +17,66 @@ class EntityManager;
 *
 * A component collection handles components of one specific type. It offers
 * functions to retrieve the component (if any) of a specific entity and
-* callbacks for when a component has been added or removed (mainly used by
+* a log of the components that have been added or removed (mainly used by
 * the EntityFilter).
 *
+* The log is shared by all its readers. Each reader has a cursor into it
+* and consumes the events it hasn't seen yet in bulk, usually just before
+* it needs an up to date view of the collection. Events that every reader
+* has seen are discarded.
+*
 * Component collections are pretty much read-only for anything but the 
 * EntityManager. Use the manager to actually add or remove components.
+*
+* While change tracking is enabled, the collection also logs the components
+* that have been touched (see Component::touch()) or added. Like event
+* readers, every change tracker has its own cursor into that log, so
+* systems that apply changes can visit only the components changed since
+* their last look.
 */
 class ComponentCollection {
 
 public:
 
     /**
-    * @brief Callback for when a component has been added or removed
+    * @brief A component having been added to or removed from an entity
+    *
+    * Overwriting a component logs a removal followed by an addition.
+    */
+    struct Event {
+
+        enum class Type {
+            Added,
+            Removed
+        };
+
+        /**
+        * @brief The entity whose component has been added or removed
+        */
+        EntityId entityId;
+
+        /**
+        * @brief What happened to the component
+        */
+        Type type;
+
+    };
+
+    /**
+    * @brief The events returned by readEvents()
+    *
+    * Only valid until the collection is modified again.
+    *
+    * If a reader falls too far behind, its events are discarded so that
+    * the log doesn't grow without bounds. The next read returns an empty,
+    * incomplete range, and the reader has to rescan the collection.
+    */
+    using EventRange = EventLog<Event>::Range;
+
+    /**
+    * @brief Packed list of the collection's components and their owners
     */
-    using ChangeCallback = std::function<void(EntityId, Component&)>;
+    using ComponentList = std::vector<std::pair<EntityId, std::unique_ptr<Component>>>;
 
     /**
     * @brief Destructor
@@ -49,12 +98,38 @@ public:
     clear();
 
     /**
-    * @brief Returns a reference to the internal component map
+    * @brief Returns a reference to the internal component list
     *
+    * The list is packed, its order changes when components are removed.
     */
-    const std::unordered_map<EntityId, std::unique_ptr<Component>>&
+    const ComponentList&
     components() const;
 
+    /**
+    * @brief Adds a reader to the event log
+    *
+    * The reader starts at the end of the log, i.e. it only sees events
+    * that happen after this call.
+    *
+    * @return
+    *   An id for readEvents() and removeEventReader()
+    */
+    unsigned int
+    addEventReader();
+
+    /**
+    * @brief Removes a change tracker
+    *
+    * When the last tracker is removed, the log of changes is discarded.
+    *
+    * @param tracker
+    *   The id returned by enableChangeTracking()
+    */
+    void
+    disableChangeTracking(
+        unsigned int tracker
+    );
+
     /**
     * @brief Checks whether this collection is empty
     *
@@ -63,6 +138,25 @@ public:
     bool
     empty() const;
 
+    /**
+    * @brief Adds a change tracker
+    *
+    * The tracker's first takeChangedComponents() returns all components.
+    *
+    * @return
+    *   An id for takeChangedComponents() and disableChangeTracking()
+    */
+    unsigned int
+    enableChangeTracking();
+
+    /**
+    * @brief The number of events logged so far
+    *
+    * Lets readers check for new events without reading them.
+    */
+    uint64_t
+    eventCount() const;
+
     /**
     * @brief Retrieves a component from the collection
     *
@@ -70,7 +164,7 @@ public:
     *
     * @return 
     *   A non-owning pointer to the component or \c nullptr if no such 
-    *   component exists
+    *   component exists. Stale entity ids never have a component.
     *
     */
     Component*
@@ -79,43 +173,86 @@ public:
     ) const;
 
     /**
-    * @brief Registers callbacks for when components are added or removed
-    *
-    * @param onComponentAdded
-    *   Called when a component has been added
-    * @param onComponentRemoved
-    *   Called when a component has been removed
+    * @brief Whether the collection has any change trackers
+    */
+    bool
+    isTrackingChanges() const;
+
+    /**
+    * @brief The collection's bit in the entity manager's component masks
     *
-    * @return 
-    *   An identifier with which you can remove the callbacks.
+    * Collections are numbered in the order their manager created them.
     *
-    * @see unregisterChangeCallbacks
+    * @see EntityManager::componentMask()
     */
     unsigned int
-    registerChangeCallbacks(
-        ChangeCallback onComponentAdded,
-        ChangeCallback onComponentRemoved
-    );
+    maskIndex() const;
 
     /**
-    * @brief The type id of the collection's components
+    * @brief Estimates the memory used by the collection in bytes
+    *
+    * Includes the components themselves, but not memory they allocate.
     */
-    ComponentTypeId
-    type() const;
+    size_t
+    memoryUsage() const;
 
     /**
-    * @brief Unregisters change callbacks
+    * @brief Returns the events a reader hasn't seen yet and marks them as
+    *   seen
     *
-    * If the id could not be found, does nothing.
+    * When there are no new events, this doesn't modify the collection, so
+    * it is safe to call from several threads as long as the collection
+    * itself isn't modified concurrently.
+    *
+    * @param reader
+    *   The id returned by addEventReader()
+    *
+    * @return
+    *   The new events, oldest first
+    */
+    EventRange
+    readEvents(
+        unsigned int reader
+    );
+
+    /**
+    * @brief Removes a reader from the event log
     *
-    * @param id
-    *   The id returned by registerChangeCallbacks
+    * @param reader
+    *   The id returned by addEventReader()
     */
     void
-    unregisterChangeCallbacks(
-        unsigned int id
+    removeEventReader(
+        unsigned int reader
     );
 
+    /**
+    * @brief Returns the components changed since a tracker's last call
+    *
+    * Each component is listed at most once, in the order of its latest
+    * change. Removed components are not listed, so all returned pointers
+    * are valid.
+    *
+    * If the tracker falls too far behind, or this is its first call, all
+    * components are returned.
+    *
+    * @param tracker
+    *   The id returned by enableChangeTracking()
+    *
+    * @return
+    *   The components that have been touched or added since the last call
+    */
+    std::vector<Component*>
+    takeChangedComponents(
+        unsigned int tracker
+    );
+
+    /**
+    * @brief The type id of the collection's components
+    */
+    ComponentTypeId
+    type() const;
+
 private:
 
     /**
@@ -123,19 +260,26 @@ private:
     */
     friend class EntityManager;
 
+    /**
+    * @brief Components queue themselves when touched or marked
+    */
+    friend class Component;
+
     /**
     * @brief Constructor
     *
     * @param type The type id of the components held by this collection.
+    * @param maskIndex The collection's bit in component masks
     */
     ComponentCollection(
-        ComponentTypeId type
+        ComponentTypeId type,
+        unsigned int maskIndex
     );
 
     /**
     * @brief Adds a component
     *
-    * Also calls any callbacks registered for added components.
+    * Also logs an event for the added component.
     *
     * @param entityId
     *   The entity the component belongs to
@@ -152,10 +296,57 @@ private:
         std::unique_ptr<Component> component
     );
 
+    /**
+    * @brief Starts listing components marked with
+    *   Component::markUnsavedChange()
+    */
+    void
+    beginJournal();
+
+    /**
+    * @brief Stops listing marked components and discards the list
+    */
+    void
+    endJournal();
+
+    /**
+    * @brief Whether marked components are listed
+    */
+    bool
+    isJournaling() const;
+
+    /**
+    * @brief Logs a change of a component for the change trackers
+    *
+    * Called by Component::touch(). Nothing is logged while the component's
+    * latest entry is still unread by every tracker.
+    *
+    * @param component
+    *   The changed component
+    */
+    void
+    queueChanged(
+        Component* component
+    );
+
+    /**
+    * @brief Adds a component to the list of marked components
+    *
+    * Called by Component::markUnsavedChange() after setting the component's
+    * flag.
+    *
+    * @param component
+    *   The marked component
+    */
+    void
+    queueUnsavedChange(
+        Component* component
+    );
+
     /**
     * @brief Removes a component
     *
-    * Also calls any callbacks registered for removed components.
+    * Also logs an event for the removed component.
     *
     * @param entityId
     *   The entity the component belongs to
@@ -169,6 +360,16 @@ private:
         EntityId entityId
     );
 
+    /**
+    * @brief Returns the owners of the components marked since the last
+    *   call and starts a new list
+    *
+    * May contain owners whose component has been removed or replaced
+    * since.
+    */
+    std::vector<EntityId>
+    takeUnsavedChanges();
+
     struct Implementation;
     std::unique_ptr<Implementation> m_impl;
     
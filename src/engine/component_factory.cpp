@@ -1,5 +1,6 @@
 #include "engine/component_factory.h"
 
+#include "engine/serialization.h"
 #include "scripting/luabind.h"
 
 #include <luabind/class_info.hpp>
@@ -12,6 +13,11 @@ using Registry = std::unordered_map<
     std::pair<ComponentTypeId, ComponentFactory::ComponentLoader>
 >;
 
+using ClonerRegistry = std::unordered_map<
+    std::string,
+    ComponentFactory::ComponentCloner
+>;
+
 struct ComponentFactory::Implementation {
 
     Registry m_registry;
@@ -19,6 +25,13 @@ struct ComponentFactory::Implementation {
 };
 
 
+static ClonerRegistry&
+globalClonerRegistry() {
+    static ClonerRegistry registry;
+    return registry;
+}
+
+
 static ComponentTypeId
 generateTypeId() {
     static ComponentTypeId typeId = NULL_COMPONENT_TYPE;
@@ -74,6 +87,23 @@ ComponentFactory::luaBindings() {
 }
 
 
+bool
+ComponentFactory::registerGlobalComponentCloner(
+    const std::string& name,
+    ComponentCloner cloner
+) {
+    bool isNew = false;
+    std::tie(std::ignore, isNew) = globalClonerRegistry().insert({
+        name,
+        cloner
+    });
+    if (not isNew) {
+        throw std::runtime_error("Duplicate component cloner: " + name);
+    }
+    return true;
+}
+
+
 ComponentTypeId
 ComponentFactory::registerGlobalComponentType(
     const std::string& name,
@@ -101,6 +131,40 @@ ComponentFactory::ComponentFactory()
 ComponentFactory::~ComponentFactory() {}
 
 
+std::unique_ptr<Component>
+ComponentFactory::clone(
+    const Component& prototype
+) const {
+    ComponentCloner cloner = this->getCloner(prototype.typeName());
+    if (not cloner) {
+        return nullptr;
+    }
+    return cloner(prototype);
+}
+
+
+ComponentFactory::ComponentCloner
+ComponentFactory::getCloner(
+    const std::string& typeName
+) const {
+    auto clonerIter = globalClonerRegistry().find(typeName);
+    if (clonerIter != globalClonerRegistry().end()) {
+        return clonerIter->second;
+    }
+    auto iter = globalRegistry().find(typeName);
+    if (iter == globalRegistry().end()) {
+        iter = m_impl->m_registry.find(typeName);
+        if (iter == m_impl->m_registry.end()) {
+            return ComponentCloner();
+        }
+    }
+    ComponentLoader loader = iter->second.second;
+    return [loader] (const Component& prototype) {
+        return loader(prototype.storage());
+    };
+}
+
+
 ComponentTypeId
 ComponentFactory::getTypeId(
     const std::string& name
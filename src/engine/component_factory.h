@@ -20,6 +20,16 @@ class ComponentFactory {
 
 public:
 
+    /**
+    * @brief Typedef for a component cloning function
+    *
+    * Takes a component and returns a std::unique_ptr to a copy that doesn't
+    * belong to any entity yet.
+    */
+    using ComponentCloner = std::function<
+        std::unique_ptr<Component>(const Component& prototype)
+    >;
+
     /**
     * @brief Typedef for a component factory function
     *
@@ -51,6 +61,38 @@ public:
     */
     ~ComponentFactory();
 
+    /**
+    * @brief Registers a copy constructor based cloner for all factories
+    *
+    * Cloning a component through its copy constructor is much cheaper than
+    * the default, which serializes the component and loads the copy from
+    * the storage. The copy constructor must not copy handles to external
+    * objects like scene nodes or rigid bodies, the systems create those for
+    * the copy.
+    *
+    * @tparam C
+    *   The subclass of Component
+    *
+    * @return \c true
+    *
+    * @note
+    *   You should probably use the REGISTER_COMPONENT_CLONER macro instead
+    *   of calling this directly.
+    */
+    template<typename C>
+    static bool
+    registerGlobalComponentCloner() {
+        return ComponentFactory::registerGlobalComponentCloner(
+            C::TYPE_NAME(),
+            [](const Component& prototype) {
+                std::unique_ptr<Component> component = make_unique<C>(
+                    static_cast<const C&>(prototype)
+                );
+                return component;
+            }
+        );
+    }
+
     /**
     * @brief Registers a component type for all factories
     *
@@ -77,6 +119,38 @@ public:
         );
     }
 
+    /**
+    * @brief Copies a component
+    *
+    * @param prototype
+    *   The component to copy
+    *
+    * @return
+    *   A new component or \c nullptr if the type is not registered
+    */
+    std::unique_ptr<Component>
+    clone(
+        const Component& prototype
+    ) const;
+
+    /**
+    * @brief Returns the function that copies components of a type
+    *
+    * Types without a registered cloner are copied by loading the copy from
+    * the prototype's storage. Look the cloner up once if you copy the same
+    * type many times.
+    *
+    * @param typeName
+    *   The name of the component type
+    *
+    * @return
+    *   The cloner or an empty function if the type is not registered
+    */
+    ComponentCloner
+    getCloner(
+        const std::string& typeName
+    ) const;
+
     /**
     * @brief Looks up a component type name and returns its id
     *
@@ -155,6 +229,12 @@ public:
 
 private:
 
+    static bool
+    registerGlobalComponentCloner(
+        const std::string& name,
+        ComponentCloner cloner
+    );
+
     static ComponentTypeId
     registerGlobalComponentType(
         const std::string& name,
@@ -174,4 +254,14 @@ private:
 #define REGISTER_COMPONENT(cls) \
     const ComponentTypeId cls::TYPE_ID = thrive::ComponentFactory::registerGlobalComponentType<cls>();
 
+/**
+ * @brief Registers a component class's copy constructor as its cloner
+ *
+ * Use this in the component's source file, after REGISTER_COMPONENT.
+ *
+ * @see ComponentFactory::registerGlobalComponentCloner()
+ */
+#define REGISTER_COMPONENT_CLONER(cls) \
+    static const bool cls##_HAS_CLONER = thrive::ComponentFactory::registerGlobalComponentCloner<cls>();
+
 }
@@ -0,0 +1,168 @@
+#include "engine/component_pool.h"
+
+#include <algorithm>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <new>
+
+using namespace thrive;
+
+namespace {
+
+// Alignment of every block, large enough for SSE types like btVector3
+const size_t BLOCK_ALIGNMENT = 16;
+
+// Target size of one slab
+const size_t SLAB_SIZE = 64 * 1024;
+
+struct FreeBlock {
+
+    FreeBlock* next;
+
+};
+
+struct Registry {
+
+    boost::mutex m_mutex;
+
+    std::vector<ComponentPool*> m_pools;
+
+};
+
+Registry&
+registry() {
+    // Never destroyed, see ComponentPool
+    static Registry* registry = new Registry();
+    return *registry;
+}
+
+}
+
+
+struct ComponentPool::Implementation {
+
+    Implementation(
+        const std::string& name,
+        size_t blockSize
+    ) {
+        blockSize = std::max(blockSize, sizeof(FreeBlock));
+        blockSize = (blockSize + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+        m_statistics.blockSize = blockSize;
+        m_statistics.name = name;
+        m_blocksPerSlab = std::max<size_t>(16, SLAB_SIZE / blockSize);
+    }
+
+    void
+    addSlab() {
+        size_t blockSize = m_statistics.blockSize;
+        std::unique_ptr<char[]> slab(new char[blockSize * m_blocksPerSlab]);
+        // Thread the new blocks into the free list, first block first
+        for (size_t i = m_blocksPerSlab; i > 0; --i) {
+            auto block = reinterpret_cast<FreeBlock*>(slab.get() + (i - 1) * blockSize);
+            block->next = m_freeList;
+            m_freeList = block;
+        }
+        m_slabs.push_back(std::move(slab));
+        m_statistics.reservedBlocks += m_blocksPerSlab;
+    }
+
+    size_t m_blocksPerSlab = 0;
+
+    FreeBlock* m_freeList = nullptr;
+
+    mutable boost::mutex m_mutex;
+
+    std::vector<std::unique_ptr<char[]>> m_slabs;
+
+    Statistics m_statistics;
+
+};
+
+
+ComponentPool*
+ComponentPool::create(
+    const std::string& name,
+    size_t blockSize
+) {
+    ComponentPool* pool = new ComponentPool(name, blockSize);
+    Registry& pools = registry();
+    boost::lock_guard<boost::mutex> lock(pools.m_mutex);
+    pools.m_pools.push_back(pool);
+    return pool;
+}
+
+
+std::vector<ComponentPool::Statistics>
+ComponentPool::statistics() {
+    Registry& pools = registry();
+    boost::lock_guard<boost::mutex> lock(pools.m_mutex);
+    std::vector<Statistics> statistics;
+    statistics.reserve(pools.m_pools.size());
+    for (const ComponentPool* pool : pools.m_pools) {
+        statistics.push_back(pool->poolStatistics());
+    }
+    return statistics;
+}
+
+
+ComponentPool::ComponentPool(
+    const std::string& name,
+    size_t blockSize
+) : m_impl(new Implementation(name, blockSize))
+{
+}
+
+
+ComponentPool::~ComponentPool() {}
+
+
+void*
+ComponentPool::allocate(
+    size_t size
+) {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+    Statistics& statistics = m_impl->m_statistics;
+    statistics.allocations += 1;
+    if (size > statistics.blockSize) {
+        statistics.fallbackAllocations += 1;
+        return ::operator new(size);
+    }
+    if (not m_impl->m_freeList) {
+        m_impl->addSlab();
+    }
+    FreeBlock* block = m_impl->m_freeList;
+    m_impl->m_freeList = block->next;
+    statistics.liveBlocks += 1;
+    statistics.peakBlocks = std::max(statistics.peakBlocks, statistics.liveBlocks);
+    return block;
+}
+
+
+void
+ComponentPool::deallocate(
+    void* pointer,
+    size_t size
+) {
+    if (not pointer) {
+        return;
+    }
+    boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+    Statistics& statistics = m_impl->m_statistics;
+    statistics.deallocations += 1;
+    if (size > statistics.blockSize) {
+        ::operator delete(pointer);
+        return;
+    }
+    auto block = static_cast<FreeBlock*>(pointer);
+    block->next = m_impl->m_freeList;
+    m_impl->m_freeList = block;
+    statistics.liveBlocks -= 1;
+}
+
+
+ComponentPool::Statistics
+ComponentPool::poolStatistics() const {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+    return m_impl->m_statistics;
+}
+
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace thrive {
+
+/**
+* @brief Fixed-size block allocator for one component type
+*
+* Every class declared with the COMPONENT macro allocates its instances from
+* its own pool, and so do Lua components. A pool hands out blocks from
+* large slabs and keeps freed blocks in a free list. Once a type has reached
+* its peak population, spawning and removing components of that type does
+* not touch the general purpose heap anymore.
+*
+* Requests for more than the pool's block size, e.g. from a subclass that
+* doesn't use COMPONENT itself, are forwarded to the global operator new.
+*
+* Pools are never destroyed, so components that outlive static destruction
+* (like those held by singletons) can still be freed safely.
+*
+* This class is thread safe.
+*/
+class ComponentPool final {
+
+public:
+
+    /**
+    * @brief Allocation counters of a pool
+    */
+    struct Statistics {
+
+        /**
+        * @brief Number of calls to allocate()
+        */
+        size_t allocations = 0;
+
+        /**
+        * @brief Size of one block in bytes
+        */
+        size_t blockSize = 0;
+
+        /**
+        * @brief Number of calls to deallocate()
+        */
+        size_t deallocations = 0;
+
+        /**
+        * @brief Allocations that were too large for a block
+        */
+        size_t fallbackAllocations = 0;
+
+        /**
+        * @brief Blocks currently in use
+        */
+        size_t liveBlocks = 0;
+
+        /**
+        * @brief The pool's name, usually the component type name
+        */
+        std::string name;
+
+        /**
+        * @brief Highest number of blocks in use at the same time
+        */
+        size_t peakBlocks = 0;
+
+        /**
+        * @brief Blocks allocated in slabs, used or free
+        */
+        size_t reservedBlocks = 0;
+
+    };
+
+    /**
+    * @brief Creates a new pool
+    *
+    * The pool is registered for statistics() and never destroyed.
+    *
+    * @param name
+    *   The pool's name for statistics
+    * @param blockSize
+    *   The size of the objects allocated from this pool
+    *
+    * @return
+    *   The new pool
+    */
+    static ComponentPool*
+    create(
+        const std::string& name,
+        size_t blockSize
+    );
+
+    /**
+    * @brief Returns the statistics of all pools created so far
+    */
+    static std::vector<Statistics>
+    statistics();
+
+    /**
+    * @brief Allocates memory for one object
+    *
+    * @param size
+    *   Number of bytes requested
+    *
+    * @return
+    *   Memory for an object of \a size bytes
+    */
+    void*
+    allocate(
+        size_t size
+    );
+
+    /**
+    * @brief Frees memory returned by allocate()
+    *
+    * @param pointer
+    *   The memory to free
+    * @param size
+    *   The size passed to allocate()
+    */
+    void
+    deallocate(
+        void* pointer,
+        size_t size
+    );
+
+    /**
+    * @brief Returns this pool's allocation counters
+    */
+    Statistics
+    poolStatistics() const;
+
+private:
+
+    ComponentPool(
+        const std::string& name,
+        size_t blockSize
+    );
+
+    ~ComponentPool();
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
+};
+
+}
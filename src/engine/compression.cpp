@@ -0,0 +1,352 @@
+#include "engine/compression.h"
+
+#include "engine/thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+using namespace thrive;
+
+////////////////////////////////////////////////////////////////////////////////
+// Format
+//
+// The magic number is followed by the uncompressed size and the number of
+// blocks as little endian uint64_t. Each block has a header with its stored
+// and original size as little endian uint32_t, followed by its data. If
+// both sizes are equal, the block is stored uncompressed.
+//
+// A compressed block is a sequence of LZ77 sequences, similar to LZ4. Each
+// sequence starts with a token byte, whose upper four bits are the number
+// of literals and whose lower four bits are the match length minus 4. A
+// value of 15 means that more bytes follow, which are added to the length
+// until one is not 255. The literals come next, then the match offset as
+// little endian uint16_t. The last sequence of a block only has literals.
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const std::array<char, 8> MAGIC_NUMBER {{'T', 'H', 'R', 'I', 'V', 'E', '\x1a', 'Z'}};
+
+const size_t BLOCK_SIZE = 256 * 1024;
+
+const size_t HASH_BITS = 14;
+
+const size_t MAX_OFFSET = 0xffff;
+
+const size_t MIN_MATCH = 4;
+
+// Position in the hash table that has not been seen yet
+const uint32_t NO_POSITION = UINT32_MAX;
+
+uint32_t
+hashSequence(
+    uint32_t sequence
+) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+uint32_t
+readSequence(
+    const char* data
+) {
+    uint32_t sequence;
+    std::memcpy(&sequence, data, sizeof(sequence));
+    return sequence;
+}
+
+void
+appendLength(
+    std::string& output,
+    size_t length
+) {
+    while (length >= 255) {
+        output.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    output.push_back(static_cast<char>(length));
+}
+
+void
+appendSequence(
+    std::string& output,
+    const char* literals,
+    size_t literalCount,
+    size_t offset,
+    size_t matchLength
+) {
+    size_t literalNibble = std::min<size_t>(literalCount, 15);
+    size_t matchNibble = matchLength ? std::min<size_t>(matchLength - MIN_MATCH, 15) : 0;
+    output.push_back(static_cast<char>((literalNibble << 4) | matchNibble));
+    if (literalNibble == 15) {
+        appendLength(output, literalCount - 15);
+    }
+    output.append(literals, literalCount);
+    if (not matchLength) {
+        return;
+    }
+    output.push_back(static_cast<char>(offset & 0xff));
+    output.push_back(static_cast<char>(offset >> 8));
+    if (matchNibble == 15) {
+        appendLength(output, matchLength - MIN_MATCH - 15);
+    }
+}
+
+void
+appendUint(
+    std::string& output,
+    uint64_t value,
+    size_t size
+) {
+    for (size_t i = 0; i < size; ++i) {
+        output.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void
+compressBlock(
+    const char* input,
+    size_t size,
+    std::string& output
+) {
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, NO_POSITION);
+    size_t anchor = 0;
+    size_t position = 0;
+    while (size >= MIN_MATCH and position <= size - MIN_MATCH) {
+        uint32_t sequence = readSequence(input + position);
+        uint32_t& entry = table[hashSequence(sequence)];
+        size_t candidate = entry;
+        entry = static_cast<uint32_t>(position);
+        if (
+            candidate != NO_POSITION and
+            position - candidate <= MAX_OFFSET and
+            readSequence(input + candidate) == sequence
+        ) {
+            size_t length = MIN_MATCH;
+            while (
+                position + length < size and
+                input[candidate + length] == input[position + length]
+            ) {
+                ++length;
+            }
+            appendSequence(
+                output,
+                input + anchor,
+                position - anchor,
+                position - candidate,
+                length
+            );
+            position += length;
+            anchor = position;
+        }
+        else {
+            // Skip faster through data that doesn't compress
+            position += 1 + ((position - anchor) >> 6);
+        }
+    }
+    if (anchor < size) {
+        appendSequence(output, input + anchor, size - anchor, 0, 0);
+    }
+}
+
+struct BlockDecoder {
+
+    void
+    check(
+        bool condition
+    ) const {
+        if (not condition) {
+            throw std::runtime_error("Corrupt compressed data");
+        }
+    }
+
+    size_t
+    readLength(
+        size_t nibble
+    ) {
+        size_t length = nibble;
+        if (nibble != 15) {
+            return length;
+        }
+        while (true) {
+            this->check(m_input < m_inputEnd);
+            uint8_t byte = static_cast<uint8_t>(*m_input++);
+            length += byte;
+            if (byte != 255) {
+                return length;
+            }
+        }
+    }
+
+    void
+    run() {
+        while (m_input < m_inputEnd) {
+            uint8_t token = static_cast<uint8_t>(*m_input++);
+            size_t literalCount = this->readLength(token >> 4);
+            this->check(size_t(m_inputEnd - m_input) >= literalCount);
+            this->check(size_t(m_outputEnd - m_output) >= literalCount);
+            std::memcpy(m_output, m_input, literalCount);
+            m_input += literalCount;
+            m_output += literalCount;
+            if (m_input == m_inputEnd) {
+                break;
+            }
+            this->check(m_inputEnd - m_input >= 2);
+            size_t offset = static_cast<uint8_t>(m_input[0]) | (size_t(static_cast<uint8_t>(m_input[1])) << 8);
+            m_input += 2;
+            size_t length = this->readLength(token & 0x0f) + MIN_MATCH;
+            this->check(offset > 0 and offset <= size_t(m_output - m_outputBegin));
+            this->check(size_t(m_outputEnd - m_output) >= length);
+            // Matches may overlap their own output
+            const char* source = m_output - offset;
+            for (size_t i = 0; i < length; ++i) {
+                m_output[i] = source[i];
+            }
+            m_output += length;
+        }
+        this->check(m_output == m_outputEnd);
+    }
+
+    const char* m_input;
+
+    const char* m_inputEnd;
+
+    char* m_output;
+
+    char* m_outputBegin;
+
+    char* m_outputEnd;
+
+};
+
+struct Reader {
+
+    uint64_t
+    readUint(
+        size_t size
+    ) {
+        if (size_t(m_end - m_position) < size) {
+            throw std::runtime_error("Corrupt compressed data");
+        }
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; ++i) {
+            value |= uint64_t(static_cast<uint8_t>(m_position[i])) << (8 * i);
+        }
+        m_position += size;
+        return value;
+    }
+
+    const char* m_end;
+
+    const char* m_position;
+
+};
+
+}
+
+
+std::string
+thrive::compress(
+    const char* data,
+    size_t size,
+    ThreadPool& threadPool
+) {
+    size_t blockCount = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    std::vector<std::string> blocks(blockCount);
+    threadPool.run(
+        blockCount,
+        [&blocks, data, size] (size_t index) {
+            const char* input = data + index * BLOCK_SIZE;
+            size_t inputSize = std::min(BLOCK_SIZE, size - index * BLOCK_SIZE);
+            std::string& block = blocks[index];
+            block.reserve(inputSize);
+            compressBlock(input, inputSize, block);
+            if (block.size() >= inputSize) {
+                block.assign(input, inputSize);
+            }
+        }
+    );
+    std::string output(MAGIC_NUMBER.begin(), MAGIC_NUMBER.end());
+    appendUint(output, size, 8);
+    appendUint(output, blockCount, 8);
+    for (size_t index = 0; index < blockCount; ++index) {
+        size_t inputSize = std::min(BLOCK_SIZE, size - index * BLOCK_SIZE);
+        appendUint(output, blocks[index].size(), 4);
+        appendUint(output, inputSize, 4);
+        output.append(blocks[index]);
+        // Release memory early, the output is already large
+        std::string().swap(blocks[index]);
+    }
+    return output;
+}
+
+
+std::string
+thrive::decompress(
+    const char* data,
+    size_t size,
+    ThreadPool& threadPool
+) {
+    if (not isCompressed(data, size)) {
+        throw std::runtime_error("Data is not compressed");
+    }
+    Reader reader{data + size, data + MAGIC_NUMBER.size()};
+    uint64_t outputSize = reader.readUint(8);
+    uint64_t blockCount = reader.readUint(8);
+    if (blockCount != (outputSize + BLOCK_SIZE - 1) / BLOCK_SIZE) {
+        throw std::runtime_error("Corrupt compressed data");
+    }
+    // Find the blocks first, so they can be decoded in parallel
+    std::vector<std::pair<const char*, size_t>> blocks;
+    blocks.reserve(blockCount);
+    for (uint64_t index = 0; index < blockCount; ++index) {
+        size_t storedSize = reader.readUint(4);
+        size_t originalSize = reader.readUint(4);
+        if (
+            originalSize != std::min<uint64_t>(BLOCK_SIZE, outputSize - index * BLOCK_SIZE) or
+            storedSize > size_t(reader.m_end - reader.m_position)
+        ) {
+            throw std::runtime_error("Corrupt compressed data");
+        }
+        blocks.emplace_back(reader.m_position, storedSize);
+        reader.m_position += storedSize;
+    }
+    std::string output(outputSize, '\0');
+    threadPool.run(
+        blockCount,
+        [&blocks, &output] (size_t index) {
+            char* begin = &output[0] + index * BLOCK_SIZE;
+            size_t originalSize = std::min(BLOCK_SIZE, output.size() - index * BLOCK_SIZE);
+            const char* input = blocks[index].first;
+            size_t storedSize = blocks[index].second;
+            if (storedSize == originalSize) {
+                std::memcpy(begin, input, storedSize);
+                return;
+            }
+            BlockDecoder decoder {
+                input,
+                input + storedSize,
+                begin,
+                begin,
+                begin + originalSize
+            };
+            decoder.run();
+        }
+    );
+    return output;
+}
+
+
+bool
+thrive::isCompressed(
+    const char* data,
+    size_t size
+) {
+    return (
+        size >= MAGIC_NUMBER.size() and
+        std::equal(MAGIC_NUMBER.begin(), MAGIC_NUMBER.end(), data)
+    );
+}
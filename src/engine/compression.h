@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace thrive {
+
+class ThreadPool;
+
+/**
+* @brief Compresses data in independent blocks
+*
+* The data is split into blocks of 256 KiB, which are compressed in
+* parallel with a fast LZ77 codec. Blocks that don't shrink are stored
+* as they are. The result starts with a magic number, see isCompressed().
+*
+* The codec favours speed over ratio. It is meant for savegames, which
+* compress well thanks to their repeated structure.
+*
+* @param data
+*   The data to compress
+* @param size
+*   The size of \a data in bytes
+* @param threadPool
+*   The pool to compress the blocks on
+*
+* @return The compressed data
+*/
+std::string
+compress(
+    const char* data,
+    size_t size,
+    ThreadPool& threadPool
+);
+
+/**
+* @brief Decompresses data created by compress()
+*
+* The blocks are decompressed in parallel.
+*
+* @param data
+*   The compressed data
+* @param size
+*   The size of \a data in bytes
+* @param threadPool
+*   The pool to decompress the blocks on
+*
+* @return The original data
+*
+* @throws std::runtime_error
+*   If \a data is not valid compressed data
+*/
+std::string
+decompress(
+    const char* data,
+    size_t size,
+    ThreadPool& threadPool
+);
+
+/**
+* @brief Whether data starts like the output of compress()
+*
+* @param data
+*   The data to check
+* @param size
+*   The size of \a data in bytes
+*/
+bool
+isCompressed(
+    const char* data,
+    size_t size
+);
+
+}
@@ -2,8 +2,11 @@
 
 #include "engine/component_collection.h"
 #include "engine/component_factory.h"
+#include "engine/component_pool.h"
 #include "engine/entity_manager.h"
 #include "engine/game_state.h"
+#include "engine/profiler.h"
+#include "engine/savegame_writer.h"
 #include "engine/serialization.h"
 #include "engine/system.h"
 #include "engine/rng.h"
@@ -40,12 +43,14 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
+#include <btBulletDynamicsCommon.h>
 #include <chrono>
 #include <ctime>
 #include <forward_list>
 #include <fstream>
 #include <iostream>
 #include <luabind/adopt_policy.hpp>
+#include <luabind/class_info.hpp>
 #include <OgreConfigFile.h>
 #include <OgreLogManager.h>
 #include <OgreRenderWindow.h>
@@ -64,6 +69,11 @@ using namespace thrive;
 
 static const char* RESOURCES_CFG = "resources.cfg";
 static const char* PLUGINS_CFG   = "plugins.cfg";
+static const char* PROFILE_FILE  = "profile.json";
+static const char* JOURNAL_SUFFIX = ".journal";
+
+// Autosaves after which the journal is replaced by a complete savegame
+static const unsigned int AUTOSAVE_COMPACTION_INTERVAL = 30;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Engine
@@ -79,10 +89,12 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
     }
 
     ~Implementation() {
-        Ogre::WindowEventUtilities::removeWindowEventListener(
-            m_graphics.renderWindow,
-            this
-        );
+        if (m_graphics.renderWindow) {
+            Ogre::WindowEventUtilities::removeWindowEventListener(
+                m_graphics.renderWindow,
+                this
+            );
+        }
     }
 
     void
@@ -99,19 +111,88 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
     }
 
     void
-    loadSavegame() {
-        std::ifstream stream(
-            m_serialization.loadFile,
-            std::ifstream::binary
+    autosave() {
+        std::string filename = std::move(m_autosave.requestedFile);
+        m_autosave.requestedFile = "";
+        bool isJournaling = true;
+        for (const auto& pair : m_gameStates) {
+            isJournaling = isJournaling and pair.second->entityManager().isJournaling();
+        }
+        SavegameWriter::CompletionCallback onCompletion = [this](const std::string&, const std::string& error) {
+            if (not error.empty()) {
+                std::cerr << error << std::endl;
+                // Start over with a complete savegame
+                m_autosave.file = "";
+            }
+        };
+        if (
+            not isJournaling or
+            filename != m_autosave.file or
+            m_autosave.recordCount >= AUTOSAVE_COMPACTION_INTERVAL
+        ) {
+            // A complete savegame, which also compacts the journal. The
+            // journal id tells the journal's records apart from those of
+            // previous savegames.
+            for (const auto& pair : m_gameStates) {
+                pair.second->entityManager().beginJournal();
+            }
+            m_autosave.file = filename;
+            m_autosave.journalId = std::chrono::system_clock::now().time_since_epoch().count();
+            m_autosave.recordCount = 0;
+            SavegameWriter::StorageBuilder buildSavegame = this->savegameSnapshot();
+            uint64_t journalId = m_autosave.journalId;
+            m_savegameWriter.write(
+                std::move(filename),
+                [buildSavegame, journalId] () -> StorageContainer {
+                    StorageContainer savegame = buildSavegame();
+                    savegame.set<uint64_t>("journalId", journalId);
+                    return savegame;
+                },
+                nullptr,
+                std::move(onCompletion)
+            );
+            return;
+        }
+        // Only the changed components are copied here, the writer
+        // serializes them
+        std::string currentGameState = m_currentGameState->name();
+        uint64_t journalId = m_autosave.journalId;
+        std::vector<std::pair<std::string, SavegameWriter::StorageBuilder>> gameStates;
+        for (const auto& pair : m_gameStates) {
+            gameStates.emplace_back(pair.first, pair.second->snapshotDelta());
+        }
+        m_savegameWriter.appendRecord(
+            filename + JOURNAL_SUFFIX,
+            [currentGameState, journalId, gameStates] () -> StorageContainer {
+                StorageContainer record;
+                record.set("currentGameState", currentGameState);
+                record.set<uint64_t>("journalId", journalId);
+                StorageContainer gameStatesStorage;
+                for (const auto& pair : gameStates) {
+                    gameStatesStorage.set(pair.first, pair.second());
+                }
+                record.set("gameStates", std::move(gameStatesStorage));
+                return record;
+            },
+            std::move(onCompletion),
+            m_autosave.recordCount == 0
         );
+        m_autosave.recordCount += 1;
+    }
+
+    void
+    loadSavegame() {
+        // The file may still be in the process of being saved
+        m_savegameWriter.wait();
+        std::string filename = std::move(m_serialization.loadFile);
         m_serialization.loadFile = "";
-        stream.clear();
-        stream.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        // Game states are decoded in their load(), states that aren't
+        // in m_gameStates are never decoded
         StorageContainer savegame;
         try {
-            stream >> savegame;
+            savegame = StorageContainer::readFile(filename);
         }
-        catch(const std::ofstream::failure& e) {
+        catch(const std::exception& e) {
             std::cerr << "Error loading file: " << e.what() << std::endl;
             throw;
         }
@@ -132,9 +213,40 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
                 pair.second->entityManager().clear();
             }
         }
+        std::string gameStateName = savegame.get<std::string>("currentGameState");
+        // Replay the autosave journal
+        if (savegame.contains("journalId")) {
+            uint64_t journalId = savegame.get<uint64_t>("journalId");
+            std::vector<StorageContainer> records;
+            try {
+                records = SavegameWriter::readRecords(filename + JOURNAL_SUFFIX);
+            }
+            catch(const std::exception& e) {
+                std::cerr << "Error loading journal: " << e.what() << std::endl;
+            }
+            for (const StorageContainer& record : records) {
+                if (record.get<uint64_t>("journalId") != journalId) {
+                    continue;
+                }
+                StorageContainer deltas = record.get<StorageContainer>("gameStates");
+                for (const auto& pair : m_gameStates) {
+                    if (deltas.contains(pair.first)) {
+                        m_currentGameState = pair.second.get();
+                        pair.second->loadDelta(
+                            deltas.get<StorageContainer>(pair.first)
+                        );
+                    }
+                }
+                gameStateName = record.get<std::string>("currentGameState");
+            }
+        }
         m_currentGameState = nullptr;
+        // The next autosave starts a new journal
+        for (const auto& pair : m_gameStates) {
+            pair.second->entityManager().endJournal();
+        }
+        m_autosave.file = "";
         // Switch gamestate
-        std::string gameStateName = savegame.get<std::string>("currentGameState");
         auto iter = m_gameStates.find(gameStateName);
         if (iter != m_gameStates.end()) {
             this->activateGameState(iter->second.get());
@@ -218,6 +330,16 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
         }
     }
 
+    bool
+    profileRequested() const {
+        for (const auto& event : m_input.keyboard.eventQueue()) {
+            if (event.key == OIS::KC_F12 and event.pressed) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     bool
     quitRequested() {
         return m_input.keyboard.isKeyDown(
@@ -225,35 +347,53 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
         );
     }
 
+    // Only copies component state, the storage tree is built by the
+    // savegame writer's thread
+    SavegameWriter::StorageBuilder
+    savegameSnapshot() {
+        Profiler::Scope scope(&m_profiler, "Engine::savegameSnapshot");
+        std::string currentGameState = m_currentGameState->name();
+        std::vector<std::pair<std::string, SavegameWriter::StorageBuilder>> gameStates;
+        for (const auto& pair : m_gameStates) {
+            gameStates.emplace_back(pair.first, pair.second->snapshot());
+        }
+        return [currentGameState, gameStates] () -> StorageContainer {
+            StorageContainer savegame;
+            savegame.set("currentGameState", currentGameState);
+            StorageContainer gameStatesStorage;
+            for (const auto& pair : gameStates) {
+                gameStatesStorage.set(pair.first, pair.second());
+            }
+            savegame.set("gameStates", std::move(gameStatesStorage));
+            return savegame;
+        };
+    }
+
     void
     saveSavegame() {
-        StorageContainer savegame;
-        savegame.set("currentGameState", m_currentGameState->name());
-        StorageContainer gameStates;
-        for (const auto& pair : m_gameStates) {
-            gameStates.set(pair.first, pair.second->storage());
+        // Building the storage, serializing and writing it happens in the
+        // background
+        SavegameWriter::StorageBuilder buildSavegame = this->savegameSnapshot();
+        SavegameWriter::CompletionCallback onCompletion = std::move(
+            m_serialization.onSaveCompletion
+        );
+        if (not onCompletion) {
+            onCompletion = [](const std::string&, const std::string& error) {
+                if (not error.empty()) {
+                    std::cerr << error << std::endl;
+                }
+            };
         }
-        savegame.set("gameStates", std::move(gameStates));
-        std::ofstream stream(
-            m_serialization.saveFile,
-            std::ofstream::trunc | std::ofstream::binary
+        m_savegameWriter.write(
+            std::move(m_serialization.saveFile),
+            std::move(buildSavegame),
+            std::move(m_serialization.onSaveProgress),
+            std::move(onCompletion),
+            m_serialization.compressSave
         );
         m_serialization.saveFile = "";
-        stream.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-        if (stream) {
-            try {
-                stream << savegame;
-                stream.flush();
-                stream.close();
-            }
-            catch (const std::ofstream::failure& e) {
-                std::cerr << "Error saving file: " << e.what() << std::endl;
-                throw;
-            }
-        }
-        else {
-            std::perror("Could not open file for saving");
-        }
+        m_serialization.onSaveProgress = nullptr;
+        m_serialization.onSaveCompletion = nullptr;
     }
 
     void
@@ -379,18 +519,61 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
 
     } m_input;
 
+    bool m_isHeadless = false;
+
     GameState* m_nextGameState = nullptr;
 
+    Profiler m_profiler;
+
+    struct Autosave {
+
+        // The savegame the journal belongs to
+        std::string file;
+
+        uint64_t journalId = 0;
+
+        // Journal records since the last complete savegame
+        unsigned int recordCount = 0;
+
+        std::string requestedFile;
+
+    } m_autosave;
+
     struct Serialization {
 
+        bool compressSave = false;
+
         std::string loadFile;
 
+        SavegameWriter::CompletionCallback onSaveCompletion;
+
+        SavegameWriter::ProgressCallback onSaveProgress;
+
         std::string saveFile;
 
     } m_serialization;
+
+    // Destroyed before the Lua state, its callbacks may hold Lua functions
+    SavegameWriter m_savegameWriter;
+
+    boost::chrono::microseconds m_tickDuration{16667};
 };
 
 
+static std::string
+getLuaClassName(
+    const luabind::object& object
+) {
+    lua_State* L = object.interpreter();
+    object.push(L);
+    luabind::argument argument(luabind::from_stack(L, lua_gettop(L)));
+    luabind::class_info info = luabind::get_class_info(argument);
+    std::string name = info.name;
+    lua_pop(L, 1);
+    return name;
+}
+
+
 static GameState*
 Engine_createGameState(
     Engine* self,
@@ -400,10 +583,12 @@ Engine_createGameState(
 ) {
     std::vector<std::unique_ptr<System>> systems;
     for (luabind::iterator iter(luaSystems), end; iter != end; ++iter) {
+        std::string systemName = getLuaClassName(*iter);
         System* system = luabind::object_cast<System*>(
             *iter,
             luabind::adopt(luabind::result)
         );
+        system->setName(std::move(systemName));
         systems.emplace_back(system);
     }
     // We can't just capture the luaInitializer in the lambda here, because
@@ -422,6 +607,117 @@ Engine_createGameState(
 }
 
 
+static void
+Engine_autosave(
+    Engine* self,
+    std::string filename
+) {
+    self->autosave(std::move(filename));
+}
+
+
+static void
+Engine_save(
+    Engine* self,
+    std::string filename
+) {
+    self->save(std::move(filename));
+}
+
+
+static void
+Engine_saveCompressed(
+    Engine* self,
+    std::string filename,
+    luabind::object onProgress,
+    luabind::object onCompletion,
+    bool compress
+) {
+    SavegameWriter::ProgressCallback progressCallback;
+    if (onProgress) {
+        progressCallback = [onProgress](const std::string& filename, float progress) {
+            luabind::call_function<void>(onProgress, filename, progress);
+        };
+    }
+    SavegameWriter::CompletionCallback completionCallback;
+    if (onCompletion) {
+        completionCallback = [onCompletion](const std::string& filename, const std::string& error) {
+            luabind::call_function<void>(onCompletion, filename, error.empty(), error);
+        };
+    }
+    self->save(
+        std::move(filename),
+        std::move(progressCallback),
+        std::move(completionCallback),
+        compress
+    );
+}
+
+
+static void
+Engine_saveWithCallbacks(
+    Engine* self,
+    std::string filename,
+    luabind::object onProgress,
+    luabind::object onCompletion
+) {
+    Engine_saveCompressed(self, filename, onProgress, onCompletion, false);
+}
+
+
+static luabind::object
+Engine_statistics(
+    Engine* self,
+    lua_State* L
+) {
+    using namespace luabind;
+    object result = newtable(L);
+    object components = newtable(L);
+    object queries = newtable(L);
+    object pools = newtable(L);
+    GameState* gameState = self->currentGameState();
+    if (gameState) {
+        const EntityManager& entityManager = gameState->entityManager();
+        result["entities"] = entityManager.entityCount();
+        result["entityManagerBytes"] = entityManager.memoryUsage();
+        int index = 1;
+        for (const auto& statistics : entityManager.collectionStatistics()) {
+            object entry = newtable(L);
+            entry["name"] = self->componentFactory().getTypeName(statistics.typeId);
+            entry["count"] = statistics.componentCount;
+            entry["bytes"] = statistics.bytes;
+            components[index++] = entry;
+        }
+        index = 1;
+        for (const auto& statistics : entityManager.queryStatistics()) {
+            object entry = newtable(L);
+            entry["name"] = statistics.name;
+            entry["entities"] = statistics.entityCount;
+            entry["bytes"] = statistics.bytes;
+            queries[index++] = entry;
+        }
+        int bodyCount = gameState->physicsWorld()->getNumCollisionObjects();
+        result["physicsBodies"] = bodyCount;
+        // A lower bound: shapes, motion states and Bullet's broadphase and
+        // contact data aren't counted, only the bodies themselves
+        result["physicsMinBytes"] = bodyCount * sizeof(btRigidBody);
+    }
+    int index = 1;
+    for (const auto& statistics : ComponentPool::statistics()) {
+        object entry = newtable(L);
+        entry["name"] = statistics.name;
+        entry["liveBlocks"] = statistics.liveBlocks;
+        entry["bytes"] = statistics.reservedBlocks * statistics.blockSize;
+        pools[index++] = entry;
+    }
+    result["components"] = components;
+    result["queries"] = queries;
+    result["pools"] = pools;
+    result["luaHeap"] = self->luaMemoryUsage();
+    return result;
+}
+
+
 luabind::scope
 Engine::luaBindings() {
     using namespace luabind;
@@ -429,12 +725,18 @@ Engine::luaBindings() {
         .def("createGameState", Engine_createGameState)
         .def("currentGameState", &Engine::currentGameState)
         .def("getGameState", &Engine::getGameState)
+        .def("isHeadless", &Engine::isHeadless)
         .def("setCurrentGameState", &Engine::setCurrentGameState)
         .def("load", &Engine::load)
-        .def("save", &Engine::save)
+        .def("autosave", &Engine_autosave)
+        .def("save", &Engine_save)
+        .def("save", &Engine_saveWithCallbacks)
+        .def("save", &Engine_saveCompressed)
+        .def("statistics", &Engine_statistics)
         .property("componentFactory", &Engine::componentFactory)
         .property("keyboard", &Engine::keyboard)
         .property("mouse", &Engine::mouse)
+        .property("profiler", &Engine::profiler)
     ;
 }
 
@@ -447,6 +749,14 @@ Engine::Engine()
 }
 
 
+void
+Engine::autosave(
+    std::string filename
+) {
+    m_impl->m_autosave.requestedFile = filename;
+}
+
+
 Engine::~Engine() { }
 
 
@@ -509,8 +819,10 @@ Engine::init() {
     std::srand(unsigned(time(0)));
     m_impl->setupLog();
     m_impl->setupScripts();
-    m_impl->setupGraphics();
-    m_impl->setupInputManager();
+    if (not m_impl->m_isHeadless) {
+        m_impl->setupGraphics();
+        m_impl->setupInputManager();
+    }
     m_impl->loadScripts("../scripts");
     GameState* previousGameState = m_impl->m_currentGameState;
     for (const auto& pair : m_impl->m_gameStates) {
@@ -522,6 +834,12 @@ Engine::init() {
 }
 
 
+bool
+Engine::isHeadless() const {
+    return m_impl->m_isHeadless;
+}
+
+
 OIS::InputManager*
 Engine::inputManager() const {
     return m_impl->m_input.inputManager;
@@ -542,6 +860,19 @@ Engine::load(
 }
 
 
+size_t
+Engine::luaMemoryUsage() {
+    lua_State* L = this->luaState();
+    return lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+}
+
+
+lua_State*
+Engine::luaState() {
+    return m_impl->m_luaState;
+}
+
+
 const Mouse&
 Engine::mouse() const {
     return m_impl->m_input.mouse;
@@ -554,6 +885,28 @@ Engine::ogreRoot() const {
 }
 
 
+Profiler&
+Engine::profiler() {
+    return m_impl->m_profiler;
+}
+
+
+void
+Engine::render(
+    int milliseconds,
+    float interpolation
+) {
+    if (m_impl->m_isHeadless) {
+        return;
+    }
+    Ogre::WindowEventUtilities::messagePump();
+    // Before the first tick, no game state has been activated yet
+    if (m_impl->m_currentGameState) {
+        m_impl->m_currentGameState->render(milliseconds, interpolation);
+    }
+}
+
+
 Ogre::RenderWindow*
 Engine::renderWindow() const {
     return m_impl->m_graphics.renderWindow;
@@ -562,9 +915,15 @@ Engine::renderWindow() const {
 
 void
 Engine::save(
-    std::string filename
+    std::string filename,
+    SavegameWriter::ProgressCallback onProgress,
+    SavegameWriter::CompletionCallback onCompletion,
+    bool compress
 ) {
+    m_impl->m_serialization.compressSave = compress;
     m_impl->m_serialization.saveFile = filename;
+    m_impl->m_serialization.onSaveProgress = std::move(onProgress);
+    m_impl->m_serialization.onSaveCompletion = std::move(onCompletion);
 }
 
 
@@ -577,31 +936,73 @@ Engine::setCurrentGameState(
 }
 
 
+void
+Engine::setHeadless(
+    bool headless
+) {
+    m_impl->m_isHeadless = headless;
+}
+
+
+void
+Engine::setTickDuration(
+    boost::chrono::microseconds duration
+) {
+    m_impl->m_tickDuration = duration;
+}
+
+
 void
 Engine::shutdown() {
+    m_impl->m_savegameWriter.wait();
     for (const auto& pair : m_impl->m_gameStates) {
         const auto& gameState = pair.second;
         gameState->shutdown();
     }
     m_impl->shutdownInputManager();
-    m_impl->m_graphics.renderWindow->destroy();
+    if (m_impl->m_graphics.renderWindow) {
+        m_impl->m_graphics.renderWindow->destroy();
+    }
     m_impl->m_graphics.root.reset();
 }
 
 
+boost::chrono::microseconds
+Engine::tickDuration() const {
+    return m_impl->m_tickDuration;
+}
+
+
 void
 Engine::update(
     int milliseconds
 ) {
+    Profiler& profiler = m_impl->m_profiler;
+    m_impl->m_savegameWriter.poll();
     if (not m_impl->m_serialization.saveFile.empty()) {
+        Profiler::Scope scope(&profiler, "Engine::saveSavegame");
         m_impl->saveSavegame();
     }
-    Ogre::WindowEventUtilities::messagePump();
+    if (not m_impl->m_autosave.requestedFile.empty()) {
+        Profiler::Scope scope(&profiler, "Engine::autosave");
+        m_impl->autosave();
+    }
     if (m_impl->quitRequested()) {
         Game::instance().quit();
     }
-    m_impl->m_input.keyboard.update();
-    m_impl->m_input.mouse.update();
+    if (not m_impl->m_isHeadless) {
+        m_impl->m_input.keyboard.update();
+        m_impl->m_input.mouse.update();
+    }
+    if (m_impl->profileRequested()) {
+        try {
+            profiler.saveChromeTrace(PROFILE_FILE);
+            std::cout << "Saved profile to " << PROFILE_FILE << std::endl;
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
     if (m_impl->m_nextGameState) {
         m_impl->activateGameState(m_impl->m_nextGameState);
         m_impl->m_nextGameState = nullptr;
@@ -609,6 +1010,7 @@ Engine::update(
     assert(m_impl->m_currentGameState != nullptr);
     m_impl->m_currentGameState->update(milliseconds);
     if (not m_impl->m_serialization.loadFile.empty()) {
+        Profiler::Scope scope(&profiler, "Engine::loadSavegame");
         m_impl->loadSavegame();
     }
 }
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "engine/game_state.h"
+#include "engine/savegame_writer.h"
 #include "engine/typedefs.h"
 
+#include <boost/chrono.hpp>
 #include <memory>
 #include <vector>
 
@@ -32,6 +34,7 @@ class Keyboard;
 class Mouse;
 class OgreViewportSystem;
 class CollisionSystem;
+class Profiler;
 class System;
 class RNG;
 
@@ -52,13 +55,26 @@ public:
     * Exposes:
     * - Engine::createGameState()
     * - Engine::currentGameState()
+    * - Engine::autosave()
     * - Engine::getGameState()
+    * - Engine::isHeadless()
     * - Engine::setCurrentGameState()
     * - Engine::load()
-    * - Engine::save()
+    * - Engine::save(): Either with just the filename or with the filename,
+    *   a progress function and a completion function. The progress
+    *   function receives the filename and the fraction written, the
+    *   completion function the filename, whether saving succeeded and an
+    *   error message. An optional fifth argument enables compression.
+    * - \c statistics(): Returns a table with the entity and component
+    *   counts, memory estimates for the component collections, query
+    *   indexes, component pools, physics bodies and the Lua heap. The
+    *   physics estimate \c physicsMinBytes is a lower bound that only
+    *   counts the rigid bodies, not their shapes. Meant for debug output,
+    *   it walks all components.
     * - Engine::componentFactory() (as property)
     * - Engine::keyboard() (as property)
     * - Engine::mouse() (as property)
+    * - Engine::profiler() (as property)
     *
     * @return
     */
@@ -81,6 +97,26 @@ public:
     */
     ~Engine();
 
+    /**
+    * @brief Creates an incremental autosave
+    *
+    * Like save(), the content is collected at the beginning of the next
+    * update. The first autosave to a file writes a complete savegame.
+    * Later ones only append the changed components to a journal next to
+    * it (\a filename + ".journal"), see EntityManager::snapshotDelta().
+    * Every few autosaves, a complete savegame replaces the journal.
+    *
+    * load() replays the journal on top of the savegame. Errors are
+    * printed to \c std::cerr.
+    *
+    * @param filename
+    *   The file to save
+    */
+    void
+    autosave(
+        std::string filename
+    );
+
     /**
     * @brief Returns the internal component factory
     *
@@ -154,8 +190,18 @@ public:
     void
     init();
 
+    /**
+    * @brief Whether the engine runs without graphics and input
+    *
+    * @see setHeadless()
+    */
+    bool
+    isHeadless() const;
+
     /**
     * @brief The engine's input manager
+    *
+    * \c nullptr in headless mode
     */
     OIS::InputManager*
     inputManager() const;
@@ -178,6 +224,12 @@ public:
         std::string filename
     );
 
+    /**
+    * @brief The memory used by the Lua heap in bytes
+    */
+    size_t
+    luaMemoryUsage();
+
     /**
     * @brief The script engine's Lua state
     */
@@ -193,19 +245,62 @@ public:
 
     /**
     * @brief The Ogre root object
+    *
+    * \c nullptr in headless mode
     */
     Ogre::Root*
     ogreRoot() const;
 
+    /**
+    * @brief The engine's frame profiler
+    *
+    * Pressing F12 saves its samples to \c profile.json.
+    */
+    Profiler&
+    profiler();
+
+    /**
+    * @brief Renders a frame
+    *
+    * Call this once per frame, after the frame's simulation ticks.
+    *
+    * @param milliseconds
+    *   The number of milliseconds since the last rendered frame
+    * @param interpolation
+    *   The fraction of a tick that has passed since the last simulation
+    *   tick, see GameState::interpolation()
+    */
+    void
+    render(
+        int milliseconds,
+        float interpolation
+    );
+
     /**
     * @brief Creates a savegame
     *
+    * A snapshot of the game is taken at the beginning of the next update()
+    * (see EntityManager::snapshot()). Turning it into the savegame's
+    * content and writing that to disk happen in the background, see
+    * SavegameWriter. The callbacks are called from update().
+    *
     * @param filename
     *   The file to save
+    * @param onProgress
+    *   Called with the fraction of the file written so far, may be empty
+    * @param onCompletion
+    *   Called when the save has finished, with an error message if it
+    *   failed. If empty, errors are printed to \c std::cerr.
+    * @param compress
+    *   Whether to compress the savegame. Compressed savegames are
+    *   smaller, but take slightly longer to write in the background.
     */
     void
     save(
-        std::string filename
+        std::string filename,
+        SavegameWriter::ProgressCallback onProgress = nullptr,
+        SavegameWriter::CompletionCallback onCompletion = nullptr,
+        bool compress = false
     );
 
     /**
@@ -224,6 +319,38 @@ public:
         GameState* gameState
     );
 
+    /**
+    * @brief Enables or disables headless mode
+    *
+    * In headless mode, the engine creates no render window, no input
+    * devices and no Ogre scene managers. Game states only initialize and
+    * update their simulation phase systems (see System::Phase) and
+    * render() does nothing. This allows running the simulation on
+    * machines without a display.
+    *
+    * Must be called before init().
+    *
+    * @param headless
+    */
+    void
+    setHeadless(
+        bool headless
+    );
+
+    /**
+    * @brief Sets the fixed duration of a simulation tick
+    *
+    * Defaults to 1/60 s, rounded to whole microseconds.
+    *
+    * @param duration
+    *
+    * @see tickDuration()
+    */
+    void
+    setTickDuration(
+        boost::chrono::microseconds duration
+    );
+
     /**
     * @brief Shuts the engine down
     *
@@ -234,13 +361,27 @@ public:
     shutdown();
 
     /**
-    * @brief Renders a single frame
+    * @brief The fixed duration of a simulation tick
+    *
+    * update() and System::update() only get whole milliseconds, so ticks
+    * that aren't a whole number of milliseconds alternate between two
+    * lengths there. Systems that need a constant step, like
+    * UpdatePhysicsSystem, use this duration instead.
+    */
+    boost::chrono::microseconds
+    tickDuration() const;
+
+    /**
+    * @brief Advances the simulation by one tick
+    *
+    * Processes input, savegames and game state switches and updates the
+    * current game state's simulation systems.
     *
     * Before calling update() the first time, you need to call Engine::init().
     *
     * @param milliseconds
-    *   The number of milliseconds to advance. For real-time, this is the
-    *   number of milliseconds since the last frame.
+    *   The number of milliseconds to advance, usually the fixed tick
+    *   duration
     */
     void
     update(
@@ -249,6 +390,8 @@ public:
 
     /**
     * @brief The render window
+    *
+    * \c nullptr in headless mode
     */
     Ogre::RenderWindow*
     renderWindow() const;
@@ -0,0 +1,245 @@
+#include "engine/entity_command_buffer.h"
+
+#include "engine/component.h"
+#include "engine/entity_manager.h"
+#include "scripting/luabind.h"
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <iostream>
+#include <luabind/adopt_policy.hpp>
+#include <stdexcept>
+
+using namespace thrive;
+
+struct EntityCommandBuffer::Implementation {
+
+    Implementation(
+        EntityManager& entityManager
+    ) : m_entityManager(entityManager)
+    {
+    }
+
+    std::vector<std::pair<EntityId, std::unique_ptr<Component>>> m_componentsToAdd;
+
+    std::vector<std::pair<EntityId, ComponentTypeId>> m_componentsToRemove;
+
+    std::vector<EntityId> m_entitiesToRemove;
+
+    EntityManager& m_entityManager;
+
+    boost::mutex m_mutex;
+
+};
+
+
+static Component*
+EntityCommandBuffer_addComponent(
+    EntityCommandBuffer* self,
+    EntityId entityId,
+    Component* nakedComponent
+) {
+    return self->addComponent(
+        entityId,
+        std::unique_ptr<Component>(nakedComponent)
+    );
+}
+
+
+static EntityId
+EntityCommandBuffer_spawn(
+    EntityCommandBuffer* self,
+    luabind::object luaComponents
+) {
+    if (luabind::type(luaComponents) != LUA_TTABLE) {
+        throw std::runtime_error("EntityCommandBuffer:spawn expects a list (table) of components");
+    }
+    std::vector<std::unique_ptr<Component>> components;
+    for (luabind::iterator iter(luaComponents), end; iter != end; ++iter) {
+        Component* component = luabind::object_cast<Component*>(
+            *iter,
+            luabind::adopt(luabind::result)
+        );
+        components.emplace_back(component);
+    }
+    return self->spawn(std::move(components));
+}
+
+
+static luabind::object
+EntityCommandBuffer_spawnMany(
+    EntityCommandBuffer* self,
+    int count,
+    luabind::object factory
+) {
+    luabind::object ids = luabind::newtable(factory.interpreter());
+    for (int index = 1; index <= count; ++index) {
+        luabind::object luaComponents = luabind::call_function<luabind::object>(
+            factory,
+            index
+        );
+        ids[index] = EntityCommandBuffer_spawn(self, luaComponents);
+    }
+    return ids;
+}
+
+
+luabind::scope
+EntityCommandBuffer::luaBindings() {
+    using namespace luabind;
+    return class_<EntityCommandBuffer>("EntityCommandBuffer")
+        .def("addComponent", &EntityCommandBuffer_addComponent, adopt(_3))
+        .def("createEntity", &EntityCommandBuffer::createEntity)
+        .def("flush", &EntityCommandBuffer::flush)
+        .def("removeComponent", &EntityCommandBuffer::removeComponent)
+        .def("removeEntity", &EntityCommandBuffer::removeEntity)
+        .def("spawn", &EntityCommandBuffer_spawn)
+        .def("spawnMany", &EntityCommandBuffer_spawnMany)
+    ;
+}
+
+
+EntityCommandBuffer::EntityCommandBuffer(
+    EntityManager& entityManager
+) : m_impl(new Implementation(entityManager))
+{
+}
+
+
+EntityCommandBuffer::~EntityCommandBuffer() {}
+
+
+Component*
+EntityCommandBuffer::addComponent(
+    EntityId entityId,
+    std::unique_ptr<Component> component
+) {
+    assert(entityId != NULL_ENTITY);
+    Component* rawComponent = component.get();
+    boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+    m_impl->m_componentsToAdd.emplace_back(entityId, std::move(component));
+    return rawComponent;
+}
+
+
+void
+EntityCommandBuffer::append(
+    EntityCommandBuffer& other
+) {
+    if (&other == this) {
+        return;
+    }
+    boost::unique_lock<boost::mutex> lock(m_impl->m_mutex, boost::defer_lock);
+    boost::unique_lock<boost::mutex> otherLock(
+        other.m_impl->m_mutex,
+        boost::defer_lock
+    );
+    boost::lock(lock, otherLock);
+    for (auto& pair : other.m_impl->m_componentsToAdd) {
+        m_impl->m_componentsToAdd.push_back(std::move(pair));
+    }
+    m_impl->m_componentsToRemove.insert(
+        m_impl->m_componentsToRemove.end(),
+        other.m_impl->m_componentsToRemove.begin(),
+        other.m_impl->m_componentsToRemove.end()
+    );
+    m_impl->m_entitiesToRemove.insert(
+        m_impl->m_entitiesToRemove.end(),
+        other.m_impl->m_entitiesToRemove.begin(),
+        other.m_impl->m_entitiesToRemove.end()
+    );
+    // Clearing keeps the capacity for the other buffer's next use
+    other.m_impl->m_componentsToAdd.clear();
+    other.m_impl->m_componentsToRemove.clear();
+    other.m_impl->m_entitiesToRemove.clear();
+}
+
+
+void
+EntityCommandBuffer::clear() {
+    m_impl->m_componentsToAdd.clear();
+    m_impl->m_componentsToRemove.clear();
+    m_impl->m_entitiesToRemove.clear();
+}
+
+
+EntityId
+EntityCommandBuffer::createEntity() {
+    return m_impl->m_entityManager.generateNewId();
+}
+
+
+bool
+EntityCommandBuffer::empty() const {
+    return m_impl->m_componentsToAdd.empty() and
+        m_impl->m_componentsToRemove.empty() and
+        m_impl->m_entitiesToRemove.empty();
+}
+
+
+void
+EntityCommandBuffer::flush() {
+    EntityManager& entityManager = m_impl->m_entityManager;
+    // Swap the queue out, so that callbacks can queue new commands for the
+    // next flush
+    std::vector<std::pair<EntityId, std::unique_ptr<Component>>> componentsToAdd;
+    {
+        boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+        componentsToAdd.swap(m_impl->m_componentsToAdd);
+    }
+    {
+        EntityManager::Batch batch(entityManager);
+        for (auto& pair : componentsToAdd) {
+            try {
+                entityManager.addComponent(pair.first, std::move(pair.second));
+            }
+            catch (const std::runtime_error& e) {
+                std::cerr << "Discarding queued component: " << e.what() << std::endl;
+            }
+        }
+    }
+    for (const auto& pair : m_impl->m_componentsToRemove) {
+        entityManager.removeComponent(pair.first, pair.second);
+    }
+    m_impl->m_componentsToRemove.clear();
+    for (EntityId entityId : m_impl->m_entitiesToRemove) {
+        entityManager.removeEntity(entityId);
+    }
+    m_impl->m_entitiesToRemove.clear();
+    // Keep the capacity for the next frame
+    componentsToAdd.clear();
+    if (m_impl->m_componentsToAdd.empty()) {
+        m_impl->m_componentsToAdd.swap(componentsToAdd);
+    }
+}
+
+
+void
+EntityCommandBuffer::removeComponent(
+    EntityId entityId,
+    ComponentTypeId typeId
+) {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+    m_impl->m_componentsToRemove.emplace_back(entityId, typeId);
+}
+
+
+void
+EntityCommandBuffer::removeEntity(
+    EntityId entityId
+) {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+    m_impl->m_entitiesToRemove.push_back(entityId);
+}
+
+
+EntityId
+EntityCommandBuffer::spawn(
+    std::vector<std::unique_ptr<Component>> components
+) {
+    EntityId entityId = this->createEntity();
+    for (auto& component : components) {
+        this->addComponent(entityId, std::move(component));
+    }
+    return entityId;
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "engine/typedefs.h"
+
+#include <memory>
+#include <vector>
+
+namespace luabind {
+    class scope;
+}
+
+namespace thrive {
+
+class Component;
+class EntityManager;
+
+/**
+* @brief Queues structural changes to an entity manager
+*
+* Adding a component to the entity manager immediately updates every entity
+* filter that watches the component's type. Creating an entity with four
+* components therefore builds its component groups four times. A command
+* buffer collects the additions instead and applies them in one batch when
+* flush() is called, so each filter looks at each entity only once.
+*
+* Removals queued here are forwarded to the entity manager's own removal
+* queue during flush(), so they take effect with the next call to
+* EntityManager::processRemovals().
+*
+* Every GameState owns a command buffer that is flushed once per frame after
+* all systems have been updated.
+*
+* Queueing additions and removals is thread safe. Creating entities and
+* flushing are not.
+*/
+class EntityCommandBuffer {
+
+public:
+
+    /**
+    * @brief Lua bindings
+    *
+    * Exposes:
+    * - EntityCommandBuffer::addComponent()
+    * - EntityCommandBuffer::createEntity()
+    * - EntityCommandBuffer::flush()
+    * - EntityCommandBuffer::removeComponent()
+    * - EntityCommandBuffer::removeEntity()
+    * - \c spawn(components): Queues a new entity with a list (table) of
+    *   components and returns its id
+    * - \c spawnMany(count, factory): Calls \a factory with the indices 1 to
+    *   \a count, each call returning a list of components for a new entity.
+    *   Returns a list of the new ids.
+    *
+    * @return
+    */
+    static luabind::scope
+    luaBindings();
+
+    /**
+    * @brief Constructor
+    *
+    * @param entityManager
+    *   The entity manager to apply the commands to
+    */
+    EntityCommandBuffer(
+        EntityManager& entityManager
+    );
+
+    /**
+    * @brief Destructor
+    *
+    * Discards unapplied commands
+    */
+    ~EntityCommandBuffer();
+
+    /**
+    * @brief Not copyable
+    */
+    EntityCommandBuffer(const EntityCommandBuffer&) = delete;
+
+    /**
+    * @brief Not copyable
+    */
+    EntityCommandBuffer&
+    operator= (const EntityCommandBuffer&) = delete;
+
+    /**
+    * @brief Queues a component for addition
+    *
+    * @param entityId
+    *   The entity to add to
+    * @param component
+    *   The component to add
+    *
+    * @return
+    *   The component as a non-owning pointer. It stays valid after flush().
+    */
+    Component*
+    addComponent(
+        EntityId entityId,
+        std::unique_ptr<Component> component
+    );
+
+    /**
+    * @brief Queues a component for addition
+    *
+    * @tparam C
+    *   The component's class
+    *
+    * @param entityId
+    *   The entity to add to
+    * @param component
+    *   The component to add
+    *
+    * @return
+    *   The component as a non-owning pointer
+    */
+    template<typename C>
+    C*
+    addComponent(
+        EntityId entityId,
+        std::unique_ptr<C> component
+    ) {
+        return static_cast<C*>(
+            this->addComponent(
+                entityId,
+                std::unique_ptr<Component>(std::move(component))
+            )
+        );
+    }
+
+    /**
+    * @brief Moves another buffer's commands to the end of this one
+    *
+    * @param other
+    *   The buffer to take the commands from. It is empty afterwards, but
+    *   keeps its allocated capacity for reuse.
+    */
+    void
+    append(
+        EntityCommandBuffer& other
+    );
+
+    /**
+    * @brief Discards all queued commands
+    */
+    void
+    clear();
+
+    /**
+    * @brief Reserves a new entity id
+    *
+    * The entity only exists after its components have been added with
+    * flush().
+    *
+    * @return
+    *   A new entity id
+    */
+    EntityId
+    createEntity();
+
+    /**
+    * @brief Whether no commands are queued
+    */
+    bool
+    empty() const;
+
+    /**
+    * @brief Applies all queued commands to the entity manager
+    *
+    * Components are added within one EntityManager batch. Components for
+    * entities that have been destroyed in the meantime are discarded.
+    */
+    void
+    flush();
+
+    /**
+    * @brief Queues a component for removal
+    *
+    * @param entityId
+    *   The component's owner
+    * @param typeId
+    *   The component's type id
+    */
+    void
+    removeComponent(
+        EntityId entityId,
+        ComponentTypeId typeId
+    );
+
+    /**
+    * @brief Queues an entity for removal
+    *
+    * @param entityId
+    *   The entity to remove
+    */
+    void
+    removeEntity(
+        EntityId entityId
+    );
+
+    /**
+    * @brief Queues a new entity with components
+    *
+    * @param components
+    *   The new entity's components
+    *
+    * @return
+    *   The new entity's id
+    */
+    EntityId
+    spawn(
+        std::vector<std::unique_ptr<Component>> components
+    );
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
+};
+
+}
@@ -17,6 +17,28 @@ struct IsRequired<Optional<ComponentType>> {
 };
 
 
+template<typename ComponentType>
+struct TypeName {
+
+    static std::string
+    get() {
+        return ComponentType::TYPE_NAME();
+    }
+
+};
+
+
+template<typename ComponentType>
+struct TypeName<Optional<ComponentType>> {
+
+    static std::string
+    get() {
+        return "Optional<" + ComponentType::TYPE_NAME() + ">";
+    }
+
+};
+
+
 template<size_t index, typename... ComponentTypes>
 struct ComponentGroupBuilder {
 
@@ -24,21 +46,23 @@ struct ComponentGroupBuilder {
         typename ExtractComponentType<ComponentTypes>::PointerType...
     >;
 
-    static bool 
+    using Collections = std::array<ComponentCollection*, sizeof...(ComponentTypes)>;
+
+    static void
     build(
-        EntityManager* entityManager,
+        const Collections& collections,
+        const ComponentMask& mask,
         EntityId entityId,
         ComponentGroup& group
     ) {
         using ComponentType = typename std::tuple_element<index, std::tuple<ComponentTypes...>>::type;
         using RawType = typename ExtractComponentType<ComponentType>::Type;
-        bool isRequired = IsRequired<ComponentType>::value;
-        RawType* component = entityManager->getComponent<RawType>(entityId);
-        if (isRequired and not component) {
-            return false;
+        const ComponentCollection* collection = collections[index];
+        // Only look up components the entity is known to have
+        if (mask.test(collection->maskIndex())) {
+            std::get<index>(group) = static_cast<RawType*>(collection->get(entityId));
         }
-        std::get<index>(group) = component;
-        return ComponentGroupBuilder<index-1, ComponentTypes...>::build(entityManager, entityId, group);
+        ComponentGroupBuilder<index-1, ComponentTypes...>::build(collections, mask, entityId, group);
     }
         
 };
@@ -47,183 +71,272 @@ struct ComponentGroupBuilder {
 template<typename... ComponentTypes>
 struct ComponentGroupBuilder<0, ComponentTypes...> {
 
-    static bool 
+    using ComponentGroup = std::tuple<
+        typename ExtractComponentType<ComponentTypes>::PointerType...
+    >;
+
+    using Collections = std::array<ComponentCollection*, sizeof...(ComponentTypes)>;
+
+    static void
     build(
-        EntityManager* entityManager,
+        const Collections& collections,
+        const ComponentMask& mask,
         EntityId entityId,
-        std::tuple<typename ExtractComponentType<ComponentTypes>::PointerType...>& group
+        ComponentGroup& group
     ) {
         using ComponentType = typename std::tuple_element<0, std::tuple<ComponentTypes...>>::type;
         using RawType = typename ExtractComponentType<ComponentType>::Type;
-        bool isRequired = IsRequired<ComponentType>::value;
-        RawType* component = entityManager->getComponent<RawType>(entityId);
-        if (isRequired and not component) {
-            return false;
+        const ComponentCollection* collection = collections[0];
+        if (mask.test(collection->maskIndex())) {
+            std::get<0>(group) = static_cast<RawType*>(collection->get(entityId));
         }
-        std::get<0>(group) = component;
-        return true;
     }
         
 };
 
-template<size_t tupleIndex>
-struct RegisterNextCallback {
-    
-    template<typename Filter>
-    static void registerNextCallback(
-        Filter& filter
-    ) {
-        // May the programming gods have mercy for the poor souls
-        // who will have to read this.
-        //
-        // This calls a template function called registerCallback
-        // on the filter object.
-        filter.template registerCallback<tupleIndex-1>();
-    }
-};
+/**
+* @brief The shared index of all filters with the same component types
+*/
+template<typename... ComponentTypes>
+class EntityFilterIndex : public QueryIndex {
 
-template<>
-struct RegisterNextCallback<0> {
+public:
 
-    template<typename Filter>
-    static void registerNextCallback(Filter&) {}
-};
+    using ComponentGroup = std::tuple<
+        typename ExtractComponentType<ComponentTypes>::PointerType...
+    >;
 
-} // namespace detail
+    using EntityMap = thrive::EntityMap<ComponentGroup>;
+
+    EntityFilterIndex(
+        EntityManager& entityManager
+    ) : QueryIndex(
+            entityManager,
+            std::vector<ComponentType>{
+                ComponentType(
+                    ExtractComponentType<ComponentTypes>::Type::TYPE_ID,
+                    IsRequired<ComponentTypes>::value
+                )...
+            }
+        )
+    {
+        std::copy(
+            this->collections().begin(),
+            this->collections().end(),
+            m_collections.begin()
+        );
+        this->initEntities();
+    }
 
+    // Readable, so that it can be shown in EntityManager::queryStatistics()
+    static std::string
+    key() {
+        std::string key = "EntityFilter<";
+        for (const std::string& name : {TypeName<ComponentTypes>::get()...}) {
+            if (key.back() != '<') {
+                key += ", ";
+            }
+            key += name;
+        }
+        return key + ">";
+    }
 
-template<typename... ComponentTypes>
-struct EntityFilter<ComponentTypes...>::Implementation {
+    const EntityMap&
+    entities() const {
+        return m_entities;
+    }
 
-    Implementation(
-        bool recordChanges
-    ) : m_recordChanges(recordChanges)
-    {
+    size_t
+    entityCount() const override {
+        return m_entities.size();
     }
 
+protected:
+
     void
-    initEntities() {
-        for (EntityId id : m_entityManager->entities()) {
-            this->initEntity(id);
-        }
+    clearEntities() override {
+        m_entities.clear();
     }
 
     void
-    initEntity(
-        EntityId id
-    ) {
-        ComponentGroup group;
-        bool isComplete = detail::ComponentGroupBuilder<sizeof...(ComponentTypes) - 1, ComponentTypes...>::build(
-            m_entityManager,
-            id,
-            group
-        );
-        if (isComplete) {
-            m_entities[id] = group;
-            m_entities.insert(std::make_pair(id, group));
-            if (m_recordChanges) {
-                m_addedEntities[id] = group;
-            }
+    collectEntities(
+        EntitySet& entities
+    ) const override {
+        for (const auto& value : m_entities) {
+            entities.insert(value.first);
         }
     }
 
-    void
-    onComponentAdded(
+    bool
+    containsEntity(
         EntityId entityId
-    ) {
-        this->initEntity(entityId);
+    ) const override {
+        return m_entities.count(entityId) > 0;
+    }
+
+    size_t
+    entityMemoryUsage() const override {
+        return m_entities.memoryUsage();
+    }
+
+    bool
+    eraseEntity(
+        EntityId entityId
+    ) override {
+        return m_entities.erase(entityId) > 0;
     }
 
-    template<int tupleIndex>
     void
-    onOptionalComponentRemoved(
+    updateEntity(
         EntityId entityId
-    ) {
+    ) override {
+        const ComponentMask& mask = this->entityManager()->componentMask(entityId);
+        const ComponentMask& requiredMask = this->requiredMask();
+        ComponentGroup group;
+        bool isRelevant = (mask & requiredMask) == requiredMask;
+        if (isRelevant) {
+            ComponentGroupBuilder<sizeof...(ComponentTypes) - 1, ComponentTypes...>::build(
+                m_collections,
+                mask,
+                entityId,
+                group
+            );
+            // Filters with only optional components need at least one
+            isRelevant = requiredMask.any() or group != ComponentGroup();
+        }
+        if (not isRelevant) {
+            this->removeEntity(entityId);
+            return;
+        }
         auto iter = m_entities.find(entityId);
-        if (iter != m_entities.end()) {
-            std::get<tupleIndex>(iter->second) = nullptr;
-            if (iter->second == ComponentGroup()) {
-                m_entities.erase(entityId);
-                if (m_recordChanges) {
-                    m_removedEntities.insert(entityId);
-                }
-            }
+        if (iter == m_entities.end()) {
+            m_entities[entityId] = group;
+            this->logChange(entityId, Change::Type::Added);
+        }
+        else if (iter->second != group) {
+            iter->second = group;
+            this->logChange(entityId, Change::Type::Updated);
         }
     }
 
+private:
+
+    std::array<ComponentCollection*, sizeof...(ComponentTypes)> m_collections;
+
+    EntityMap m_entities;
+
+};
+
+} // namespace detail
+
+
+template<typename... ComponentTypes>
+struct EntityFilter<ComponentTypes...>::Implementation {
+
+    using Index = detail::EntityFilterIndex<ComponentTypes...>;
+
+    Implementation(
+        bool recordChanges
+    ) : m_recordChanges(recordChanges)
+    {
+    }
+
+    ~Implementation() {
+        this->release();
+    }
+
     void
-    onRequiredComponentRemoved(
-        EntityId entityId
+    acquire(
+        EntityManager& entityManager
     ) {
-        
-        if (m_entities.erase(entityId) > 0 and m_recordChanges) {
-            if (m_addedEntities.erase(entityId) == 0) {
-                // If entityId already was in addedEntities, the entity
-                // was added, then removed in the same frame.
-                m_removedEntities.insert(entityId);
+        const std::string key = Index::key();
+        m_index = std::static_pointer_cast<Index>(
+            entityManager.getQueryIndex(key)
+        );
+        if (not m_index) {
+            m_index = std::make_shared<Index>(entityManager);
+            entityManager.setQueryIndex(key, m_index);
+        }
+        if (m_recordChanges) {
+            m_index->sync();
+            boost::lock_guard<boost::mutex> lock(m_index->mutex());
+            m_changeReader = m_index->changes().addReader();
+            for (const auto& value : m_index->entities()) {
+                m_addedEntities[value.first] = value.second;
             }
         }
     }
 
-    template<int tupleIndex>
+    const EntityMap&
+    entities() const {
+        static const EntityMap EMPTY_ENTITIES;
+        return m_index ? m_index->entities() : EMPTY_ENTITIES;
+    }
+
     void
-    registerCallback() {
-        using ComponentType = typename std::tuple_element<
-            tupleIndex, 
-            std::tuple<ComponentTypes...>
-        >::type;
-        using RawType = typename detail::ExtractComponentType<ComponentType>::Type;
-        bool isRequired = detail::IsRequired<ComponentType>::value;
-        auto& collection = m_entityManager->getComponentCollection(
-            RawType::TYPE_ID
-        );
-        // Callbacks
-        auto onAdded = [this] (EntityId id, Component&) {
-            this->onComponentAdded(id);
-        };
-        ComponentCollection::ChangeCallback onRemoved;
-        if (isRequired) {
-            onRemoved = [this] (EntityId id, Component&) {
-                this->onRequiredComponentRemoved(id);
-            };
-        }
-        else {
-            onRemoved = [this] (EntityId id, Component&) {
-                this->onOptionalComponentRemoved<tupleIndex>(id);
-            };
+    release() {
+        if (m_index and m_recordChanges) {
+            boost::lock_guard<boost::mutex> lock(m_index->mutex());
+            m_index->changes().removeReader(m_changeReader);
         }
-        unsigned int id = collection.registerChangeCallbacks(
-            onAdded,
-            onRemoved
-        );
-        m_registeredCallbacks.push_front(
-            std::make_pair(std::ref(collection), id)
-        );
-        detail::RegisterNextCallback<tupleIndex>::registerNextCallback(*this);
+        m_index.reset();
+        m_addedEntities.clear();
+        m_localChanges.clear();
+        m_removedEntities.clear();
     }
 
+    // Brings the shared index up to date and follows its changes. Must be
+    // called before the entities are accessed, their groups may point to
+    // removed components until then.
     void
-    unregisterCallbacks() {
-        for(auto& pair : m_registeredCallbacks) {
-            pair.first.get().unregisterChangeCallbacks(pair.second);
+    sync() {
+        if (not m_index) {
+            return;
+        }
+        m_index->sync();
+        if (not m_recordChanges) {
+            return;
+        }
+        boost::lock_guard<boost::mutex> lock(m_index->mutex());
+        auto changes = m_index->changes().read(m_changeReader);
+        const EntityMap& entities = m_index->entities();
+        for (auto change = changes.begin; change != changes.end; ++change) {
+            EntityId entityId = change->entityId;
+            if (change->type == QueryIndex::Change::Type::Removed) {
+                // The added entry's components are about to be destroyed
+                m_addedEntities.erase(entityId);
+                m_removedEntities.insert(entityId);
+                continue;
+            }
+            // Later changes in the log may have removed the entity again
+            auto iter = entities.find(entityId);
+            if (iter == entities.end()) {
+                continue;
+            }
+            if (change->type == QueryIndex::Change::Type::Added) {
+                m_addedEntities[entityId] = iter->second;
+            }
+            else {
+                auto addedIter = m_addedEntities.find(entityId);
+                if (addedIter != m_addedEntities.end()) {
+                    addedIter->second = iter->second;
+                }
+            }
         }
-        m_registeredCallbacks.clear();
     }
 
     EntityMap m_addedEntities;
 
-    EntityMap m_entities;
+    unsigned int m_changeReader = 0;
 
-    EntityManager* m_entityManager = nullptr;
+    std::shared_ptr<Index> m_index;
 
-    bool m_recordChanges;
+    // Reused by parallelForEach(), indexed by ThreadPool::workerIndex()
+    std::vector<std::unique_ptr<EntityCommandBuffer>> m_localChanges;
 
-    std::forward_list<std::pair<
-        std::reference_wrapper<ComponentCollection>, 
-        unsigned int
-    >> m_registeredCallbacks;
+    bool m_recordChanges;
 
-    std::unordered_set<EntityId> m_removedEntities;
+    EntitySet m_removedEntities;
 
 };
 
@@ -239,6 +352,7 @@ template<typename... ComponentTypes>
 typename EntityFilter<ComponentTypes...>::EntityMap&
 EntityFilter<ComponentTypes...>::addedEntities() {
     assert(m_impl->m_recordChanges && "Added entities are not recorded by this filter");
+    m_impl->sync();
     return m_impl->m_addedEntities;
 }
 
@@ -246,13 +360,16 @@ EntityFilter<ComponentTypes...>::addedEntities() {
 template<typename... ComponentTypes>
 typename EntityFilter<ComponentTypes...>::EntityMap::const_iterator
 EntityFilter<ComponentTypes...>::begin() const {
-    return m_impl->m_entities.cbegin();
+    m_impl->sync();
+    return m_impl->entities().cbegin();
 }
 
 
 template<typename... ComponentTypes>
 void
 EntityFilter<ComponentTypes...>::clearChanges() {
+    // Changes that haven't been consumed yet belong to this round
+    m_impl->sync();
     m_impl->m_addedEntities.clear();
     m_impl->m_removedEntities.clear();
 }
@@ -263,28 +380,116 @@ bool
 EntityFilter<ComponentTypes...>::containsEntity(
     EntityId id
 ) const {
-    return m_impl->m_entities.find(id) != m_impl->m_entities.end();
+    m_impl->sync();
+    return m_impl->entities().count(id) > 0;
 }
 
 
 template<typename... ComponentTypes>
 typename EntityFilter<ComponentTypes...>::EntityMap::const_iterator
 EntityFilter<ComponentTypes...>::end() const {
-    return m_impl->m_entities.cend();
+    m_impl->sync();
+    return m_impl->entities().cend();
 }
 
 
 template<typename... ComponentTypes>
 const typename EntityFilter<ComponentTypes...>::EntityMap&
 EntityFilter<ComponentTypes...>::entities() const {
-    return m_impl->m_entities;
+    m_impl->sync();
+    return m_impl->entities();
+}
+
+
+template<typename... ComponentTypes>
+template<typename Function>
+void
+EntityFilter<ComponentTypes...>::parallelForEach(
+    Function function,
+    size_t chunkSize
+) const {
+    assert(chunkSize > 0);
+    m_impl->sync();
+    const EntityMap& entities = m_impl->entities();
+    size_t chunkCount = (entities.size() + chunkSize - 1) / chunkSize;
+    if (chunkCount <= 1) {
+        for (const auto& value : entities) {
+            function(value.first, value.second);
+        }
+        return;
+    }
+    ThreadPool::shared().run(
+        chunkCount,
+        [&entities, &function, chunkSize] (size_t chunk) {
+            auto iter = entities.cbegin() + chunk * chunkSize;
+            auto end = entities.cbegin() + std::min(
+                (chunk + 1) * chunkSize,
+                entities.size()
+            );
+            for (; iter != end; ++iter) {
+                function(iter->first, iter->second);
+            }
+        }
+    );
 }
 
 
 template<typename... ComponentTypes>
-std::unordered_set<EntityId>&
+template<typename Function>
+void
+EntityFilter<ComponentTypes...>::parallelForEach(
+    EntityCommandBuffer& changes,
+    Function function,
+    size_t chunkSize
+) const {
+    assert(chunkSize > 0);
+    m_impl->sync();
+    const EntityMap& entities = m_impl->entities();
+    size_t chunkCount = (entities.size() + chunkSize - 1) / chunkSize;
+    if (chunkCount <= 1) {
+        for (const auto& value : entities) {
+            function(value.first, value.second, changes);
+        }
+        return;
+    }
+    ThreadPool& pool = ThreadPool::shared();
+    // One buffer per thread that may run a chunk, kept across calls
+    auto& localChanges = m_impl->m_localChanges;
+    if (localChanges.size() < pool.workerCount() + 1) {
+        localChanges.resize(pool.workerCount() + 1);
+    }
+    for (auto& local : localChanges) {
+        if (not local) {
+            local.reset(
+                new EntityCommandBuffer(*m_impl->m_index->entityManager())
+            );
+        }
+    }
+    pool.run(
+        chunkCount,
+        [&entities, &function, &localChanges, &pool, chunkSize] (size_t chunk) {
+            EntityCommandBuffer& local = *localChanges[pool.workerIndex()];
+            auto iter = entities.cbegin() + chunk * chunkSize;
+            auto end = entities.cbegin() + std::min(
+                (chunk + 1) * chunkSize,
+                entities.size()
+            );
+            for (; iter != end; ++iter) {
+                function(iter->first, iter->second, local);
+            }
+        }
+    );
+    for (auto& local : localChanges) {
+        changes.append(*local);
+    }
+}
+
+
+template<typename... ComponentTypes>
+EntitySet&
 EntityFilter<ComponentTypes...>::removedEntities() {
     assert(m_impl->m_recordChanges && "Removed entities are not recorded by this filter");
+    m_impl->sync();
     return m_impl->m_removedEntities;
 }
 
@@ -294,14 +499,9 @@ void
 EntityFilter<ComponentTypes...>::setEntityManager(
     EntityManager* entityManager
 ) {
-    m_impl->unregisterCallbacks();
-    m_impl->m_entities.clear();
-    m_impl->m_addedEntities.clear();
-    m_impl->m_removedEntities.clear();
-    m_impl->m_entityManager = entityManager;
+    m_impl->release();
     if (entityManager) {
-        detail::RegisterNextCallback<sizeof...(ComponentTypes)>::registerNextCallback(*m_impl);
-        m_impl->initEntities();
+        m_impl->acquire(*entityManager);
     }
 }
 
@@ -1,13 +1,21 @@
 #pragma once
 
+#include "engine/entity_command_buffer.h"
 #include "engine/entity_manager.h"
+#include "engine/entity_map.h"
 #include "engine/component_collection.h"
+#include "engine/query_index.h"
+#include "engine/thread_pool.h"
 
+#include <algorithm>
+#include <array>
 #include <assert.h>
-#include <forward_list>
-#include <functional>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <memory>
+#include <string>
 #include <tuple>
-#include <unordered_map>
+#include <vector>
 
 #include <iostream>
 
@@ -50,6 +58,15 @@ struct ExtractComponentType<Optional<ComponentType>> {
 * An entity filter helps a system in finding the entities that have exactly
 * the right components to be relevant for the system. 
 *
+* All filters with the same component types on the same entity manager
+* share one QueryIndex. The index reads the event logs of its component
+* collections (see ComponentCollection::readEvents()) and applies all
+* structural changes since its last sync in one go when any of its filters
+* is accessed. Adding or removing components therefore costs nothing until
+* a filter is used, and costs it once, however many systems use the same
+* query. Filters recording changes follow the index's change log with their
+* own cursor.
+*
 * @tparam ComponentTypes
 *   The component classes to watch for. You can wrap a class with the 
 *   Optional template if you want to know if it's there, but it's not
@@ -110,8 +127,16 @@ public:
 
     /**
     * @brief Typedef for the filter's list of relevant entities
+    *
+    * The entities are packed into an array, iterating over them is a
+    * linear scan.
     */
-    using EntityMap = std::unordered_map<EntityId, ComponentGroup>;
+    using EntityMap = thrive::EntityMap<ComponentGroup>;
+
+    /**
+    * @brief Default number of entities per task of parallelForEach()
+    */
+    static const size_t DEFAULT_CHUNK_SIZE = 256;
 
     /**
     * @brief Constructor
@@ -201,14 +226,86 @@ public:
     const EntityMap&
     entities() const;
 
+    /**
+    * @brief Calls a function for every entity, in parallel
+    *
+    * The entities are split into chunks of consecutive entries, which are
+    * processed as tasks of the shared ThreadPool. A system running on the
+    * pool can call this as well, the chunks become a nested job.
+    *
+    * The function must only modify the components of the entity it is
+    * called for and must not change the entity manager's structure, i.e.
+    * add or remove components or entities. Use the overload taking an
+    * EntityCommandBuffer for that.
+    *
+    * Usage example:
+    * \code
+    * m_entities.parallelForEach(
+    *     [] (EntityId, const ComponentGroup& group) {
+    *         MyComponent* myComponent = std::get<0>(group);
+    *         // Do something with myComponent
+    *     }
+    * );
+    * \endcode
+    *
+    * @param function
+    *   Called as \c function(EntityId, const ComponentGroup&)
+    * @param chunkSize
+    *   The number of entities per task. Smaller chunks balance better,
+    *   larger chunks have less overhead.
+    */
+    template<typename Function>
+    void
+    parallelForEach(
+        Function function,
+        size_t chunkSize = DEFAULT_CHUNK_SIZE
+    ) const;
+
+    /**
+    * @brief Calls a function for every entity, in parallel, collecting
+    *   structural changes
+    *
+    * Like parallelForEach(Function, size_t), but every thread running
+    * chunks gets its own EntityCommandBuffer to queue additions and
+    * removals into without contending for a lock. After all chunks are
+    * done, the threads' commands are appended to \a changes. Commands of
+    * one chunk stay in order, the order between chunks is unspecified.
+    *
+    * The threads' buffers belong to the filter and are reused by later
+    * calls, so the function must not call this method on the same filter.
+    *
+    * The thread's buffer must not be used for creating entities, queue
+    * those into \a changes directly.
+    *
+    * @param changes
+    *   Receives the commands of all chunks
+    * @param function
+    *   Called as \c function(EntityId, const ComponentGroup&,
+    *   EntityCommandBuffer&)
+    * @param chunkSize
+    *   The number of entities per task
+    */
+    template<typename Function>
+    void
+    parallelForEach(
+        EntityCommandBuffer& changes,
+        Function function,
+        size_t chunkSize = DEFAULT_CHUNK_SIZE
+    ) const;
+
     /**
     * @brief Returns the entities removed from this filter
     *
+    * An entity that was added and removed again since the last call to
+    * clearChanges() is only reported here, not in addedEntities(). If no
+    * filter sharing this filter's index was accessed in between, it is
+    * reported in neither.
+    *
     * When you have processed the collection, please call clear() on
     * it.
     *
     */
-    std::unordered_set<EntityId>&
+    EntitySet&
     removedEntities();
 
     /**
@@ -2,10 +2,14 @@
 
 #include "engine/component_collection.h"
 #include "engine/component_factory.h"
+#include "engine/query_index.h"
 #include "engine/serialization.h"
 
 #include <atomic>
 #include <boost/thread.hpp>
+#include <deque>
+#include <stdexcept>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -14,34 +18,430 @@
 
 using namespace thrive;
 
+namespace {
+
+void
+checkLegacyId(
+    EntityId entityId
+) {
+    if (entityId > ENTITY_INDEX_MASK) {
+        throw std::runtime_error(
+            "Savegame entity id " + std::to_string(entityId) +
+            " is too large to restore, at most " +
+            std::to_string(ENTITY_INDEX_MASK) + " is supported"
+        );
+    }
+}
+
+/**
+* @brief Checks that a savegame from before generational ids fits the id
+* layout
+*
+* Those savegames stored plain counter values, which would be misread as
+* slot index and generation if they don't fit the index bits. The ids can't
+* be remapped because components may refer to other entities by id.
+*/
+void
+checkLegacyIds(
+    const StorageContainer& storage
+) {
+    EntityId currentId = storage.get<EntityId>("currentId");
+    if (currentId > 0) {
+        checkLegacyId(currentId - 1);
+    }
+    for (const auto& entry : storage.get<StorageList>("namedIds")) {
+        checkLegacyId(entry.get<EntityId>("entityId"));
+    }
+    StorageContainer collections = storage.get<StorageContainer>("collections");
+    for (const std::string& typeName : collections.keys()) {
+        for (const auto& componentStorage : collections.get<StorageList>(typeName)) {
+            checkLegacyId(componentStorage.get<EntityId>("owner", NULL_ENTITY));
+        }
+    }
+    for (const auto& entry : storage.get<StorageList>("componentsToRemove")) {
+        checkLegacyId(entry.get<EntityId>("entityId"));
+    }
+    for (const auto& entry : storage.get<StorageList>("entitiesToRemove")) {
+        checkLegacyId(entry.get<EntityId>("id"));
+    }
+}
+
+/**
+* @brief Components of one collection, serialized later
+*
+* See EntityManager::snapshot().
+*/
+struct CollectionSnapshot {
+
+    void
+    add(
+        EntityId entityId,
+        const Component& component,
+        const ComponentFactory::ComponentCloner& cloner
+    ) {
+        if (cloner) {
+            std::unique_ptr<Component> copy = cloner(component);
+            // The owner is not part of a component's copy
+            copy->setOwner(entityId);
+            copies.push_back(std::move(copy));
+        }
+        else {
+            storedComponents.append(component.storage());
+        }
+        savedEntities.push_back(entityId);
+    }
+
+    StorageList
+    build() {
+        StorageList componentList = std::move(storedComponents);
+        componentList.reserve(componentList.size() + copies.size());
+        for (const auto& copy : copies) {
+            componentList.append(copy->storage());
+        }
+        copies.clear();
+        return componentList;
+    }
+
+    std::vector<std::unique_ptr<Component>> copies;
+
+    std::vector<EntityId> savedEntities;
+
+    StorageList storedComponents;
+
+    std::string typeName;
+
+};
+
+void
+restoreRemovals(
+    EntityManager& entityManager,
+    const StorageContainer& storage,
+    const ComponentFactory& factory
+) {
+    StorageList componentsToRemove = storage.get<StorageList>("componentsToRemove");
+    for (const StorageContainer& entry : componentsToRemove) {
+        EntityId entityId = entry.get<EntityId>("entityId");
+        std::string typeName = entry.get<std::string>("componentTypeName");
+        ComponentTypeId typeId = factory.getTypeId(typeName);
+        entityManager.removeComponent(entityId, typeId);
+    }
+    StorageList entitiesToRemove = storage.get<StorageList>("entitiesToRemove");
+    for (const auto& entry : entitiesToRemove) {
+        EntityId entityId = entry.get<EntityId>("id");
+        entityManager.removeEntity(entityId);
+    }
+}
+
+}
+
 struct EntityManager::Implementation {
 
+    struct Slot {
+
+        uint16_t componentCount = 0;
+
+        uint16_t generation = 0;
+
+        bool isAllocated = false;
+
+        bool isPinned = false;
+
+        // Whether the slot's entity ever had a component, see
+        // reclaimUnusedIds()
+        bool isUsed = false;
+
+        ComponentMask mask;
+
+    };
+
+    Implementation() {
+        this->resetSlots();
+    }
+
+    Slot*
+    acquireSlot(
+        EntityId entityId
+    ) {
+        uint32_t index = entityIndex(entityId);
+        uint32_t generation = entityGeneration(entityId);
+        if (index >= m_slots.size()) {
+            for (uint32_t freeIndex = m_slots.size(); freeIndex < index; ++freeIndex) {
+                m_freeIndices.push_back(freeIndex);
+            }
+            m_slots.resize(index + 1);
+        }
+        Slot& slot = m_slots[index];
+        if (slot.isAllocated) {
+            return slot.generation == generation ? &slot : nullptr;
+        }
+        else if (generation < slot.generation) {
+            // The slot has been recycled since this id was valid
+            return nullptr;
+        }
+        // Adopt an id that was not handed out by this manager, e.g. from a
+        // savegame or a script
+        slot.generation = generation;
+        slot.isAllocated = true;
+        slot.isUsed = false;
+        return &slot;
+    }
+
     ComponentCollection&
     getComponentCollection(
         ComponentTypeId typeId
     ) {
         std::unique_ptr<ComponentCollection>& collection = m_collections[typeId];
         if (not collection) {
-            collection.reset(new ComponentCollection(typeId));
+            // Collections are never removed, so the new one is the last
+            unsigned int maskIndex = m_collections.size() - 1;
+            if (maskIndex >= MAX_COMPONENT_TYPES) {
+                m_collections.erase(typeId);
+                throw std::runtime_error("Too many component types");
+            }
+            collection.reset(new ComponentCollection(typeId, maskIndex));
+            m_collectionsByMaskIndex.push_back(collection.get());
+            if (m_journal.isActive) {
+                m_journal.eventReaders[typeId] = collection->addEventReader();
+                collection->beginJournal();
+            }
         }
         return *collection;
     }
 
+    bool
+    removeComponentNow(
+        EntityId entityId,
+        ComponentTypeId typeId
+    ) {
+        auto& componentCollection = this->getComponentCollection(typeId);
+        if (not componentCollection.removeComponent(entityId)) {
+            return false;
+        }
+        Slot* slot = this->resolve(entityId);
+        assert(slot and slot->componentCount > 0 && "Removed component from non-existent entity");
+        slot->mask.reset(componentCollection.maskIndex());
+        slot->componentCount -= 1;
+        // The slot stays allocated until the entity is removed, so that
+        // components can still be added to it
+        return true;
+    }
+
+    // Ids that never received a component are released after a grace
+    // period of one processRemovals(), their owners have lost interest
+    void
+    reclaimUnusedIds() {
+        for (EntityId entityId : m_agingIds) {
+            const Slot* slot = this->resolve(entityId);
+            if (slot and not slot->isUsed and not slot->isPinned) {
+                this->releaseSlot(entityId);
+            }
+        }
+        m_agingIds.swap(m_newIds);
+        m_newIds.clear();
+    }
+
+    void
+    releaseSlot(
+        EntityId entityId
+    ) {
+        uint32_t index = entityIndex(entityId);
+        Slot& slot = m_slots[index];
+        slot.componentCount = 0;
+        slot.mask.reset();
+        if (slot.isPinned) {
+            return;
+        }
+        m_volatileEntities.erase(entityId);
+        slot.isAllocated = false;
+        slot.isUsed = false;
+        slot.generation = (slot.generation + 1) & ENTITY_GENERATION_MASK;
+        m_freeIndices.push_back(index);
+        if (m_journal.isActive) {
+            m_journal.releasedSlots.push_back(makeEntityId(index, slot.generation));
+        }
+    }
+
+    void
+    restoreFreeSlots(
+        const StorageList& freeSlots
+    ) {
+        for (const StorageContainer& entry : freeSlots) {
+            EntityId id = entry.get<EntityId>("id");
+            uint32_t index = entityIndex(id);
+            // Every unallocated slot is in m_freeIndices already
+            bool isListed = false;
+            if (index >= m_slots.size()) {
+                for (uint32_t freeIndex = m_slots.size(); freeIndex < index; ++freeIndex) {
+                    m_freeIndices.push_back(freeIndex);
+                }
+                m_slots.resize(index + 1);
+            }
+            else {
+                isListed = not m_slots[index].isAllocated;
+            }
+            Slot& slot = m_slots[index];
+            if (slot.isAllocated and (slot.componentCount > 0 or slot.isPinned)) {
+                continue;
+            }
+            // Empty slots are only freed by removing their entity, which
+            // the savegame's free list accounts for
+            slot.componentCount = 0;
+            slot.generation = entityGeneration(id);
+            slot.isAllocated = false;
+            slot.isUsed = false;
+            slot.mask.reset();
+            if (not isListed) {
+                m_freeIndices.push_back(index);
+            }
+        }
+    }
+
+    void
+    resetSlots() {
+        m_agingIds.clear();
+        m_freeIndices.clear();
+        m_newIds.clear();
+        m_slots.assign(1, Slot());
+        // Reserve the slot of NULL_ENTITY
+        m_slots[0].isAllocated = true;
+        m_slots[0].isPinned = true;
+    }
+
+    const Slot*
+    resolve(
+        EntityId entityId
+    ) const {
+        uint32_t index = entityIndex(entityId);
+        if (index >= m_slots.size()) {
+            return nullptr;
+        }
+        const Slot& slot = m_slots[index];
+        if (not slot.isAllocated or slot.generation != entityGeneration(entityId)) {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    Slot*
+    resolve(
+        EntityId entityId
+    ) {
+        return const_cast<Slot*>(
+            static_cast<const Implementation*>(this)->resolve(entityId)
+        );
+    }
+
+    // Slots of entities that are not saved, e.g. volatile ones, are freed
+    // as well, so their ids become stale after loading.
+    static void
+    storeFreeSlots(
+        StorageContainer& storage,
+        const std::vector<Slot>& slots,
+        const std::unordered_set<EntityId>& savedEntities
+    ) {
+        StorageList freeSlots;
+        for (uint32_t index = 1; index < slots.size(); ++index) {
+            const Slot& slot = slots[index];
+            EntityId entityId = makeEntityId(index, slot.generation);
+            if (slot.isPinned or savedEntities.count(entityId) > 0) {
+                continue;
+            }
+            StorageContainer slotStorage;
+            if (slot.isAllocated) {
+                slotStorage.set("id", makeEntityId(index, slot.generation + 1));
+            }
+            else {
+                slotStorage.set("id", entityId);
+            }
+            freeSlots.append(std::move(slotStorage));
+        }
+        storage.set("freeSlots", std::move(freeSlots));
+    }
+
+    void
+    storeRemovalsAndNames(
+        StorageContainer& storage,
+        const ComponentFactory& factory
+    ) const {
+        // Components to remove
+        StorageList componentsToRemove;
+        componentsToRemove.reserve(m_componentsToRemove.size());
+        for (const auto& pair : m_componentsToRemove) {
+            StorageContainer pairStorage;
+            pairStorage.set("entityId", pair.first);
+            std::string typeName = factory.getTypeName(pair.second);
+            pairStorage.set("componentTypeName", typeName);
+            componentsToRemove.append(std::move(pairStorage));
+        }
+        storage.set("componentsToRemove", std::move(componentsToRemove));
+        // Entities to remove
+        StorageList entitiesToRemove;
+        entitiesToRemove.reserve(m_entitiesToRemove.size());
+        for (EntityId entityId : m_entitiesToRemove) {
+            StorageContainer idStorage;
+            idStorage.set("id", entityId);
+            entitiesToRemove.append(std::move(idStorage));
+        }
+        storage.set("entitiesToRemove", std::move(entitiesToRemove));
+        // Named entities
+        StorageList namedIds;
+        namedIds.reserve(m_namedIds.size());
+        for (const auto& item : m_namedIds) {
+            StorageContainer itemStorage;
+            itemStorage.set("name", item.first);
+            itemStorage.set("entityId", item.second);
+            namedIds.append(std::move(itemStorage));
+        }
+        storage.set("namedIds", std::move(namedIds));
+    }
+
+    unsigned int m_batchDepth = 0;
+
     std::unordered_map<
         ComponentTypeId, 
         std::unique_ptr<ComponentCollection>
     > m_collections;
 
+    std::vector<ComponentCollection*> m_collectionsByMaskIndex;
+
     std::list<std::pair<EntityId, ComponentTypeId>> m_componentsToRemove;
 
-    EntityId m_currentId = NULL_ENTITY + 1;
+    std::list<EntityId> m_entitiesToRemove;
 
-    std::unordered_map<EntityId, uint16_t> m_entities;
+    // Generated ids that have seen one processRemovals(), see
+    // reclaimUnusedIds()
+    std::vector<EntityId> m_agingIds;
 
-    std::list<EntityId> m_entitiesToRemove;
+    std::deque<uint32_t> m_freeIndices;
+
+    struct Journal {
+
+        // Entities whose volatile flag changed since the last delta
+        std::unordered_set<EntityId> changedVolatility;
+
+        std::unordered_map<ComponentTypeId, unsigned int> eventReaders;
+
+        bool isActive = false;
+
+        // Ids the released slots will have when next allocated
+        std::vector<EntityId> releasedSlots;
+
+    } m_journal;
 
     std::unordered_map<std::string, EntityId> m_namedIds;
 
+    // Generated ids that may not have received a component yet
+    std::vector<EntityId> m_newIds;
+
+    std::unordered_map<std::string, std::weak_ptr<QueryIndex>> m_queryIndexes;
+
+    // Systems may queue removals concurrently, see System::setComponentAccess()
+    boost::mutex m_removalMutex;
+
+    RemovalStatistics m_removalStatistics;
+
+    std::vector<Slot> m_slots;
+
     std::unordered_set<EntityId> m_volatileEntities;
 
 };
@@ -53,6 +453,14 @@ EntityManager::EntityManager()
 }
 
 EntityManager::~EntityManager() {
+    // Filters may outlive the manager, their indexes must not touch the
+    // collections afterwards
+    for (auto& pair : m_impl->m_queryIndexes) {
+        std::shared_ptr<QueryIndex> index = pair.second.lock();
+        if (index) {
+            index->detach();
+        }
+    }
 }
 
 Component*
@@ -61,54 +469,254 @@ EntityManager::addComponent(
     std::unique_ptr<Component> component
 ) {
     assert(entityId != NULL_ENTITY);
+    Implementation::Slot* slot = m_impl->acquireSlot(entityId);
+    if (not slot) {
+        throw std::runtime_error("Tried to add a component to a destroyed entity");
+    }
     ComponentTypeId typeId = component->typeId();
     auto& componentCollection = m_impl->getComponentCollection(typeId);
     Component* rawComponent = component.get();
+    // Set the bit first, filters check it in the collection's callbacks
+    slot->mask.set(componentCollection.maskIndex());
     bool isNew = componentCollection.addComponent(
         entityId, 
         std::move(component)
     );
     if (isNew) {
-        m_impl->m_entities[entityId] += 1;
+        slot->componentCount += 1;
     }
+    slot->isUsed = true;
     return rawComponent;
 }
 
 
+void
+EntityManager::applyDelta(
+    const StorageContainer& delta,
+    const ComponentFactory& factory
+) {
+    // Load components first, replaced collections need to know their owners
+    std::vector<std::unique_ptr<Component>> components;
+    StorageContainer collections = delta.get<StorageContainer>("collections");
+    for (const std::string& typeName : collections.keys()) {
+        StorageList componentList = collections.get<StorageList>(typeName);
+        for (const StorageContainer& componentStorage : componentList) {
+            components.push_back(factory.load(typeName, componentStorage));
+        }
+    }
+    // Removals
+    StorageList removedComponents = delta.get<StorageList>("removedComponents");
+    for (const StorageContainer& entry : removedComponents) {
+        EntityId entityId = entry.get<EntityId>("entityId");
+        std::string typeName = entry.get<std::string>("componentTypeName");
+        m_impl->removeComponentNow(entityId, factory.getTypeId(typeName));
+    }
+    StorageContainer replacedCollections = delta.get<StorageContainer>("replacedCollections");
+    for (const std::string& typeName : replacedCollections.keys()) {
+        ComponentTypeId typeId = factory.getTypeId(typeName);
+        std::unordered_set<EntityId> owners;
+        for (const auto& component : components) {
+            if (component->typeId() == typeId) {
+                owners.insert(component->owner());
+            }
+        }
+        std::vector<EntityId> obsolete;
+        for (const auto& pair : m_impl->getComponentCollection(typeId).components()) {
+            if (owners.count(pair.first) == 0) {
+                obsolete.push_back(pair.first);
+            }
+        }
+        for (EntityId entityId : obsolete) {
+            m_impl->removeComponentNow(entityId, typeId);
+        }
+    }
+    // Named entities
+    StorageList namedIds = delta.get<StorageList>("namedIds");
+    for (const auto& entry : namedIds) {
+        std::string name = entry.get<std::string>("name");
+        EntityId id = entry.get<EntityId>("entityId");
+        if (m_impl->m_namedIds.count(name) > 0) {
+            continue;
+        }
+        m_impl->m_namedIds[name] = id;
+        Implementation::Slot* slot = m_impl->acquireSlot(id);
+        assert(slot && "Named entity id in savegame is in use");
+        slot->isPinned = true;
+    }
+    // An entity removed since the last delta leaves an empty slot behind
+    // here, release it if its index was reused for a newer entity
+    for (const auto& component : components) {
+        EntityId owner = component->owner();
+        uint32_t index = entityIndex(owner);
+        if (index >= m_impl->m_slots.size()) {
+            continue;
+        }
+        const Implementation::Slot& slot = m_impl->m_slots[index];
+        if (
+            slot.isAllocated and
+            not slot.isPinned and
+            slot.componentCount == 0 and
+            slot.generation != entityGeneration(owner)
+        ) {
+            m_impl->releaseSlot(makeEntityId(index, slot.generation));
+        }
+    }
+    // Additions, batched so that filters see each entity only once
+    {
+        Batch batch(*this);
+        for (auto& component : components) {
+            EntityId owner = component->owner();
+            if (owner == NULL_ENTITY) {
+                std::cerr << "Component with no entity: " << component->typeName() << std::endl;
+            }
+            this->addComponent(owner, std::move(component));
+        }
+    }
+    // Slots released since the previous delta
+    m_impl->restoreFreeSlots(delta.get<StorageList>("releasedSlots"));
+    m_impl->m_componentsToRemove.clear();
+    m_impl->m_entitiesToRemove.clear();
+    restoreRemovals(*this, delta, factory);
+}
+
+
+void
+EntityManager::beginBatch() {
+    m_impl->m_batchDepth += 1;
+}
+
+
+void
+EntityManager::beginJournal() {
+    auto& journal = m_impl->m_journal;
+    if (journal.isActive) {
+        this->endJournal();
+    }
+    journal.isActive = true;
+    for (const auto& item : m_impl->m_collections) {
+        journal.eventReaders[item.first] = item.second->addEventReader();
+        item.second->beginJournal();
+    }
+}
+
+
+std::vector<EntityManager::CollectionStatistics>
+EntityManager::collectionStatistics() const {
+    std::vector<CollectionStatistics> statistics;
+    statistics.reserve(m_impl->m_collectionsByMaskIndex.size());
+    for (const ComponentCollection* collection : m_impl->m_collectionsByMaskIndex) {
+        CollectionStatistics entry;
+        entry.bytes = collection->memoryUsage();
+        entry.componentCount = collection->components().size();
+        entry.typeId = collection->type();
+        statistics.push_back(entry);
+    }
+    return statistics;
+}
+
+
+const ComponentMask&
+EntityManager::componentMask(
+    EntityId entityId
+) const {
+    static const ComponentMask EMPTY_MASK;
+    const Implementation::Slot* slot = m_impl->resolve(entityId);
+    return slot ? slot->mask : EMPTY_MASK;
+}
+
+
 void
 EntityManager::clear() {
     for (auto& pair : m_impl->m_collections) {
         pair.second->clear();
     }
     m_impl->m_componentsToRemove.clear();
-    m_impl->m_entities.clear();
     m_impl->m_entitiesToRemove.clear();
     m_impl->m_namedIds.clear();
+    m_impl->resetSlots();
     m_impl->m_volatileEntities.clear();
 }
 
 
+void
+EntityManager::endBatch() {
+    assert(m_impl->m_batchDepth > 0 && "endBatch() without beginBatch()");
+    m_impl->m_batchDepth -= 1;
+}
+
+
+void
+EntityManager::endJournal() {
+    auto& journal = m_impl->m_journal;
+    for (const auto& pair : journal.eventReaders) {
+        ComponentCollection& collection = *m_impl->m_collections.at(pair.first);
+        collection.removeEventReader(pair.second);
+        collection.endJournal();
+    }
+    journal.eventReaders.clear();
+    journal.changedVolatility.clear();
+    journal.releasedSlots.clear();
+    journal.isActive = false;
+}
+
+
 std::unordered_set<EntityId>
 EntityManager::entities() {
     std::unordered_set<EntityId> entities;
-    for (const auto& pair : m_impl->m_entities) {
-        entities.insert(pair.first);
+    const auto& slots = m_impl->m_slots;
+    for (uint32_t index = 0; index < slots.size(); ++index) {
+        if (slots[index].componentCount > 0) {
+            entities.insert(makeEntityId(index, slots[index].generation));
+        }
     }
     return entities;
 }
 
 
+size_t
+EntityManager::entityCount() const {
+    size_t count = 0;
+    for (const Implementation::Slot& slot : m_impl->m_slots) {
+        if (slot.componentCount > 0) {
+            count += 1;
+        }
+    }
+    return count;
+}
+
+
 bool
 EntityManager::exists(
     EntityId entityId
 ) const {
-    return m_impl->m_entities.find(entityId) != m_impl->m_entities.end();
+    const Implementation::Slot* slot = m_impl->resolve(entityId);
+    return slot and slot->componentCount > 0;
 }
 
 
 EntityId
 EntityManager::generateNewId() {
-    return m_impl->m_currentId++;
+    auto& slots = m_impl->m_slots;
+    while (not m_impl->m_freeIndices.empty()) {
+        uint32_t index = m_impl->m_freeIndices.front();
+        m_impl->m_freeIndices.pop_front();
+        // Adopted ids may have taken a slot that is still in the free list
+        if (not slots[index].isAllocated) {
+            slots[index].isAllocated = true;
+            EntityId entityId = makeEntityId(index, slots[index].generation);
+            m_impl->m_newIds.push_back(entityId);
+            return entityId;
+        }
+    }
+    uint32_t index = slots.size();
+    if (index > ENTITY_INDEX_MASK) {
+        throw std::runtime_error("Out of entity ids");
+    }
+    slots.emplace_back();
+    slots.back().isAllocated = true;
+    EntityId entityId = makeEntityId(index, 0);
+    m_impl->m_newIds.push_back(entityId);
+    return entityId;
 }
 
 
@@ -117,8 +725,12 @@ EntityManager::getComponent(
     EntityId entityId,
     ComponentTypeId typeId
 ) {
-    auto& componentCollection = m_impl->getComponentCollection(typeId);
-    return componentCollection[entityId];
+    // Don't create collections just for a lookup
+    auto iter = m_impl->m_collections.find(typeId);
+    if (iter == m_impl->m_collections.end()) {
+        return nullptr;
+    }
+    return iter->second->get(entityId);
 }
 
 
@@ -140,12 +752,41 @@ EntityManager::getNamedId(
     }
     else {
         EntityId newId = this->generateNewId();
+        m_impl->m_slots[entityIndex(newId)].isPinned = true;
         m_impl->m_namedIds.insert(iter, std::make_pair(name, newId));
         return newId;
     }
 }
 
 
+std::shared_ptr<QueryIndex>
+EntityManager::getQueryIndex(
+    const std::string& key
+) {
+    auto iter = m_impl->m_queryIndexes.find(key);
+    if (iter == m_impl->m_queryIndexes.end()) {
+        return nullptr;
+    }
+    std::shared_ptr<QueryIndex> index = iter->second.lock();
+    if (not index) {
+        m_impl->m_queryIndexes.erase(iter);
+    }
+    return index;
+}
+
+
+bool
+EntityManager::isBatching() const {
+    return m_impl->m_batchDepth > 0;
+}
+
+
+bool
+EntityManager::isJournaling() const {
+    return m_impl->m_journal.isActive;
+}
+
+
 bool
 EntityManager::isVolatile(
     EntityId id
@@ -154,6 +795,16 @@ EntityManager::isVolatile(
 }
 
 
+size_t
+EntityManager::memoryUsage() const {
+    return sizeof(Implementation) +
+        m_impl->m_slots.capacity() * sizeof(Implementation::Slot) +
+        m_impl->m_freeIndices.size() * sizeof(uint32_t) +
+        m_impl->m_collectionsByMaskIndex.capacity() * sizeof(ComponentCollection*) +
+        m_impl->m_volatileEntities.size() * sizeof(EntityId);
+}
+
+
 std::unordered_set<ComponentTypeId>
 EntityManager::nonEmptyCollections() const {
     std::unordered_set<ComponentTypeId> collections;
@@ -168,29 +819,68 @@ EntityManager::nonEmptyCollections() const {
 
 void
 EntityManager::processRemovals() {
+    using Clock = boost::chrono::high_resolution_clock;
+    Clock::time_point start = Clock::now();
+    RemovalStatistics statistics;
     for (const auto& pair : m_impl->m_componentsToRemove) {
-        EntityId entityId = pair.first;
-        ComponentTypeId typeId = pair.second;
-        auto& componentCollection = m_impl->getComponentCollection(typeId);
-        bool removed = componentCollection.removeComponent(entityId);
-        if (removed) {
-            auto iter = m_impl->m_entities.find(entityId);
-            iter->second -= 1;
-            if (iter->second == 0) {
-                m_impl->m_entities.erase(iter);
-            }
-            else {
-                assert(iter->second > 0 && "Removed component from non-existent entity");
-            }
+        if (m_impl->removeComponentNow(pair.first, pair.second)) {
+            statistics.componentsRemoved += 1;
         }
     }
     m_impl->m_componentsToRemove.clear();
     for (EntityId entityId : m_impl->m_entitiesToRemove) {
-        for (const auto& pair : m_impl->m_collections) {
-            pair.second->removeComponent(entityId);
+        if (not m_impl->resolve(entityId)) {
+            // Stale or already removed
+            continue;
+        }
+        // Copy the mask, the removal callbacks may look at the slot
+        ComponentMask mask = m_impl->resolve(entityId)->mask;
+        const auto& collections = m_impl->m_collectionsByMaskIndex;
+        for (unsigned int maskIndex = 0; maskIndex < collections.size() and mask.any(); ++maskIndex) {
+            if (mask.test(maskIndex)) {
+                mask.reset(maskIndex);
+                statistics.collectionsVisited += 1;
+                if (collections[maskIndex]->removeComponent(entityId)) {
+                    statistics.componentsRemoved += 1;
+                }
+            }
+        }
+        if (m_impl->resolve(entityId)) {
+            m_impl->releaseSlot(entityId);
+            statistics.entitiesRemoved += 1;
         }
     }
     m_impl->m_entitiesToRemove.clear();
+    m_impl->reclaimUnusedIds();
+    statistics.duration = boost::chrono::duration_cast<boost::chrono::microseconds>(
+        Clock::now() - start
+    );
+    m_impl->m_removalStatistics = statistics;
+}
+
+
+std::vector<EntityManager::QueryStatistics>
+EntityManager::queryStatistics() const {
+    std::vector<QueryStatistics> statistics;
+    for (const auto& pair : m_impl->m_queryIndexes) {
+        std::shared_ptr<QueryIndex> index = pair.second.lock();
+        if (not index) {
+            continue;
+        }
+        boost::lock_guard<boost::mutex> lock(index->mutex());
+        QueryStatistics entry;
+        entry.bytes = index->memoryUsage();
+        entry.entityCount = index->entityCount();
+        entry.name = pair.first;
+        statistics.push_back(entry);
+    }
+    return statistics;
+}
+
+
+const EntityManager::RemovalStatistics&
+EntityManager::removalStatistics() const {
+    return m_impl->m_removalStatistics;
 }
 
 
@@ -199,6 +889,7 @@ EntityManager::removeComponent(
     EntityId entityId,
     ComponentTypeId typeId
 ) {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_removalMutex);
     m_impl->m_componentsToRemove.emplace_back(entityId, typeId);
 }
 
@@ -206,6 +897,7 @@ void
 EntityManager::removeEntity(
     EntityId entityId
 ) {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_removalMutex);
     m_impl->m_entitiesToRemove.push_back(entityId);
 }
 
@@ -215,44 +907,69 @@ EntityManager::restore(
     const StorageContainer& storage,
     const ComponentFactory& factory
 ) {
+    bool isLegacy = not storage.contains("freeSlots");
+    if (isLegacy) {
+        // Before clearing, so that a rejected savegame leaves us untouched
+        checkLegacyIds(storage);
+    }
     this->clear();
-    // Current Id
-    m_impl->m_currentId = storage.get<EntityId>("currentId");
     // Named entities
     StorageList namedIds = storage.get<StorageList>("namedIds");
     for (const auto& entry : namedIds) {
         std::string name = entry.get<std::string>("name");
         EntityId id = entry.get<EntityId>("entityId");
         m_impl->m_namedIds[name] = id;
+        Implementation::Slot* slot = m_impl->acquireSlot(id);
+        assert(slot && "Duplicate named entity id in savegame");
+        slot->isPinned = true;
     }
-    // Collections
+    // Collections, batched so that filters see each entity only once
     StorageContainer collections = storage.get<StorageContainer>("collections");
     auto typeNames = collections.keys();
-    for (const std::string& typeName : typeNames) {
-        StorageList componentList = collections.get<StorageList>(typeName);
-        for (const StorageContainer& componentStorage : componentList) {
-            auto component = factory.load(typeName, componentStorage);
-            EntityId owner = component->owner();
-            if (owner == NULL_ENTITY) {
-                std::cerr << "Component with no entity: " << typeName << std::endl;
+    {
+        Batch batch(*this);
+        for (const std::string& typeName : typeNames) {
+            StorageList componentList = collections.get<StorageList>(typeName);
+            for (const StorageContainer& componentStorage : componentList) {
+                auto component = factory.load(typeName, componentStorage);
+                EntityId owner = component->owner();
+                if (owner == NULL_ENTITY) {
+                    std::cerr << "Component with no entity: " << typeName << std::endl;
+                }
+                this->addComponent(owner, std::move(component));
             }
-            this->addComponent(owner, std::move(component));
         }
     }
-    // Components to remove
-    StorageList componentsToRemove = storage.get<StorageList>("componentsToRemove");
-    for (const StorageContainer& entry : componentsToRemove) {
-        EntityId entityId = entry.get<EntityId>("entityId");
-        std::string typeName = entry.get<std::string>("componentTypeName");
-        ComponentTypeId typeId = factory.getTypeId(typeName);
-        this->removeComponent(entityId, typeId);
+    // Slots
+    auto& slots = m_impl->m_slots;
+    if (not isLegacy) {
+        m_impl->restoreFreeSlots(storage.get<StorageList>("freeSlots"));
     }
-    // Entities to remove
-    StorageList entitiesToRemove = storage.get<StorageList>("entitiesToRemove");
-    for (const auto& entry : entitiesToRemove) {
-        EntityId entityId = entry.get<EntityId>("id");
-        this->removeEntity(entityId);
+    else {
+        // Savegames from before generational ids: every slot below the old
+        // id counter that was not restored is free. Start it at generation 1
+        // so that dangling ids from the savegame stay invalid.
+        EntityId currentId = storage.get<EntityId>("currentId");
+        if (currentId > slots.size()) {
+            slots.resize(currentId);
+        }
+        for (uint32_t index = 1; index < currentId; ++index) {
+            if (not slots[index].isAllocated) {
+                slots[index].generation = 1;
+                m_impl->m_freeIndices.push_back(index);
+            }
+        }
     }
+    restoreRemovals(*this, storage, factory);
+}
+
+
+void
+EntityManager::setQueryIndex(
+    const std::string& key,
+    std::shared_ptr<QueryIndex> index
+) {
+    m_impl->m_queryIndexes[key] = index;
 }
 
 
@@ -267,6 +984,162 @@ EntityManager::setVolatile(
     else {
         m_impl->m_volatileEntities.erase(id);
     }
+    if (m_impl->m_journal.isActive) {
+        m_impl->m_journal.changedVolatility.insert(id);
+    }
+}
+
+
+std::function<StorageContainer()>
+EntityManager::snapshot(
+    const ComponentFactory& factory
+) const {
+    struct Snapshot {
+
+        std::vector<CollectionSnapshot> collections;
+
+        std::vector<Implementation::Slot> slots;
+
+        StorageContainer storage;
+
+    };
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->storage.set<EntityId>("currentId", m_impl->m_slots.size());
+    for (const auto& item : m_impl->m_collections) {
+        const auto& components = item.second->components();
+        CollectionSnapshot collection;
+        collection.typeName = factory.getTypeName(item.first);
+        ComponentFactory::ComponentCloner cloner = factory.getCloner(collection.typeName);
+        for (const auto& pair : components) {
+            EntityId entityId = pair.first;
+            const std::unique_ptr<Component>& component = pair.second;
+            if (component->isVolatile() or
+                m_impl->m_volatileEntities.count(entityId) > 0
+            ) {
+                continue;
+            }
+            collection.add(entityId, *component, cloner);
+        }
+        if (not collection.savedEntities.empty()) {
+            snapshot->collections.push_back(std::move(collection));
+        }
+    }
+    snapshot->slots = m_impl->m_slots;
+    m_impl->storeRemovalsAndNames(snapshot->storage, factory);
+    return [snapshot] () -> StorageContainer {
+        std::unordered_set<EntityId> savedEntities;
+        StorageContainer collections;
+        for (CollectionSnapshot& collection : snapshot->collections) {
+            savedEntities.insert(
+                collection.savedEntities.begin(),
+                collection.savedEntities.end()
+            );
+            collections.set(collection.typeName, collection.build());
+        }
+        StorageContainer storage = std::move(snapshot->storage);
+        storage.set("collections", std::move(collections));
+        Implementation::storeFreeSlots(storage, snapshot->slots, savedEntities);
+        return storage;
+    };
+}
+
+
+std::function<StorageContainer()>
+EntityManager::snapshotDelta(
+    const ComponentFactory& factory
+) {
+    auto& journal = m_impl->m_journal;
+    if (not journal.isActive) {
+        throw std::logic_error("snapshotDelta() without beginJournal()");
+    }
+    auto isSaved = [this] (EntityId entityId, const Component& component) {
+        return (
+            not component.isVolatile() and
+            m_impl->m_volatileEntities.count(entityId) == 0
+        );
+    };
+    struct DeltaSnapshot {
+
+        std::vector<CollectionSnapshot> collections;
+
+        StorageContainer delta;
+
+    };
+    auto snapshot = std::make_shared<DeltaSnapshot>();
+    // Collections
+    StorageContainer replacedCollections;
+    StorageList removedComponents;
+    for (const auto& item : m_impl->m_collections) {
+        ComponentCollection& collection = *item.second;
+        auto events = collection.readEvents(journal.eventReaders.at(item.first));
+        std::vector<EntityId> unsavedChanges = collection.takeUnsavedChanges();
+        CollectionSnapshot collectionSnapshot;
+        collectionSnapshot.typeName = factory.getTypeName(item.first);
+        ComponentFactory::ComponentCloner cloner = factory.getCloner(collectionSnapshot.typeName);
+        if (not events.isComplete) {
+            // Without a complete record of additions and removals, the
+            // whole collection is saved again
+            for (const auto& pair : collection.components()) {
+                if (isSaved(pair.first, *pair.second)) {
+                    collectionSnapshot.add(pair.first, *pair.second, cloner);
+                }
+            }
+            replacedCollections.set(collectionSnapshot.typeName, true);
+        }
+        else {
+            std::unordered_set<EntityId> candidates(
+                unsavedChanges.begin(),
+                unsavedChanges.end()
+            );
+            for (const auto* event = events.begin; event != events.end; ++event) {
+                candidates.insert(event->entityId);
+            }
+            for (EntityId entityId : journal.changedVolatility) {
+                if (collection.get(entityId)) {
+                    candidates.insert(entityId);
+                }
+            }
+            for (EntityId entityId : candidates) {
+                Component* component = collection.get(entityId);
+                if (component and isSaved(entityId, *component)) {
+                    collectionSnapshot.add(entityId, *component, cloner);
+                }
+                else {
+                    StorageContainer entry;
+                    entry.set("entityId", entityId);
+                    entry.set("componentTypeName", collectionSnapshot.typeName);
+                    removedComponents.append(std::move(entry));
+                }
+            }
+        }
+        if (not collectionSnapshot.savedEntities.empty()) {
+            snapshot->collections.push_back(std::move(collectionSnapshot));
+        }
+    }
+    journal.changedVolatility.clear();
+    // Slots
+    StorageList releasedSlots;
+    releasedSlots.reserve(journal.releasedSlots.size());
+    for (EntityId entityId : journal.releasedSlots) {
+        StorageContainer slotStorage;
+        slotStorage.set("id", entityId);
+        releasedSlots.append(std::move(slotStorage));
+    }
+    journal.releasedSlots.clear();
+    StorageContainer& delta = snapshot->delta;
+    delta.set("releasedSlots", std::move(releasedSlots));
+    delta.set("removedComponents", std::move(removedComponents));
+    delta.set("replacedCollections", std::move(replacedCollections));
+    m_impl->storeRemovalsAndNames(delta, factory);
+    return [snapshot] () -> StorageContainer {
+        StorageContainer collections;
+        for (CollectionSnapshot& collection : snapshot->collections) {
+            collections.set(collection.typeName, collection.build());
+        }
+        StorageContainer delta = std::move(snapshot->delta);
+        delta.set("collections", std::move(collections));
+        return delta;
+    };
 }
 
 
@@ -276,8 +1149,9 @@ EntityManager::storage(
 ) const {
     StorageContainer storage;
     // Current Id
-    storage.set("currentId", m_impl->m_currentId);
+    storage.set<EntityId>("currentId", m_impl->m_slots.size());
     // Collections
+    std::unordered_set<EntityId> savedEntities;
     StorageContainer collections;
     for (const auto& item : m_impl->m_collections) {
         const auto& components = item.second->components();
@@ -292,6 +1166,7 @@ EntityManager::storage(
                 continue;
             }
             componentList.append(component->storage());
+            savedEntities.insert(entityId);
         }
         if (not componentList.empty()) {
             std::string typeName = factory.getTypeName(item.first);
@@ -299,37 +1174,16 @@ EntityManager::storage(
         }
     }
     storage.set("collections", std::move(collections));
-    // Components to remove
-    StorageList componentsToRemove;
-    componentsToRemove.reserve(m_impl->m_componentsToRemove.size());
-    for (const auto& pair : m_impl->m_componentsToRemove) {
-        StorageContainer pairStorage;
-        pairStorage.set("entityId", pair.first);
-        std::string typeName = factory.getTypeName(pair.second);
-        pairStorage.set("componentTypeName", typeName);
-        componentsToRemove.append(std::move(pairStorage));
-    }
-    storage.set("componentsToRemove", std::move(componentsToRemove));
-    // Entities to remove
-    StorageList entitiesToRemove;
-    entitiesToRemove.reserve(m_impl->m_entitiesToRemove.size());
-    for (EntityId entityId : m_impl->m_entitiesToRemove) {
-        StorageContainer idStorage;
-        idStorage.set("id", entityId);
-        entitiesToRemove.append(std::move(idStorage));
-    }
-    storage.set("entitiesToRemove", std::move(entitiesToRemove));
-    // Named entities
-    StorageList namedIds;
-    namedIds.reserve(m_impl->m_namedIds.size());
-    for (const auto& item : m_impl->m_namedIds) {
-        StorageContainer itemStorage;
-        itemStorage.set("name", item.first);
-        itemStorage.set("entityId", item.second);
-        namedIds.append(std::move(itemStorage));
-    }
-    storage.set("namedIds", std::move(namedIds));
+    m_impl->storeFreeSlots(storage, m_impl->m_slots, savedEntities);
+    m_impl->storeRemovalsAndNames(storage, factory);
     return storage;
 }
 
 
+StorageContainer
+EntityManager::storageDelta(
+    const ComponentFactory& factory
+) {
+    return this->snapshotDelta(factory)();
+}
+
@@ -3,14 +3,19 @@
 #include "engine/typedefs.h"
 #include "util/make_unique.h"
 
+#include <boost/chrono.hpp>
+#include <functional>
 #include <memory>
+#include <string>
 #include <unordered_set>
+#include <vector>
 
 namespace thrive {
 
 class Component;
 class ComponentCollection;
 class ComponentFactory;
+class QueryIndex;
 class StorageContainer;
 
 /**
@@ -18,11 +23,125 @@ class StorageContainer;
 *
 * The entity manager holds a collection of Component objects, sorted by type
 * and entity.
+*
+* Entity ids are generational handles. The low bits of an id are the index
+* of a slot in the manager, the high bits are the slot's generation (see
+* entityIndex() and entityGeneration()). When an entity loses its last
+* component or is removed, its slot is recycled with an incremented
+* generation. Ids still referring to the old generation are stale: they
+* don't exist, have no components and can't receive new ones. Named entities
+* keep their slot for the manager's lifetime.
 */
 class EntityManager {
 
 public:
 
+    /**
+    * @brief Keeps a batch open for its lifetime
+    *
+    * @see beginBatch()
+    */
+    class Batch {
+
+    public:
+
+        Batch(
+            EntityManager& entityManager
+        ) : m_entityManager(entityManager)
+        {
+            m_entityManager.beginBatch();
+        }
+
+        ~Batch() {
+            m_entityManager.endBatch();
+        }
+
+        Batch(const Batch&) = delete;
+
+        Batch&
+        operator= (const Batch&) = delete;
+
+    private:
+
+        EntityManager& m_entityManager;
+
+    };
+
+    /**
+    * @brief Size of a component collection
+    *
+    * @see collectionStatistics()
+    */
+    struct CollectionStatistics {
+
+        /**
+        * @brief Estimated memory used by the collection and its components
+        */
+        size_t bytes = 0;
+
+        /**
+        * @brief Number of components in the collection
+        */
+        size_t componentCount = 0;
+
+        /**
+        * @brief The collection's component type
+        */
+        ComponentTypeId typeId = NULL_COMPONENT_TYPE;
+
+    };
+
+    /**
+    * @brief Size of a query index shared by entity filters
+    *
+    * @see queryStatistics()
+    */
+    struct QueryStatistics {
+
+        /**
+        * @brief Estimated memory used by the index
+        */
+        size_t bytes = 0;
+
+        /**
+        * @brief Number of matching entities
+        */
+        size_t entityCount = 0;
+
+        /**
+        * @brief The index's key, see getQueryIndex()
+        */
+        std::string name;
+
+    };
+
+    /**
+    * @brief What the last call to processRemovals() did
+    */
+    struct RemovalStatistics {
+
+        /**
+        * @brief Number of collections touched while removing whole entities
+        */
+        size_t collectionsVisited = 0;
+
+        /**
+        * @brief Number of components that were removed
+        */
+        size_t componentsRemoved = 0;
+
+        /**
+        * @brief Time spent in processRemovals()
+        */
+        boost::chrono::microseconds duration = boost::chrono::microseconds(0);
+
+        /**
+        * @brief Number of entities that were removed
+        */
+        size_t entitiesRemoved = 0;
+
+    };
+
     /**
     * @brief Constructor
     */
@@ -44,6 +163,9 @@ public:
     * @return
     *   The component as a non-owning pointer
     *
+    * @throws std::runtime_error
+    *   If \a entityId is stale
+    *
     * @note:
     *   Use the templated version to receive the proper type back
     */
@@ -82,6 +204,49 @@ public:
         );
     }
 
+    /**
+    * @brief Applies changes recorded by storageDelta()
+    *
+    * The manager must be in the state the delta was recorded against,
+    * usually restored from a savegame and earlier deltas.
+    *
+    * @param delta
+    *   The changes to apply
+    * @param factory
+    *   The component factory to use
+    */
+    void
+    applyDelta(
+        const StorageContainer& delta,
+        const ComponentFactory& factory
+    );
+
+    /**
+    * @brief Starts a batch of structural changes
+    *
+    * While a batch is open, entity filters don't add new entities. They
+    * remember them and build each entity's group once, on their first
+    * access after the batch has ended. Batches can be nested, only the
+    * outermost endBatch() completes the batch.
+    *
+    * Prefer EntityCommandBuffer over calling this directly.
+    *
+    * @see endBatch()
+    */
+    void
+    beginBatch();
+
+    /**
+    * @brief Starts recording changes for storageDelta()
+    *
+    * Changes are recorded from the collections' event logs and from
+    * components marked with Component::markUnsavedChange(), which
+    * Component::touch() calls. If the journal is already running, it
+    * starts over.
+    */
+    void
+    beginJournal();
+
     /**
     * @brief Removes all components
     *
@@ -90,16 +255,66 @@ public:
     void
     clear();
 
+    /**
+    * @brief Returns the size of every component collection
+    *
+    * Walks all components, so this is meant for debugging output rather
+    * than for every frame.
+    */
+    std::vector<CollectionStatistics>
+    collectionStatistics() const;
+
+    /**
+    * @brief Returns the component types an entity has
+    *
+    * Bit \c i is set if the entity has a component in the collection whose
+    * ComponentCollection::maskIndex() is \c i. Testing a set of component
+    * types against this mask is much cheaper than looking up every
+    * component.
+    *
+    * @param entityId
+    *   The entity to query
+    *
+    * @return
+    *   The entity's component mask, empty for stale ids
+    */
+    const ComponentMask&
+    componentMask(
+        EntityId entityId
+    ) const;
+
+    /**
+    * @brief Ends a batch started with beginBatch()
+    */
+    void
+    endBatch();
+
+    /**
+    * @brief Stops recording changes
+    */
+    void
+    endJournal();
+
     /**
     * @brief Returns a set of entity ids that have at least one components
     */
     std::unordered_set<EntityId>
     entities();
 
+    /**
+    * @brief The number of entities with at least one component
+    */
+    size_t
+    entityCount() const;
+
     /**
     * @brief Generates a new, unique entity id
     *
-    * This function is safe.
+    * Reuses the slot that has been free the longest, if any.
+    *
+    * An id that has not received a component by the second
+    * processRemovals() after this call is released again, like a removed
+    * entity's id.
     *
     * @return A new entity id
     */
@@ -185,6 +400,24 @@ public:
         const std::string& name
     );
 
+    /**
+    * @brief Returns a shared query index
+    *
+    * Entity filters with the same query share one index, see
+    * setQueryIndex().
+    *
+    * @param key
+    *   Identifies the query
+    *
+    * @return
+    *   The index or \c nullptr if no live index is registered under
+    *   \a key
+    */
+    std::shared_ptr<QueryIndex>
+    getQueryIndex(
+        const std::string& key
+    );
+
     /**
     * @brief Retrieves a component, creating it if necessary
     *
@@ -224,13 +457,36 @@ public:
     * @param entityId
     *   The id to check for
     *
-    * @return \c true if the entity has at least one component, false otherwise
+    * @return \c true if the entity has at least one component and \a entityId
+    *   is not stale, false otherwise
     */
     bool
     exists(
         EntityId entityId
     ) const;
 
+    /**
+    * @brief Whether a batch of structural changes is open
+    *
+    * @see beginBatch()
+    */
+    bool
+    isBatching() const;
+
+    /**
+    * @brief Whether changes are being recorded for storageDelta()
+    */
+    bool
+    isJournaling() const;
+
+    /**
+    * @brief Estimates the memory used by the manager's own bookkeeping
+    *
+    * Doesn't include the collections, see collectionStatistics().
+    */
+    size_t
+    memoryUsage() const;
+
     /**
     * @brief Returns the set of non-empty collection ids
     *
@@ -255,10 +511,28 @@ public:
 
     /**
     * @brief Removes all components queued for removal
+    *
+    * Removing an entity only touches the collections it has components in,
+    * according to its component mask. Only removing the entity frees its
+    * id, an entity whose last component was removed keeps it.
     */
     void
     processRemovals();
 
+    /**
+    * @brief Returns the size of every live query index
+    *
+    * Must not be called while systems sync their filters concurrently.
+    */
+    std::vector<QueryStatistics>
+    queryStatistics() const;
+
+    /**
+    * @brief Returns statistics about the last call to processRemovals()
+    */
+    const RemovalStatistics&
+    removalStatistics() const;
+
     /**
     * @brief Removes a component
     *
@@ -267,6 +541,8 @@ public:
     * To allow self-removing components such as script handles, the component
     * is only removed with the next call to EntityManager::processRemovals().
     *
+    * This function is thread safe.
+    *
     * @param entityId
     *   The component's owner
     * @param typeId
@@ -286,6 +562,8 @@ public:
     * To allow self-removing components such as script handles, the component
     * is only removed with the next call to EntityManager::processRemovals().
     *
+    * This function is thread safe.
+    *
     * @param entityId
     *   The entity to remove
     */
@@ -301,6 +579,10 @@ public:
     *   The storage container to restore from
     * @param factory
     *   The component factory to use
+    *
+    * @throws std::runtime_error
+    *   If \a storage is from before generational ids and holds an id above
+    *   ENTITY_INDEX_MASK. The entity manager is left unchanged.
     */
     void
     restore(
@@ -308,6 +590,26 @@ public:
         const ComponentFactory& factory
     );
 
+    /**
+    * @brief Registers a query index for sharing
+    *
+    * The manager only keeps a weak reference, the index is released when
+    * the last filter using it lets go of it. Indexes still alive when the
+    * manager is destroyed are detached (see QueryIndex::detach()).
+    *
+    * Not thread safe, register indexes while setting up systems.
+    *
+    * @param key
+    *   Identifies the query
+    * @param index
+    *   The index to share
+    */
+    void
+    setQueryIndex(
+        const std::string& key,
+        std::shared_ptr<QueryIndex> index
+    );
+
     /**
     * @brief Sets the volatile flag for an entity
     *
@@ -320,6 +622,51 @@ public:
         bool isVolatile
     );
 
+    /**
+    * @brief Takes a snapshot for serializing later, e.g. on another thread
+    *
+    * Components of types with a registered cloner (see
+    * ComponentFactory::registerGlobalComponentCloner()) are copied, and
+    * their storage is only built when the returned function is called.
+    * Other components, such as those implemented in Lua, are serialized
+    * right away.
+    *
+    * The returned function may be called from any thread, once. Its
+    * result is the same as that of storage() at the time of the snapshot.
+    *
+    * @param factory
+    *   The component factory to use for cloning and type name lookup
+    *
+    * @return
+    *   Builds the storage container
+    */
+    std::function<StorageContainer()>
+    snapshot(
+        const ComponentFactory& factory
+    ) const;
+
+    /**
+    * @brief Takes a snapshot of the changes since the last delta for
+    *   serializing later
+    *
+    * Collects the changes like storageDelta() and copies the changed
+    * components like snapshot(). The returned function may be called from
+    * any thread, once, and returns what storageDelta() would have.
+    *
+    * @param factory
+    *   The component factory to use for cloning and type name lookup
+    *
+    * @return
+    *   Builds the delta
+    *
+    * @throws std::logic_error
+    *   If the journal isn't running
+    */
+    std::function<StorageContainer()>
+    snapshotDelta(
+        const ComponentFactory& factory
+    );
+
     /**
     * @brief Serializes the current non-volatile components into a storage container
     *
@@ -333,6 +680,35 @@ public:
         const ComponentFactory& factory
     ) const;
 
+    /**
+    * @brief Serializes the changes since the last call
+    *
+    * The first call after beginJournal() returns the changes since
+    * beginJournal(). Apply the result to a manager restored from storage()
+    * with applyDelta().
+    *
+    * Only components that have been added, touched or marked (see
+    * Component::markUnsavedChange()) are serialized, so the cost depends
+    * on the number of changes, not on the size of the world. Collections
+    * whose event log overflowed are serialized completely.
+    *
+    * Unlike storage(), the delta only lists the slots released since the
+    * last call, slots of volatile entities are not freed.
+    *
+    * @param factory
+    *   The component factory to use for type name lookup
+    *
+    * @return
+    *   The changes, with the same bookkeeping as storage()
+    *
+    * @throws std::logic_error
+    *   If the journal isn't running
+    */
+    StorageContainer
+    storageDelta(
+        const ComponentFactory& factory
+    );
+
 private:
 
     struct Implementation;
@@ -0,0 +1,353 @@
+#pragma once
+
+#include "engine/sparse_index.h"
+#include "engine/typedefs.h"
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace thrive {
+
+/**
+* @brief Associative container from entity ids to values, stored as a
+* sparse set
+*
+* The entries live in one packed array, so iterating over the map is a
+* linear scan. A SparseIndex maps entity ids to their position in that
+* array, which makes lookup, insertion and removal O(1). Removal moves the
+* last entry into the gap, so the iteration order is not stable.
+*
+* The interface follows the subset of std::unordered_map used by the
+* entity filters: entries are <tt>std::pair<EntityId, Value></tt>.
+*
+* @tparam Value
+*   The mapped type
+*/
+template<typename Value>
+class EntityMap {
+
+public:
+
+    using value_type = std::pair<EntityId, Value>;
+
+    using Entries = std::vector<value_type>;
+
+    using const_iterator = typename Entries::const_iterator;
+
+    using iterator = typename Entries::iterator;
+
+    /**
+    * @brief Returns the value for an entity, inserting a default value if
+    * necessary
+    */
+    Value&
+    operator[] (
+        EntityId entityId
+    ) {
+        uint32_t position = this->position(entityId);
+        if (position == SparseIndex::NONE) {
+            position = m_entries.size();
+            m_index.set(entityId, position);
+            m_entries.emplace_back(entityId, Value());
+        }
+        return m_entries[position].second;
+    }
+
+    /**
+    * @brief Returns the value for an entity
+    *
+    * @throws std::out_of_range
+    *   If the entity is not in the map
+    */
+    const Value&
+    at(
+        EntityId entityId
+    ) const {
+        uint32_t position = this->position(entityId);
+        if (position == SparseIndex::NONE) {
+            throw std::out_of_range("Entity not in map");
+        }
+        return m_entries[position].second;
+    }
+
+    iterator
+    begin() {
+        return m_entries.begin();
+    }
+
+    const_iterator
+    begin() const {
+        return m_entries.begin();
+    }
+
+    const_iterator
+    cbegin() const {
+        return m_entries.cbegin();
+    }
+
+    const_iterator
+    cend() const {
+        return m_entries.cend();
+    }
+
+    /**
+    * @brief Removes all entries
+    *
+    * Keeps the allocated memory, so a map that is refilled every frame
+    * doesn't reallocate.
+    */
+    void
+    clear() {
+        for (const value_type& entry : m_entries) {
+            m_index.erase(entry.first);
+        }
+        m_entries.clear();
+    }
+
+    /**
+    * @brief Returns 1 if the entity is in the map, 0 otherwise
+    */
+    size_t
+    count(
+        EntityId entityId
+    ) const {
+        return this->position(entityId) == SparseIndex::NONE ? 0 : 1;
+    }
+
+    bool
+    empty() const {
+        return m_entries.empty();
+    }
+
+    iterator
+    end() {
+        return m_entries.end();
+    }
+
+    const_iterator
+    end() const {
+        return m_entries.end();
+    }
+
+    /**
+    * @brief Removes an entity
+    *
+    * @return
+    *   The number of removed entries, either 0 or 1
+    */
+    size_t
+    erase(
+        EntityId entityId
+    ) {
+        uint32_t position = this->position(entityId);
+        if (position == SparseIndex::NONE) {
+            return 0;
+        }
+        m_index.erase(entityId);
+        if (position + 1 != m_entries.size()) {
+            m_entries[position] = std::move(m_entries.back());
+            m_index.set(m_entries[position].first, position);
+        }
+        m_entries.pop_back();
+        return 1;
+    }
+
+    /**
+    * @brief Looks up an entity
+    *
+    * @return
+    *   An iterator to the entity's entry or end()
+    */
+    iterator
+    find(
+        EntityId entityId
+    ) {
+        uint32_t position = this->position(entityId);
+        if (position == SparseIndex::NONE) {
+            return m_entries.end();
+        }
+        return m_entries.begin() + position;
+    }
+
+    const_iterator
+    find(
+        EntityId entityId
+    ) const {
+        uint32_t position = this->position(entityId);
+        if (position == SparseIndex::NONE) {
+            return m_entries.end();
+        }
+        return m_entries.begin() + position;
+    }
+
+    /**
+    * @brief The memory used by the map in bytes
+    *
+    * Doesn't include memory the values allocate themselves.
+    */
+    size_t
+    memoryUsage() const {
+        return m_entries.capacity() * sizeof(value_type) + m_index.memoryUsage();
+    }
+
+    /**
+    * @brief Inserts or overwrites the value for an entity
+    */
+    void
+    set(
+        EntityId entityId,
+        const Value& value
+    ) {
+        (*this)[entityId] = value;
+    }
+
+    size_t
+    size() const {
+        return m_entries.size();
+    }
+
+private:
+
+    uint32_t
+    position(
+        EntityId entityId
+    ) const {
+        uint32_t position = m_index.get(entityId);
+        if (position < m_entries.size() and m_entries[position].first == entityId) {
+            return position;
+        }
+        return SparseIndex::NONE;
+    }
+
+    Entries m_entries;
+
+    SparseIndex m_index;
+
+};
+
+
+/**
+* @brief Set of entity ids, stored as a sparse set
+*
+* Like EntityMap, but without values. Iterating yields the entity ids in a
+* packed array.
+*/
+class EntitySet {
+
+public:
+
+    using const_iterator = std::vector<EntityId>::const_iterator;
+
+    using iterator = const_iterator;
+
+    const_iterator
+    begin() const {
+        return m_entities.begin();
+    }
+
+    /**
+    * @brief Removes all entities, keeping the allocated memory
+    */
+    void
+    clear() {
+        for (EntityId entityId : m_entities) {
+            m_index.erase(entityId);
+        }
+        m_entities.clear();
+    }
+
+    /**
+    * @brief Returns 1 if the entity is in the set, 0 otherwise
+    */
+    size_t
+    count(
+        EntityId entityId
+    ) const {
+        return this->position(entityId) == SparseIndex::NONE ? 0 : 1;
+    }
+
+    bool
+    empty() const {
+        return m_entities.empty();
+    }
+
+    const_iterator
+    end() const {
+        return m_entities.end();
+    }
+
+    /**
+    * @brief Removes an entity
+    *
+    * @return
+    *   The number of removed entities, either 0 or 1
+    */
+    size_t
+    erase(
+        EntityId entityId
+    ) {
+        uint32_t position = this->position(entityId);
+        if (position == SparseIndex::NONE) {
+            return 0;
+        }
+        m_index.erase(entityId);
+        if (position + 1 != m_entities.size()) {
+            m_entities[position] = m_entities.back();
+            m_index.set(m_entities[position], position);
+        }
+        m_entities.pop_back();
+        return 1;
+    }
+
+    /**
+    * @brief Adds an entity
+    *
+    * @return
+    *   \c true if the entity was not in the set before
+    */
+    bool
+    insert(
+        EntityId entityId
+    ) {
+        if (this->position(entityId) != SparseIndex::NONE) {
+            return false;
+        }
+        m_index.set(entityId, m_entities.size());
+        m_entities.push_back(entityId);
+        return true;
+    }
+
+    /**
+    * @brief The memory used by the set in bytes
+    */
+    size_t
+    memoryUsage() const {
+        return m_entities.capacity() * sizeof(EntityId) + m_index.memoryUsage();
+    }
+
+    size_t
+    size() const {
+        return m_entities.size();
+    }
+
+private:
+
+    uint32_t
+    position(
+        EntityId entityId
+    ) const {
+        uint32_t position = m_index.get(entityId);
+        if (position < m_entities.size() and m_entities[position] == entityId) {
+            return position;
+        }
+        return SparseIndex::NONE;
+    }
+
+    std::vector<EntityId> m_entities;
+
+    SparseIndex m_index;
+
+};
+
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace thrive {
+
+/**
+* @brief An append-only list of events, consumed by several readers
+*
+* Every reader has a cursor into the log and reads all events it hasn't
+* seen yet in one go. Events that every reader has seen are discarded.
+* Appending to a log without readers does nothing.
+*
+* The log is not thread safe.
+*
+* @tparam Event
+*   The event type, should be small and trivially copyable
+*/
+template<typename Event>
+class EventLog {
+
+public:
+
+    /**
+    * @brief The events returned by read()
+    *
+    * Only valid until the log is appended to.
+    */
+    struct Range {
+
+        const Event* begin;
+
+        const Event* end;
+
+        /**
+        * @brief Whether these are all events since the last read
+        *
+        * If a reader falls behind by more than maxLag() events, its events
+        * are discarded. The next read returns an empty, incomplete range.
+        */
+        bool isComplete;
+
+    };
+
+    /**
+    * @brief Adds a reader
+    *
+    * The reader starts at the end of the log, i.e. it only sees events
+    * appended after this call.
+    *
+    * @return
+    *   An id for read() and removeReader()
+    */
+    unsigned int
+    addReader() {
+        m_readerCount += 1;
+        for (unsigned int reader = 0; reader < m_cursors.size(); ++reader) {
+            if (m_cursors[reader] == UNUSED) {
+                m_cursors[reader] = this->eventCount();
+                return reader;
+            }
+        }
+        m_cursors.push_back(this->eventCount());
+        return m_cursors.size() - 1;
+    }
+
+    /**
+    * @brief Appends an event
+    *
+    * @param event
+    */
+    void
+    append(
+        const Event& event
+    ) {
+        if (m_readerCount == 0) {
+            return;
+        }
+        if (m_events.size() >= m_compactionThreshold) {
+            this->compact();
+        }
+        m_events.push_back(event);
+    }
+
+    /**
+    * @brief The number of events appended while the log had readers
+    *
+    * Only ever grows, so it can be used to check for new events without
+    * reading them.
+    */
+    uint64_t
+    eventCount() const {
+        return m_firstSequence + m_events.size();
+    }
+
+    /**
+    * @brief Whether the log has any readers
+    */
+    bool
+    hasReaders() const {
+        return m_readerCount > 0;
+    }
+
+    /**
+    * @brief How far a reader may fall behind before its events are
+    *   discarded
+    */
+    uint64_t
+    maxLag() const {
+        return m_maxLag;
+    }
+
+    /**
+    * @brief The memory used by the log in bytes
+    */
+    size_t
+    memoryUsage() const {
+        return m_events.capacity() * sizeof(Event) + m_cursors.capacity() * sizeof(uint64_t);
+    }
+
+    /**
+    * @brief Returns the events a reader hasn't seen yet and marks them as
+    *   seen
+    *
+    * When there are no new events, this doesn't modify the log.
+    *
+    * @param reader
+    *   The id returned by addReader()
+    *
+    * @return
+    *   The new events, oldest first
+    */
+    Range
+    read(
+        unsigned int reader
+    ) {
+        assert(reader < m_cursors.size() && m_cursors[reader] != UNUSED && "Unknown reader");
+        uint64_t& cursor = m_cursors[reader];
+        uint64_t end = this->eventCount();
+        if (cursor == OVERFLOWED) {
+            cursor = end;
+            return Range{nullptr, nullptr, false};
+        }
+        if (cursor == end) {
+            return Range{nullptr, nullptr, true};
+        }
+        Range range{
+            m_events.data() + (cursor - m_firstSequence),
+            m_events.data() + m_events.size(),
+            true
+        };
+        cursor = end;
+        return range;
+    }
+
+    /**
+    * @brief Removes a reader
+    *
+    * @param reader
+    *   The id returned by addReader()
+    */
+    void
+    removeReader(
+        unsigned int reader
+    ) {
+        assert(reader < m_cursors.size() && m_cursors[reader] != UNUSED && "Unknown reader");
+        m_cursors[reader] = UNUSED;
+        m_readerCount -= 1;
+        if (m_readerCount == 0) {
+            m_firstSequence = this->eventCount();
+            m_events.clear();
+        }
+    }
+
+    /**
+    * @brief Sets how far a reader may fall behind
+    *
+    * Defaults to no limit.
+    *
+    * @param maxLag
+    */
+    void
+    setMaxLag(
+        uint64_t maxLag
+    ) {
+        m_maxLag = maxLag;
+    }
+
+private:
+
+    static const uint64_t UNUSED = std::numeric_limits<uint64_t>::max();
+
+    static const uint64_t OVERFLOWED = UNUSED - 1;
+
+    static const size_t MIN_COMPACTION_THRESHOLD = 256;
+
+    void
+    compact() {
+        uint64_t end = this->eventCount();
+        uint64_t oldest = end;
+        for (uint64_t& cursor : m_cursors) {
+            if (cursor == UNUSED or cursor == OVERFLOWED) {
+                continue;
+            }
+            if (end - cursor > m_maxLag) {
+                cursor = OVERFLOWED;
+            }
+            else {
+                oldest = std::min(oldest, cursor);
+            }
+        }
+        m_events.erase(
+            m_events.begin(),
+            m_events.begin() + (oldest - m_firstSequence)
+        );
+        m_firstSequence = oldest;
+        m_compactionThreshold = std::max<size_t>(MIN_COMPACTION_THRESHOLD, 2 * m_events.size());
+    }
+
+    size_t m_compactionThreshold = MIN_COMPACTION_THRESHOLD;
+
+    // Sequence number of the next unread event per reader
+    std::vector<uint64_t> m_cursors;
+
+    std::vector<Event> m_events;
+
+    // Sequence number of m_events.front()
+    uint64_t m_firstSequence = 0;
+
+    uint64_t m_maxLag = std::numeric_limits<uint64_t>::max();
+
+    unsigned int m_readerCount = 0;
+
+};
+
+template<typename Event>
+const uint64_t EventLog<Event>::UNUSED;
+
+template<typename Event>
+const uint64_t EventLog<Event>::OVERFLOWED;
+
+template<typename Event>
+const size_t EventLog<Event>::MIN_COMPACTION_THRESHOLD;
+
+}
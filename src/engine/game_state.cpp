@@ -1,9 +1,13 @@
 #include "engine/game_state.h"
 
 #include "engine/engine.h"
+#include "engine/entity_command_buffer.h"
 #include "engine/entity_manager.h"
+#include "engine/profiler.h"
 #include "engine/serialization.h"
 #include "engine/system.h"
+#include "engine/system_scheduler.h"
+#include "engine/thread_pool.h"
 
 #include <btBulletDynamicsCommon.h>
 #include <OgreRoot.h>
@@ -18,8 +22,11 @@ struct GameState::Implementation {
         std::vector<std::unique_ptr<System>> systems,
         Initializer initializer
     ) : m_engine(engine),
+        m_commandBuffer(m_entityManager),
         m_initializer(initializer),
         m_name(name),
+        m_renderScheduler(ThreadPool::shared()),
+        m_scheduler(ThreadPool::shared()),
         m_systems(std::move(systems))
     {
     }
@@ -56,10 +63,18 @@ struct GameState::Implementation {
 
     EntityManager m_entityManager;
 
+    EntityCommandBuffer m_commandBuffer;
+
     Initializer m_initializer;
 
+    float m_interpolation = 1.0f;
+
     std::string m_name;
 
+    SystemScheduler m_renderScheduler;
+
+    SystemScheduler m_scheduler;
+
     Ogre::SceneManager* m_sceneManager = nullptr;
 
     struct Physics {
@@ -85,6 +100,7 @@ luabind::scope
 GameState::luaBindings() {
     using namespace luabind;
     return class_<GameState>("GameState")
+        .def("commandBuffer", &GameState::commandBuffer)
         .def("name", &GameState::name)
     ;
 }
@@ -103,10 +119,19 @@ GameState::GameState(
 GameState::~GameState() {}
 
 
+EntityCommandBuffer&
+GameState::commandBuffer() {
+    return m_impl->m_commandBuffer;
+}
+
+
 void
 GameState::activate() {
     for (const auto& system : m_impl->m_systems) {
-        system->activate();
+        // Render systems are not initialized in headless mode
+        if (system->gameState()) {
+            system->activate();
+        }
     }
 }
 
@@ -114,7 +139,9 @@ GameState::activate() {
 void
 GameState::deactivate() {
     for (const auto& system : m_impl->m_systems) {
-        system->deactivate();
+        if (system->gameState()) {
+            system->deactivate();
+        }
     }
 }
 
@@ -139,11 +166,30 @@ GameState::entityManager() {
 
 void
 GameState::init() {
+    bool isHeadless = m_impl->m_engine.isHeadless();
     m_impl->setupPhysics();
-    m_impl->setupSceneManager();
+    if (not isHeadless) {
+        m_impl->setupSceneManager();
+    }
+    std::vector<System*> renderSystems;
+    std::vector<System*> simulationSystems;
     for (const auto& system : m_impl->m_systems) {
+        if (isHeadless and system->phase() == System::Phase::Render) {
+            continue;
+        }
         system->init(this);
+        if (system->phase() == System::Phase::Render) {
+            renderSystems.push_back(system.get());
+        }
+        else {
+            simulationSystems.push_back(system.get());
+        }
     }
+    // Systems may declare their component access in init()
+    m_impl->m_renderScheduler.setSystems(renderSystems);
+    m_impl->m_renderScheduler.setProfiler(&m_impl->m_engine.profiler());
+    m_impl->m_scheduler.setSystems(simulationSystems);
+    m_impl->m_scheduler.setProfiler(&m_impl->m_engine.profiler());
     m_impl->m_initializer();
 }
 
@@ -157,6 +203,7 @@ GameState::load(
     const StorageContainer& storage
 ) {
     StorageContainer entities = storage.get<StorageContainer>("entities");
+    m_impl->m_commandBuffer.clear();
     m_impl->m_entityManager.clear();
     try {
         m_impl->m_entityManager.restore(
@@ -176,6 +223,36 @@ GameState::load(
 }
 
 
+void
+GameState::loadDelta(
+    const StorageContainer& storage
+) {
+    StorageContainer entities = storage.get<StorageContainer>("entities");
+    m_impl->m_commandBuffer.clear();
+    try {
+        m_impl->m_entityManager.applyDelta(
+            entities,
+            m_impl->m_engine.componentFactory()
+        );
+    }
+    catch (const luabind::error& e) {
+        luabind::object error_msg(luabind::from_stack(
+            e.state(),
+            -1
+        ));
+        // TODO: Log error
+        std::cerr << error_msg << std::endl;
+        throw;
+    }
+}
+
+
+float
+GameState::interpolation() const {
+    return m_impl->m_interpolation;
+}
+
+
 std::string
 GameState::name() const {
     return m_impl->m_name;
@@ -188,6 +265,16 @@ GameState::physicsWorld() const {
 }
 
 
+void
+GameState::render(
+    int milliseconds,
+    float interpolation
+) {
+    m_impl->m_interpolation = interpolation;
+    m_impl->m_renderScheduler.update(milliseconds);
+}
+
+
 Ogre::SceneManager*
 GameState::sceneManager() const {
     return m_impl->m_sceneManager;
@@ -197,12 +284,67 @@ GameState::sceneManager() const {
 void
 GameState::shutdown() {
     for (const auto& system : m_impl->m_systems) {
-        system->shutdown();
+        if (system->gameState()) {
+            system->shutdown();
+        }
     }
     m_impl->m_physics.world.reset();
-    m_impl->m_engine.ogreRoot()->destroySceneManager(
-        m_impl->m_sceneManager
-    );
+    if (m_impl->m_sceneManager) {
+        m_impl->m_engine.ogreRoot()->destroySceneManager(
+            m_impl->m_sceneManager
+        );
+        m_impl->m_sceneManager = nullptr;
+    }
+}
+
+
+std::function<StorageContainer()>
+GameState::snapshot() const {
+    std::function<StorageContainer()> buildEntities;
+    try {
+        buildEntities = m_impl->m_entityManager.snapshot(
+            m_impl->m_engine.componentFactory()
+        );
+    }
+    catch (const luabind::error& e) {
+        luabind::object error_msg(luabind::from_stack(
+            e.state(),
+            -1
+        ));
+        // TODO: Log error
+        std::cerr << error_msg << std::endl;
+        throw;
+    }
+    return [buildEntities] () -> StorageContainer {
+        StorageContainer storage;
+        storage.set("entities", buildEntities());
+        return storage;
+    };
+}
+
+
+std::function<StorageContainer()>
+GameState::snapshotDelta() {
+    std::function<StorageContainer()> buildEntities;
+    try {
+        buildEntities = m_impl->m_entityManager.snapshotDelta(
+            m_impl->m_engine.componentFactory()
+        );
+    }
+    catch (const luabind::error& e) {
+        luabind::object error_msg(luabind::from_stack(
+            e.state(),
+            -1
+        ));
+        // TODO: Log error
+        std::cerr << error_msg << std::endl;
+        throw;
+    }
+    return [buildEntities] () -> StorageContainer {
+        StorageContainer storage;
+        storage.set("entities", buildEntities());
+        return storage;
+    };
 }
 
 
@@ -233,10 +375,17 @@ void
 GameState::update(
     int milliseconds
 ) {
-    for(auto& system : m_impl->m_systems) {
-        if (system->enabled()) {
-            system->update(milliseconds);
-        }
+    Profiler& profiler = m_impl->m_engine.profiler();
+    m_impl->m_scheduler.update(milliseconds);
+    {
+        Profiler::Scope scope(&profiler, "EntityCommandBuffer::flush");
+        m_impl->m_commandBuffer.flush();
     }
-    m_impl->m_entityManager.processRemovals();
+    Profiler::Scope scope(&profiler, "EntityManager::processRemovals");
+    auto& entityManager = m_impl->m_entityManager;
+    entityManager.processRemovals();
+    const auto& statistics = entityManager.removalStatistics();
+    scope.addArgument("entitiesRemoved", statistics.entitiesRemoved);
+    scope.addArgument("componentsRemoved", statistics.componentsRemoved);
+    scope.addArgument("collectionsVisited", statistics.collectionsVisited);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <vector>
 #include <iostream>
@@ -16,6 +17,7 @@ namespace Ogre {
 namespace thrive {
 
 class Engine;
+class EntityCommandBuffer;
 class EntityManager;
 class StorageContainer;
 class System;
@@ -49,6 +51,7 @@ public:
     * @brief Lua bindings
     *
     * Exposes:
+    * - GameState::commandBuffer()
     * - GameState::name()
     *
     * @return
@@ -73,6 +76,17 @@ public:
     */
     GameState& operator=(const GameState&) = delete;
 
+    /**
+    * @brief Returns the game state's command buffer
+    *
+    * The command buffer is flushed after all systems have been updated,
+    * right before removals are processed.
+    *
+    * @return
+    */
+    EntityCommandBuffer&
+    commandBuffer();
+
     /**
     * @brief Returns the engine this game state belongs to
     *
@@ -105,6 +119,16 @@ public:
     const EntityManager&
     entityManager() const;
 
+    /**
+    * @brief How far rendering is between the last two simulation ticks
+    *
+    * Render phase systems can use this to interpolate between the state
+    * of the previous and the current tick. 0 means the previous tick's
+    * state, 1 the current one's.
+    */
+    float
+    interpolation() const;
+
     /**
     * @brief The game state's name
     *
@@ -121,6 +145,8 @@ public:
 
     /**
     * @brief The Ogre scene manager
+    *
+    * \c nullptr in headless mode, see Engine::setHeadless()
     */
     Ogre::SceneManager*
     sceneManager() const;
@@ -201,6 +227,18 @@ private:
         const StorageContainer& storage
     );
 
+    /**
+    * @brief Called by the engine when replaying an autosave journal
+    *
+    * @param storage
+    *
+    * @see GameState::snapshotDelta()
+    */
+    void
+    loadDelta(
+        const StorageContainer& storage
+    );
+
     /**
     * @brief Called by the engine to shut the game state down
     *
@@ -209,6 +247,49 @@ private:
     void
     shutdown();
 
+    /**
+    * @brief Called by the engine to render a frame
+    *
+    * Updates the systems of the render phase, see System::Phase.
+    *
+    * @param milliseconds
+    *   The number of milliseconds since the last rendered frame
+    * @param interpolation
+    *   See interpolation()
+    */
+    void
+    render(
+        int milliseconds,
+        float interpolation
+    );
+
+    /**
+    * @brief Called by the engine during savegame creation
+    *
+    * Like storage(), but defers building the storage container, see
+    * EntityManager::snapshot().
+    *
+    * @return
+    *   Builds the same storage container as storage(), from any thread
+    */
+    std::function<StorageContainer()>
+    snapshot() const;
+
+    /**
+    * @brief Called by the engine during incremental autosaves
+    *
+    * The entity manager's journal must be running, see
+    * EntityManager::beginJournal().
+    *
+    * @return
+    *   Builds the changes since the last call, from any thread, see
+    *   EntityManager::snapshotDelta()
+    *
+    * @see GameState::loadDelta()
+    */
+    std::function<StorageContainer()>
+    snapshotDelta();
+
     /**
     * @brief Called by the engine during savegame creation
     *
@@ -219,14 +300,15 @@ private:
     StorageContainer
     storage() const;
 
+
     /**
-    * @brief Called by the engine to update the game state
+    * @brief Called by the engine to advance the simulation by one tick
     *
-    * Updates all the systems in turn
+    * Updates the systems of the simulation phase, see System::Phase.
     *
     * @param milliseconds
     *   The number of milliseconds of game time elapsed since the
-    *   last frame (which may have been rendered by another game state).
+    *   last tick (which may have been simulated by another game state).
     */
     void
     update(
@@ -0,0 +1,233 @@
+#include "engine/prefab.h"
+
+#include "engine/component.h"
+#include "engine/component_factory.h"
+#include "engine/entity_command_buffer.h"
+#include "scripting/luabind.h"
+
+#include <luabind/adopt_policy.hpp>
+#include <stdexcept>
+
+using namespace thrive;
+
+struct Prefab::Implementation {
+
+    struct Prototype {
+
+        ComponentFactory::ComponentCloner cloner;
+
+        std::unique_ptr<Component> component;
+
+    };
+
+    Implementation(
+        const ComponentFactory& factory
+    ) : m_factory(factory)
+    {
+    }
+
+    const ComponentFactory& m_factory;
+
+    std::vector<Prototype> m_prototypes;
+
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Prefab::Instance
+////////////////////////////////////////////////////////////////////////////////
+
+luabind::scope
+Prefab::Instance::luaBindings() {
+    using namespace luabind;
+    return class_<Instance>("Instance")
+        .def("getComponent", static_cast<Component* (Instance::*)(ComponentTypeId) const>(&Instance::getComponent))
+        .def("index", &Instance::index)
+    ;
+}
+
+
+Prefab::Instance::Instance(
+    size_t index,
+    const std::vector<std::unique_ptr<Component>>& components
+) : m_components(components),
+    m_index(index)
+{
+}
+
+
+Component*
+Prefab::Instance::getComponent(
+    ComponentTypeId typeId
+) const {
+    for (const auto& component : m_components) {
+        if (component->typeId() == typeId) {
+            return component.get();
+        }
+    }
+    return nullptr;
+}
+
+
+size_t
+Prefab::Instance::index() const {
+    return m_index;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Prefab
+////////////////////////////////////////////////////////////////////////////////
+
+static Component*
+Prefab_addComponent(
+    Prefab* self,
+    Component* nakedComponent
+) {
+    return self->addComponent(
+        std::unique_ptr<Component>(nakedComponent)
+    );
+}
+
+
+static luabind::object
+Prefab_instantiateWithOverride(
+    Prefab* self,
+    EntityCommandBuffer& commandBuffer,
+    size_t count,
+    luabind::object override,
+    lua_State* L
+) {
+    Prefab::Override function;
+    if (override.is_valid() and luabind::type(override) != LUA_TNIL) {
+        function = [&override] (const Prefab::Instance& instance) {
+            // Lua lists start at 1
+            luabind::call_function<void>(
+                override,
+                instance.index() + 1,
+                &instance
+            );
+        };
+    }
+    std::vector<EntityId> entityIds = self->instantiate(
+        commandBuffer,
+        count,
+        function
+    );
+    luabind::object ids = luabind::newtable(L);
+    for (size_t i = 0; i < entityIds.size(); ++i) {
+        ids[i + 1] = entityIds[i];
+    }
+    return ids;
+}
+
+
+static luabind::object
+Prefab_instantiate(
+    Prefab* self,
+    EntityCommandBuffer& commandBuffer,
+    size_t count,
+    lua_State* L
+) {
+    return Prefab_instantiateWithOverride(
+        self,
+        commandBuffer,
+        count,
+        luabind::object(),
+        L
+    );
+}
+
+
+luabind::scope
+Prefab::luaBindings() {
+    using namespace luabind;
+    return class_<Prefab>("Prefab")
+        .scope [
+            Instance::luaBindings()
+        ]
+        .def(constructor<const ComponentFactory&>())
+        .def("addComponent", &Prefab_addComponent, adopt(_2))
+        .def("getComponent", &Prefab::getComponent)
+        .def("instantiate", &Prefab_instantiate)
+        .def("instantiate", &Prefab_instantiateWithOverride)
+    ;
+}
+
+
+Prefab::Prefab(
+    const ComponentFactory& factory
+) : m_impl(new Implementation(factory))
+{
+}
+
+
+Prefab::~Prefab() {}
+
+
+Component*
+Prefab::addComponent(
+    std::unique_ptr<Component> prototype
+) {
+    ComponentFactory::ComponentCloner cloner = m_impl->m_factory.getCloner(
+        prototype->typeName()
+    );
+    if (not cloner) {
+        throw std::runtime_error("Prefab component has unknown type: " + prototype->typeName());
+    }
+    Component* rawPrototype = prototype.get();
+    for (auto& existing : m_impl->m_prototypes) {
+        if (existing.component->typeId() == prototype->typeId()) {
+            existing.cloner = cloner;
+            existing.component = std::move(prototype);
+            return rawPrototype;
+        }
+    }
+    m_impl->m_prototypes.push_back(
+        Implementation::Prototype{cloner, std::move(prototype)}
+    );
+    return rawPrototype;
+}
+
+
+Component*
+Prefab::getComponent(
+    ComponentTypeId typeId
+) const {
+    for (const auto& prototype : m_impl->m_prototypes) {
+        if (prototype.component->typeId() == typeId) {
+            return prototype.component.get();
+        }
+    }
+    return nullptr;
+}
+
+
+std::vector<EntityId>
+Prefab::instantiate(
+    EntityCommandBuffer& commandBuffer,
+    size_t count,
+    const Override& override
+) const {
+    std::vector<EntityId> entityIds;
+    entityIds.reserve(count);
+    std::vector<std::unique_ptr<Component>> components;
+    components.reserve(m_impl->m_prototypes.size());
+    for (size_t index = 0; index < count; ++index) {
+        for (const auto& prototype : m_impl->m_prototypes) {
+            components.push_back(
+                prototype.cloner(*prototype.component)
+            );
+        }
+        if (override) {
+            override(Instance(index, components));
+        }
+        EntityId entityId = commandBuffer.createEntity();
+        for (auto& component : components) {
+            commandBuffer.addComponent(entityId, std::move(component));
+        }
+        components.clear();
+        entityIds.push_back(entityId);
+    }
+    return entityIds;
+}
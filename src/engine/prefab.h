@@ -0,0 +1,257 @@
+#pragma once
+
+#include "engine/typedefs.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace luabind {
+    class scope;
+}
+
+namespace thrive {
+
+class Component;
+class ComponentFactory;
+class EntityCommandBuffer;
+
+/**
+* @brief A template for entities
+*
+* A prefab holds a prototype for each component of the entities it creates.
+* instantiate() copies the prototypes for any number of new entities in one
+* call and queues them into an EntityCommandBuffer, so the entity filters
+* see them in one batch.
+*
+* The prototypes are copied with the component factory's cloners (see
+* ComponentFactory::getCloner()), which are looked up once per prototype.
+* Data the components hold by shared pointer, like collision shapes, is
+* shared by all instances instead of being created for each.
+*
+* Per-instance values such as positions and velocities are set by an
+* override function that is called for every instance before it is queued.
+*
+* Usage example:
+* \code
+* Prefab prefab(engine.componentFactory());
+* auto rigidBody = prefab.addComponent(make_unique<RigidBodyComponent>());
+* rigidBody->m_properties.shape = std::make_shared<SphereShape>(1.0);
+* prefab.addComponent(make_unique<OgreSceneNodeComponent>());
+* prefab.instantiate(
+*     commandBuffer,
+*     100,
+*     [] (const Prefab::Instance& instance) {
+*         auto rigidBody = instance.getComponent<RigidBodyComponent>();
+*         rigidBody->m_dynamicProperties.position.x = instance.index();
+*     }
+* );
+* \endcode
+*/
+class Prefab {
+
+public:
+
+    /**
+    * @brief The components of an entity being instantiated
+    */
+    class Instance {
+
+    public:
+
+        /**
+        * @brief Lua bindings
+        *
+        * Exposes:
+        * - Instance::getComponent()
+        * - Instance::index()
+        *
+        * @return
+        */
+        static luabind::scope
+        luaBindings();
+
+        /**
+        * @brief Returns the instance's copy of a component
+        *
+        * @param typeId
+        *   The component's type id
+        *
+        * @return
+        *   The component or \c nullptr if the prefab has no component of
+        *   that type
+        */
+        Component*
+        getComponent(
+            ComponentTypeId typeId
+        ) const;
+
+        /**
+        * @brief Convenience template overload
+        *
+        * @tparam C
+        *   The component class
+        */
+        template<typename C>
+        C*
+        getComponent() const {
+            return static_cast<C*>(
+                this->getComponent(C::TYPE_ID)
+            );
+        }
+
+        /**
+        * @brief The instance's position in the call to instantiate()
+        *
+        * Starts at 0.
+        */
+        size_t
+        index() const;
+
+    private:
+
+        friend class Prefab;
+
+        Instance(
+            size_t index,
+            const std::vector<std::unique_ptr<Component>>& components
+        );
+
+        const std::vector<std::unique_ptr<Component>>& m_components;
+
+        size_t m_index;
+
+    };
+
+    /**
+    * @brief Typedef for override functions
+    *
+    * Called for every instance with its components, before they are queued.
+    */
+    using Override = std::function<void(const Instance& instance)>;
+
+    /**
+    * @brief Lua bindings
+    *
+    * Exposes:
+    * - Prefab(ComponentFactory)
+    * - Prefab::addComponent()
+    * - Prefab::getComponent()
+    * - \c instantiate(commandBuffer, count [, override]): Queues \a count
+    *   new entities into \a commandBuffer. If given, \a override is called
+    *   with the indices 1 to \a count and the Instance. Returns a list of
+    *   the new ids.
+    *
+    * @return
+    */
+    static luabind::scope
+    luaBindings();
+
+    /**
+    * @brief Constructor
+    *
+    * @param factory
+    *   The factory for copying the prototypes. Must outlive the prefab.
+    */
+    Prefab(
+        const ComponentFactory& factory
+    );
+
+    /**
+    * @brief Destructor
+    */
+    ~Prefab();
+
+    Prefab(const Prefab&) = delete;
+
+    Prefab&
+    operator= (const Prefab&) = delete;
+
+    /**
+    * @brief Adds a prototype component
+    *
+    * The prototype never belongs to an entity. Changes to it after
+    * instantiate() only affect later instances.
+    *
+    * @param prototype
+    *   The component to copy for every instance. Replaces an earlier
+    *   prototype of the same type.
+    *
+    * @return
+    *   The prototype as a non-owning pointer
+    *
+    * @throws std::runtime_error
+    *   If the component factory doesn't know the component's type
+    */
+    Component*
+    addComponent(
+        std::unique_ptr<Component> prototype
+    );
+
+    /**
+    * @brief Adds a prototype component
+    *
+    * @tparam C
+    *   The component's class
+    *
+    * @param prototype
+    *   The component to copy for every instance
+    *
+    * @return
+    *   The prototype as a non-owning pointer
+    */
+    template<typename C>
+    C*
+    addComponent(
+        std::unique_ptr<C> prototype
+    ) {
+        return static_cast<C*>(
+            this->addComponent(
+                std::unique_ptr<Component>(std::move(prototype))
+            )
+        );
+    }
+
+    /**
+    * @brief Returns a prototype component
+    *
+    * @param typeId
+    *   The component's type id
+    *
+    * @return
+    *   The prototype or \c nullptr if the prefab has no component of that
+    *   type
+    */
+    Component*
+    getComponent(
+        ComponentTypeId typeId
+    ) const;
+
+    /**
+    * @brief Queues new entities built from the prototypes
+    *
+    * @param commandBuffer
+    *   The command buffer to queue the entities into
+    * @param count
+    *   The number of entities
+    * @param override
+    *   If not empty, called for every instance before it is queued
+    *
+    * @return
+    *   The new entity ids, in the order of their instance indices
+    */
+    std::vector<EntityId>
+    instantiate(
+        EntityCommandBuffer& commandBuffer,
+        size_t count,
+        const Override& override = Override()
+    ) const;
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
+};
+
+}
@@ -0,0 +1,322 @@
+#include "engine/profiler.h"
+
+#include "scripting/luabind.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+
+using namespace thrive;
+
+namespace {
+
+using Clock = boost::chrono::high_resolution_clock;
+
+unsigned int
+currentThreadIndex() {
+    static std::atomic<unsigned int> nextIndex{0};
+    thread_local unsigned int index = nextIndex.fetch_add(1);
+    return index;
+}
+
+
+void
+writeJsonString(
+    std::ostream& stream,
+    const std::string& string
+) {
+    stream << '"';
+    for (char c : string) {
+        switch (c) {
+            case '"':
+                stream << "\\\"";
+                break;
+            case '\\':
+                stream << "\\\\";
+                break;
+            case '\n':
+                stream << "\\n";
+                break;
+            case '\t':
+                stream << "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[7];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    stream << escaped;
+                }
+                else {
+                    stream << c;
+                }
+        }
+    }
+    stream << '"';
+}
+
+
+double
+toMilliseconds(
+    boost::chrono::microseconds duration
+) {
+    return duration.count() / 1000.0;
+}
+
+}
+
+
+struct Profiler::Implementation {
+
+    Implementation(
+        size_t capacity
+    ) : m_samples(capacity)
+    {
+    }
+
+    size_t m_count = 0;
+
+    std::atomic<bool> m_enabled{true};
+
+    std::atomic<unsigned int> m_frame{0};
+
+    mutable boost::mutex m_mutex;
+
+    size_t m_next = 0;
+
+    std::vector<Sample> m_samples;
+
+    Clock::time_point m_startTime = Clock::now();
+
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Profiler::Scope
+////////////////////////////////////////////////////////////////////////////////
+
+Profiler::Scope::Scope(
+    Profiler* profiler,
+    const std::string& name
+) : m_profiler(profiler and profiler->enabled() ? profiler : nullptr)
+{
+    if (m_profiler) {
+        m_sample.name = name;
+        m_sample.frame = m_profiler->currentFrame();
+        m_sample.thread = currentThreadIndex();
+        m_sample.start = m_profiler->now();
+    }
+}
+
+
+Profiler::Scope::~Scope() {
+    if (m_profiler) {
+        m_sample.duration = m_profiler->now() - m_sample.start;
+        m_profiler->record(std::move(m_sample));
+    }
+}
+
+
+void
+Profiler::Scope::addArgument(
+    const std::string& name,
+    double value
+) {
+    if (m_profiler) {
+        m_sample.arguments.emplace_back(name, value);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Profiler
+////////////////////////////////////////////////////////////////////////////////
+
+static luabind::object
+Profiler_averageDurations(
+    Profiler* self,
+    unsigned int frames,
+    lua_State* L
+) {
+    std::map<std::string, double> totals;
+    for (const Profiler::Sample& sample : self->samples(frames)) {
+        totals[sample.name] += toMilliseconds(sample.duration);
+    }
+    luabind::object result = luabind::newtable(L);
+    for (const auto& pair : totals) {
+        result[pair.first] = pair.second / std::max(1u, frames);
+    }
+    return result;
+}
+
+
+static luabind::object
+Profiler_samples(
+    Profiler* self,
+    unsigned int frames,
+    lua_State* L
+) {
+    luabind::object result = luabind::newtable(L);
+    int index = 1;
+    for (const Profiler::Sample& sample : self->samples(frames)) {
+        luabind::object luaSample = luabind::newtable(L);
+        luaSample["name"] = sample.name;
+        luaSample["frame"] = sample.frame;
+        luaSample["thread"] = sample.thread;
+        luaSample["start"] = toMilliseconds(sample.start);
+        luaSample["duration"] = toMilliseconds(sample.duration);
+        result[index++] = luaSample;
+    }
+    return result;
+}
+
+
+luabind::scope
+Profiler::luaBindings() {
+    using namespace luabind;
+    return class_<Profiler>("Profiler")
+        .def("averageDurations", &Profiler_averageDurations)
+        .def("clear", &Profiler::clear)
+        .def("enabled", &Profiler::enabled)
+        .def("samples", &Profiler_samples)
+        .def("saveChromeTrace", &Profiler::saveChromeTrace)
+        .def("setEnabled", &Profiler::setEnabled)
+    ;
+}
+
+
+Profiler::Profiler(
+    size_t capacity
+) : m_impl(new Implementation(std::max<size_t>(1, capacity)))
+{
+}
+
+
+Profiler::~Profiler() {}
+
+
+void
+Profiler::beginFrame() {
+    m_impl->m_frame.fetch_add(1);
+}
+
+
+void
+Profiler::clear() {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+    m_impl->m_count = 0;
+    m_impl->m_next = 0;
+}
+
+
+unsigned int
+Profiler::currentFrame() const {
+    return m_impl->m_frame.load();
+}
+
+
+bool
+Profiler::enabled() const {
+    return m_impl->m_enabled.load();
+}
+
+
+boost::chrono::microseconds
+Profiler::now() const {
+    return boost::chrono::duration_cast<boost::chrono::microseconds>(
+        Clock::now() - m_impl->m_startTime
+    );
+}
+
+
+void
+Profiler::record(
+    Sample sample
+) {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+    auto& samples = m_impl->m_samples;
+    // Swap instead of moving to keep the old sample's buffers for reuse
+    std::swap(samples[m_impl->m_next], sample);
+    m_impl->m_next = (m_impl->m_next + 1) % samples.size();
+    m_impl->m_count = std::min(m_impl->m_count + 1, samples.size());
+}
+
+
+std::vector<Profiler::Sample>
+Profiler::samples(
+    unsigned int frames
+) const {
+    unsigned int currentFrame = this->currentFrame();
+    unsigned int firstFrame = 0;
+    if (frames > 0 and frames <= currentFrame) {
+        firstFrame = currentFrame - frames + 1;
+    }
+    std::vector<Sample> result;
+    boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+    const auto& samples = m_impl->m_samples;
+    size_t first = (m_impl->m_next + samples.size() - m_impl->m_count) % samples.size();
+    result.reserve(m_impl->m_count);
+    for (size_t i = 0; i < m_impl->m_count; ++i) {
+        const Sample& sample = samples[(first + i) % samples.size()];
+        if (sample.frame >= firstFrame) {
+            result.push_back(sample);
+        }
+    }
+    return result;
+}
+
+
+void
+Profiler::saveChromeTrace(
+    const std::string& filename
+) const {
+    std::ofstream stream(filename);
+    if (not stream) {
+        throw std::runtime_error("Could not open profile file " + filename);
+    }
+    this->writeChromeTrace(stream);
+    if (not stream) {
+        throw std::runtime_error("Could not write profile file " + filename);
+    }
+}
+
+
+void
+Profiler::setEnabled(
+    bool enabled
+) {
+    m_impl->m_enabled.store(enabled);
+}
+
+
+void
+Profiler::writeChromeTrace(
+    std::ostream& stream
+) const {
+    stream << "{\"traceEvents\":[";
+    bool isFirst = true;
+    for (const Sample& sample : this->samples()) {
+        stream << (isFirst ? "\n" : ",\n");
+        isFirst = false;
+        stream << "{\"name\":";
+        writeJsonString(stream, sample.name);
+        stream << ",\"ph\":\"X\",\"pid\":0"
+            << ",\"tid\":" << sample.thread
+            << ",\"ts\":" << sample.start.count()
+            << ",\"dur\":" << sample.duration.count()
+            << ",\"args\":{\"frame\":" << sample.frame;
+        for (const auto& argument : sample.arguments) {
+            stream << ",";
+            writeJsonString(stream, argument.first);
+            stream << ":" << argument.second;
+        }
+        stream << "}}";
+    }
+    stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
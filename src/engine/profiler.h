@@ -0,0 +1,280 @@
+#pragma once
+
+#include <boost/chrono.hpp>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace luabind {
+    class scope;
+}
+
+namespace thrive {
+
+/**
+* @brief Records how long parts of each frame take
+*
+* Timings are recorded with Profiler::Scope objects and stored in a ring
+* buffer that holds the most recent samples. The samples can be queried
+* from Lua or saved in the Chrome \c trace_event format, which can be
+* opened with \c chrome://tracing.
+*
+* Recording is thread safe, so systems running on worker threads can be
+* profiled as well.
+*
+* Usage example:
+* \code
+* void
+* MySystem::update(int milliseconds) {
+*     Profiler::Scope scope(&this->engine()->profiler(), "MySystem::expensiveStep");
+*     expensiveStep();
+* }
+* \endcode
+*/
+class Profiler {
+
+public:
+
+    /**
+    * @brief A single timed section
+    */
+    struct Sample {
+
+        /**
+        * @brief Additional numbers shown with the sample
+        */
+        std::vector<std::pair<std::string, double>> arguments;
+
+        /**
+        * @brief How long the section took
+        */
+        boost::chrono::microseconds duration;
+
+        /**
+        * @brief The frame the section was recorded in
+        */
+        unsigned int frame;
+
+        /**
+        * @brief The section's name
+        */
+        std::string name;
+
+        /**
+        * @brief When the section started, relative to the profiler's
+        *   creation
+        */
+        boost::chrono::microseconds start;
+
+        /**
+        * @brief Small number identifying the thread the section ran on
+        *
+        * The thread that first recorded a sample gets 0, usually the main
+        * thread.
+        */
+        unsigned int thread;
+
+    };
+
+    /**
+    * @brief Times a section from construction to destruction
+    */
+    class Scope {
+
+    public:
+
+        /**
+        * @brief Constructor
+        *
+        * @param profiler
+        *   The profiler to record into. If \c nullptr or disabled, nothing
+        *   is recorded.
+        * @param name
+        *   The section's name
+        */
+        Scope(
+            Profiler* profiler,
+            const std::string& name
+        );
+
+        /**
+        * @brief Destructor
+        *
+        * Records the sample
+        */
+        ~Scope();
+
+        /**
+        * @brief Not copyable
+        */
+        Scope(const Scope&) = delete;
+
+        /**
+        * @brief Not copyable
+        */
+        Scope&
+        operator= (const Scope&) = delete;
+
+        /**
+        * @brief Attaches a number to the sample
+        *
+        * @param name
+        *   The number's name
+        * @param value
+        *   The number
+        */
+        void
+        addArgument(
+            const std::string& name,
+            double value
+        );
+
+    private:
+
+        Profiler* m_profiler;
+
+        Sample m_sample;
+
+    };
+
+    /**
+    * @brief The number of samples kept by default
+    */
+    static const size_t DEFAULT_CAPACITY = 1 << 16;
+
+    /**
+    * @brief Lua bindings
+    *
+    * Exposes:
+    * - Profiler::clear()
+    * - Profiler::enabled()
+    * - Profiler::saveChromeTrace()
+    * - Profiler::setEnabled()
+    * - \c averageDurations(frames): Returns a table mapping section names
+    *   to their average time per frame in milliseconds, over the last
+    *   \a frames frames
+    * - \c samples(frames): Returns a list of the samples of the last
+    *   \a frames frames. Each is a table with the keys \c name, \c frame,
+    *   \c thread, \c start and \c duration (in milliseconds).
+    *
+    * @return
+    */
+    static luabind::scope
+    luaBindings();
+
+    /**
+    * @brief Constructor
+    *
+    * @param capacity
+    *   The maximum number of samples kept. Older samples are overwritten.
+    */
+    explicit Profiler(
+        size_t capacity = DEFAULT_CAPACITY
+    );
+
+    /**
+    * @brief Destructor
+    */
+    ~Profiler();
+
+    /**
+    * @brief Starts the next frame
+    *
+    * Samples are tagged with the current frame number.
+    */
+    void
+    beginFrame();
+
+    /**
+    * @brief Discards all samples
+    */
+    void
+    clear();
+
+    /**
+    * @brief The current frame number
+    */
+    unsigned int
+    currentFrame() const;
+
+    /**
+    * @brief Whether samples are being recorded
+    *
+    * Defaults to \c true
+    */
+    bool
+    enabled() const;
+
+    /**
+    * @brief Time since the profiler was created
+    */
+    boost::chrono::microseconds
+    now() const;
+
+    /**
+    * @brief Adds a sample to the ring buffer
+    *
+    * Usually called by Scope.
+    */
+    void
+    record(
+        Sample sample
+    );
+
+    /**
+    * @brief The recorded samples, oldest first
+    *
+    * @param frames
+    *   Only returns samples of the last \a frames frames, including the
+    *   current one. With 0, all samples are returned.
+    */
+    std::vector<Sample>
+    samples(
+        unsigned int frames = 0
+    ) const;
+
+    /**
+    * @brief Writes the samples to a file in Chrome's trace_event format
+    *
+    * @param filename
+    *   The file to write
+    *
+    * @throws std::runtime_error
+    *   If the file can't be written
+    */
+    void
+    saveChromeTrace(
+        const std::string& filename
+    ) const;
+
+    /**
+    * @brief Enables or disables recording
+    *
+    * @param enabled
+    */
+    void
+    setEnabled(
+        bool enabled
+    );
+
+    /**
+    * @brief Writes the samples in Chrome's trace_event format
+    *
+    * @param stream
+    *   The stream to write to
+    */
+    void
+    writeChromeTrace(
+        std::ostream& stream
+    ) const;
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
+};
+
+}
@@ -0,0 +1,224 @@
+#include "engine/query_index.h"
+
+#include "engine/component_collection.h"
+#include "engine/entity_manager.h"
+#include "engine/entity_map.h"
+
+#include <atomic>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+using namespace thrive;
+
+struct QueryIndex::Implementation {
+
+    Implementation(
+        EntityManager& entityManager
+    ) : m_entityManager(&entityManager)
+    {
+    }
+
+    uint64_t
+    eventCount() const {
+        uint64_t count = 0;
+        for (const ComponentCollection* collection : m_collections) {
+            count += collection->eventCount();
+        }
+        return count;
+    }
+
+    bool
+    isSynced() const {
+        return not m_hasPendingEntities.load() and
+            m_syncedEventCount.load() == this->eventCount();
+    }
+
+    EventLog<Change> m_changes;
+
+    std::vector<ComponentCollection*> m_collections;
+
+    EntityManager* m_entityManager;
+
+    std::vector<unsigned int> m_eventReaders;
+
+    std::atomic<bool> m_hasPendingEntities{false};
+
+    std::vector<bool> m_isRequired;
+
+    mutable boost::mutex m_mutex;
+
+    EntitySet m_pendingEntities;
+
+    ComponentMask m_requiredMask;
+
+    std::atomic<uint64_t> m_syncedEventCount{0};
+
+};
+
+
+QueryIndex::QueryIndex(
+    EntityManager& entityManager,
+    const std::vector<ComponentType>& componentTypes
+) : m_impl(new Implementation(entityManager))
+{
+    for (const ComponentType& componentType : componentTypes) {
+        auto& collection = entityManager.getComponentCollection(componentType.first);
+        m_impl->m_collections.push_back(&collection);
+        m_impl->m_eventReaders.push_back(collection.addEventReader());
+        m_impl->m_isRequired.push_back(componentType.second);
+        if (componentType.second) {
+            m_impl->m_requiredMask.set(collection.maskIndex());
+        }
+    }
+    m_impl->m_syncedEventCount = m_impl->eventCount();
+}
+
+
+QueryIndex::~QueryIndex() {
+    if (m_impl->m_entityManager) {
+        for (size_t i = 0; i < m_impl->m_collections.size(); ++i) {
+            m_impl->m_collections[i]->removeEventReader(m_impl->m_eventReaders[i]);
+        }
+    }
+}
+
+
+EventLog<QueryIndex::Change>&
+QueryIndex::changes() {
+    return m_impl->m_changes;
+}
+
+
+const std::vector<ComponentCollection*>&
+QueryIndex::collections() const {
+    return m_impl->m_collections;
+}
+
+
+void
+QueryIndex::detach() {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+    if (not m_impl->m_entityManager) {
+        return;
+    }
+    for (size_t i = 0; i < m_impl->m_collections.size(); ++i) {
+        m_impl->m_collections[i]->removeEventReader(m_impl->m_eventReaders[i]);
+    }
+    m_impl->m_collections.clear();
+    m_impl->m_eventReaders.clear();
+    m_impl->m_entityManager = nullptr;
+    m_impl->m_pendingEntities.clear();
+    m_impl->m_hasPendingEntities = false;
+    m_impl->m_syncedEventCount = 0;
+    this->clearEntities();
+}
+
+
+EntityManager*
+QueryIndex::entityManager() const {
+    return m_impl->m_entityManager;
+}
+
+
+void
+QueryIndex::initEntities() {
+    for (EntityId entityId : m_impl->m_entityManager->entities()) {
+        this->updateEntity(entityId);
+    }
+}
+
+
+void
+QueryIndex::logChange(
+    EntityId entityId,
+    Change::Type type
+) {
+    m_impl->m_changes.append(Change{entityId, type});
+}
+
+
+size_t
+QueryIndex::memoryUsage() const {
+    return sizeof(Implementation) +
+        m_impl->m_changes.memoryUsage() +
+        m_impl->m_pendingEntities.memoryUsage() +
+        this->entityMemoryUsage();
+}
+
+
+boost::mutex&
+QueryIndex::mutex() const {
+    return m_impl->m_mutex;
+}
+
+
+void
+QueryIndex::removeEntity(
+    EntityId entityId
+) {
+    if (this->eraseEntity(entityId)) {
+        this->logChange(entityId, Change::Type::Removed);
+    }
+}
+
+
+const ComponentMask&
+QueryIndex::requiredMask() const {
+    return m_impl->m_requiredMask;
+}
+
+
+void
+QueryIndex::sync() {
+    // Filters sharing the index may be used by systems running
+    // concurrently. They can't change the entity manager, so if nothing
+    // is pending, there is nothing to do.
+    if (not m_impl->m_entityManager or m_impl->isSynced()) {
+        return;
+    }
+    boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+    if (not m_impl->m_entityManager or m_impl->isSynced()) {
+        return;
+    }
+    auto& pendingEntities = m_impl->m_pendingEntities;
+    bool isComplete = true;
+    for (size_t i = 0; i < m_impl->m_collections.size(); ++i) {
+        auto events = m_impl->m_collections[i]->readEvents(m_impl->m_eventReaders[i]);
+        isComplete = isComplete and events.isComplete;
+        for (auto event = events.begin; event != events.end; ++event) {
+            if (
+                event->type == ComponentCollection::Event::Type::Removed and
+                m_impl->m_isRequired[i]
+            ) {
+                // Removed before re-adding, so that overwritten
+                // components are reported as removed and added
+                this->removeEntity(event->entityId);
+            }
+            pendingEntities.insert(event->entityId);
+        }
+    }
+    m_impl->m_syncedEventCount = m_impl->eventCount();
+    if (not isComplete) {
+        // Fell too far behind, compare with the current state instead
+        this->collectEntities(pendingEntities);
+        for (EntityId entityId : m_impl->m_entityManager->entities()) {
+            pendingEntities.insert(entityId);
+        }
+    }
+    if (m_impl->m_entityManager->isBatching()) {
+        // Don't add new entities until the batch is complete, but keep
+        // the known ones up to date
+        for (EntityId entityId : pendingEntities) {
+            if (this->containsEntity(entityId)) {
+                this->updateEntity(entityId);
+            }
+        }
+    }
+    else {
+        for (EntityId entityId : pendingEntities) {
+            this->updateEntity(entityId);
+        }
+        pendingEntities.clear();
+    }
+    m_impl->m_hasPendingEntities = not pendingEntities.empty();
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "engine/event_log.h"
+#include "engine/typedefs.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace boost {
+    class mutex;
+}
+
+namespace thrive {
+
+class ComponentCollection;
+class EntityManager;
+class EntitySet;
+
+/**
+* @brief The set of entities matching a query, shared by all entity filters
+*   with that query
+*
+* Entity managers keep a registry of their query indexes (see
+* EntityManager::getQueryIndex()), so that filters with the same component
+* signature share one index instead of each tracking the same entities.
+*
+* The index reads the event logs of the queried component collections and
+* applies the structural changes in bulk on sync(). Subclasses store the
+* matching entities and decide what to store for each.
+*
+* Changes to the set of matching entities are logged in changes(), so that
+* filters recording added and removed entities can follow them with their
+* own cursors.
+*/
+class QueryIndex {
+
+public:
+
+    /**
+    * @brief A change to the set of matching entities
+    */
+    struct Change {
+
+        enum class Type {
+            Added,
+            Removed,
+            // The entity still matches, but its components changed
+            Updated
+        };
+
+        EntityId entityId;
+
+        Type type;
+
+    };
+
+    /**
+    * @brief A component type of the query and whether it is required
+    */
+    using ComponentType = std::pair<ComponentTypeId, bool>;
+
+    /**
+    * @brief Constructor
+    *
+    * Subclasses should call initEntities() in their constructor.
+    *
+    * @param entityManager
+    *   The entity manager to index
+    * @param componentTypes
+    *   The queried component types
+    */
+    QueryIndex(
+        EntityManager& entityManager,
+        const std::vector<ComponentType>& componentTypes
+    );
+
+    /**
+    * @brief Destructor
+    */
+    virtual ~QueryIndex();
+
+    /**
+    * @brief Log of the changes to the set of matching entities
+    *
+    * Lock mutex() while using the log.
+    */
+    EventLog<Change>&
+    changes();
+
+    /**
+    * @brief The queried collections, in the order of the component types
+    *   passed to the constructor
+    */
+    const std::vector<ComponentCollection*>&
+    collections() const;
+
+    /**
+    * @brief Stops indexing the entity manager
+    *
+    * Called by the entity manager before it is destroyed. Afterwards, the
+    * index is empty.
+    */
+    void
+    detach();
+
+    /**
+    * @brief The number of matching entities
+    */
+    virtual size_t
+    entityCount() const = 0;
+
+    /**
+    * @brief The indexed entity manager
+    *
+    * @return
+    *   The entity manager or \c nullptr if the index has been detached
+    */
+    EntityManager*
+    entityManager() const;
+
+    /**
+    * @brief Estimates the memory used by the index in bytes
+    *
+    * Lock mutex() while calling this.
+    */
+    size_t
+    memoryUsage() const;
+
+    /**
+    * @brief Protects changes() and sync()
+    */
+    boost::mutex&
+    mutex() const;
+
+    /**
+    * @brief Applies the structural changes since the last sync
+    *
+    * Must be called before accessing the matching entities. Cheap if
+    * nothing has changed.
+    *
+    * Thread safe, as long as the entity manager doesn't change
+    * concurrently.
+    */
+    void
+    sync();
+
+protected:
+
+    /**
+    * @brief Removes all entities
+    */
+    virtual void
+    clearEntities() = 0;
+
+    /**
+    * @brief Adds all matching entities to a set
+    */
+    virtual void
+    collectEntities(
+        EntitySet& entities
+    ) const = 0;
+
+    /**
+    * @brief Whether an entity matches
+    */
+    virtual bool
+    containsEntity(
+        EntityId entityId
+    ) const = 0;
+
+    /**
+    * @brief The memory used for the matching entities in bytes
+    */
+    virtual size_t
+    entityMemoryUsage() const = 0;
+
+    /**
+    * @brief Removes an entity's entry
+    *
+    * @return
+    *   \c true if the entity was in the index
+    */
+    virtual bool
+    eraseEntity(
+        EntityId entityId
+    ) = 0;
+
+    /**
+    * @brief Indexes all current entities
+    */
+    void
+    initEntities();
+
+    /**
+    * @brief Logs a change to the set of matching entities
+    */
+    void
+    logChange(
+        EntityId entityId,
+        Change::Type type
+    );
+
+    /**
+    * @brief Removes an entity and logs the removal
+    */
+    void
+    removeEntity(
+        EntityId entityId
+    );
+
+    /**
+    * @brief The mask of the required component types
+    */
+    const ComponentMask&
+    requiredMask() const;
+
+    /**
+    * @brief Brings an entity's entry up to date with its components
+    *
+    * Adds, updates or removes the entry and logs the change.
+    */
+    virtual void
+    updateEntity(
+        EntityId entityId
+    ) = 0;
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
+};
+
+}
@@ -0,0 +1,396 @@
+#include "engine/savegame_writer.h"
+
+#include "engine/compression.h"
+#include "engine/serialization.h"
+#include "engine/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/filesystem.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace thrive;
+
+namespace {
+
+// Progress is updated after each chunk
+const size_t CHUNK_SIZE = 1 << 20;
+
+// Size of a journal record's length prefix
+const size_t RECORD_HEADER_SIZE = 8;
+
+struct Job {
+
+    SavegameWriter::StorageBuilder buildSavegame;
+
+    bool compress = false;
+
+    std::string error;
+
+    std::string filename;
+
+    bool isRecord = false;
+
+    float lastReportedProgress = 0.0f;
+
+    SavegameWriter::CompletionCallback onCompletion;
+
+    SavegameWriter::ProgressCallback onProgress;
+
+    std::atomic<float> progress{0.0f};
+
+    StorageContainer savegame;
+
+    bool truncate = false;
+
+};
+
+}
+
+
+struct SavegameWriter::Implementation {
+
+    Implementation()
+      : m_thread(&Implementation::run, this)
+    {
+    }
+
+    ~Implementation() {
+        {
+            boost::lock_guard<boost::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_jobAdded.notify_all();
+        m_thread.join();
+    }
+
+    bool
+    isBusy() const {
+        return not m_pending.empty() or m_current;
+    }
+
+    void
+    reportProgress(
+        Job& job
+    ) {
+        float progress = job.progress.load();
+        if (progress != job.lastReportedProgress) {
+            job.lastReportedProgress = progress;
+            if (job.onProgress) {
+                job.onProgress(job.filename, progress);
+            }
+        }
+    }
+
+    void
+    run() {
+        while (true) {
+            std::shared_ptr<Job> job;
+            {
+                boost::unique_lock<boost::mutex> lock(m_mutex);
+                while (m_pending.empty() and not m_stopping) {
+                    m_jobAdded.wait(lock);
+                }
+                // Pending saves are still written when stopping
+                if (m_pending.empty()) {
+                    return;
+                }
+                job = m_pending.front();
+                m_pending.pop_front();
+                m_current = job;
+            }
+            if (job->isRecord) {
+                job->error = this->writeRecord(*job);
+            }
+            else {
+                job->error = this->writeSavegame(*job);
+            }
+            {
+                boost::lock_guard<boost::mutex> lock(m_mutex);
+                m_current.reset();
+                m_finished.push_back(std::move(job));
+            }
+            m_jobFinished.notify_all();
+        }
+    }
+
+    std::string
+    writeRecord(
+        Job& job
+    ) {
+        try {
+            if (job.buildSavegame) {
+                job.savegame = job.buildSavegame();
+                job.buildSavegame = nullptr;
+            }
+            std::ostringstream buffer(std::ios_base::out | std::ios_base::binary);
+            buffer << job.savegame;
+            job.savegame = StorageContainer();
+            std::string data = buffer.str();
+            char header[RECORD_HEADER_SIZE];
+            for (size_t i = 0; i < RECORD_HEADER_SIZE; ++i) {
+                header[i] = static_cast<char>(uint64_t(data.size()) >> (8 * i));
+            }
+            std::ofstream stream(
+                job.filename,
+                (job.truncate ? std::ofstream::trunc : std::ofstream::app) | std::ofstream::binary
+            );
+            if (not stream.is_open()) {
+                throw std::runtime_error("Could not open file for saving");
+            }
+            stream.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            stream.write(header, RECORD_HEADER_SIZE);
+            stream.write(data.data(), data.size());
+            stream.close();
+            job.progress = 1.0f;
+        }
+        catch (const std::exception& e) {
+            return "Error saving " + job.filename + ": " + e.what();
+        }
+        return "";
+    }
+
+    std::string
+    writeSavegame(
+        Job& job
+    ) {
+        namespace fs = boost::filesystem;
+        fs::path path(job.filename);
+        fs::path temporaryPath(job.filename + ".tmp");
+        try {
+            if (job.buildSavegame) {
+                job.savegame = job.buildSavegame();
+                job.buildSavegame = nullptr;
+            }
+            std::ostringstream buffer(std::ios_base::out | std::ios_base::binary);
+            buffer << job.savegame;
+            // Release the snapshot early, it's usually larger than the
+            // serialized data
+            job.savegame = StorageContainer();
+            std::string data = buffer.str();
+            if (job.compress) {
+                data = thrive::compress(data.data(), data.size(), ThreadPool::shared());
+            }
+            std::ofstream stream(
+                temporaryPath.string(),
+                std::ofstream::trunc | std::ofstream::binary
+            );
+            if (not stream.is_open()) {
+                throw std::runtime_error("Could not open file for saving");
+            }
+            stream.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            size_t written = 0;
+            while (written < data.size()) {
+                size_t chunkSize = std::min(CHUNK_SIZE, data.size() - written);
+                stream.write(data.data() + written, chunkSize);
+                written += chunkSize;
+                job.progress = float(written) / data.size();
+            }
+            stream.close();
+            fs::rename(temporaryPath, path);
+            job.progress = 1.0f;
+        }
+        catch (const std::exception& e) {
+            boost::system::error_code ignored;
+            fs::remove(temporaryPath, ignored);
+            return "Error saving " + job.filename + ": " + e.what();
+        }
+        return "";
+    }
+
+    std::shared_ptr<Job> m_current;
+
+    std::vector<std::shared_ptr<Job>> m_finished;
+
+    boost::condition_variable m_jobAdded;
+
+    boost::condition_variable m_jobFinished;
+
+    mutable boost::mutex m_mutex;
+
+    std::deque<std::shared_ptr<Job>> m_pending;
+
+    bool m_stopping = false;
+
+    // Last, so that everything else exists when the thread starts
+    boost::thread m_thread;
+
+};
+
+
+SavegameWriter::SavegameWriter()
+  : m_impl(new Implementation())
+{
+}
+
+
+SavegameWriter::~SavegameWriter() {}
+
+
+void
+SavegameWriter::appendRecord(
+    std::string filename,
+    StorageContainer record,
+    CompletionCallback onCompletion,
+    bool truncate
+) {
+    auto job = std::make_shared<Job>();
+    job->filename = std::move(filename);
+    job->isRecord = true;
+    job->savegame = std::move(record);
+    job->onCompletion = std::move(onCompletion);
+    job->truncate = truncate;
+    {
+        boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+        m_impl->m_pending.push_back(std::move(job));
+    }
+    m_impl->m_jobAdded.notify_one();
+}
+
+
+void
+SavegameWriter::appendRecord(
+    std::string filename,
+    StorageBuilder buildRecord,
+    CompletionCallback onCompletion,
+    bool truncate
+) {
+    auto job = std::make_shared<Job>();
+    job->buildSavegame = std::move(buildRecord);
+    job->filename = std::move(filename);
+    job->isRecord = true;
+    job->onCompletion = std::move(onCompletion);
+    job->truncate = truncate;
+    {
+        boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+        m_impl->m_pending.push_back(std::move(job));
+    }
+    m_impl->m_jobAdded.notify_one();
+}
+
+
+bool
+SavegameWriter::isBusy() const {
+    boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+    return m_impl->isBusy();
+}
+
+
+void
+SavegameWriter::poll() {
+    std::shared_ptr<Job> current;
+    std::vector<std::shared_ptr<Job>> finished;
+    {
+        boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+        current = m_impl->m_current;
+        finished.swap(m_impl->m_finished);
+    }
+    // Callbacks are called without the lock, so they may queue new saves
+    for (const auto& job : finished) {
+        m_impl->reportProgress(*job);
+        if (job->onCompletion) {
+            job->onCompletion(job->filename, job->error);
+        }
+    }
+    if (current) {
+        m_impl->reportProgress(*current);
+    }
+}
+
+
+std::vector<StorageContainer>
+SavegameWriter::readRecords(
+    const std::string& filename
+) {
+    std::vector<StorageContainer> records;
+    std::ifstream stream(filename, std::ifstream::binary);
+    if (not stream.is_open()) {
+        return records;
+    }
+    std::string data(
+        (std::istreambuf_iterator<char>(stream)),
+        std::istreambuf_iterator<char>()
+    );
+    size_t position = 0;
+    while (data.size() - position >= RECORD_HEADER_SIZE) {
+        uint64_t size = 0;
+        for (size_t i = 0; i < RECORD_HEADER_SIZE; ++i) {
+            size |= uint64_t(static_cast<uint8_t>(data[position + i])) << (8 * i);
+        }
+        position += RECORD_HEADER_SIZE;
+        if (size > data.size() - position) {
+            break;
+        }
+        std::istringstream recordStream(
+            data.substr(position, size),
+            std::ios_base::in | std::ios_base::binary
+        );
+        StorageContainer record;
+        recordStream >> record;
+        records.push_back(std::move(record));
+        position += size;
+    }
+    return records;
+}
+
+
+void
+SavegameWriter::wait() {
+    boost::unique_lock<boost::mutex> lock(m_impl->m_mutex);
+    while (m_impl->isBusy()) {
+        m_impl->m_jobFinished.wait(lock);
+    }
+}
+
+
+void
+SavegameWriter::write(
+    std::string filename,
+    StorageContainer savegame,
+    ProgressCallback onProgress,
+    CompletionCallback onCompletion,
+    bool compress
+) {
+    auto job = std::make_shared<Job>();
+    job->compress = compress;
+    job->filename = std::move(filename);
+    job->savegame = std::move(savegame);
+    job->onProgress = std::move(onProgress);
+    job->onCompletion = std::move(onCompletion);
+    {
+        boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+        m_impl->m_pending.push_back(std::move(job));
+    }
+    m_impl->m_jobAdded.notify_one();
+}
+
+
+void
+SavegameWriter::write(
+    std::string filename,
+    StorageBuilder buildSavegame,
+    ProgressCallback onProgress,
+    CompletionCallback onCompletion,
+    bool compress
+) {
+    auto job = std::make_shared<Job>();
+    job->buildSavegame = std::move(buildSavegame);
+    job->compress = compress;
+    job->filename = std::move(filename);
+    job->onProgress = std::move(onProgress);
+    job->onCompletion = std::move(onCompletion);
+    {
+        boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+        m_impl->m_pending.push_back(std::move(job));
+    }
+    m_impl->m_jobAdded.notify_one();
+}
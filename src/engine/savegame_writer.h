@@ -0,0 +1,240 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace thrive {
+
+class StorageContainer;
+
+/**
+* @brief Writes savegames on a background thread
+*
+* The caller takes a snapshot of the game at a frame boundary and hands
+* it over with write(), either as a finished StorageContainer or as a
+* function that builds one (see EntityManager::snapshot()). Building the
+* container, serializing it and writing it to disk happen on a worker
+* thread, so the game keeps running meanwhile.
+*
+* Savegames can optionally be compressed. Blocks are compressed in parallel
+* on the shared ThreadPool.
+*
+* The file is first written next to its destination and then renamed, so
+* an interrupted save never leaves a truncated savegame behind.
+*
+* Autosaves can append small records to a journal with appendRecord()
+* instead of rewriting the whole savegame, see readRecords().
+*
+* Callbacks are never called from the worker thread. Call poll() regularly
+* (e.g. once per frame) to receive them on the calling thread, which makes
+* it safe to pass Lua functions.
+*
+* Usage example:
+* \code
+* SavegameWriter writer;
+* writer.write(
+*     "quick.sav",
+*     std::move(savegame),
+*     nullptr,
+*     [] (const std::string& filename, const std::string& error) {
+*         if (not error.empty()) {
+*             std::cerr << error << std::endl;
+*         }
+*     }
+* );
+* // Each frame
+* writer.poll();
+* \endcode
+*/
+class SavegameWriter {
+
+public:
+
+    /**
+    * @brief Called when a save has finished
+    *
+    * Receives the savegame's filename and an error message, which is empty
+    * if saving succeeded.
+    */
+    using CompletionCallback = std::function<void(const std::string&, const std::string&)>;
+
+    /**
+    * @brief Called while a savegame is being written
+    *
+    * Receives the savegame's filename and the fraction of the file that
+    * has been written so far, between 0 and 1.
+    */
+    using ProgressCallback = std::function<void(const std::string&, float)>;
+
+    /**
+    * @brief Builds a savegame's content on the worker thread
+    *
+    * Must not access anything the game may modify meanwhile.
+    */
+    using StorageBuilder = std::function<StorageContainer()>;
+
+    /**
+    * @brief Constructor
+    *
+    * Starts the worker thread.
+    */
+    SavegameWriter();
+
+    /**
+    * @brief Destructor
+    *
+    * Waits for all pending saves. Their callbacks are not called anymore.
+    */
+    ~SavegameWriter();
+
+    /**
+    * @brief Queues a record to be appended to a journal file
+    *
+    * Records are written in the same order as savegames. Each one is
+    * prefixed with its size, so that a record cut short by a crash can be
+    * detected.
+    *
+    * Unlike write(), this modifies the file in place.
+    *
+    * @param filename
+    *   The journal file
+    * @param record
+    *   The record's content
+    * @param onCompletion
+    *   Called when the record has been written or failed, may be empty
+    * @param truncate
+    *   Whether to discard the journal's previous records
+    */
+    void
+    appendRecord(
+        std::string filename,
+        StorageContainer record,
+        CompletionCallback onCompletion,
+        bool truncate = false
+    );
+
+    /**
+    * @brief Queues a record to be appended to a journal file, built on the
+    *   worker thread
+    *
+    * Exceptions thrown by \a buildRecord are reported to \a onCompletion
+    * like write errors.
+    *
+    * @param filename
+    *   The journal file
+    * @param buildRecord
+    *   Builds the record's content
+    * @param onCompletion
+    *   Called when the record has been written or failed, may be empty
+    * @param truncate
+    *   Whether to discard the journal's previous records
+    */
+    void
+    appendRecord(
+        std::string filename,
+        StorageBuilder buildRecord,
+        CompletionCallback onCompletion,
+        bool truncate = false
+    );
+
+    /**
+    * @brief Whether any saves are pending or running
+    */
+    bool
+    isBusy() const;
+
+    /**
+    * @brief Calls the callbacks for progress made since the last call
+    */
+    void
+    poll();
+
+    /**
+    * @brief Reads the records of a journal written by appendRecord()
+    *
+    * A truncated record at the end of the file, e.g. from a crash during
+    * writing, is ignored along with anything after it.
+    *
+    * @param filename
+    *   The journal to read
+    *
+    * @return
+    *   The records, oldest first. Empty if the file doesn't exist.
+    *
+    * @throws std::runtime_error
+    *   If a complete record is corrupt
+    */
+    static std::vector<StorageContainer>
+    readRecords(
+        const std::string& filename
+    );
+
+    /**
+    * @brief Blocks until all pending saves are written
+    *
+    * Call poll() afterwards to receive their callbacks.
+    */
+    void
+    wait();
+
+    /**
+    * @brief Queues a savegame for writing
+    *
+    * Savegames are written in the order they are queued.
+    *
+    * @param filename
+    *   The file to write
+    * @param savegame
+    *   The savegame's content
+    * @param onProgress
+    *   Called with the writing progress, may be empty
+    * @param onCompletion
+    *   Called when the save has finished or failed, may be empty
+    * @param compress
+    *   Whether to compress the savegame, see thrive::compress()
+    */
+    void
+    write(
+        std::string filename,
+        StorageContainer savegame,
+        ProgressCallback onProgress,
+        CompletionCallback onCompletion,
+        bool compress = false
+    );
+
+    /**
+    * @brief Queues a savegame for writing, built on the worker thread
+    *
+    * Exceptions thrown by \a buildSavegame are reported to \a onCompletion
+    * like write errors.
+    *
+    * @param filename
+    *   The file to write
+    * @param buildSavegame
+    *   Builds the savegame's content
+    * @param onProgress
+    *   Called with the writing progress, may be empty
+    * @param onCompletion
+    *   Called when the save has finished or failed, may be empty
+    * @param compress
+    *   Whether to compress the savegame, see thrive::compress()
+    */
+    void
+    write(
+        std::string filename,
+        StorageBuilder buildSavegame,
+        ProgressCallback onProgress,
+        CompletionCallback onCompletion,
+        bool compress = false
+    );
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
+};
+
+}
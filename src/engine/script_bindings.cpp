@@ -4,7 +4,10 @@
 #include "engine/component_factory.h"
 #include "engine/engine.h"
 #include "engine/entity.h"
+#include "engine/entity_command_buffer.h"
 #include "engine/game_state.h"
+#include "engine/prefab.h"
+#include "engine/profiler.h"
 #include "engine/serialization.h"
 #include "engine/system.h"
 #include "engine/touchable.h"
@@ -21,9 +24,12 @@ thrive::EngineBindings::luaBindings() {
         Component::luaBindings(),
         ComponentFactory::luaBindings(),
         Entity::luaBindings(),
+        EntityCommandBuffer::luaBindings(),
+        Prefab::luaBindings(),
         Touchable::luaBindings(),
         GameState::luaBindings(),
         Engine::luaBindings(),
+        Profiler::luaBindings(),
         RNG::luaBindings()
     );
 }
@@ -1,13 +1,27 @@
 #include "engine/serialization.h"
 
+#include "engine/compression.h"
+#include "engine/thread_pool.h"
 #include "scripting/luabind.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <boost/container/small_vector.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/variant.hpp>
 #include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <iterator>
 #include <luabind/iterator_policy.hpp>
 #include <stdexcept>
 #include <unordered_map>
+#include <unordered_set>
 
 using namespace thrive;
 
@@ -34,11 +48,58 @@ using Variant = boost::variant<
     StorageList
 >;
 
-struct StoredValue {
+// Most containers are small, e.g. vectors and quaternions
+const size_t INLINE_ENTRIES = 4;
+
+struct Entry {
+
+    // Interned, see internKey()
+    const std::string* key;
+
     TypeId typeId;
+
     Variant value;
+
 };
 
+/**
+* @brief Returns the unique copy of a key
+*
+* Containers store a pointer to the interned key instead of their own
+* copy. Only keys that are stored get interned, lookups compare against the
+* stored keys directly, so unknown keys don't grow the set. The set of keys
+* in use is small, so interned keys are never freed.
+*
+* @param key
+*   The key to intern
+*
+* @return A pointer that stays valid until the program exits
+*/
+const std::string*
+internKey(
+    const std::string& key
+) {
+    // Keys are looked up without locking once a thread has seen them
+    thread_local std::unordered_map<std::string, const std::string*> t_keys;
+    auto iter = t_keys.find(key);
+    if (iter != t_keys.end()) {
+        return iter->second;
+    }
+    struct Keys {
+        boost::mutex mutex;
+        std::unordered_set<std::string> keys;
+    };
+    // Leaked, so that keys outlive other static objects
+    static Keys* keys = new Keys();
+    const std::string* interned;
+    {
+        boost::lock_guard<boost::mutex> lock(keys->mutex);
+        interned = &*keys->keys.insert(key).first;
+    }
+    t_keys.emplace(key, interned);
+    return interned;
+}
+
 /**
 * @brief Information about a storable type
 *
@@ -85,7 +146,7 @@ struct TypeInfo {
     */
     static StoredType
     convertToStoredType (
-        const Type& value
+        Type value
     ) {
         return value;
     }
@@ -110,7 +171,7 @@ struct IdToType {
         \
         static StoredType \
         convertToStoredType( \
-            const type& value \
+            type value \
         ); \
         \
     }; \
@@ -143,13 +204,12 @@ TYPE_INFO(Ogre::Plane, StorageContainer, 288)
 TYPE_INFO(Ogre::Vector3, StorageContainer, 304)
 TYPE_INFO(Ogre::Quaternion, StorageContainer, 320)
 TYPE_INFO(Ogre::ColourValue, uint32_t, 336)
-} // namespace
 
 #define TO_LUA_CASE(typeName) \
     case TypeInfo<typeName>::Id: \
     { \
         using Info = TypeInfo<typeName>; \
-        auto storedValue = boost::get<Info::StoredType>(value.value); \
+        const auto& storedValue = boost::get<Info::StoredType>(entry.value); \
         auto value = Info::convertFromStoredType(storedValue); \
         return luabind::object(L, value); \
     }
@@ -157,9 +217,9 @@ TYPE_INFO(Ogre::ColourValue, uint32_t, 336)
 static luabind::object
 toLua(
     lua_State* L,
-    const StoredValue& value
+    const Entry& entry
 ) {
-    switch(value.typeId) {
+    switch(entry.typeId) {
         TO_LUA_CASE(bool);
         TO_LUA_CASE(char);
         TO_LUA_CASE(int8_t);
@@ -186,51 +246,128 @@ toLua(
     }
 }
 
+// Memory that encoded containers are decoded from
+struct EncodedSource {
+
+    // Only used when the source is a file
+    boost::interprocess::file_mapping file;
+
+    boost::interprocess::mapped_region region;
+
+    // Only used when the source is a stream
+    std::string buffer;
+
+    std::vector<std::string> strings;
+
+    // Interned keys by string index, filled in when first used as a key
+    mutable std::unique_ptr<std::atomic<const std::string*>[]> keys;
+
+};
+
+} // namespace
+
 struct StorageContainer::Implementation {
 
-    template<typename T>
-    bool
-    rawContains(
+    // Entries in order of insertion. Lookups intern the key once and scan
+    // the entries comparing addresses, which beats hashing for the handful
+    // of keys a container usually has.
+    using Content = boost::container::small_vector<Entry, INLINE_ENTRIES>;
+
+    void
+    clear() {
+        m_source.reset();
+        m_content.clear();
+    }
+
+    const Content&
+    content() const {
+        if (m_source) {
+            this->decode();
+        }
+        return m_content;
+    }
+
+    Content&
+    content() {
+        if (m_source) {
+            this->decode();
+        }
+        return m_content;
+    }
+
+    // Defined with the binary format below
+    void
+    decode() const;
+
+    const Entry*
+    find(
         const std::string& key
     ) const {
-        auto iter = m_content.find(key);
-        return (
-            iter != m_content.end() and
-            iter->second.typeId == TypeInfo<T>::Id
-        );
+        // Comparing the sizes first rejects most keys without touching
+        // their characters
+        for (const Entry& entry : this->content()) {
+            if (
+                entry.key->size() == key.size() and
+                entry.key->compare(key) == 0
+            ) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    Entry*
+    find(
+        const std::string& key
+    ) {
+        const Implementation& self = *this;
+        return const_cast<Entry*>(self.find(key));
     }
 
     template<typename T>
-    typename TypeInfo<T>::StoredType
+    const typename TypeInfo<T>::StoredType*
     rawGet(
-        const std::string& key,
-        const typename TypeInfo<T>::StoredType& defaultValue = typename TypeInfo<T>::StoredType()
+        const std::string& key
     ) const {
-        auto iter = m_content.find(key);
-        if (iter == m_content.end()) {
-            return defaultValue;
-        }
-        else if (iter->second.typeId != TypeInfo<T>::Id){
-            return defaultValue;
-        }
-        else {
-            return boost::get<typename TypeInfo<T>::StoredType>(iter->second.value);
+        const Entry* entry = this->find(key);
+        if (not entry or entry->typeId != TypeInfo<T>::Id) {
+            return nullptr;
         }
+        return &boost::get<typename TypeInfo<T>::StoredType>(entry->value);
     }
 
     template<typename T>
-    void
+    typename TypeInfo<T>::StoredType&
     rawSet(
         const std::string& key,
         typename TypeInfo<T>::StoredType value
     ) {
-        m_content[key] = StoredValue{
-            TypeInfo<T>::Id, 
-            std::move(value)
-        };
+        Entry* entry = this->find(key);
+        if (entry) {
+            entry->typeId = TypeInfo<T>::Id;
+            entry->value = std::move(value);
+        }
+        else {
+            Content& content = this->content();
+            content.push_back(Entry{
+                internKey(key),
+                TypeInfo<T>::Id,
+                std::move(value)
+            });
+            entry = &content.back();
+        }
+        return boost::get<typename TypeInfo<T>::StoredType>(entry->value);
     }
 
-    std::unordered_map<std::string, StoredValue> m_content;
+    mutable Content m_content;
+
+    // Containers read from a savegame are only decoded when their content
+    // is first accessed. Until then, they keep the encoded data alive.
+    mutable std::shared_ptr<const EncodedSource> m_source;
+
+    mutable const char* m_encodedBegin = nullptr;
+
+    mutable const char* m_encodedEnd = nullptr;
 
 };
 
@@ -241,7 +378,7 @@ struct StorageContainer::Implementation {
     StorageContainer::contains<type>( \
         const std::string& key \
     ) const { \
-        return m_impl->rawContains<type>(key); \
+        return m_impl->rawGet<type>(key) != nullptr; \
     } \
     \
     template<> \
@@ -250,11 +387,11 @@ struct StorageContainer::Implementation {
         const std::string& key, \
         const type& defaultValue \
     ) const { \
-        if (not this->contains<type>(key)) { \
+        const auto* storedValue = m_impl->rawGet<type>(key); \
+        if (not storedValue) { \
             return defaultValue; \
         } \
-        auto storedValue = m_impl->rawGet<type>(key); \
-        return TypeInfo<type>::convertFromStoredType(storedValue); \
+        return TypeInfo<type>::convertFromStoredType(*storedValue); \
     } \
     \
     template <> \
@@ -263,8 +400,10 @@ struct StorageContainer::Implementation {
         const std::string& key, \
         type value \
     ) { \
-        auto storedValue = TypeInfo<type>::convertToStoredType(value); \
-        m_impl->rawSet<type>(key, std::move(storedValue)); \
+        m_impl->rawSet<type>( \
+            key, \
+            TypeInfo<type>::convertToStoredType(std::move(value)) \
+        ); \
     }
 
 GET_SET_CONTAINS(bool)
@@ -289,6 +428,22 @@ GET_SET_CONTAINS(Ogre::Vector3)
 GET_SET_CONTAINS(Ogre::Quaternion)
 GET_SET_CONTAINS(Ogre::ColourValue)
 
+template<>
+StorageContainer&
+StorageContainer::emplace<StorageContainer>(
+    const std::string& key
+) {
+    return m_impl->rawSet<StorageContainer>(key, StorageContainer());
+}
+
+template<>
+StorageList&
+StorageContainer::emplace<StorageList>(
+    const std::string& key
+) {
+    return m_impl->rawSet<StorageList>(key, StorageList());
+}
+
 luabind::scope
 StorageContainer::luaBindings() {
     using namespace luabind;
@@ -328,7 +483,8 @@ StorageContainer::StorageContainer(
 
 StorageContainer::StorageContainer(
     StorageContainer&& other
-) : m_impl(std::move(other.m_impl))
+) noexcept
+  : m_impl(std::move(other.m_impl))
 {
 }
 
@@ -341,7 +497,15 @@ StorageContainer::operator = (
     const StorageContainer& other
 ) {
     if (this != &other) {
+        // Moved-from containers may be assigned to again
+        if (not m_impl) {
+            m_impl.reset(new Implementation());
+        }
         m_impl->m_content = other.m_impl->m_content;
+        // Undecoded containers are copied without decoding them
+        m_impl->m_source = other.m_impl->m_source;
+        m_impl->m_encodedBegin = other.m_impl->m_encodedBegin;
+        m_impl->m_encodedEnd = other.m_impl->m_encodedEnd;
     }
     return *this;
 }
@@ -350,7 +514,7 @@ StorageContainer::operator = (
 StorageContainer&
 StorageContainer::operator = (
     StorageContainer&& other
-) {
+) noexcept {
     assert(this != &other);
     m_impl = std::move(other.m_impl);
     return *this;
@@ -361,7 +525,7 @@ bool
 StorageContainer::contains(
     const std::string& key
 ) const {
-    return m_impl->m_content.find(key) != m_impl->m_content.cend();
+    return m_impl->find(key) != nullptr;
 }
 
 
@@ -370,12 +534,12 @@ StorageContainer::luaGet(
     const std::string& key,
     luabind::object defaultValue
 ) const {
-    auto iter = m_impl->m_content.find(key);
-    if (iter == m_impl->m_content.end()) {
+    const Entry* entry = m_impl->find(key);
+    if (not entry) {
         return defaultValue;
     }
     else {
-        luabind::object obj = toLua(defaultValue.interpreter(), iter->second);
+        luabind::object obj = toLua(defaultValue.interpreter(), *entry);
         if (obj) {
             return obj;
         }
@@ -389,8 +553,8 @@ StorageContainer::luaGet(
 std::list<std::string>
 StorageContainer::keys() const {
     std::list<std::string> keys;
-    for (const auto& pair : m_impl->m_content) {
-        keys.push_back(pair.first);
+    for (const Entry& entry : m_impl->content()) {
+        keys.push_back(*entry.key);
     }
     return keys;
 }
@@ -406,7 +570,7 @@ StorageContainer::keys() const {
     \
     typeName \
     TypeInfo<typeName>::convertToStoredType( \
-        const typeName& value \
+        typeName value \
     ) { \
         return value; \
     }
@@ -442,7 +606,7 @@ TypeInfo<Ogre::Degree>::convertFromStoredType(
 
 float
 TypeInfo<Ogre::Degree>::convertToStoredType(
-    const Ogre::Degree& value
+    Ogre::Degree value
 ) {
     return value.valueDegrees();
 }
@@ -465,7 +629,7 @@ TypeInfo<Ogre::Plane>::convertFromStoredType(
 
 StorageContainer
 TypeInfo<Ogre::Plane>::convertToStoredType(
-    const Ogre::Plane& value
+    Ogre::Plane value
 ) {
     StorageContainer storage;
     storage.set<Ogre::Vector3>("normal", value.normal);
@@ -494,7 +658,7 @@ TypeInfo<Ogre::Vector3>::convertFromStoredType(
 
 StorageContainer
 TypeInfo<Ogre::Vector3>::convertToStoredType(
-    const Ogre::Vector3& value
+    Ogre::Vector3 value
 ) {
     StorageContainer storage;
     storage.set<Ogre::Real>("x", value.x);
@@ -525,7 +689,7 @@ TypeInfo<Ogre::Quaternion>::convertFromStoredType(
 
 StorageContainer
 TypeInfo<Ogre::Quaternion>::convertToStoredType(
-    const Ogre::Quaternion& value
+    Ogre::Quaternion value
 ) {
     StorageContainer storage;
     storage.set<Ogre::Real>("w", value.w);
@@ -553,7 +717,7 @@ TypeInfo<Ogre::ColourValue>::convertFromStoredType(
 
 uint32_t
 TypeInfo<Ogre::ColourValue>::convertToStoredType(
-    const Ogre::ColourValue& value
+    Ogre::ColourValue value
 ) {
     return value.getAsRGBA();
 }
@@ -563,12 +727,21 @@ TypeInfo<Ogre::ColourValue>::convertToStoredType(
 // StorageList
 ////////////////////////////////////////////////////////////////////////////////
 
+static void
+StorageList_append(
+    StorageList* self,
+    const StorageContainer& element
+) {
+    self->append(StorageContainer(element));
+}
+
+
 luabind::scope
 StorageList::luaBindings() {
     using namespace luabind;
     return class_<StorageList>("StorageList")
         .def(constructor<>())
-        .def("append", &StorageList::append)
+        .def("append", &StorageList_append)
         .def("get", &StorageList::get)
         .def("size", &StorageList::size)
     ;
@@ -586,7 +759,8 @@ StorageList::StorageList(
 
 StorageList::StorageList(
     StorageList&& other
-) : std::vector<StorageContainer>(other)
+) noexcept
+  : std::vector<StorageContainer>(std::move(other))
 {
 }
 
@@ -603,20 +777,27 @@ StorageList::operator = (
 StorageList&
 StorageList::operator = (
     StorageList&& other
-) {
-    std::vector<StorageContainer>::operator=(other);
+) noexcept {
+    std::vector<StorageContainer>::operator=(std::move(other));
     return *this;
 }
 
 
 void
 StorageList::append(
-    StorageContainer element
+    StorageContainer&& element
 ) {
     this->emplace_back(std::move(element));
 }
 
 
+StorageContainer&
+StorageList::emplace() {
+    this->emplace_back();
+    return this->back();
+}
+
+
 StorageContainer&
 StorageList::get(
     size_t index
@@ -632,6 +813,22 @@ StorageList::get(
 
 namespace {
 
+// Versioned streams start with this, followed by the version. Version 1
+// streams start with the container's size as an uint64_t, which can't be
+// mistaken for it.
+const std::array<char, 8> MAGIC_NUMBER {{'T', 'H', 'R', 'I', 'V', 'E', '\x1a', '\0'}};
+
+// Version 2 is still read, but no longer written
+const uint64_t FORMAT_VERSION = 3;
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Version 1
+//
+// Only read, for older savegames. Numbers are in native byte order, floats
+// are stored as text and keys are repeated for every container.
+////////////////////////////////////////////////////////////////////////////////
+
 template<typename T>
 struct TypeHandler {
 
@@ -640,19 +837,9 @@ struct TypeHandler {
         std::istream& stream
     );
 
-    static void
-    serialize(
-        std::ostream& stream,
-        const T& value
-    );
-
 };
 
 
-////////////////////////////////////////////////////////////////////////////////
-// Integrals
-////////////////////////////////////////////////////////////////////////////////
-
 template<typename T>
 struct IntegralTypeHandler {
 
@@ -669,16 +856,6 @@ struct IntegralTypeHandler {
         return value;
     }
 
-    static void
-    serialize(
-        std::ostream& stream,
-        T value
-    ) {
-        stream.write(
-            reinterpret_cast<char*>(&value), 
-            sizeof(T)
-        );
-    }
 };
 
 #define INTEGRAL_TYPE_HANDLER(typeName) \
@@ -694,10 +871,6 @@ INTEGRAL_TYPE_HANDLER(uint32_t)
 INTEGRAL_TYPE_HANDLER(uint64_t)
 
 
-////////////////////////////////////////////////////////////////////////////////
-// Bool
-////////////////////////////////////////////////////////////////////////////////
-
 template<>
 struct TypeHandler<bool> {
 
@@ -709,22 +882,9 @@ struct TypeHandler<bool> {
         return value > 0;
     }
 
-    static void
-    serialize(
-        std::ostream& stream,
-        const bool& value
-    ) {
-        uint8_t encoded = value ? 1 : 0;
-        TypeHandler<uint8_t>::serialize(stream, encoded);
-    }
-
 };
 
 
-////////////////////////////////////////////////////////////////////////////////
-// Char
-////////////////////////////////////////////////////////////////////////////////
-
 template<>
 struct TypeHandler<char> {
 
@@ -738,20 +898,9 @@ struct TypeHandler<char> {
         return value;
     }
 
-    static void
-    serialize(
-        std::ostream& stream,
-        const char& value
-    ) {
-        stream.write(&value, 1);
-    }
 };
 
 
-////////////////////////////////////////////////////////////////////////////////
-// String
-////////////////////////////////////////////////////////////////////////////////
-
 template<>
 struct TypeHandler<std::string> {
 
@@ -761,28 +910,14 @@ struct TypeHandler<std::string> {
     ) {
         uint64_t size = TypeHandler<uint64_t>::deserialize(stream);
         std::vector<char> buffer(size, '\0');
-        stream.read(&buffer[0], size);
+        stream.read(buffer.data(), size);
         assert(not stream.fail());
         return std::string(buffer.begin(), buffer.end());
     }
 
-    static void
-    serialize(
-        std::ostream& stream,
-        const std::string& string
-    ) {
-        uint64_t size = string.size();
-        TypeHandler<uint64_t>::serialize(stream, size);
-        stream.write(string.data(), size);
-    }
-
 };
 
 
-////////////////////////////////////////////////////////////////////////////////
-// Float
-////////////////////////////////////////////////////////////////////////////////
-
 template<>
 struct TypeHandler<float> {
 
@@ -794,22 +929,9 @@ struct TypeHandler<float> {
         return boost::lexical_cast<float>(asString);
     }
 
-    static void
-    serialize(
-        std::ostream& stream,
-        const float& value
-    ) {
-        std::string asString = boost::lexical_cast<std::string>(value);
-        TypeHandler<std::string>::serialize(stream, asString);
-    }
-
 };
 
 
-////////////////////////////////////////////////////////////////////////////////
-// Double
-////////////////////////////////////////////////////////////////////////////////
-
 template<>
 struct TypeHandler<double> {
 
@@ -821,22 +943,9 @@ struct TypeHandler<double> {
         return boost::lexical_cast<double>(asString);
     }
 
-    static void
-    serialize(
-        std::ostream& stream,
-        const double& value
-    ) {
-        std::string asString = boost::lexical_cast<std::string>(value);
-        TypeHandler<std::string>::serialize(stream, asString);
-    }
-
 };
 
 
-////////////////////////////////////////////////////////////////////////////////
-// StorageContainer
-////////////////////////////////////////////////////////////////////////////////
-
 template<>
 struct TypeHandler<StorageContainer> {
 
@@ -844,27 +953,16 @@ struct TypeHandler<StorageContainer> {
     deserialize(
         std::istream& stream
     ) {
+        // Nested containers have no magic number, so they are read as
+        // version 1
         StorageContainer value;
         stream >> value;
         return value;
     }
 
-
-    static void
-    serialize(
-        std::ostream& stream,
-        const StorageContainer& value
-    ) {
-        stream << value;
-    }
-
 };
 
 
-////////////////////////////////////////////////////////////////////////////////
-// StorageList
-////////////////////////////////////////////////////////////////////////////////
-
 template<>
 struct TypeHandler<StorageList> {
 
@@ -881,39 +979,6 @@ struct TypeHandler<StorageList> {
         return list;
     }
 
-
-    static void
-    serialize(
-        std::ostream& stream,
-        const StorageList& list
-    ) {
-        uint64_t size = list.size();
-        TypeHandler<uint64_t>::serialize(stream, size);
-        for (const auto& storageContainer : list) {
-            TypeHandler<StorageContainer>::serialize(stream, storageContainer);
-        }
-    }
-
-};
-
-
-struct SerializationVisitor : public boost::static_visitor<> {
-
-    SerializationVisitor(
-        std::ostream& stream
-    ) : m_stream(stream)
-    {
-    }
-
-    template<typename T>
-    void
-    operator () (
-        const T& value
-    ) const {
-        TypeHandler<T>::serialize(m_stream, value);
-    }
-
-    std::ostream& m_stream;
 };
 
 #define DESERIALIZE_CASE(typeName) \
@@ -956,19 +1021,695 @@ deserialize(
 
 } // namespace
 
+
+////////////////////////////////////////////////////////////////////////////////
+// Version 2 and 3
+//
+// Integers are stored as variable length integers (7 bits per byte, signed
+// ones zigzag encoded), floats as their IEEE 754 bytes in little endian
+// order.
+//
+// Version 3 continues with a table of all keys and strings in the stream,
+// which are referred to by their index afterwards. Every container is
+// prefixed with its size in bytes as a little endian uint32_t, so that it
+// can be skipped and decoded only when it is accessed.
+//
+// In version 2, strings are written on first use: a reference of 0 is
+// followed by a new string, any other reference is the 1-based index of an
+// earlier one. Containers have no size and are decoded right away.
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// The unsigned integer a float's bytes are converted through, so that they
+// are written in the same order on every platform
+template<typename T>
+struct RawBits;
+
+template<>
+struct RawBits<float> {
+
+    static_assert(sizeof(float) == sizeof(uint32_t), "Float must be 32 bits");
+
+    using Type = uint32_t;
+
+};
+
+template<>
+struct RawBits<double> {
+
+    static_assert(sizeof(double) == sizeof(uint64_t), "Double must be 64 bits");
+
+    using Type = uint64_t;
+
+};
+
+
+void
+appendVarint(
+    std::string& buffer,
+    uint64_t value
+) {
+    char bytes[10];
+    size_t size = 0;
+    while (value >= 0x80) {
+        bytes[size++] = static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    bytes[size++] = static_cast<char>(value);
+    buffer.append(bytes, size);
+}
+
+} // namespace
+
+#define READ_CASE(typeName) \
+    case TypeInfo<typeName>::Id: \
+        return this->readStored<TypeInfo<typeName>::StoredType>()
+
+struct StorageContainer::Reader {
+
+    Reader(
+        std::shared_ptr<const EncodedSource> source,
+        const char* begin,
+        const char* end,
+        uint64_t version
+    ) : m_end(end),
+        m_position(begin),
+        m_source(std::move(source)),
+        m_version(version)
+    {
+    }
+
+    static void
+    readStream(
+        std::shared_ptr<EncodedSource> source,
+        const char* begin,
+        const char* end,
+        StorageContainer& storage
+    ) {
+        Reader reader(source, begin, end, 0);
+        reader.m_version = reader.readVarint();
+        if (reader.m_version < 2 or reader.m_version > FORMAT_VERSION) {
+            throw std::runtime_error(
+                "Unsupported savegame version: " + std::to_string(reader.m_version)
+            );
+        }
+        if (reader.m_version >= 3) {
+            reader.readStringTable(source->strings);
+            source->keys.reset(
+                new std::atomic<const std::string*>[source->strings.size()]()
+            );
+        }
+        reader.read(storage);
+    }
+
+    void
+    read(
+        bool& value
+    ) {
+        value = this->readByte() != 0;
+    }
+
+    void
+    read(
+        char& value
+    ) {
+        value = static_cast<char>(this->readByte());
+    }
+
+    void
+    read(
+        int8_t& value
+    ) {
+        value = static_cast<int8_t>(this->readByte());
+    }
+
+    void
+    read(
+        int16_t& value
+    ) {
+        value = static_cast<int16_t>(this->readSigned());
+    }
+
+    void
+    read(
+        int32_t& value
+    ) {
+        value = static_cast<int32_t>(this->readSigned());
+    }
+
+    void
+    read(
+        int64_t& value
+    ) {
+        value = this->readSigned();
+    }
+
+    void
+    read(
+        uint8_t& value
+    ) {
+        value = this->readByte();
+    }
+
+    void
+    read(
+        uint16_t& value
+    ) {
+        value = static_cast<uint16_t>(this->readVarint());
+    }
+
+    void
+    read(
+        uint32_t& value
+    ) {
+        value = static_cast<uint32_t>(this->readVarint());
+    }
+
+    void
+    read(
+        uint64_t& value
+    ) {
+        value = this->readVarint();
+    }
+
+    void
+    read(
+        float& value
+    ) {
+        this->readRaw(value);
+    }
+
+    void
+    read(
+        double& value
+    ) {
+        this->readRaw(value);
+    }
+
+    void
+    read(
+        std::string& value
+    ) {
+        value = this->readString();
+    }
+
+    void
+    read(
+        StorageContainer& storage
+    ) {
+        Implementation& impl = *storage.m_impl;
+        impl.clear();
+        if (m_version < 3) {
+            this->readEntries(impl.m_content);
+            return;
+        }
+        uint32_t size = this->readSize();
+        impl.m_source = m_source;
+        impl.m_encodedBegin = m_position;
+        impl.m_encodedEnd = m_position + size;
+        m_position += size;
+    }
+
+    void
+    read(
+        StorageList& list
+    ) {
+        uint64_t size = this->readVarint();
+        list.clear();
+        for (uint64_t i = 0; i < size; ++i) {
+            list.emplace_back();
+            this->read(list.back());
+        }
+    }
+
+    uint8_t
+    readByte() {
+        this->require(1);
+        return static_cast<uint8_t>(*m_position++);
+    }
+
+    void
+    readEntries(
+        Implementation::Content& content
+    ) {
+        uint64_t size = this->readVarint();
+        // Every entry takes at least two bytes, don't trust larger sizes
+        content.reserve(std::min<uint64_t>(size, (m_end - m_position) / 2));
+        for (uint64_t i = 0; i < size; ++i) {
+            const std::string* key = this->readKey();
+            TypeId typeId = static_cast<TypeId>(this->readVarint());
+            content.push_back(Entry{
+                key,
+                typeId,
+                this->readValue(typeId)
+            });
+        }
+    }
+
+    const std::string*
+    readKey() {
+        if (m_version < 3) {
+            return internKey(this->readString());
+        }
+        uint64_t reference = this->readVarint();
+        if (reference >= m_source->strings.size()) {
+            throw std::runtime_error("Invalid string reference in savegame");
+        }
+        // Containers sharing a source may be decoded on different threads.
+        // Racing threads intern the same key, so either result is fine.
+        std::atomic<const std::string*>& key = m_source->keys[reference];
+        const std::string* interned = key.load(std::memory_order_relaxed);
+        if (not interned) {
+            interned = internKey(m_source->strings[reference]);
+            key.store(interned, std::memory_order_relaxed);
+        }
+        return interned;
+    }
+
+    template<typename T>
+    void
+    readRaw(
+        T& value
+    ) {
+        using Bits = typename RawBits<T>::Type;
+        this->require(sizeof(T));
+        Bits bits = 0;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            bits |= Bits(static_cast<uint8_t>(m_position[i])) << (8 * i);
+        }
+        std::memcpy(&value, &bits, sizeof(T));
+        m_position += sizeof(T);
+    }
+
+    int64_t
+    readSigned() {
+        uint64_t encoded = this->readVarint();
+        return static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+    }
+
+    uint32_t
+    readSize() {
+        uint32_t size = 0;
+        for (unsigned int shift = 0; shift < 32; shift += 8) {
+            size |= uint32_t(this->readByte()) << shift;
+        }
+        this->require(size);
+        return size;
+    }
+
+    const std::string&
+    readString() {
+        uint64_t reference = this->readVarint();
+        if (m_version >= 3) {
+            if (reference >= m_source->strings.size()) {
+                throw std::runtime_error("Invalid string reference in savegame");
+            }
+            return m_source->strings[reference];
+        }
+        if (reference == 0) {
+            uint64_t size = this->readVarint();
+            this->require(size);
+            m_strings.emplace_back(m_position, size);
+            m_position += size;
+            return m_strings.back();
+        }
+        if (reference > m_strings.size()) {
+            throw std::runtime_error("Invalid string reference in savegame");
+        }
+        return m_strings[reference - 1];
+    }
+
+    void
+    readStringTable(
+        std::vector<std::string>& strings
+    ) {
+        uint64_t count = this->readVarint();
+        // Every string takes at least one byte, don't trust larger counts
+        strings.reserve(std::min<uint64_t>(count, m_end - m_position));
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t size = this->readVarint();
+            this->require(size);
+            strings.emplace_back(m_position, size);
+            m_position += size;
+        }
+    }
+
+    template<typename T>
+    T
+    readStored() {
+        T value;
+        this->read(value);
+        return value;
+    }
+
+    Variant
+    readValue(
+        TypeId typeId
+    ) {
+        switch (typeId) {
+            READ_CASE(bool);
+            READ_CASE(char);
+            READ_CASE(int8_t);
+            READ_CASE(int16_t);
+            READ_CASE(int32_t);
+            READ_CASE(int64_t);
+            READ_CASE(uint8_t);
+            READ_CASE(uint16_t);
+            READ_CASE(uint32_t);
+            READ_CASE(uint64_t);
+            READ_CASE(float);
+            READ_CASE(double);
+            READ_CASE(std::string);
+            READ_CASE(StorageContainer);
+            READ_CASE(StorageList);
+            // Compound types
+            READ_CASE(Ogre::Degree);
+            READ_CASE(Ogre::Plane);
+            READ_CASE(Ogre::Vector3);
+            READ_CASE(Ogre::Quaternion);
+            READ_CASE(Ogre::ColourValue);
+            default:
+                throw std::runtime_error(
+                    "Unknown type id in savegame: " + std::to_string(typeId)
+                );
+        }
+    }
+
+    uint64_t
+    readVarint() {
+        uint64_t value = 0;
+        for (unsigned int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = this->readByte();
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (not (byte & 0x80)) {
+                return value;
+            }
+        }
+        throw std::runtime_error("Invalid integer in savegame");
+    }
+
+    void
+    require(
+        uint64_t size
+    ) const {
+        if (size > uint64_t(m_end - m_position)) {
+            throw std::runtime_error("Unexpected end of savegame");
+        }
+    }
+
+    const char* m_end;
+
+    const char* m_position;
+
+    std::shared_ptr<const EncodedSource> m_source;
+
+    // Only used by version 2
+    std::vector<std::string> m_strings;
+
+    uint64_t m_version;
+
+};
+
+
+void
+StorageContainer::Implementation::decode() const {
+    // Released first, so that content() doesn't decode again
+    std::shared_ptr<const EncodedSource> source = std::move(m_source);
+    StorageContainer::Reader reader(
+        source,
+        m_encodedBegin,
+        m_encodedEnd,
+        FORMAT_VERSION
+    );
+    m_encodedBegin = nullptr;
+    m_encodedEnd = nullptr;
+    m_content.clear();
+    reader.readEntries(m_content);
+}
+
+
+struct StorageContainer::Writer : public boost::static_visitor<> {
+
+    template<typename T>
+    void
+    operator () (
+        const T& value
+    ) {
+        this->write(value);
+    }
+
+    void
+    finish(
+        std::ostream& stream
+    ) {
+        std::string header(MAGIC_NUMBER.begin(), MAGIC_NUMBER.end());
+        appendVarint(header, FORMAT_VERSION);
+        appendVarint(header, m_strings.size());
+        for (const std::string* string : m_strings) {
+            appendVarint(header, string->size());
+            header.append(*string);
+        }
+        stream.write(header.data(), header.size());
+        stream.write(m_buffer.data(), m_buffer.size());
+    }
+
+    void
+    write(
+        bool value
+    ) {
+        m_buffer.push_back(value ? 1 : 0);
+    }
+
+    void
+    write(
+        char value
+    ) {
+        m_buffer.push_back(value);
+    }
+
+    void
+    write(
+        int8_t value
+    ) {
+        m_buffer.push_back(static_cast<char>(value));
+    }
+
+    void
+    write(
+        int16_t value
+    ) {
+        this->writeSigned(value);
+    }
+
+    void
+    write(
+        int32_t value
+    ) {
+        this->writeSigned(value);
+    }
+
+    void
+    write(
+        int64_t value
+    ) {
+        this->writeSigned(value);
+    }
+
+    void
+    write(
+        uint8_t value
+    ) {
+        m_buffer.push_back(static_cast<char>(value));
+    }
+
+    void
+    write(
+        uint16_t value
+    ) {
+        appendVarint(m_buffer, value);
+    }
+
+    void
+    write(
+        uint32_t value
+    ) {
+        appendVarint(m_buffer, value);
+    }
+
+    void
+    write(
+        uint64_t value
+    ) {
+        appendVarint(m_buffer, value);
+    }
+
+    void
+    write(
+        float value
+    ) {
+        this->writeRaw(value);
+    }
+
+    void
+    write(
+        double value
+    ) {
+        this->writeRaw(value);
+    }
+
+    void
+    write(
+        const std::string& value
+    ) {
+        this->writeString(value);
+    }
+
+    void
+    write(
+        const StorageContainer& storage
+    ) {
+        const auto& content = storage.m_impl->content();
+        // The size is filled in when it is known
+        size_t sizeOffset = m_buffer.size();
+        m_buffer.append(4, '\0');
+        appendVarint(m_buffer, content.size());
+        for (const Entry& entry : content) {
+            this->writeKey(entry.key);
+            appendVarint(m_buffer, entry.typeId);
+            boost::apply_visitor(*this, entry.value);
+        }
+        uint64_t size = m_buffer.size() - sizeOffset - 4;
+        if (size > UINT32_MAX) {
+            throw std::runtime_error("Container too large for savegame");
+        }
+        for (unsigned int i = 0; i < 4; ++i) {
+            m_buffer[sizeOffset + i] = static_cast<char>(size >> (8 * i));
+        }
+    }
+
+    void
+    write(
+        const StorageList& list
+    ) {
+        appendVarint(m_buffer, list.size());
+        for (const StorageContainer& element : list) {
+            this->write(element);
+        }
+    }
+
+    void
+    writeKey(
+        const std::string* key
+    ) {
+        // Interned keys are found by address, without hashing the string
+        auto iter = m_keyIndices.find(key);
+        if (iter != m_keyIndices.end()) {
+            appendVarint(m_buffer, iter->second);
+            return;
+        }
+        uint64_t index = this->writeString(*key);
+        m_keyIndices.emplace(key, index);
+    }
+
+    template<typename T>
+    void
+    writeRaw(
+        T value
+    ) {
+        using Bits = typename RawBits<T>::Type;
+        Bits bits;
+        std::memcpy(&bits, &value, sizeof(T));
+        char bytes[sizeof(T)];
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            bytes[i] = static_cast<char>(bits >> (8 * i));
+        }
+        m_buffer.append(bytes, sizeof(T));
+    }
+
+    void
+    writeSigned(
+        int64_t value
+    ) {
+        // Zigzag encoding, so that small negative numbers stay short
+        appendVarint(
+            m_buffer,
+            (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63)
+        );
+    }
+
+    uint64_t
+    writeString(
+        const std::string& string
+    ) {
+        auto inserted = m_stringIndices.emplace(string, m_strings.size());
+        if (inserted.second) {
+            m_strings.push_back(&inserted.first->first);
+        }
+        appendVarint(m_buffer, inserted.first->second);
+        return inserted.first->second;
+    }
+
+    std::string m_buffer;
+
+    std::unordered_map<const std::string*, uint64_t> m_keyIndices;
+
+    std::unordered_map<std::string, uint64_t> m_stringIndices;
+
+    // Points into m_stringIndices, in order of their index
+    std::vector<const std::string*> m_strings;
+
+};
+
+
+StorageContainer
+StorageContainer::readFile(
+    const std::string& filename
+) {
+    namespace interprocess = boost::interprocess;
+    auto source = std::make_shared<EncodedSource>();
+    interprocess::file_mapping file(filename.c_str(), interprocess::read_only);
+    interprocess::mapped_region region(file, interprocess::read_only);
+    source->file.swap(file);
+    source->region.swap(region);
+    const char* begin = static_cast<const char*>(source->region.get_address());
+    const char* end = begin + source->region.get_size();
+    bool compressed = isCompressed(begin, end - begin);
+    if (compressed) {
+        source->buffer = decompress(begin, end - begin, ThreadPool::shared());
+        // Decoding only needs the decompressed data
+        interprocess::mapped_region().swap(source->region);
+        interprocess::file_mapping().swap(source->file);
+        begin = source->buffer.data();
+        end = begin + source->buffer.size();
+    }
+    StorageContainer storage;
+    if (
+        size_t(end - begin) >= MAGIC_NUMBER.size() and
+        std::equal(MAGIC_NUMBER.begin(), MAGIC_NUMBER.end(), begin)
+    ) {
+        Reader::readStream(source, begin + MAGIC_NUMBER.size(), end, storage);
+    }
+    else if (compressed) {
+        throw std::runtime_error("Compressed data is not a savegame");
+    }
+    else {
+        std::ifstream stream(filename, std::ifstream::binary);
+        stream.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        stream >> storage;
+    }
+    return storage;
+}
+
+
 std::ostream&
 thrive::operator << (
     std::ostream& stream,
     const StorageContainer& storage
 ) {
-    SerializationVisitor visitor(stream);
-    const auto& content = storage.m_impl->m_content;
-    TypeHandler<uint64_t>::serialize(stream, content.size());
-    for (const auto& pair : content) {
-        TypeHandler<std::string>::serialize(stream, pair.first);    
-        TypeHandler<TypeId>::serialize(stream, pair.second.typeId);    
-        boost::apply_visitor(visitor, pair.second.value);
-    }
+    StorageContainer::Writer writer;
+    writer.write(storage);
+    writer.finish(stream);
     return stream;
 }
 
@@ -978,20 +1719,67 @@ thrive::operator >> (
     std::istream& stream,
     StorageContainer& storage
 ) {
-    uint64_t size = TypeHandler<uint64_t>::deserialize(stream);
-    storage.m_impl->m_content.clear();
-    for (size_t i = 0; i < size; ++i) {
-        std::string key = TypeHandler<std::string>::deserialize(stream);
-        TypeId typeId = TypeHandler<TypeId>::deserialize(stream);
-        storage.m_impl->m_content[key] = StoredValue {
-            typeId,
-            deserialize(typeId, stream)
-        };
+    std::array<char, 8> header;
+    stream.read(header.data(), header.size());
+    if (stream.fail()) {
+        throw std::runtime_error("Unexpected end of savegame");
+    }
+    if (header == MAGIC_NUMBER) {
+        auto source = std::make_shared<EncodedSource>();
+        source->buffer.assign(
+            std::istreambuf_iterator<char>(stream),
+            std::istreambuf_iterator<char>()
+        );
+        const char* begin = source->buffer.data();
+        StorageContainer::Reader::readStream(
+            source,
+            begin,
+            begin + source->buffer.size(),
+            storage
+        );
+    }
+    else if (isCompressed(header.data(), header.size())) {
+        std::string compressed(header.begin(), header.end());
+        compressed.append(
+            std::istreambuf_iterator<char>(stream),
+            std::istreambuf_iterator<char>()
+        );
+        auto source = std::make_shared<EncodedSource>();
+        source->buffer = decompress(
+            compressed.data(),
+            compressed.size(),
+            ThreadPool::shared()
+        );
+        const char* begin = source->buffer.data();
+        const char* end = begin + source->buffer.size();
+        if (
+            size_t(end - begin) < MAGIC_NUMBER.size() or
+            not std::equal(MAGIC_NUMBER.begin(), MAGIC_NUMBER.end(), begin)
+        ) {
+            throw std::runtime_error("Compressed data is not a savegame");
+        }
+        StorageContainer::Reader::readStream(
+            source,
+            begin + MAGIC_NUMBER.size(),
+            end,
+            storage
+        );
+    }
+    else {
+        uint64_t size = 0;
+        static_assert(sizeof(size) == sizeof(header), "Header must fit version 1 size");
+        std::memcpy(&size, header.data(), sizeof(size));
+        StorageContainer::Implementation& impl = *storage.m_impl;
+        impl.clear();
+        for (size_t i = 0; i < size; ++i) {
+            std::string key = TypeHandler<std::string>::deserialize(stream);
+            TypeId typeId = TypeHandler<TypeId>::deserialize(stream);
+            impl.m_content.push_back(Entry{
+                internKey(key),
+                typeId,
+                deserialize(typeId, stream)
+            });
+        }
     }
     return stream;
 }
-
-
-
-
-
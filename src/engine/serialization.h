@@ -32,6 +32,11 @@ namespace thrive {
 
 /**
 * @brief A key-value storage for serialization
+*
+* Entries are kept in a flat array with room for a few of them inline, and
+* keys are interned, so building a small container allocates little. Move
+* values in with set() or build nested containers in place with emplace()
+* to avoid copying them.
 */
 class StorageContainer {
 
@@ -48,6 +53,31 @@ public:
     static luabind::scope
     luaBindings();
 
+    /**
+    * @brief Reads a container from a file
+    *
+    * The file is memory mapped. Nested containers are only decoded when
+    * they are first accessed, so parts of the file that are never
+    * accessed cost neither time nor memory. The mapping is released when
+    * the last container referring to it has been decoded or destroyed.
+    *
+    * Older formats without support for this are read completely.
+    * Compressed files (see thrive::compress()) are decompressed into
+    * memory first.
+    *
+    * @param filename
+    *   The file to read
+    *
+    * @return The file's root container
+    *
+    * @throws std::exception
+    *   If the file can't be opened or is corrupt
+    */
+    static StorageContainer
+    readFile(
+        const std::string& filename
+    );
+
     /**
     * @brief Constructor
     */
@@ -69,7 +99,7 @@ public:
     */
     StorageContainer(
         StorageContainer&& other
-    );
+    ) noexcept;
 
     /**
     * @brief Destructor
@@ -96,7 +126,7 @@ public:
     StorageContainer&
     operator = (
         StorageContainer&& other
-    );
+    ) noexcept;
 
     /**
     * @brief Checks for a key
@@ -129,6 +159,27 @@ public:
         const std::string& key
     ) const;
 
+    /**
+    * @brief Constructs an empty value in place
+    *
+    * Only available for StorageContainer and StorageList. If \a key is
+    * already associated with a value, it is overwritten.
+    *
+    * @tparam T
+    *   The value's type
+    * @param key
+    *   The key to associate with the value
+    *
+    * @return
+    *   The new value. Only valid until the next value is set in this
+    *   container.
+    */
+    template<typename T>
+    T&
+    emplace(
+        const std::string& key
+    );
+
     /**
     * @brief Retrieves a value from the container
     *
@@ -207,11 +258,22 @@ private:
 
     struct Implementation;
     std::unique_ptr<Implementation> m_impl;
+
+    // Binary format, see operator<<()
+    struct Reader;
+    struct Writer;
+
 };
 
 /**
 * @brief Output stream operator for StorageContainer
 *
+* Writes version 3 of the binary format: A magic number and the version,
+* a table of all keys and strings, followed by the container. Numbers are
+* written as raw IEEE floats or as variable length integers. Every nested
+* container is prefixed with its size, so readers can skip it until it is
+* needed.
+*
 * @param stream
 * @param storage
 *
@@ -226,10 +288,22 @@ operator << (
 /**
 * @brief Input stream operator for StorageContainer
 *
+* Reads the current format as well as version 2 and version 1, which has
+* no header and stores numbers as text.
+*
+* Compressed streams (see thrive::compress()) are decompressed first.
+*
+* For the current format, the rest of the stream is read into memory and
+* nested containers are decoded when they are first accessed. Prefer
+* StorageContainer::readFile() for files.
+*
 * @param stream
 * @param storage
 *
 * @return 
+*
+* @throws std::runtime_error
+*   If the stream has an unknown version or is corrupt
 */
 std::istream&
 operator >> (
@@ -278,7 +352,7 @@ public:
     */
     StorageList(
         StorageList&& other
-    );
+    ) noexcept;
 
     /**
     * @brief Copy assignment
@@ -300,19 +374,30 @@ public:
     StorageList&
     operator = (
         StorageList&& other
-    );
+    ) noexcept;
 
     /**
     * @brief Appends a StorageContainer to this list
     *
+    * Takes an rvalue so that copies are explicit. Lua's version copies.
+    *
     * @param element
     *   The container to append
     */
     void
     append(
-        StorageContainer element
+        StorageContainer&& element
     );
 
+    /**
+    * @brief Appends an empty StorageContainer to fill in place
+    *
+    * @return
+    *   The new element. Only valid until the next element is appended.
+    */
+    StorageContainer&
+    emplace();
+
     /**
     * @brief Retrieves an element by index
     *
@@ -381,4 +466,16 @@ STORABLE_TYPE(Ogre::Plane)
 STORABLE_TYPE(Ogre::Vector3)
 STORABLE_TYPE(Ogre::Quaternion)
 STORABLE_TYPE(Ogre::ColourValue)
+
+template<>
+StorageContainer&
+StorageContainer::emplace<StorageContainer>(
+    const std::string& key
+);
+
+template<>
+StorageList&
+StorageContainer::emplace<StorageList>(
+    const std::string& key
+);
 }
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "engine/typedefs.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace thrive {
+
+/**
+* @brief Maps entity slot indices to positions in a dense array
+*
+* The index is split into pages that are only allocated when an entity in
+* their range is inserted, so sparse ids don't cost a full-sized array.
+* Lookup is two array accesses.
+*
+* Only the slot index part of an entity id (see entityIndex()) is used as
+* key. Containers using this index should store the full entity id next to
+* their dense data and compare it to detect stale ids.
+*/
+class SparseIndex {
+
+public:
+
+    /**
+    * @brief Returned by get() for unknown entities
+    */
+    static const uint32_t NONE = 0xFFFFFFFF;
+
+    /**
+    * @brief Number of entries per page
+    */
+    static const size_t PAGE_SIZE = 4096;
+
+    /**
+    * @brief Constructor
+    */
+    SparseIndex() = default;
+
+    /**
+    * @brief Copy constructor
+    */
+    SparseIndex(
+        const SparseIndex& other
+    ) {
+        *this = other;
+    }
+
+    /**
+    * @brief Move constructor
+    */
+    SparseIndex(
+        SparseIndex&& other
+    ) = default;
+
+    /**
+    * @brief Copy assignment, copies all allocated pages
+    */
+    SparseIndex&
+    operator= (
+        const SparseIndex& other
+    ) {
+        if (this == &other) {
+            return *this;
+        }
+        m_pages.clear();
+        m_pages.resize(other.m_pages.size());
+        for (size_t i = 0; i < other.m_pages.size(); ++i) {
+            if (other.m_pages[i]) {
+                m_pages[i].reset(new uint32_t[PAGE_SIZE]);
+                std::copy(
+                    other.m_pages[i].get(),
+                    other.m_pages[i].get() + PAGE_SIZE,
+                    m_pages[i].get()
+                );
+            }
+        }
+        return *this;
+    }
+
+    /**
+    * @brief Move assignment
+    */
+    SparseIndex&
+    operator= (
+        SparseIndex&& other
+    ) = default;
+
+    /**
+    * @brief Removes all entries and releases all pages
+    */
+    void
+    clear() {
+        m_pages.clear();
+    }
+
+    /**
+    * @brief Removes an entry
+    *
+    * @param entityId
+    *   The entity to remove. Does nothing if there is no entry.
+    */
+    void
+    erase(
+        EntityId entityId
+    ) {
+        uint32_t index = entityIndex(entityId);
+        size_t pageIndex = index / PAGE_SIZE;
+        if (pageIndex < m_pages.size() and m_pages[pageIndex]) {
+            m_pages[pageIndex][index % PAGE_SIZE] = NONE;
+        }
+    }
+
+    /**
+    * @brief Looks up an entry
+    *
+    * @param entityId
+    *   The entity to look up
+    *
+    * @return
+    *   The position stored for the entity's slot index or NONE
+    */
+    uint32_t
+    get(
+        EntityId entityId
+    ) const {
+        uint32_t index = entityIndex(entityId);
+        size_t pageIndex = index / PAGE_SIZE;
+        if (pageIndex >= m_pages.size() or not m_pages[pageIndex]) {
+            return NONE;
+        }
+        return m_pages[pageIndex][index % PAGE_SIZE];
+    }
+
+    /**
+    * @brief The memory used by the index in bytes
+    */
+    size_t
+    memoryUsage() const {
+        size_t pageCount = std::count_if(
+            m_pages.begin(),
+            m_pages.end(),
+            [] (const std::unique_ptr<uint32_t[]>& page) {
+                return bool(page);
+            }
+        );
+        return m_pages.capacity() * sizeof(m_pages[0]) + pageCount * PAGE_SIZE * sizeof(uint32_t);
+    }
+
+    /**
+    * @brief Sets an entry
+    *
+    * @param entityId
+    *   The entity to set the position for
+    * @param position
+    *   The entity's position in the dense array
+    */
+    void
+    set(
+        EntityId entityId,
+        uint32_t position
+    ) {
+        uint32_t index = entityIndex(entityId);
+        size_t pageIndex = index / PAGE_SIZE;
+        if (pageIndex >= m_pages.size()) {
+            m_pages.resize(pageIndex + 1);
+        }
+        std::unique_ptr<uint32_t[]>& page = m_pages[pageIndex];
+        if (not page) {
+            page.reset(new uint32_t[PAGE_SIZE]);
+            std::fill(page.get(), page.get() + PAGE_SIZE, uint32_t(NONE));
+        }
+        page[index % PAGE_SIZE] = position;
+    }
+
+private:
+
+    std::vector<std::unique_ptr<uint32_t[]>> m_pages;
+
+};
+
+}
@@ -4,7 +4,9 @@
 #include "engine/game_state.h"
 #include "scripting/luabind.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <luabind/iterator_policy.hpp>
 
 using namespace thrive;
 
@@ -62,6 +64,35 @@ struct SystemWrapper : System, luabind::wrap_base {
 */
 
 
+static std::vector<ComponentTypeId>
+componentTypeIds(
+    luabind::object componentTypes
+) {
+    if (luabind::type(componentTypes) != LUA_TTABLE) {
+        throw std::runtime_error("System:setComponentAccess expects lists (tables) of component types");
+    }
+    std::vector<ComponentTypeId> typeIds;
+    for (luabind::iterator iter(componentTypes), end; iter != end; ++iter) {
+        luabind::object typeId = (*iter)["TYPE_ID"];
+        typeIds.push_back(luabind::object_cast<ComponentTypeId>(typeId));
+    }
+    return typeIds;
+}
+
+
+static void
+System_setComponentAccess(
+    System* self,
+    luabind::object reads,
+    luabind::object writes
+) {
+    self->setComponentAccess(
+        componentTypeIds(reads),
+        componentTypeIds(writes)
+    );
+}
+
+
 luabind::scope
 System::luaBindings() {
     using namespace luabind;
@@ -69,6 +100,7 @@ System::luaBindings() {
         .def(constructor<>())
         .def("enabled", &System::enabled)
         .def("init", &System::init, &SystemWrapper::default_init)
+        .def("setComponentAccess", &System_setComponentAccess)
         .def("setEnabled", &System::setEnabled)
         .def("shutdown", &System::shutdown, &SystemWrapper::default_shutdown)
         .def("update", &System::update, &SystemWrapper::default_update)
@@ -78,10 +110,22 @@ System::luaBindings() {
 
 struct System::Implementation {
 
+    std::vector<ComponentTypeId> m_componentReads;
+
+    std::vector<ComponentTypeId> m_componentWrites;
+
     bool m_enabled = true;
 
     GameState* m_gameState = nullptr;
 
+    bool m_hasComponentAccess = false;
+
+    std::string m_name;
+
+    Phase m_phase = Phase::Simulation;
+
+    bool m_requiresMainThread = true;
+
 };
 
 
@@ -106,6 +150,18 @@ System::deactivate() {
 }
 
 
+const std::vector<ComponentTypeId>&
+System::componentReads() const {
+    return m_impl->m_componentReads;
+}
+
+
+const std::vector<ComponentTypeId>&
+System::componentWrites() const {
+    return m_impl->m_componentWrites;
+}
+
+
 bool
 System::enabled() const {
     return m_impl->m_enabled;
@@ -140,6 +196,12 @@ System::gameState() const {
 }
 
 
+bool
+System::hasComponentAccess() const {
+    return m_impl->m_hasComponentAccess;
+}
+
+
 void
 System::init(
     GameState* gameState
@@ -149,6 +211,38 @@ System::init(
 }
 
 
+const std::string&
+System::name() const {
+    return m_impl->m_name;
+}
+
+
+System::Phase
+System::phase() const {
+    return m_impl->m_phase;
+}
+
+
+bool
+System::requiresMainThread() const {
+    return m_impl->m_requiresMainThread;
+}
+
+
+void
+System::setComponentAccess(
+    std::vector<ComponentTypeId> reads,
+    std::vector<ComponentTypeId> writes
+) {
+    // Sorted for the scheduler's conflict test
+    std::sort(reads.begin(), reads.end());
+    std::sort(writes.begin(), writes.end());
+    m_impl->m_componentReads = std::move(reads);
+    m_impl->m_componentWrites = std::move(writes);
+    m_impl->m_hasComponentAccess = true;
+}
+
+
 void
 System::setEnabled(
     bool enabled
@@ -157,6 +251,30 @@ System::setEnabled(
 }
 
 
+void
+System::setName(
+    std::string name
+) {
+    m_impl->m_name = std::move(name);
+}
+
+
+void
+System::setPhase(
+    Phase phase
+) {
+    m_impl->m_phase = phase;
+}
+
+
+void
+System::setRequiresMainThread(
+    bool requiresMainThread
+) {
+    m_impl->m_requiresMainThread = requiresMainThread;
+}
+
+
 
 void
 System::shutdown() {
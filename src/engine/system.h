@@ -1,6 +1,10 @@
 #pragma once
 
+#include "engine/typedefs.h"
+
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace luabind {
 class scope;
@@ -18,17 +22,44 @@ class GameState;
 * Systems can operate on entities and their components, but they can also 
 * handle tasks that don't require components at all, such as issuing a render
 * call to the graphics engine.
+*
+* By default, a system is updated on the main thread, after all systems
+* before it and before all systems after it. A system that declares which
+* component types it reads and writes with setComponentAccess() may run
+* concurrently with neighbouring systems it doesn't conflict with. See
+* SystemScheduler.
 */
 class System {
 
 public:
 
+    /**
+    * @brief When a system is updated within a frame
+    */
+    enum class Phase {
+
+        /**
+        * @brief Updated once per simulation tick with the fixed tick
+        *   duration
+        */
+        Simulation,
+
+        /**
+        * @brief Updated once per rendered frame, after all simulation ticks
+        *   of the frame, with the frame's duration
+        */
+        Render
+
+    };
+
     /**
     * @brief Lua bindings
     *
     * Exposes:
     * - System::active
     * - System::setActive
+    * - \c setComponentAccess(reads, writes): Takes two lists (tables) of
+    *   component classes
     *
     * @return 
     */
@@ -54,6 +85,22 @@ public:
     virtual void
     activate();
 
+    /**
+    * @brief The component types this system reads
+    *
+    * @see setComponentAccess()
+    */
+    const std::vector<ComponentTypeId>&
+    componentReads() const;
+
+    /**
+    * @brief The component types this system writes
+    *
+    * @see setComponentAccess()
+    */
+    const std::vector<ComponentTypeId>&
+    componentWrites() const;
+
     /**
     * @brief Called by GameState::deactivate()
     *
@@ -100,6 +147,15 @@ public:
     GameState*
     gameState() const;
 
+    /**
+    * @brief Whether the system has declared its component access
+    *
+    * Systems without a declaration never run concurrently with other
+    * systems.
+    */
+    bool
+    hasComponentAccess() const;
+
     /**
     * @brief Initializes the system
     *
@@ -113,6 +169,56 @@ public:
         GameState* gameState
     );
 
+    /**
+    * @brief The system's name
+    *
+    * Used to label the system in profiles. Systems created from Lua are
+    * named after their class.
+    */
+    const std::string&
+    name() const;
+
+    /**
+    * @brief The phase this system is updated in
+    *
+    * Defaults to Phase::Simulation.
+    */
+    Phase
+    phase() const;
+
+    /**
+    * @brief Whether this system must be updated on the main thread
+    *
+    * Defaults to \c true. Systems implemented in Lua always run on the main
+    * thread.
+    */
+    bool
+    requiresMainThread() const;
+
+    /**
+    * @brief Declares the component types this system accesses
+    *
+    * Two systems conflict if one of them writes a component type the other
+    * reads or writes. Systems that don't conflict may be updated at the same
+    * time. Component types that are written need not be listed as read.
+    *
+    * By declaring its access, a system also promises not to touch any other
+    * shared state and to make no structural changes during update() except
+    * through EntityManager::removeComponent(),
+    * EntityManager::removeEntity() or the game state's EntityCommandBuffer
+    * (except for creating entities). Those are safe to call concurrently.
+    *
+    * @param reads
+    *   The component types read
+    * @param writes
+    *   The component types written
+    */
+    void
+    setComponentAccess(
+        std::vector<ComponentTypeId> reads,
+        std::vector<ComponentTypeId> writes
+    );
+
     /**
     * @brief Sets the enabled status of this system
     *
@@ -125,6 +231,44 @@ public:
         bool enabled
     );
 
+    /**
+    * @brief Sets the system's name
+    *
+    * @param name
+    */
+    void
+    setName(
+        std::string name
+    );
+
+    /**
+    * @brief Sets the phase this system is updated in
+    *
+    * Systems that only present the simulation's state, like those
+    * talking to Ogre, should use Phase::Render. Set this in the constructor
+    * or in init() at the latest.
+    *
+    * @param phase
+    */
+    void
+    setPhase(
+        Phase phase
+    );
+
+    /**
+    * @brief Sets whether the system must be updated on the main thread
+    *
+    * Only systems that have declared their component access can run on
+    * other threads. Systems that use Ogre or Lua must stay on the main
+    * thread.
+    *
+    * @param requiresMainThread
+    */
+    void
+    setRequiresMainThread(
+        bool requiresMainThread
+    );
+
     /**
     * @brief Shuts the system down
     *
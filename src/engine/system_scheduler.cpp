@@ -0,0 +1,171 @@
+#include "engine/system_scheduler.h"
+
+#include "engine/profiler.h"
+#include "engine/system.h"
+#include "engine/thread_pool.h"
+
+#include <algorithm>
+
+using namespace thrive;
+
+namespace {
+
+bool
+intersects(
+    const std::vector<ComponentTypeId>& first,
+    const std::vector<ComponentTypeId>& second
+) {
+    // Both are sorted, see System::setComponentAccess()
+    auto firstIter = first.begin();
+    auto secondIter = second.begin();
+    while (firstIter != first.end() and secondIter != second.end()) {
+        if (*firstIter < *secondIter) {
+            ++firstIter;
+        }
+        else if (*secondIter < *firstIter) {
+            ++secondIter;
+        }
+        else {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool
+conflicts(
+    const System& first,
+    const System& second
+) {
+    if (not first.hasComponentAccess() or not second.hasComponentAccess()) {
+        return true;
+    }
+    return intersects(first.componentWrites(), second.componentWrites()) or
+        intersects(first.componentWrites(), second.componentReads()) or
+        intersects(first.componentReads(), second.componentWrites());
+}
+
+
+void
+updateSystem(
+    System& system,
+    Profiler* profiler,
+    int milliseconds
+) {
+    static const std::string UNNAMED = "System";
+    if (not system.enabled()) {
+        return;
+    }
+    Profiler::Scope scope(
+        profiler,
+        system.name().empty() ? UNNAMED : system.name()
+    );
+    system.update(milliseconds);
+}
+
+}
+
+
+struct SystemScheduler::Implementation {
+
+    Implementation(
+        ThreadPool& threadPool
+    ) : m_threadPool(threadPool)
+    {
+    }
+
+    std::vector<Level> m_levels;
+
+    Profiler* m_profiler = nullptr;
+
+    ThreadPool& m_threadPool;
+
+};
+
+
+SystemScheduler::SystemScheduler(
+    ThreadPool& threadPool
+) : m_impl(new Implementation(threadPool))
+{
+}
+
+
+SystemScheduler::~SystemScheduler() {}
+
+
+const std::vector<SystemScheduler::Level>&
+SystemScheduler::levels() const {
+    return m_impl->m_levels;
+}
+
+
+void
+SystemScheduler::setProfiler(
+    Profiler* profiler
+) {
+    m_impl->m_profiler = profiler;
+}
+
+
+void
+SystemScheduler::setSystems(
+    const std::vector<System*>& systems
+) {
+    std::vector<size_t> systemLevels(systems.size(), 0);
+    size_t levelCount = 0;
+    for (size_t i = 0; i < systems.size(); ++i) {
+        size_t level = 0;
+        for (size_t j = 0; j < i; ++j) {
+            if (conflicts(*systems[i], *systems[j])) {
+                level = std::max(level, systemLevels[j] + 1);
+            }
+        }
+        systemLevels[i] = level;
+        levelCount = std::max(levelCount, level + 1);
+    }
+    m_impl->m_levels.assign(levelCount, Level());
+    for (size_t i = 0; i < systems.size(); ++i) {
+        Level& level = m_impl->m_levels[systemLevels[i]];
+        if (systems[i]->requiresMainThread()) {
+            level.mainThreadSystems.push_back(systems[i]);
+        }
+        else {
+            level.workerSystems.push_back(systems[i]);
+        }
+    }
+}
+
+
+void
+SystemScheduler::update(
+    int milliseconds
+) {
+    ThreadPool& threadPool = m_impl->m_threadPool;
+    Profiler* profiler = m_impl->m_profiler;
+    for (const Level& level : m_impl->m_levels) {
+        const std::vector<System*>& workerSystems = level.workerSystems;
+        threadPool.start(
+            workerSystems.size(),
+            [&workerSystems, profiler, milliseconds] (size_t index) {
+                updateSystem(*workerSystems[index], profiler, milliseconds);
+            }
+        );
+        try {
+            for (System* system : level.mainThreadSystems) {
+                updateSystem(*system, profiler, milliseconds);
+            }
+        }
+        catch (...) {
+            // Don't leave the workers running on a level we're abandoning
+            try {
+                threadPool.wait();
+            }
+            catch (...) {
+                // Report the main thread's error
+            }
+            throw;
+        }
+        threadPool.wait();
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace thrive {
+
+class Profiler;
+class System;
+class ThreadPool;
+
+/**
+* @brief Updates a game state's systems, running independent ones concurrently
+*
+* The scheduler groups the systems into levels. A system's level is one
+* higher than the highest level of any earlier system it conflicts with (see
+* System::setComponentAccess()). Systems without declared component access
+* conflict with every other system, so they run alone. The levels are
+* updated in order, the systems within a level at the same time.
+*
+* This keeps the order of conflicting systems as it was passed to
+* Engine::createGameState(), so the result of an update does not depend on
+* thread timing.
+*
+* Within a level, systems that require the main thread are updated there,
+* in their original order, while the other systems run on the thread pool.
+*/
+class SystemScheduler {
+
+public:
+
+    /**
+    * @brief Systems that may be updated at the same time
+    */
+    struct Level {
+
+        /**
+        * @brief Systems updated on the main thread, in order
+        */
+        std::vector<System*> mainThreadSystems;
+
+        /**
+        * @brief Systems updated on the thread pool
+        */
+        std::vector<System*> workerSystems;
+
+    };
+
+    /**
+    * @brief Constructor
+    *
+    * @param threadPool
+    *   The pool to run systems on
+    */
+    SystemScheduler(
+        ThreadPool& threadPool
+    );
+
+    /**
+    * @brief Destructor
+    */
+    ~SystemScheduler();
+
+    /**
+    * @brief The levels computed by setSystems()
+    */
+    const std::vector<Level>&
+    levels() const;
+
+    /**
+    * @brief Sets the profiler to record system updates into
+    *
+    * @param profiler
+    *   If \c nullptr, updates are not profiled
+    */
+    void
+    setProfiler(
+        Profiler* profiler
+    );
+
+    /**
+    * @brief Sets the systems to update
+    *
+    * Call this again when a system's component access changes.
+    *
+    * @param systems
+    *   The systems in their original order
+    */
+    void
+    setSystems(
+        const std::vector<System*>& systems
+    );
+
+    /**
+    * @brief Updates all enabled systems
+    *
+    * @param milliseconds
+    *   Passed on to System::update()
+    */
+    void
+    update(
+        int milliseconds
+    );
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
+};
+
+}
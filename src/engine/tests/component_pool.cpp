@@ -0,0 +1,85 @@
+#include "engine/component_pool.h"
+
+#include "engine/component.h"
+#include "engine/serialization.h"
+#include "util/make_unique.h"
+
+#include <gtest/gtest.h>
+
+using namespace thrive;
+
+
+namespace {
+
+class PooledComponent : public Component {
+    COMPONENT(ComponentPoolTestComponent)
+
+public:
+
+    void
+    load(
+        const StorageContainer& storage
+    ) override {
+        Component::load(storage);
+    }
+
+    StorageContainer
+    storage() const override {
+        return Component::storage();
+    }
+
+    double m_payload[4];
+
+};
+
+}
+
+const ComponentTypeId PooledComponent::TYPE_ID = 20000;
+
+
+TEST(ComponentPool, RecyclesBlocks) {
+    ComponentPool* pool = ComponentPool::create("RecyclesBlocks", 24);
+    void* first = pool->allocate(24);
+    void* second = pool->allocate(24);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(first) % 16);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(second) % 16);
+    pool->deallocate(first, 24);
+    // The most recently freed block is reused first
+    EXPECT_EQ(first, pool->allocate(24));
+    auto statistics = pool->poolStatistics();
+    EXPECT_EQ(3u, statistics.allocations);
+    EXPECT_EQ(1u, statistics.deallocations);
+    EXPECT_EQ(2u, statistics.liveBlocks);
+    EXPECT_EQ(2u, statistics.peakBlocks);
+    EXPECT_EQ(32u, statistics.blockSize);
+    EXPECT_LE(2u, statistics.reservedBlocks);
+}
+
+
+TEST(ComponentPool, FallbackForLargeObjects) {
+    ComponentPool* pool = ComponentPool::create("FallbackForLargeObjects", 16);
+    void* large = pool->allocate(1000);
+    pool->deallocate(large, 1000);
+    auto statistics = pool->poolStatistics();
+    EXPECT_EQ(1u, statistics.fallbackAllocations);
+    EXPECT_EQ(0u, statistics.liveBlocks);
+    EXPECT_EQ(0u, statistics.reservedBlocks);
+}
+
+
+TEST(ComponentPool, ComponentMacro) {
+    std::unique_ptr<Component> component = make_unique<PooledComponent>();
+    ComponentPool::Statistics statistics = PooledComponent::componentPool(
+        sizeof(PooledComponent)
+    ).poolStatistics();
+    EXPECT_EQ(PooledComponent::TYPE_NAME(), statistics.name);
+    EXPECT_EQ(1u, statistics.liveBlocks);
+    Component* raw = component.get();
+    component.reset();
+    statistics = PooledComponent::componentPool(sizeof(PooledComponent)).poolStatistics();
+    EXPECT_EQ(0u, statistics.liveBlocks);
+    // Freed block is recycled
+    component = make_unique<PooledComponent>();
+    EXPECT_EQ(raw, component.get());
+}
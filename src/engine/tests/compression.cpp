@@ -0,0 +1,68 @@
+#include "engine/compression.h"
+
+#include "engine/thread_pool.h"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <stdexcept>
+
+using namespace thrive;
+
+
+static std::string
+roundTrip(
+    const std::string& data
+) {
+    ThreadPool pool(2);
+    std::string compressed = compress(data.data(), data.size(), pool);
+    EXPECT_TRUE(isCompressed(compressed.data(), compressed.size()));
+    return decompress(compressed.data(), compressed.size(), pool);
+}
+
+
+TEST(Compression, Empty) {
+    EXPECT_EQ("", roundTrip(""));
+}
+
+
+TEST(Compression, Repetitive) {
+    std::string data;
+    for (int i = 0; i < 100000; ++i) {
+        data += "linearVelocity" + std::to_string(i % 17);
+    }
+    ThreadPool pool(2);
+    std::string compressed = compress(data.data(), data.size(), pool);
+    EXPECT_LT(compressed.size(), data.size() / 4);
+    EXPECT_EQ(data, decompress(compressed.data(), compressed.size(), pool));
+}
+
+
+TEST(Compression, Random) {
+    // Incompressible and not a multiple of the block size
+    std::mt19937 generator(42);
+    std::string data(1000 * 1000, '\0');
+    for (char& byte : data) {
+        byte = static_cast<char>(generator());
+    }
+    EXPECT_EQ(data, roundTrip(data));
+}
+
+
+TEST(Compression, LongMatches) {
+    std::string data(600 * 1000, 'a');
+    data += "end";
+    EXPECT_EQ(data, roundTrip(data));
+}
+
+
+TEST(Compression, Corrupt) {
+    ThreadPool pool(0);
+    std::string data(10000, 'a');
+    std::string compressed = compress(data.data(), data.size(), pool);
+    compressed.resize(compressed.size() - 1);
+    EXPECT_THROW(
+        decompress(compressed.data(), compressed.size(), pool),
+        std::runtime_error
+    );
+    EXPECT_FALSE(isCompressed(data.data(), data.size()));
+}
@@ -0,0 +1,104 @@
+#include "engine/entity_command_buffer.h"
+
+#include "engine/entity_filter.h"
+#include "engine/entity_manager.h"
+#include "engine/tests/test_component.h"
+#include "util/make_unique.h"
+
+#include <gtest/gtest.h>
+
+using namespace thrive;
+
+
+TEST(EntityCommandBuffer, Spawn) {
+    EntityManager entityManager;
+    EntityFilter<TestComponent<0>, TestComponent<1>> filter(true);
+    filter.setEntityManager(&entityManager);
+    EntityCommandBuffer commandBuffer(entityManager);
+    std::vector<std::unique_ptr<Component>> components;
+    components.emplace_back(make_unique<TestComponent<0>>());
+    components.emplace_back(make_unique<TestComponent<1>>());
+    EntityId entityId = commandBuffer.spawn(std::move(components));
+    auto component = commandBuffer.addComponent(entityId, make_unique<TestComponent<2>>());
+    // Nothing happens before the flush
+    EXPECT_FALSE(commandBuffer.empty());
+    EXPECT_FALSE(entityManager.exists(entityId));
+    EXPECT_EQ(0, filter.entities().size());
+    commandBuffer.flush();
+    EXPECT_TRUE(commandBuffer.empty());
+    EXPECT_TRUE(entityManager.exists(entityId));
+    EXPECT_EQ(component, entityManager.getComponent<TestComponent<2>>(entityId));
+    EXPECT_EQ(1, filter.entities().count(entityId));
+    EXPECT_EQ(1, filter.addedEntities().count(entityId));
+}
+
+
+TEST(EntityCommandBuffer, BuildsFilterOncePerEntity) {
+    EntityManager entityManager;
+    EntityFilter<TestComponent<0>, Optional<TestComponent<1>>> filter(true);
+    filter.setEntityManager(&entityManager);
+    EntityCommandBuffer commandBuffer(entityManager);
+    EntityId entityId = commandBuffer.createEntity();
+    commandBuffer.addComponent(entityId, make_unique<TestComponent<0>>());
+    auto optional = commandBuffer.addComponent(entityId, make_unique<TestComponent<1>>());
+    commandBuffer.flush();
+    // The group was built after both components were added, so the
+    // optional component is present
+    ASSERT_EQ(1, filter.entities().count(entityId));
+    EXPECT_EQ(optional, std::get<1>(filter.entities().at(entityId)));
+    EXPECT_EQ(1, filter.addedEntities().size());
+}
+
+
+TEST(EntityCommandBuffer, Removals) {
+    EntityManager entityManager;
+    EntityFilter<TestComponent<0>> filter;
+    filter.setEntityManager(&entityManager);
+    EntityCommandBuffer commandBuffer(entityManager);
+    EntityId first = commandBuffer.createEntity();
+    EntityId second = commandBuffer.createEntity();
+    commandBuffer.addComponent(first, make_unique<TestComponent<0>>());
+    commandBuffer.addComponent(first, make_unique<TestComponent<1>>());
+    commandBuffer.addComponent(second, make_unique<TestComponent<0>>());
+    commandBuffer.flush();
+    EXPECT_EQ(2, filter.entities().size());
+    commandBuffer.removeComponent(first, TestComponent<0>::TYPE_ID);
+    commandBuffer.removeEntity(second);
+    commandBuffer.flush();
+    entityManager.processRemovals();
+    EXPECT_EQ(0, filter.entities().size());
+    EXPECT_TRUE(entityManager.exists(first));
+    EXPECT_FALSE(entityManager.exists(second));
+}
+
+
+TEST(EntityCommandBuffer, DiscardsComponentsOfDestroyedEntities) {
+    EntityManager entityManager;
+    EntityCommandBuffer commandBuffer(entityManager);
+    EntityId entityId = entityManager.generateNewId();
+    entityManager.addComponent(entityId, make_unique<TestComponent<0>>());
+    commandBuffer.addComponent(entityId, make_unique<TestComponent<1>>());
+    entityManager.removeEntity(entityId);
+    entityManager.processRemovals();
+    EXPECT_NO_THROW(commandBuffer.flush());
+    EXPECT_FALSE(entityManager.exists(entityId));
+}
+
+
+TEST(EntityCommandBuffer, NestedBatches) {
+    EntityManager entityManager;
+    EntityFilter<TestComponent<0>> filter;
+    filter.setEntityManager(&entityManager);
+    EntityId entityId = entityManager.generateNewId();
+    {
+        EntityManager::Batch outer(entityManager);
+        {
+            EntityManager::Batch inner(entityManager);
+            entityManager.addComponent(entityId, make_unique<TestComponent<0>>());
+        }
+        EXPECT_TRUE(entityManager.isBatching());
+        EXPECT_EQ(0, filter.entities().size());
+    }
+    EXPECT_FALSE(entityManager.isBatching());
+    EXPECT_EQ(1, filter.entities().count(entityId));
+}
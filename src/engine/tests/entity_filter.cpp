@@ -1,10 +1,12 @@
 #include "engine/entity_filter.h"
 
+#include "engine/entity_command_buffer.h"
 #include "engine/entity_manager.h"
 #include "engine/tests/test_component.h"
 #include "util/make_unique.h"
 
 #include <gtest/gtest.h>
+#include <vector>
 
 using namespace thrive;
 
@@ -212,3 +214,230 @@ TEST(EntityFilter, Record) {
 }
 
 
+TEST(EntityFilter, RecordOverwrittenComponent) {
+    EntityManager entityManager;
+    using TestFilter = EntityFilter<
+        TestComponent<0>
+    >;
+    TestFilter filter(true);
+    filter.setEntityManager(&entityManager);
+    EntityId entityId = entityManager.generateNewId();
+    entityManager.addComponent(
+        entityId,
+        make_unique<TestComponent<0>>()
+    );
+    filter.clearChanges();
+    // Overwrite the component
+    auto component = make_unique<TestComponent<0>>();
+    TestComponent<0>* rawComponent = component.get();
+    entityManager.addComponent(
+        entityId,
+        std::move(component)
+    );
+    // Reported as removed and added again, with the new component
+    EXPECT_EQ(1, filter.removedEntities().count(entityId));
+    ASSERT_EQ(1, filter.addedEntities().count(entityId));
+    EXPECT_EQ(rawComponent, std::get<0>(filter.addedEntities()[entityId]));
+    EXPECT_EQ(rawComponent, std::get<0>(filter.entities().at(entityId)));
+}
+
+
+TEST(EntityFilter, RescanAfterFallingBehind) {
+    EntityManager entityManager;
+    using TestFilter = EntityFilter<
+        TestComponent<0>
+    >;
+    TestFilter filter(true);
+    filter.setEntityManager(&entityManager);
+    EntityId removedId = entityManager.generateNewId();
+    entityManager.addComponent(
+        removedId,
+        make_unique<TestComponent<0>>()
+    );
+    filter.clearChanges();
+    entityManager.removeEntity(removedId);
+    entityManager.processRemovals();
+    // Enough events for the collection to discard them, without accessing
+    // the filter in between
+    std::vector<EntityId> entities;
+    for (int i = 0; i < 10000; ++i) {
+        EntityId entityId = entityManager.generateNewId();
+        entityManager.addComponent(
+            entityId,
+            make_unique<TestComponent<0>>()
+        );
+        entities.push_back(entityId);
+    }
+    EXPECT_EQ(entities.size(), filter.entities().size());
+    EXPECT_EQ(entities.size(), filter.addedEntities().size());
+    EXPECT_EQ(1, filter.removedEntities().count(removedId));
+    for (EntityId entityId : entities) {
+        EXPECT_EQ(1, filter.entities().count(entityId));
+    }
+}
+
+
+
+TEST(EntityFilter, ParallelForEach) {
+    EntityManager entityManager;
+    EntityFilter<TestComponent<0>> filter;
+    filter.setEntityManager(&entityManager);
+    const int entityCount = 1000;
+    for (int i = 0; i < entityCount; ++i) {
+        entityManager.addComponent(
+            entityManager.generateNewId(),
+            make_unique<TestComponent<0>>()
+        );
+    }
+    // Every entity has its own slot, so the tasks never write the same one
+    std::vector<int> visits(entityCount + 1, 0);
+    filter.parallelForEach(
+        [&visits] (EntityId entityId, const EntityFilter<TestComponent<0>>::ComponentGroup& group) {
+            EXPECT_TRUE(nullptr != std::get<0>(group));
+            visits.at(entityIndex(entityId)) += 1;
+        },
+        7
+    );
+    int total = 0;
+    for (int count : visits) {
+        EXPECT_GE(1, count);
+        total += count;
+    }
+    EXPECT_EQ(entityCount, total);
+}
+
+TEST(EntityFilter, ParallelForEachCollectsChanges) {
+    EntityManager entityManager;
+    EntityFilter<TestComponent<0>> filter;
+    filter.setEntityManager(&entityManager);
+    std::vector<EntityId> expected;
+    for (int i = 0; i < 1000; ++i) {
+        EntityId entityId = entityManager.generateNewId();
+        entityManager.addComponent(
+            entityId,
+            make_unique<TestComponent<0>>()
+        );
+        if (entityIndex(entityId) % 3 == 0) {
+            expected.push_back(entityId);
+        }
+    }
+    EntityCommandBuffer changes(entityManager);
+    filter.parallelForEach(
+        changes,
+        [&filter] (EntityId entityId, const EntityFilter<TestComponent<0>>::ComponentGroup&, EntityCommandBuffer& local) {
+            // Nothing is removed until the changes are applied
+            EXPECT_TRUE(filter.containsEntity(entityId));
+            if (entityIndex(entityId) % 3 == 0) {
+                local.removeEntity(entityId);
+            }
+        },
+        16
+    );
+    EXPECT_FALSE(changes.empty());
+    EXPECT_EQ(1000, filter.entities().size());
+    changes.flush();
+    entityManager.processRemovals();
+    EXPECT_TRUE(changes.empty());
+    EXPECT_EQ(1000 - expected.size(), filter.entities().size());
+    for (EntityId entityId : expected) {
+        EXPECT_FALSE(filter.containsEntity(entityId));
+    }
+}
+
+TEST(EntityFilter, ParallelForEachReusesBuffers) {
+    EntityManager entityManager;
+    EntityFilter<TestComponent<0>> filter;
+    filter.setEntityManager(&entityManager);
+    for (int i = 0; i < 1000; ++i) {
+        entityManager.addComponent(
+            entityManager.generateNewId(),
+            make_unique<TestComponent<0>>()
+        );
+    }
+    EntityCommandBuffer changes(entityManager);
+    filter.parallelForEach(
+        changes,
+        [] (EntityId entityId, const EntityFilter<TestComponent<0>>::ComponentGroup&, EntityCommandBuffer& local) {
+            if (entityIndex(entityId) % 2 == 0) {
+                local.removeEntity(entityId);
+            }
+        },
+        16
+    );
+    changes.flush();
+    entityManager.processRemovals();
+    EXPECT_EQ(500, filter.entities().size());
+    // The second call must not deliver leftovers of the first one
+    filter.parallelForEach(
+        changes,
+        [] (EntityId, const EntityFilter<TestComponent<0>>::ComponentGroup&, EntityCommandBuffer&) {},
+        16
+    );
+    EXPECT_TRUE(changes.empty());
+}
+
+
+TEST(EntityFilter, SharedIndex) {
+    EntityManager entityManager;
+    using TestFilter = EntityFilter<
+        TestComponent<0>
+    >;
+    TestFilter recording(true);
+    TestFilter plain;
+    recording.setEntityManager(&entityManager);
+    plain.setEntityManager(&entityManager);
+    EXPECT_EQ(&recording.entities(), &plain.entities());
+    EntityId entityId = entityManager.generateNewId();
+    entityManager.addComponent(
+        entityId,
+        make_unique<TestComponent<0>>()
+    );
+    // Accessing one filter syncs the index for both
+    EXPECT_TRUE(plain.containsEntity(entityId));
+    EXPECT_EQ(1, recording.addedEntities().count(entityId));
+    // A filter joining later sees the current entities as added
+    TestFilter late(true);
+    late.setEntityManager(&entityManager);
+    EXPECT_EQ(1, late.addedEntities().count(entityId));
+    late.clearChanges();
+    entityManager.removeEntity(entityId);
+    entityManager.processRemovals();
+    EXPECT_EQ(1, late.removedEntities().count(entityId));
+    EXPECT_EQ(0, recording.addedEntities().count(entityId));
+    EXPECT_EQ(1, recording.removedEntities().count(entityId));
+}
+
+
+TEST(EntityFilter, OutliveEntityManager) {
+    EntityFilter<TestComponent<0>> filter(true);
+    {
+        EntityManager entityManager;
+        filter.setEntityManager(&entityManager);
+        entityManager.addComponent(
+            entityManager.generateNewId(),
+            make_unique<TestComponent<0>>()
+        );
+        EXPECT_EQ(1, filter.entities().size());
+    }
+    EXPECT_EQ(0, filter.entities().size());
+    filter.setEntityManager(nullptr);
+}
+
+
+TEST(EntityFilter, QueryStatistics) {
+    EntityManager entityManager;
+    EntityFilter<TestComponent<0>, Optional<TestComponent<1>>> filter;
+    filter.setEntityManager(&entityManager);
+    entityManager.addComponent(
+        entityManager.generateNewId(),
+        make_unique<TestComponent<0>>()
+    );
+    EXPECT_EQ(1, filter.entities().size());
+    auto statistics = entityManager.queryStatistics();
+    ASSERT_EQ(1u, statistics.size());
+    EXPECT_EQ("EntityFilter<TestComponent0, Optional<TestComponent1>>", statistics[0].name);
+    EXPECT_EQ(1u, statistics[0].entityCount);
+    EXPECT_GT(statistics[0].bytes, 0u);
+    filter.setEntityManager(nullptr);
+    EXPECT_TRUE(entityManager.queryStatistics().empty());
+}
@@ -0,0 +1,582 @@
+#include "engine/entity_manager.h"
+
+#include "engine/component_collection.h"
+#include "engine/component_factory.h"
+#include "engine/serialization.h"
+#include "engine/tests/test_component.h"
+#include "engine/touchable.h"
+#include "util/make_unique.h"
+
+#include <gtest/gtest.h>
+
+using namespace thrive;
+
+
+namespace {
+
+// Needs to be registered with the component factory for serialization
+class SavedComponent : public Component {
+    COMPONENT(EntityManagerTestComponent)
+
+public:
+
+    void
+    load(
+        const StorageContainer& storage
+    ) override {
+        Component::load(storage);
+    }
+
+    StorageContainer
+    storage() const override {
+        return Component::storage();
+    }
+
+};
+
+
+class TouchedComponent : public Component {
+    COMPONENT(EntityManagerTouchedComponent)
+
+public:
+
+    TouchedComponent() {
+        m_properties.setComponent(this);
+    }
+
+    void
+    load(
+        const StorageContainer& storage
+    ) override {
+        Component::load(storage);
+        m_position = storage.get<int32_t>("position");
+    }
+
+    StorageContainer
+    storage() const override {
+        StorageContainer storage = Component::storage();
+        storage.set<int32_t>("position", m_position);
+        return storage;
+    }
+
+    // Like a rigid body's position, written without touching
+    int32_t m_position = 0;
+
+    Touchable m_properties;
+
+};
+
+
+// Copied by snapshots instead of serialized right away
+class ClonedComponent : public Component {
+    COMPONENT(EntityManagerClonedComponent)
+
+public:
+
+    void
+    load(
+        const StorageContainer& storage
+    ) override {
+        Component::load(storage);
+        m_position = storage.get<int32_t>("position");
+    }
+
+    StorageContainer
+    storage() const override {
+        StorageContainer storage = Component::storage();
+        storage.set<int32_t>("position", m_position);
+        return storage;
+    }
+
+    int32_t m_position = 0;
+
+};
+
+}
+
+REGISTER_COMPONENT(ClonedComponent)
+REGISTER_COMPONENT_CLONER(ClonedComponent)
+REGISTER_COMPONENT(SavedComponent)
+REGISTER_COMPONENT(TouchedComponent)
+
+
+TEST(EntityManager, RecycleIds) {
+    EntityManager entityManager;
+    EntityId first = entityManager.generateNewId();
+    entityManager.addComponent(first, make_unique<TestComponent<0>>());
+    entityManager.removeEntity(first);
+    entityManager.processRemovals();
+    EntityId second = entityManager.generateNewId();
+    EXPECT_NE(first, second);
+    EXPECT_EQ(entityIndex(first), entityIndex(second));
+    EXPECT_EQ(entityGeneration(first) + 1, entityGeneration(second));
+}
+
+
+TEST(EntityManager, StaleIds) {
+    EntityManager entityManager;
+    EntityId first = entityManager.generateNewId();
+    entityManager.addComponent(first, make_unique<TestComponent<0>>());
+    EXPECT_TRUE(entityManager.exists(first));
+    entityManager.removeEntity(first);
+    entityManager.processRemovals();
+    EXPECT_FALSE(entityManager.exists(first));
+    EntityId second = entityManager.generateNewId();
+    entityManager.addComponent(second, make_unique<TestComponent<0>>());
+    EXPECT_TRUE(entityManager.exists(second));
+    EXPECT_FALSE(entityManager.exists(first));
+    EXPECT_TRUE(nullptr == entityManager.getComponent(first, TestComponent<0>::TYPE_ID));
+    EXPECT_THROW(
+        entityManager.addComponent(first, make_unique<TestComponent<1>>()),
+        std::runtime_error
+    );
+    // Removing through a stale id doesn't touch the new entity
+    entityManager.removeEntity(first);
+    entityManager.processRemovals();
+    EXPECT_TRUE(entityManager.exists(second));
+}
+
+
+TEST(EntityManager, EmptyEntityKeepsItsId) {
+    EntityManager entityManager;
+    EntityId entityId = entityManager.generateNewId();
+    entityManager.addComponent(entityId, make_unique<TestComponent<0>>());
+    entityManager.removeComponent(entityId, TestComponent<0>::TYPE_ID);
+    entityManager.processRemovals();
+    EXPECT_FALSE(entityManager.exists(entityId));
+    // Only removing the entity frees the id
+    EXPECT_NE(entityIndex(entityId), entityIndex(entityManager.generateNewId()));
+    entityManager.addComponent(entityId, make_unique<TestComponent<1>>());
+    EXPECT_TRUE(entityManager.exists(entityId));
+}
+
+
+TEST(EntityManager, ReclaimsUnusedIds) {
+    EntityManager entityManager;
+    EntityId unused = entityManager.generateNewId();
+    EntityId used = entityManager.generateNewId();
+    // Ids survive the first processRemovals() without components
+    entityManager.processRemovals();
+    entityManager.addComponent(used, make_unique<TestComponent<0>>());
+    entityManager.processRemovals();
+    EXPECT_TRUE(entityManager.exists(used));
+    EntityId recycled = entityManager.generateNewId();
+    EXPECT_EQ(entityIndex(unused), entityIndex(recycled));
+    EXPECT_NE(unused, recycled);
+    EXPECT_THROW(
+        entityManager.addComponent(unused, make_unique<TestComponent<0>>()),
+        std::runtime_error
+    );
+}
+
+
+TEST(EntityManager, NamedIdsArePinned) {
+    EntityManager entityManager;
+    EntityId named = entityManager.getNamedId("named");
+    entityManager.addComponent(named, make_unique<TestComponent<0>>());
+    entityManager.removeEntity(named);
+    entityManager.processRemovals();
+    EXPECT_FALSE(entityManager.exists(named));
+    EXPECT_EQ(named, entityManager.getNamedId("named"));
+    EXPECT_NE(entityIndex(named), entityIndex(entityManager.generateNewId()));
+    entityManager.addComponent(named, make_unique<TestComponent<0>>());
+    EXPECT_TRUE(entityManager.exists(named));
+}
+
+
+TEST(EntityManager, StorageKeepsGenerations) {
+    ComponentFactory factory;
+    EntityManager entityManager;
+    EntityId removed = entityManager.generateNewId();
+    entityManager.addComponent(removed, make_unique<SavedComponent>());
+    EntityId alive = entityManager.generateNewId();
+    entityManager.addComponent(alive, make_unique<SavedComponent>());
+    entityManager.removeEntity(removed);
+    entityManager.processRemovals();
+    // Save and restore
+    EntityManager restored;
+    restored.restore(entityManager.storage(factory), factory);
+    EXPECT_TRUE(restored.exists(alive));
+    EXPECT_FALSE(restored.exists(removed));
+    EntityId recycled = restored.generateNewId();
+    EXPECT_EQ(entityIndex(removed), entityIndex(recycled));
+    EXPECT_NE(removed, recycled);
+}
+
+
+TEST(EntityManager, RestoreWithoutSlots) {
+    ComponentFactory factory;
+    // Savegame layout from before generational ids
+    StorageContainer componentStorage;
+    componentStorage.set<EntityId>("owner", 2);
+    StorageList componentList;
+    componentList.append(std::move(componentStorage));
+    StorageContainer collections;
+    collections.set(SavedComponent::TYPE_NAME(), std::move(componentList));
+    StorageContainer storage;
+    storage.set<EntityId>("currentId", 5);
+    storage.set("collections", std::move(collections));
+    storage.set("componentsToRemove", StorageList());
+    storage.set("entitiesToRemove", StorageList());
+    storage.set("namedIds", StorageList());
+    EntityManager entityManager;
+    entityManager.restore(storage, factory);
+    EXPECT_TRUE(entityManager.exists(2));
+    // Ids below the old counter must not come back with generation 0
+    for (int i = 0; i < 3; ++i) {
+        EntityId entityId = entityManager.generateNewId();
+        EXPECT_NE(2u, entityIndex(entityId));
+        EXPECT_NE(0u, entityGeneration(entityId));
+    }
+}
+
+
+TEST(EntityManager, RestoreWithoutSlotsRejectsLargeIds) {
+    ComponentFactory factory;
+    // Before generational ids, ids were a plain counter and could grow
+    // beyond the index bits
+    EntityId largeId = ENTITY_INDEX_MASK + 2;
+    StorageContainer componentStorage;
+    componentStorage.set<EntityId>("owner", largeId);
+    StorageList componentList;
+    componentList.append(std::move(componentStorage));
+    StorageContainer collections;
+    collections.set(SavedComponent::TYPE_NAME(), std::move(componentList));
+    StorageContainer storage;
+    storage.set<EntityId>("currentId", largeId + 1);
+    storage.set("collections", std::move(collections));
+    storage.set("componentsToRemove", StorageList());
+    storage.set("entitiesToRemove", StorageList());
+    storage.set("namedIds", StorageList());
+    EntityManager entityManager;
+    EntityId existing = entityManager.generateNewId();
+    entityManager.addComponent(existing, make_unique<SavedComponent>());
+    EXPECT_THROW(entityManager.restore(storage, factory), std::runtime_error);
+    // The rejected savegame didn't touch the manager
+    EXPECT_TRUE(entityManager.exists(existing));
+    EXPECT_FALSE(entityManager.exists(largeId));
+    // Also rejected if only a component refers to a large id
+    storage.set<EntityId>("currentId", 5);
+    EXPECT_THROW(entityManager.restore(storage, factory), std::runtime_error);
+}
+
+
+TEST(EntityManager, ComponentMask) {
+    EntityManager entityManager;
+    EntityId entityId = entityManager.generateNewId();
+    EXPECT_TRUE(entityManager.componentMask(entityId).none());
+    entityManager.addComponent(entityId, make_unique<TestComponent<0>>());
+    entityManager.addComponent(entityId, make_unique<TestComponent<1>>());
+    unsigned int first = entityManager.getComponentCollection(TestComponent<0>::TYPE_ID).maskIndex();
+    unsigned int second = entityManager.getComponentCollection(TestComponent<1>::TYPE_ID).maskIndex();
+    EXPECT_NE(first, second);
+    EXPECT_TRUE(entityManager.componentMask(entityId).test(first));
+    EXPECT_TRUE(entityManager.componentMask(entityId).test(second));
+    EXPECT_EQ(2, entityManager.componentMask(entityId).count());
+    entityManager.removeComponent(entityId, TestComponent<0>::TYPE_ID);
+    entityManager.processRemovals();
+    EXPECT_FALSE(entityManager.componentMask(entityId).test(first));
+    EXPECT_TRUE(entityManager.componentMask(entityId).test(second));
+    entityManager.removeEntity(entityId);
+    entityManager.processRemovals();
+    EXPECT_TRUE(entityManager.componentMask(entityId).none());
+    // The recycled slot starts out empty
+    EntityId recycled = entityManager.generateNewId();
+    EXPECT_EQ(entityIndex(entityId), entityIndex(recycled));
+    EXPECT_TRUE(entityManager.componentMask(recycled).none());
+}
+
+
+TEST(EntityManager, GetComponentDoesNotCreateCollections) {
+    EntityManager entityManager;
+    EntityId entityId = entityManager.generateNewId();
+    entityManager.addComponent(entityId, make_unique<TestComponent<0>>());
+    EXPECT_EQ(nullptr, entityManager.getComponent(entityId, TestComponent<1>::TYPE_ID));
+    // The lookup didn't take a mask index
+    EXPECT_EQ(1u, entityManager.getComponentCollection(TestComponent<1>::TYPE_ID).maskIndex());
+}
+
+
+TEST(EntityManager, RemoveEntityVisitsOnlyItsCollections) {
+    EntityManager entityManager;
+    // Unrelated collections
+    EntityId other = entityManager.generateNewId();
+    entityManager.addComponent(other, make_unique<TestComponent<2>>());
+    entityManager.addComponent(other, make_unique<TestComponent<3>>());
+    EntityId entityId = entityManager.generateNewId();
+    entityManager.addComponent(entityId, make_unique<TestComponent<0>>());
+    entityManager.addComponent(entityId, make_unique<TestComponent<1>>());
+    entityManager.removeEntity(entityId);
+    // Removing twice is harmless
+    entityManager.removeEntity(entityId);
+    entityManager.processRemovals();
+    const auto& statistics = entityManager.removalStatistics();
+    EXPECT_EQ(2u, statistics.collectionsVisited);
+    EXPECT_EQ(2u, statistics.componentsRemoved);
+    EXPECT_EQ(1u, statistics.entitiesRemoved);
+    EXPECT_FALSE(entityManager.exists(entityId));
+    EXPECT_EQ(nullptr, entityManager.getComponent(entityId, TestComponent<0>::TYPE_ID));
+    EXPECT_TRUE(entityManager.exists(other));
+}
+
+
+TEST(EntityManager, ChangeTracking) {
+    EntityManager entityManager;
+    auto& collection = entityManager.getComponentCollection(TouchedComponent::TYPE_ID);
+    EntityId first = entityManager.generateNewId();
+    auto firstComponent = entityManager.addComponent(first, make_unique<TouchedComponent>());
+    // Not tracked yet
+    firstComponent->touch();
+    EXPECT_FALSE(collection.isTrackingChanges());
+    // A new tracker sees existing components
+    unsigned int tracker = collection.enableChangeTracking();
+    EXPECT_TRUE(collection.isTrackingChanges());
+    auto changed = collection.takeChangedComponents(tracker);
+    ASSERT_EQ(1u, changed.size());
+    EXPECT_EQ(firstComponent, changed[0]);
+    EXPECT_TRUE(collection.takeChangedComponents(tracker).empty());
+    // New components are listed
+    EntityId second = entityManager.generateNewId();
+    auto secondComponent = entityManager.addComponent(second, make_unique<TouchedComponent>());
+    // Touching a touchable lists its component, but only once
+    firstComponent->m_properties.touch();
+    firstComponent->m_properties.touch();
+    firstComponent->touch();
+    changed = collection.takeChangedComponents(tracker);
+    ASSERT_EQ(2u, changed.size());
+    EXPECT_EQ(secondComponent, changed[0]);
+    EXPECT_EQ(firstComponent, changed[1]);
+    // Removed components are not listed
+    firstComponent->touch();
+    secondComponent->touch();
+    entityManager.removeEntity(first);
+    entityManager.processRemovals();
+    changed = collection.takeChangedComponents(tracker);
+    ASSERT_EQ(1u, changed.size());
+    EXPECT_EQ(secondComponent, changed[0]);
+    collection.disableChangeTracking(tracker);
+    EXPECT_FALSE(collection.isTrackingChanges());
+}
+
+
+TEST(EntityManager, ChangeTrackersHaveTheirOwnCursors) {
+    EntityManager entityManager;
+    auto& collection = entityManager.getComponentCollection(TouchedComponent::TYPE_ID);
+    EntityId first = entityManager.generateNewId();
+    auto firstComponent = entityManager.addComponent(first, make_unique<TouchedComponent>());
+    EntityId second = entityManager.generateNewId();
+    auto secondComponent = entityManager.addComponent(second, make_unique<TouchedComponent>());
+    unsigned int early = collection.enableChangeTracking();
+    unsigned int late = collection.enableChangeTracking();
+    collection.takeChangedComponents(early);
+    collection.takeChangedComponents(late);
+    firstComponent->touch();
+    // One tracker taking its changes doesn't hide them from the other
+    auto changed = collection.takeChangedComponents(early);
+    ASSERT_EQ(1u, changed.size());
+    EXPECT_EQ(firstComponent, changed[0]);
+    secondComponent->touch();
+    firstComponent->touch();
+    changed = collection.takeChangedComponents(late);
+    ASSERT_EQ(2u, changed.size());
+    EXPECT_EQ(secondComponent, changed[0]);
+    EXPECT_EQ(firstComponent, changed[1]);
+    changed = collection.takeChangedComponents(early);
+    ASSERT_EQ(2u, changed.size());
+    EXPECT_TRUE(collection.takeChangedComponents(late).empty());
+    // The remaining tracker keeps working after the other is removed
+    collection.disableChangeTracking(early);
+    secondComponent->touch();
+    changed = collection.takeChangedComponents(late);
+    ASSERT_EQ(1u, changed.size());
+    EXPECT_EQ(secondComponent, changed[0]);
+    collection.disableChangeTracking(late);
+}
+
+
+TEST(EntityManager, CopiedTouchableHasNoComponent) {
+    EntityManager entityManager;
+    auto& collection = entityManager.getComponentCollection(TouchedComponent::TYPE_ID);
+    unsigned int tracker = collection.enableChangeTracking();
+    EntityId entityId = entityManager.generateNewId();
+    auto component = entityManager.addComponent(entityId, make_unique<TouchedComponent>());
+    collection.takeChangedComponents(tracker);
+    Touchable copy = component->m_properties;
+    copy.touch();
+    EXPECT_TRUE(collection.takeChangedComponents(tracker).empty());
+    // Assigning to the component's touchable touches it
+    component->m_properties.untouch();
+    component->m_properties = copy;
+    EXPECT_TRUE(component->m_properties.hasChanges());
+    EXPECT_EQ(1u, collection.takeChangedComponents(tracker).size());
+    collection.disableChangeTracking(tracker);
+}
+
+
+TEST(EntityManager, CollectionStatistics) {
+    EntityManager entityManager;
+    for (int i = 0; i < 3; ++i) {
+        EntityId entityId = entityManager.generateNewId();
+        entityManager.addComponent(entityId, make_unique<TestComponent<0>>());
+        if (i == 0) {
+            entityManager.addComponent(entityId, make_unique<TestComponent<1>>());
+        }
+    }
+    EXPECT_EQ(3u, entityManager.entityCount());
+    auto statistics = entityManager.collectionStatistics();
+    ASSERT_EQ(2u, statistics.size());
+    EXPECT_TRUE(TestComponent<0>::TYPE_ID == statistics[0].typeId);
+    EXPECT_EQ(3u, statistics[0].componentCount);
+    EXPECT_TRUE(TestComponent<1>::TYPE_ID == statistics[1].typeId);
+    EXPECT_EQ(1u, statistics[1].componentCount);
+    // At least the components themselves
+    EXPECT_GE(statistics[0].bytes, 3 * sizeof(Component));
+    EXPECT_GT(statistics[0].bytes, statistics[1].bytes);
+}
+
+
+TEST(EntityManager, JournalReplaysChanges) {
+    ComponentFactory factory;
+    EntityManager entityManager;
+    std::vector<EntityId> ids;
+    std::vector<TouchedComponent*> components;
+    for (int i = 0; i < 3; ++i) {
+        ids.push_back(entityManager.generateNewId());
+        components.push_back(static_cast<TouchedComponent*>(
+            entityManager.addComponent(ids.back(), make_unique<TouchedComponent>())
+        ));
+    }
+    EntityId unchanged = entityManager.generateNewId();
+    entityManager.addComponent(unchanged, make_unique<SavedComponent>());
+    StorageContainer base = entityManager.storage(factory);
+    EXPECT_THROW(entityManager.storageDelta(factory), std::logic_error);
+    entityManager.beginJournal();
+    // Change, remove, add and hide components
+    components[0]->m_properties.touch();
+    entityManager.removeEntity(ids[1]);
+    entityManager.processRemovals();
+    EntityId added = entityManager.generateNewId();
+    entityManager.addComponent(added, make_unique<TouchedComponent>());
+    entityManager.setVolatile(ids[2], true);
+    StorageContainer delta = entityManager.storageDelta(factory);
+    // Only changed components are saved
+    StorageContainer collections = delta.get<StorageContainer>("collections");
+    EXPECT_EQ(2u, collections.get<StorageList>(TouchedComponent::TYPE_NAME()).size());
+    EXPECT_FALSE(collections.contains(SavedComponent::TYPE_NAME()));
+    EXPECT_EQ(2u, delta.get<StorageList>("removedComponents").size());
+    EXPECT_EQ(1u, delta.get<StorageList>("releasedSlots").size());
+    // Replay
+    EntityManager restored;
+    restored.restore(base, factory);
+    restored.applyDelta(delta, factory);
+    EXPECT_TRUE(restored.exists(ids[0]));
+    EXPECT_FALSE(restored.exists(ids[1]));
+    EXPECT_FALSE(restored.exists(ids[2]));
+    EXPECT_TRUE(restored.exists(added));
+    EXPECT_TRUE(restored.exists(unchanged));
+    EXPECT_NE(ids[1], restored.generateNewId());
+    // Nothing changed since the last delta
+    delta = entityManager.storageDelta(factory);
+    collections = delta.get<StorageContainer>("collections");
+    EXPECT_FALSE(collections.contains(TouchedComponent::TYPE_NAME()));
+    EXPECT_TRUE(delta.get<StorageList>("removedComponents").empty());
+    EXPECT_TRUE(delta.get<StorageList>("releasedSlots").empty());
+    entityManager.endJournal();
+    EXPECT_FALSE(entityManager.isJournaling());
+}
+
+
+TEST(EntityManager, JournalRecordsUntouchedMoves) {
+    ComponentFactory factory;
+    EntityManager entityManager;
+    auto& collection = entityManager.getComponentCollection(TouchedComponent::TYPE_ID);
+    unsigned int tracker = collection.enableChangeTracking();
+    EntityId entityId = entityManager.generateNewId();
+    auto component = static_cast<TouchedComponent*>(
+        entityManager.addComponent(entityId, make_unique<TouchedComponent>())
+    );
+    collection.takeChangedComponents(tracker);
+    StorageContainer base = entityManager.storage(factory);
+    entityManager.beginJournal();
+    // Moved without touching, so systems don't see the change
+    component->m_position = 5;
+    component->markUnsavedChange();
+    EXPECT_TRUE(collection.takeChangedComponents(tracker).empty());
+    StorageContainer delta = entityManager.storageDelta(factory);
+    EntityManager restored;
+    restored.restore(base, factory);
+    restored.applyDelta(delta, factory);
+    auto restoredComponent = static_cast<TouchedComponent*>(
+        restored.getComponent(entityId, TouchedComponent::TYPE_ID)
+    );
+    ASSERT_NE(nullptr, restoredComponent);
+    EXPECT_EQ(5, restoredComponent->m_position);
+    collection.disableChangeTracking(tracker);
+}
+
+
+TEST(EntityManager, SnapshotIsUnaffectedByLaterChanges) {
+    ComponentFactory factory;
+    EntityManager entityManager;
+    EntityId cloned = entityManager.generateNewId();
+    auto clonedComponent = static_cast<ClonedComponent*>(
+        entityManager.addComponent(cloned, make_unique<ClonedComponent>())
+    );
+    clonedComponent->m_position = 1;
+    EntityId stored = entityManager.generateNewId();
+    entityManager.addComponent(stored, make_unique<SavedComponent>());
+    EntityId volatileId = entityManager.generateNewId();
+    entityManager.addComponent(volatileId, make_unique<ClonedComponent>());
+    entityManager.setVolatile(volatileId, true);
+    auto buildStorage = entityManager.snapshot(factory);
+    // Changes after the snapshot
+    clonedComponent->m_position = 2;
+    entityManager.removeEntity(cloned);
+    entityManager.removeEntity(stored);
+    entityManager.processRemovals();
+    EntityManager restored;
+    restored.restore(buildStorage(), factory);
+    auto restoredComponent = static_cast<ClonedComponent*>(
+        restored.getComponent(cloned, ClonedComponent::TYPE_ID)
+    );
+    ASSERT_NE(nullptr, restoredComponent);
+    EXPECT_EQ(1, restoredComponent->m_position);
+    EXPECT_TRUE(restored.exists(stored));
+    EXPECT_FALSE(restored.exists(volatileId));
+    // The volatile entity's slot is freed like in storage()
+    EntityId recycled = restored.generateNewId();
+    EXPECT_EQ(entityIndex(volatileId), entityIndex(recycled));
+    EXPECT_NE(volatileId, recycled);
+}
+
+
+TEST(EntityManager, DeltaSnapshotIsUnaffectedByLaterChanges) {
+    ComponentFactory factory;
+    EntityManager entityManager;
+    EntityId entityId = entityManager.generateNewId();
+    auto component = static_cast<ClonedComponent*>(
+        entityManager.addComponent(entityId, make_unique<ClonedComponent>())
+    );
+    StorageContainer base = entityManager.storage(factory);
+    entityManager.beginJournal();
+    component->m_position = 1;
+    component->markUnsavedChange();
+    auto buildDelta = entityManager.snapshotDelta(factory);
+    // Changes after the snapshot belong to the next delta
+    component->m_position = 2;
+    component->markUnsavedChange();
+    EntityManager restored;
+    restored.restore(base, factory);
+    restored.applyDelta(buildDelta(), factory);
+    auto restoredComponent = static_cast<ClonedComponent*>(
+        restored.getComponent(entityId, ClonedComponent::TYPE_ID)
+    );
+    ASSERT_NE(nullptr, restoredComponent);
+    EXPECT_EQ(1, restoredComponent->m_position);
+    restored.applyDelta(entityManager.storageDelta(factory), factory);
+    restoredComponent = static_cast<ClonedComponent*>(
+        restored.getComponent(entityId, ClonedComponent::TYPE_ID)
+    );
+    ASSERT_NE(nullptr, restoredComponent);
+    EXPECT_EQ(2, restoredComponent->m_position);
+}
@@ -0,0 +1,70 @@
+#include "engine/entity_map.h"
+
+#include <gtest/gtest.h>
+
+using namespace thrive;
+
+
+TEST(EntityMap, InsertAndErase) {
+    EntityMap<int> map;
+    for (EntityId id = 1; id <= 10; ++id) {
+        map[id] = id * 10;
+    }
+    EXPECT_EQ(10, map.size());
+    // Erasing from the middle moves the last entry into the gap
+    EXPECT_EQ(1, map.erase(3));
+    EXPECT_EQ(0, map.erase(3));
+    EXPECT_EQ(9, map.size());
+    EXPECT_EQ(0, map.count(3));
+    for (EntityId id = 1; id <= 10; ++id) {
+        if (id != 3) {
+            EXPECT_EQ(int(id * 10), map.at(id));
+        }
+    }
+    // Iteration visits every entry once
+    int sum = 0;
+    for (const auto& entry : map) {
+        sum += entry.second;
+    }
+    EXPECT_EQ(550 - 30, sum);
+}
+
+
+TEST(EntityMap, StaleIds) {
+    EntityMap<int> map;
+    EntityId current = makeEntityId(5, 1);
+    map[current] = 1;
+    EXPECT_EQ(1, map.count(current));
+    EXPECT_EQ(0, map.count(makeEntityId(5, 0)));
+    EXPECT_TRUE(map.find(makeEntityId(5, 0)) == map.end());
+    EXPECT_EQ(0, map.erase(makeEntityId(5, 0)));
+    EXPECT_EQ(1, map.size());
+}
+
+
+TEST(EntityMap, ClearAndCopy) {
+    EntityMap<int> map;
+    map[1] = 1;
+    map[5000] = 2;
+    EntityMap<int> copy = map;
+    map.clear();
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(0, map.count(5000));
+    EXPECT_EQ(2, copy.size());
+    EXPECT_EQ(2, copy.at(5000));
+}
+
+
+TEST(EntitySet, InsertAndErase) {
+    EntitySet set;
+    EXPECT_TRUE(set.insert(1));
+    EXPECT_FALSE(set.insert(1));
+    EXPECT_TRUE(set.insert(2));
+    EXPECT_EQ(2, set.size());
+    EXPECT_EQ(1, set.erase(1));
+    EXPECT_EQ(0, set.count(1));
+    EXPECT_EQ(1, set.count(2));
+    set.clear();
+    EXPECT_TRUE(set.empty());
+    EXPECT_EQ(0, set.count(2));
+}
@@ -0,0 +1,134 @@
+#include "engine/prefab.h"
+
+#include "engine/component_factory.h"
+#include "engine/entity_command_buffer.h"
+#include "engine/entity_manager.h"
+#include "engine/serialization.h"
+#include "engine/tests/test_component.h"
+#include "util/make_unique.h"
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+using namespace thrive;
+
+namespace {
+
+// Copied with its copy constructor
+class ClonedComponent : public Component {
+    COMPONENT(PrefabTestClonedComponent)
+
+public:
+
+    void
+    load(
+        const StorageContainer& storage
+    ) override {
+        Component::load(storage);
+    }
+
+    StorageContainer
+    storage() const override {
+        return Component::storage();
+    }
+
+    std::shared_ptr<int> m_shared;
+
+    int m_value = 0;
+
+};
+
+
+// Copied through its storage
+class LoadedComponent : public Component {
+    COMPONENT(PrefabTestLoadedComponent)
+
+public:
+
+    void
+    load(
+        const StorageContainer& storage
+    ) override {
+        Component::load(storage);
+        m_value = storage.get<int>("value");
+    }
+
+    StorageContainer
+    storage() const override {
+        StorageContainer storage = Component::storage();
+        storage.set<int>("value", m_value);
+        return storage;
+    }
+
+    int m_value = 0;
+
+};
+
+}
+
+REGISTER_COMPONENT(ClonedComponent)
+REGISTER_COMPONENT_CLONER(ClonedComponent)
+REGISTER_COMPONENT(LoadedComponent)
+
+
+TEST(Prefab, Instantiate) {
+    ComponentFactory factory;
+    EntityManager entityManager;
+    EntityCommandBuffer commandBuffer(entityManager);
+    Prefab prefab(factory);
+    auto cloned = prefab.addComponent(make_unique<ClonedComponent>());
+    cloned->m_shared = std::make_shared<int>(42);
+    cloned->m_value = 1;
+    auto loaded = prefab.addComponent(make_unique<LoadedComponent>());
+    loaded->m_value = 2;
+    std::vector<EntityId> entityIds = prefab.instantiate(
+        commandBuffer,
+        10,
+        [] (const Prefab::Instance& instance) {
+            instance.getComponent<ClonedComponent>()->m_value += instance.index();
+        }
+    );
+    ASSERT_EQ(10, entityIds.size());
+    // Nothing is added before the flush
+    EXPECT_FALSE(entityManager.exists(entityIds[0]));
+    commandBuffer.flush();
+    for (size_t i = 0; i < entityIds.size(); ++i) {
+        auto clonedCopy = entityManager.getComponent<ClonedComponent>(entityIds[i]);
+        auto loadedCopy = entityManager.getComponent<LoadedComponent>(entityIds[i]);
+        ASSERT_TRUE(nullptr != clonedCopy);
+        ASSERT_TRUE(nullptr != loadedCopy);
+        EXPECT_NE(cloned, clonedCopy);
+        EXPECT_EQ(entityIds[i], clonedCopy->owner());
+        EXPECT_EQ(cloned->m_shared, clonedCopy->m_shared);
+        EXPECT_EQ(1 + static_cast<int>(i), clonedCopy->m_value);
+        EXPECT_EQ(2, loadedCopy->m_value);
+    }
+    // The prototypes are untouched
+    EXPECT_EQ(NULL_ENTITY, cloned->owner());
+    EXPECT_EQ(1, cloned->m_value);
+}
+
+
+TEST(Prefab, ReplacePrototype) {
+    ComponentFactory factory;
+    EntityManager entityManager;
+    EntityCommandBuffer commandBuffer(entityManager);
+    Prefab prefab(factory);
+    prefab.addComponent(make_unique<LoadedComponent>());
+    auto replacement = prefab.addComponent(make_unique<LoadedComponent>());
+    replacement->m_value = 3;
+    EXPECT_EQ(replacement, prefab.getComponent(LoadedComponent::TYPE_ID));
+    EntityId entityId = prefab.instantiate(commandBuffer, 1).at(0);
+    commandBuffer.flush();
+    EXPECT_EQ(3, entityManager.getComponent<LoadedComponent>(entityId)->m_value);
+}
+
+
+TEST(Prefab, UnknownType) {
+    ComponentFactory factory;
+    Prefab prefab(factory);
+    EXPECT_THROW(
+        prefab.addComponent(make_unique<TestComponent<0>>()),
+        std::runtime_error
+    );
+}
@@ -0,0 +1,76 @@
+#include "engine/profiler.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace thrive;
+
+
+TEST(Profiler, Scope) {
+    Profiler profiler;
+    profiler.beginFrame();
+    {
+        Profiler::Scope scope(&profiler, "Outer");
+        Profiler::Scope innerScope(&profiler, "Inner");
+        innerScope.addArgument("count", 3);
+    }
+    auto samples = profiler.samples();
+    ASSERT_EQ(2, samples.size());
+    // Inner scopes finish first
+    EXPECT_EQ("Inner", samples[0].name);
+    EXPECT_EQ("Outer", samples[1].name);
+    EXPECT_EQ(1, samples[0].frame);
+    EXPECT_LE(samples[1].start, samples[0].start);
+    EXPECT_GE(samples[1].duration, samples[0].duration);
+    ASSERT_EQ(1, samples[0].arguments.size());
+    EXPECT_EQ("count", samples[0].arguments[0].first);
+    EXPECT_EQ(3, samples[0].arguments[0].second);
+}
+
+
+TEST(Profiler, Disabled) {
+    Profiler profiler;
+    profiler.setEnabled(false);
+    {
+        Profiler::Scope scope(&profiler, "Ignored");
+    }
+    {
+        Profiler::Scope scope(nullptr, "Ignored");
+    }
+    EXPECT_TRUE(profiler.samples().empty());
+}
+
+
+TEST(Profiler, RingBuffer) {
+    Profiler profiler(4);
+    for (int frame = 0; frame < 3; ++frame) {
+        profiler.beginFrame();
+        Profiler::Scope first(&profiler, "First");
+        Profiler::Scope second(&profiler, "Second");
+    }
+    // Only the last four samples are kept
+    auto samples = profiler.samples();
+    ASSERT_EQ(4, samples.size());
+    EXPECT_EQ(2, samples[0].frame);
+    EXPECT_EQ(3, samples[3].frame);
+    // The last frame only
+    EXPECT_EQ(2, profiler.samples(1).size());
+    profiler.clear();
+    EXPECT_TRUE(profiler.samples().empty());
+}
+
+
+TEST(Profiler, ChromeTrace) {
+    Profiler profiler;
+    {
+        Profiler::Scope scope(&profiler, "Quoted \"name\"");
+        scope.addArgument("entities", 12);
+    }
+    std::ostringstream stream;
+    profiler.writeChromeTrace(stream);
+    std::string trace = stream.str();
+    EXPECT_EQ(0, trace.find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"Quoted \\\"name\\\"\""));
+    EXPECT_NE(std::string::npos, trace.find("\"ph\":\"X\""));
+    EXPECT_NE(std::string::npos, trace.find("\"entities\":12"));
+}
@@ -0,0 +1,153 @@
+#include "engine/savegame_writer.h"
+
+#include "engine/serialization.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+
+using namespace thrive;
+
+namespace fs = boost::filesystem;
+
+
+TEST(SavegameWriter, WritesInBackground) {
+    fs::path path = fs::temp_directory_path() / fs::unique_path();
+    StorageContainer savegame;
+    savegame.set<int32_t>("answer", 42);
+    std::string completedFile;
+    std::string completionError = "not called";
+    float lastProgress = 0.0f;
+    SavegameWriter writer;
+    writer.write(
+        path.string(),
+        std::move(savegame),
+        [&lastProgress] (const std::string&, float progress) {
+            lastProgress = progress;
+        },
+        [&] (const std::string& filename, const std::string& error) {
+            completedFile = filename;
+            completionError = error;
+        }
+    );
+    writer.wait();
+    EXPECT_FALSE(writer.isBusy());
+    // Callbacks only run during poll()
+    EXPECT_EQ("not called", completionError);
+    writer.poll();
+    EXPECT_EQ(path.string(), completedFile);
+    EXPECT_EQ("", completionError);
+    EXPECT_EQ(1.0f, lastProgress);
+    EXPECT_FALSE(fs::exists(path.string() + ".tmp"));
+    std::ifstream stream(path.string(), std::ifstream::binary);
+    StorageContainer loaded;
+    stream >> loaded;
+    EXPECT_EQ(42, loaded.get<int32_t>("answer"));
+    stream.close();
+    fs::remove(path);
+}
+
+
+TEST(SavegameWriter, ReportsErrors) {
+    fs::path path = fs::temp_directory_path() / fs::unique_path() / "missing_directory" / "file.sav";
+    std::string completionError;
+    SavegameWriter writer;
+    writer.write(
+        path.string(),
+        StorageContainer(),
+        nullptr,
+        [&completionError] (const std::string&, const std::string& error) {
+            completionError = error;
+        }
+    );
+    writer.wait();
+    writer.poll();
+    EXPECT_NE("", completionError);
+    EXPECT_FALSE(fs::exists(path));
+}
+
+
+TEST(SavegameWriter, BuildsSavegameOnWorkerThread) {
+    fs::path path = fs::temp_directory_path() / fs::unique_path();
+    boost::thread::id builderThread;
+    std::string completionError = "not called";
+    SavegameWriter writer;
+    writer.write(
+        path.string(),
+        [&builderThread] () -> StorageContainer {
+            builderThread = boost::this_thread::get_id();
+            StorageContainer savegame;
+            savegame.set<int32_t>("answer", 42);
+            return savegame;
+        },
+        nullptr,
+        [&completionError] (const std::string&, const std::string& error) {
+            completionError = error;
+        }
+    );
+    writer.wait();
+    writer.poll();
+    EXPECT_EQ("", completionError);
+    EXPECT_NE(boost::thread::id(), builderThread);
+    EXPECT_NE(boost::this_thread::get_id(), builderThread);
+    std::ifstream stream(path.string(), std::ifstream::binary);
+    StorageContainer loaded;
+    stream >> loaded;
+    EXPECT_EQ(42, loaded.get<int32_t>("answer"));
+    stream.close();
+    fs::remove(path);
+    // Failures while building are reported like write errors
+    writer.write(
+        path.string(),
+        [] () -> StorageContainer {
+            throw std::runtime_error("snapshot failed");
+        },
+        nullptr,
+        [&completionError] (const std::string&, const std::string& error) {
+            completionError = error;
+        }
+    );
+    writer.wait();
+    writer.poll();
+    EXPECT_NE(std::string::npos, completionError.find("snapshot failed"));
+    EXPECT_FALSE(fs::exists(path));
+}
+
+
+TEST(SavegameWriter, AppendsRecords) {
+    fs::path path = fs::temp_directory_path() / fs::unique_path();
+    {
+        std::ofstream stream(path.string(), std::ofstream::binary);
+        stream << "stale records";
+    }
+    SavegameWriter writer;
+    for (int32_t i = 0; i < 2; ++i) {
+        StorageContainer record;
+        record.set<int32_t>("index", i);
+        writer.appendRecord(path.string(), std::move(record), nullptr, i == 0);
+    }
+    // Built on the worker thread
+    writer.appendRecord(
+        path.string(),
+        [] () -> StorageContainer {
+            StorageContainer record;
+            record.set<int32_t>("index", 2);
+            return record;
+        },
+        nullptr
+    );
+    writer.wait();
+    // A record cut short by a crash
+    {
+        std::ofstream stream(path.string(), std::ofstream::app | std::ofstream::binary);
+        stream.write("\x40\0\0\0\0\0\0\0abc", 11);
+    }
+    auto records = SavegameWriter::readRecords(path.string());
+    ASSERT_EQ(3u, records.size());
+    for (int32_t i = 0; i < 3; ++i) {
+        EXPECT_EQ(i, records[i].get<int32_t>("index"));
+    }
+    fs::remove(path);
+    EXPECT_TRUE(SavegameWriter::readRecords(path.string()).empty());
+}
@@ -1,6 +1,13 @@
 #include "engine/serialization.h"
 
+#include "engine/compression.h"
+#include "engine/thread_pool.h"
+
+#include <boost/filesystem.hpp>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <limits>
+#include <stdexcept>
 
 using namespace thrive;
 
@@ -66,6 +73,29 @@ TEST(Serialization, double) {
 }
 
 
+TEST(Serialization, FloatsAreLittleEndian) {
+    // The value is the last thing written for a single entry
+    auto lastBytes = [] (const StorageContainer& container, size_t count) {
+        std::ostringstream stream(std::ios_base::out | std::ios_base::binary);
+        stream << container;
+        std::string data = stream.str();
+        return data.substr(data.size() - count);
+    };
+    StorageContainer floatContainer;
+    floatContainer.set<float>("value", 1.0f);
+    EXPECT_EQ(
+        std::string("\x00\x00\x80\x3f", 4),
+        lastBytes(floatContainer, 4)
+    );
+    StorageContainer doubleContainer;
+    doubleContainer.set<double>("value", -2.0);
+    EXPECT_EQ(
+        std::string("\x00\x00\x00\x00\x00\x00\x00\xc0", 8),
+        lastBytes(doubleContainer, 8)
+    );
+}
+
+
 TEST(Serialization, integer) {
     testSerialization(2001);
     testSerialization(-18000);
@@ -109,3 +139,196 @@ TEST(Serialization, Vector3) {
 
 
 
+TEST(Serialization, LargeIntegers) {
+    testSerialization(std::numeric_limits<int64_t>::min());
+    testSerialization(std::numeric_limits<int64_t>::max());
+    testSerialization(std::numeric_limits<uint64_t>::max());
+    testSerialization<int8_t>(-1);
+}
+
+
+TEST(Serialization, StorageList) {
+    StorageList list;
+    for (int i = 0; i < 3; ++i) {
+        StorageContainer element;
+        element.set<int32_t>("index", i);
+        element.set<std::string>("name", "element");
+        list.append(std::move(element));
+    }
+    StorageList listCopy = copy(list);
+    ASSERT_EQ(3, listCopy.size());
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(i, listCopy[i].get<int32_t>("index"));
+        EXPECT_EQ("element", listCopy[i].get<std::string>("name"));
+    }
+}
+
+
+TEST(Serialization, Emplace) {
+    StorageContainer container;
+    container.set<int32_t>("value", 1);
+    StorageList& list = container.emplace<StorageList>("list");
+    for (int32_t i = 0; i < 10; ++i) {
+        list.emplace().set<int32_t>("index", i);
+    }
+    // Emplacing overwrites
+    container.emplace<StorageContainer>("value").set<std::string>("name", "nested");
+    // Setting overwrites as well, without adding a key
+    container.set<int32_t>("other", 1);
+    container.set<int32_t>("other", 2);
+    EXPECT_EQ(3u, container.keys().size());
+    StorageContainer containerCopy = copy(container);
+    StorageList listCopy = containerCopy.get<StorageList>("list");
+    ASSERT_EQ(10u, listCopy.size());
+    EXPECT_EQ(9, listCopy[9].get<int32_t>("index"));
+    EXPECT_FALSE(containerCopy.contains<int32_t>("value"));
+    EXPECT_EQ("nested", containerCopy.get<StorageContainer>("value").get<std::string>("name"));
+    EXPECT_EQ(2, containerCopy.get<int32_t>("other"));
+}
+
+
+TEST(Serialization, RepeatedKeysAreWrittenOnce) {
+    const std::string key = "linearVelocity";
+    StorageList list;
+    for (int i = 0; i < 100; ++i) {
+        StorageContainer element;
+        element.set<float>(key, 1.5f * i);
+        list.append(std::move(element));
+    }
+    StorageContainer container;
+    container.set("list", list);
+    std::ostringstream stream(std::ios_base::out | std::ios_base::binary);
+    stream << container;
+    // Size, entry count, key reference, type id and float per element, plus
+    // the header and the key itself
+    EXPECT_LT(stream.str().size(), 100 * (sizeof(float) + 8) + key.size() + 64);
+}
+
+
+TEST(Serialization, ReadVersion1) {
+    // Version 1 has no header, sizes are native uint64_t and floats are
+    // stored as strings
+    std::ostringstream stream(std::ios_base::out | std::ios_base::binary);
+    auto writeInteger = [&stream] (uint64_t value, size_t size) {
+        stream.write(reinterpret_cast<const char*>(&value), size);
+    };
+    auto writeString = [&stream, &writeInteger] (const std::string& string) {
+        writeInteger(string.size(), sizeof(uint64_t));
+        stream.write(string.data(), string.size());
+    };
+    writeInteger(2, sizeof(uint64_t));
+    writeString("float");
+    writeInteger(176, sizeof(uint16_t));
+    writeString("2.5");
+    writeString("container");
+    writeInteger(224, sizeof(uint16_t));
+    writeInteger(1, sizeof(uint64_t));
+    writeString("value");
+    writeInteger(80, sizeof(uint16_t));
+    writeInteger(42, sizeof(int32_t));
+    std::istringstream inputStream(
+        stream.str(),
+        std::ios_base::in | std::ios_base::binary
+    );
+    StorageContainer container;
+    inputStream >> container;
+    EXPECT_FLOAT_EQ(2.5f, container.get<float>("float"));
+    EXPECT_EQ(42, container.get<StorageContainer>("container").get<int32_t>("value"));
+}
+
+
+TEST(Serialization, UnknownVersion) {
+    std::ostringstream stream(std::ios_base::out | std::ios_base::binary);
+    stream << StorageContainer();
+    std::string data = stream.str();
+    // The version follows the magic number
+    data[8] = 99;
+    std::istringstream inputStream(data, std::ios_base::in | std::ios_base::binary);
+    StorageContainer container;
+    EXPECT_THROW(inputStream >> container, std::runtime_error);
+}
+
+
+TEST(Serialization, ReadVersion2) {
+    // Version 2 has no string table and no container sizes
+    const char data[] = {
+        'T', 'H', 'R', 'I', 'V', 'E', '\x1a', '\0',
+        2, // Version
+        1, // Entries
+        0, 5, 'v', 'a', 'l', 'u', 'e', // New key
+        80, // int32_t
+        84 // 42, zigzag encoded
+    };
+    std::istringstream inputStream(
+        std::string(data, sizeof(data)),
+        std::ios_base::in | std::ios_base::binary
+    );
+    StorageContainer container;
+    inputStream >> container;
+    EXPECT_EQ(42, container.get<int32_t>("value"));
+}
+
+
+TEST(Serialization, ReadFile) {
+    namespace fs = boost::filesystem;
+    fs::path path = fs::temp_directory_path() / fs::unique_path();
+    {
+        StorageList list;
+        for (int i = 0; i < 10; ++i) {
+            StorageContainer element;
+            element.set<int32_t>("index", i);
+            list.append(std::move(element));
+        }
+        StorageContainer nested;
+        nested.set("list", list);
+        nested.set<std::string>("name", "nested");
+        StorageContainer container;
+        container.set("nested", nested);
+        container.set<float>("float", 1.5f);
+        std::ofstream stream(path.string(), std::ofstream::binary);
+        stream << container;
+    }
+    StorageContainer container = StorageContainer::readFile(path.string());
+    EXPECT_EQ(1.5f, container.get<float>("float"));
+    // Copies of undecoded containers decode independently
+    StorageContainer nested = container.get<StorageContainer>("nested");
+    StorageContainer nestedCopy = nested;
+    EXPECT_EQ("nested", nested.get<std::string>("name"));
+    StorageList list = nestedCopy.get<StorageList>("list");
+    ASSERT_EQ(10, list.size());
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(i, list[i].get<int32_t>("index"));
+    }
+    fs::remove(path);
+}
+
+
+TEST(Serialization, Truncated) {
+    StorageContainer nested;
+    nested.set<std::string>("name", "nested");
+    StorageContainer container;
+    container.set("nested", nested);
+    std::ostringstream stream(std::ios_base::out | std::ios_base::binary);
+    stream << container;
+    std::string data = stream.str();
+    data.resize(data.size() - 3);
+    std::istringstream inputStream(data, std::ios_base::in | std::ios_base::binary);
+    StorageContainer copy;
+    EXPECT_THROW(inputStream >> copy, std::runtime_error);
+}
+
+
+TEST(Serialization, Compressed) {
+    StorageContainer container;
+    container.set<std::string>("name", "compressed");
+    std::ostringstream stream(std::ios_base::out | std::ios_base::binary);
+    stream << container;
+    std::string data = stream.str();
+    std::istringstream inputStream(
+        compress(data.data(), data.size(), ThreadPool::shared()),
+        std::ios_base::in | std::ios_base::binary
+    );
+    StorageContainer copy;
+    inputStream >> copy;
+    EXPECT_EQ("compressed", copy.get<std::string>("name"));
+}
@@ -0,0 +1,114 @@
+#include "engine/system_scheduler.h"
+
+#include "engine/profiler.h"
+#include "engine/system.h"
+#include "engine/thread_pool.h"
+
+#include <atomic>
+#include <gtest/gtest.h>
+
+using namespace thrive;
+
+
+namespace {
+
+class TestSystem : public System {
+
+public:
+
+    TestSystem(
+        std::atomic<int>& clock
+    ) : m_clock(clock)
+    {
+    }
+
+    void
+    update(
+        int
+    ) override {
+        m_updatedAt = m_clock++;
+    }
+
+    std::atomic<int>& m_clock;
+
+    int m_updatedAt = -1;
+
+};
+
+}
+
+
+TEST(SystemScheduler, Levels) {
+    std::atomic<int> clock{0};
+    TestSystem writeA(clock);
+    writeA.setComponentAccess({}, {1});
+    TestSystem writeB(clock);
+    writeB.setComponentAccess({}, {2});
+    TestSystem readA(clock);
+    readA.setComponentAccess({1}, {3});
+    TestSystem undeclared(clock);
+    TestSystem readB(clock);
+    readB.setComponentAccess({2}, {});
+    readB.setRequiresMainThread(false);
+    ThreadPool pool(2);
+    SystemScheduler scheduler(pool);
+    scheduler.setSystems({&writeA, &writeB, &readA, &undeclared, &readB});
+    const auto& levels = scheduler.levels();
+    ASSERT_EQ(4, levels.size());
+    // writeA and writeB don't conflict
+    EXPECT_EQ(2, levels[0].mainThreadSystems.size());
+    EXPECT_EQ(&writeA, levels[0].mainThreadSystems[0]);
+    EXPECT_EQ(&writeB, levels[0].mainThreadSystems[1]);
+    // readA has to wait for writeA
+    ASSERT_EQ(1, levels[1].mainThreadSystems.size());
+    EXPECT_EQ(&readA, levels[1].mainThreadSystems[0]);
+    // Undeclared systems run alone
+    ASSERT_EQ(1, levels[2].mainThreadSystems.size());
+    EXPECT_EQ(&undeclared, levels[2].mainThreadSystems[0]);
+    ASSERT_EQ(1, levels[3].workerSystems.size());
+    EXPECT_EQ(&readB, levels[3].workerSystems[0]);
+    scheduler.update(10);
+    EXPECT_LT(writeA.m_updatedAt, readA.m_updatedAt);
+    EXPECT_LT(readA.m_updatedAt, undeclared.m_updatedAt);
+    EXPECT_LT(undeclared.m_updatedAt, readB.m_updatedAt);
+}
+
+
+TEST(SystemScheduler, SkipsDisabledSystems) {
+    std::atomic<int> clock{0};
+    TestSystem first(clock);
+    first.setComponentAccess({}, {1});
+    first.setRequiresMainThread(false);
+    TestSystem second(clock);
+    second.setComponentAccess({}, {2});
+    second.setRequiresMainThread(false);
+    second.setEnabled(false);
+    ThreadPool pool(2);
+    SystemScheduler scheduler(pool);
+    scheduler.setSystems({&first, &second});
+    ASSERT_EQ(1, scheduler.levels().size());
+    EXPECT_EQ(2, scheduler.levels()[0].workerSystems.size());
+    scheduler.update(10);
+    EXPECT_EQ(0, first.m_updatedAt);
+    EXPECT_EQ(-1, second.m_updatedAt);
+}
+
+
+TEST(SystemScheduler, ProfilesSystems) {
+    std::atomic<int> clock{0};
+    TestSystem named(clock);
+    named.setName("Named");
+    named.setComponentAccess({}, {1});
+    named.setRequiresMainThread(false);
+    TestSystem unnamed(clock);
+    ThreadPool pool(1);
+    Profiler profiler;
+    SystemScheduler scheduler(pool);
+    scheduler.setSystems({&named, &unnamed});
+    scheduler.setProfiler(&profiler);
+    scheduler.update(10);
+    auto samples = profiler.samples();
+    ASSERT_EQ(2, samples.size());
+    EXPECT_EQ("Named", samples[0].name);
+    EXPECT_EQ("System", samples[1].name);
+}
@@ -0,0 +1,99 @@
+#include "engine/thread_pool.h"
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+
+using namespace thrive;
+
+
+TEST(ThreadPool, RunsEveryTaskOnce) {
+    ThreadPool pool(3);
+    std::vector<std::atomic<int>> counts(1000);
+    pool.run(
+        counts.size(),
+        [&counts] (size_t index) {
+            counts[index] += 1;
+        }
+    );
+    for (const auto& count : counts) {
+        EXPECT_EQ(1, count.load());
+    }
+}
+
+
+TEST(ThreadPool, WithoutWorkers) {
+    ThreadPool pool(0);
+    int sum = 0;
+    pool.run(
+        10,
+        [&sum] (size_t index) {
+            sum += index;
+        }
+    );
+    EXPECT_EQ(45, sum);
+}
+
+
+TEST(ThreadPool, NestedJobs) {
+    ThreadPool pool(2);
+    std::atomic<int> sum{0};
+    pool.run(
+        4,
+        [&pool, &sum] (size_t) {
+            pool.run(
+                4,
+                [&sum] (size_t) {
+                    sum += 1;
+                }
+            );
+        }
+    );
+    EXPECT_EQ(16, sum.load());
+}
+
+
+TEST(ThreadPool, WorkerIndex) {
+    ThreadPool pool(3);
+    EXPECT_EQ(3u, pool.workerIndex());
+    std::vector<std::atomic<int>> threadTasks(pool.workerCount() + 1);
+    pool.run(
+        1000,
+        [&pool, &threadTasks] (size_t) {
+            unsigned int index = pool.workerIndex();
+            EXPECT_EQ(index < pool.workerCount(), pool.isWorkerThread());
+            threadTasks.at(index) += 1;
+        }
+    );
+    int total = 0;
+    for (const auto& count : threadTasks) {
+        total += count.load();
+    }
+    EXPECT_EQ(1000, total);
+}
+
+
+TEST(ThreadPool, PropagatesExceptions) {
+    ThreadPool pool(2);
+    EXPECT_THROW(
+        pool.run(
+            8,
+            [] (size_t index) {
+                if (index == 5) {
+                    throw std::runtime_error("Task failed");
+                }
+            }
+        ),
+        std::runtime_error
+    );
+    // The pool is still usable
+    std::atomic<int> count{0};
+    pool.run(
+        8,
+        [&count] (size_t) {
+            count += 1;
+        }
+    );
+    EXPECT_EQ(8, count.load());
+}
@@ -0,0 +1,244 @@
+#include "engine/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
+using namespace thrive;
+
+namespace {
+
+struct Job {
+
+    Job(
+        size_t count,
+        ThreadPool::Task task
+    ) : count(count),
+        task(std::move(task))
+    {
+    }
+
+    size_t count;
+
+    std::exception_ptr error;
+
+    boost::mutex errorMutex;
+
+    std::atomic<size_t> finished{0};
+
+    std::atomic<size_t> next{0};
+
+    ThreadPool::Task task;
+
+};
+
+// A job started with start() that still needs its wait()
+struct PendingJob {
+
+    const void* pool;
+
+    std::shared_ptr<Job> job;
+
+};
+
+// Jobs are waited for in reverse order of starting, on the same thread
+thread_local std::vector<PendingJob> t_pendingJobs;
+
+// The pool the current thread works for, if any
+thread_local const void* t_workerPool = nullptr;
+
+// The current thread's index among its pool's workers
+thread_local unsigned int t_workerIndex = 0;
+
+}
+
+
+struct ThreadPool::Implementation {
+
+    // Runs unclaimed tasks of the job until none are left
+    void
+    work(
+        Job& job
+    ) {
+        while (true) {
+            size_t index = job.next.fetch_add(1);
+            if (index >= job.count) {
+                return;
+            }
+            try {
+                job.task(index);
+            }
+            catch (...) {
+                boost::lock_guard<boost::mutex> lock(job.errorMutex);
+                if (not job.error) {
+                    job.error = std::current_exception();
+                }
+            }
+            if (job.finished.fetch_add(1) + 1 == job.count) {
+                boost::lock_guard<boost::mutex> lock(m_mutex);
+                m_jobFinished.notify_all();
+            }
+        }
+    }
+
+    // Returns the oldest job with unclaimed tasks, if any
+    std::shared_ptr<Job>
+    nextJob() const {
+        for (const auto& job : m_jobs) {
+            if (job->next.load() < job->count) {
+                return job;
+            }
+        }
+        return nullptr;
+    }
+
+    void
+    workerLoop(
+        unsigned int index
+    ) {
+        t_workerPool = this;
+        t_workerIndex = index;
+        while (true) {
+            std::shared_ptr<Job> job;
+            {
+                boost::unique_lock<boost::mutex> lock(m_mutex);
+                while (not m_isShuttingDown and not (job = this->nextJob())) {
+                    m_jobAvailable.wait(lock);
+                }
+                if (m_isShuttingDown) {
+                    return;
+                }
+            }
+            this->work(*job);
+        }
+    }
+
+    bool m_isShuttingDown = false;
+
+    std::vector<std::shared_ptr<Job>> m_jobs;
+
+    boost::condition_variable m_jobAvailable;
+
+    boost::condition_variable m_jobFinished;
+
+    boost::mutex m_mutex;
+
+    std::vector<boost::thread> m_workers;
+
+};
+
+
+ThreadPool&
+ThreadPool::shared() {
+    static ThreadPool pool(
+        std::max(1u, boost::thread::hardware_concurrency()) - 1
+    );
+    return pool;
+}
+
+
+ThreadPool::ThreadPool(
+    unsigned int workerCount
+) : m_impl(new Implementation())
+{
+    m_impl->m_workers.reserve(workerCount);
+    Implementation* impl = m_impl.get();
+    for (unsigned int i = 0; i < workerCount; ++i) {
+        m_impl->m_workers.emplace_back([impl, i] () {
+            impl->workerLoop(i);
+        });
+    }
+}
+
+
+ThreadPool::~ThreadPool() {
+    {
+        boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+        m_impl->m_isShuttingDown = true;
+        m_impl->m_jobAvailable.notify_all();
+    }
+    for (boost::thread& worker : m_impl->m_workers) {
+        worker.join();
+    }
+}
+
+
+bool
+ThreadPool::isWorkerThread() const {
+    return t_workerPool == m_impl.get();
+}
+
+
+void
+ThreadPool::run(
+    size_t taskCount,
+    Task task
+) {
+    this->start(taskCount, std::move(task));
+    this->wait();
+}
+
+
+void
+ThreadPool::start(
+    size_t taskCount,
+    Task task
+) {
+    PendingJob pending;
+    pending.pool = m_impl.get();
+    pending.job = std::make_shared<Job>(taskCount, std::move(task));
+    // A single task is cheaper to run on the waiting thread
+    if (taskCount > 1 or (taskCount == 1 and not this->isWorkerThread())) {
+        boost::lock_guard<boost::mutex> lock(m_impl->m_mutex);
+        m_impl->m_jobs.push_back(pending.job);
+        m_impl->m_jobAvailable.notify_all();
+    }
+    t_pendingJobs.push_back(std::move(pending));
+}
+
+
+void
+ThreadPool::wait() {
+    if (t_pendingJobs.empty() or t_pendingJobs.back().pool != m_impl.get()) {
+        throw std::logic_error("ThreadPool::wait() without matching start()");
+    }
+    PendingJob pending = std::move(t_pendingJobs.back());
+    t_pendingJobs.pop_back();
+    Job& job = *pending.job;
+    m_impl->work(job);
+    {
+        boost::unique_lock<boost::mutex> lock(m_impl->m_mutex);
+        while (job.finished.load() != job.count) {
+            m_impl->m_jobFinished.wait(lock);
+        }
+        auto& jobs = m_impl->m_jobs;
+        jobs.erase(
+            std::remove(jobs.begin(), jobs.end(), pending.job),
+            jobs.end()
+        );
+    }
+    if (job.error) {
+        std::rethrow_exception(job.error);
+    }
+}
+
+
+unsigned int
+ThreadPool::workerCount() const {
+    return m_impl->m_workers.size();
+}
+
+
+unsigned int
+ThreadPool::workerIndex() const {
+    if (this->isWorkerThread()) {
+        return t_workerIndex;
+    }
+    return this->workerCount();
+}
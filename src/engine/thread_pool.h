@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace thrive {
+
+/**
+* @brief A fixed set of worker threads for running tasks in parallel
+*
+* A job is a number of tasks, identified by their index, that may run in
+* any order and on any thread. Idle threads claim the next unstarted task of
+* the oldest job, so a job with uneven tasks still keeps all threads busy.
+* The thread that waits for a job helps running its tasks.
+*
+* Jobs can be started from within tasks of another job, e.g. by a system
+* that runs on the pool and processes its entities in parallel. Idle workers
+* help with the nested job as well.
+*
+* Usage example:
+* \code
+* ThreadPool& pool = ThreadPool::shared();
+* pool.run(
+*     chunks.size(),
+*     [&chunks] (size_t index) {
+*         processChunk(chunks[index]);
+*     }
+* );
+* \endcode
+*/
+class ThreadPool {
+
+public:
+
+    /**
+    * @brief Function called for every task of a job
+    */
+    using Task = std::function<void(size_t)>;
+
+    /**
+    * @brief Returns the pool shared by the engine
+    *
+    * It has one worker thread less than the machine has hardware threads,
+    * because the thread waiting for a job works as well.
+    */
+    static ThreadPool&
+    shared();
+
+    /**
+    * @brief Constructor
+    *
+    * @param workerCount
+    *   The number of worker threads. With 0, all tasks run on the thread
+    *   that waits for them.
+    */
+    explicit ThreadPool(
+        unsigned int workerCount
+    );
+
+    /**
+    * @brief Destructor
+    *
+    * Waits for the current job and stops the worker threads.
+    */
+    ~ThreadPool();
+
+    /**
+    * @brief Whether the calling thread is one of this pool's workers
+    */
+    bool
+    isWorkerThread() const;
+
+    /**
+    * @brief Runs a job and waits for it
+    *
+    * Equivalent to start() followed by wait().
+    *
+    * @param taskCount
+    *   The number of tasks
+    * @param task
+    *   Called with every index from 0 to \a taskCount - 1
+    */
+    void
+    run(
+        size_t taskCount,
+        Task task
+    );
+
+    /**
+    * @brief Starts a job without waiting for it
+    *
+    * Every call must be paired with a call to wait() on the same thread.
+    *
+    * @param taskCount
+    *   The number of tasks
+    * @param task
+    *   Called with every index from 0 to \a taskCount - 1
+    */
+    void
+    start(
+        size_t taskCount,
+        Task task
+    );
+
+    /**
+    * @brief Waits until the job started last has finished
+    *
+    * The calling thread runs unclaimed tasks while waiting.
+    *
+    * @throws
+    *   The first exception thrown by a task, if any
+    */
+    void
+    wait();
+
+    /**
+    * @brief The number of worker threads
+    */
+    unsigned int
+    workerCount() const;
+
+    /**
+    * @brief The calling thread's index among the threads running tasks
+    *
+    * Workers have the indices 0 to workerCount() - 1, any other thread has
+    * workerCount(). Only one thread that isn't a worker runs the tasks of
+    * a job, the one waiting for it, so per-thread data for a job can be
+    * kept in workerCount() + 1 slots without locking.
+    */
+    unsigned int
+    workerIndex() const;
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
+};
+
+}
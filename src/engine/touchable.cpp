@@ -1,10 +1,28 @@
 #include "engine/touchable.h"
 
+#include "engine/component.h"
 #include "scripting/luabind.h"
 
 using namespace thrive;
 
 
+Touchable::Touchable(
+    const Touchable&
+) : m_component(nullptr),
+    m_hasChanges(true)
+{
+}
+
+
+Touchable&
+Touchable::operator= (
+    const Touchable&
+) {
+    this->touch();
+    return *this;
+}
+
+
 luabind::scope
 Touchable::luaBindings() {
     using namespace luabind;
@@ -22,9 +40,20 @@ Touchable::hasChanges() const {
 }
 
 
+void
+Touchable::setComponent(
+    Component* component
+) {
+    m_component = component;
+}
+
+
 void
 Touchable::touch() {
     m_hasChanges = true;
+    if (m_component) {
+        m_component->touch();
+    }
 }
 
 
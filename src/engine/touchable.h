@@ -6,12 +6,18 @@ namespace luabind {
 
 namespace thrive {
 
+class Component;
+
 /**
 * @brief Helper class for keeping track of changing data
 *
 * Properties of components should be derived from Touchable so that the system
 * that handles the component can quickly check for any changes.
 *
+* If the component passes itself to setComponent(), touching also marks the
+* component as changed (see Component::touch()). Systems can then visit only
+* the changed components instead of checking every component's touchables.
+*
 * @note
 *   A Touchable starts out with <tt> Touchable::hasChanges() == true </tt>
 */
@@ -19,6 +25,29 @@ class Touchable {
 
 public:
 
+    /**
+    * @brief Constructor
+    */
+    Touchable() = default;
+
+    /**
+    * @brief Copy constructor
+    *
+    * The copy has changes, but doesn't belong to a component
+    */
+    Touchable(
+        const Touchable& other
+    );
+
+    /**
+    * @brief Copy assignment
+    *
+    * Keeps the component and touches this
+    */
+    Touchable&
+    operator= (
+        const Touchable& other
+    );
 
     /**
     * @brief Lua bindings
@@ -39,8 +68,23 @@ public:
     bool
     hasChanges() const;
 
+    /**
+    * @brief Sets the component that touch() marks as changed
+    *
+    * Usually called in the component's constructor.
+    *
+    * @param component
+    *   The component this touchable is part of
+    */
+    void
+    setComponent(
+        Component* component
+    );
+
     /**
     * @brief Marks the Touchable as changed
+    *
+    * Also marks the component set with setComponent() as changed.
     */
     void
     touch();
@@ -53,6 +97,8 @@ public:
 
 private:
 
+    Component* m_component = nullptr;
+
     bool m_hasChanges = true;
 };
 
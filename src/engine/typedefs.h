@@ -1,5 +1,6 @@
 #pragma once
 
+#include <bitset>
 #include <cstdint>
 #include <utility>
 
@@ -20,4 +21,61 @@ namespace thrive {
 
     static const ComponentTypeId NULL_COMPONENT_TYPE = 0;
 
+    /**
+    * @brief Maximum number of component types per EntityManager
+    */
+    static const unsigned int MAX_COMPONENT_TYPES = 256;
+
+    /**
+    * @brief Set of component types, one bit per ComponentCollection::maskIndex()
+    *
+    * The bit positions are assigned per EntityManager, so masks from
+    * different managers can't be compared.
+    */
+    using ComponentMask = std::bitset<MAX_COMPONENT_TYPES>;
+
+    /**
+    * @brief Number of low bits of an EntityId that hold the slot index
+    *
+    * The remaining high bits hold the slot's generation, which is incremented
+    * whenever the EntityManager recycles the slot. An id whose generation
+    * does not match its slot's current generation is stale.
+    */
+    static const unsigned int ENTITY_INDEX_BITS = 22;
+
+    static const EntityId ENTITY_INDEX_MASK = (EntityId(1) << ENTITY_INDEX_BITS) - 1;
+
+    static const EntityId ENTITY_GENERATION_MASK = ~EntityId(0) >> ENTITY_INDEX_BITS;
+
+    /**
+    * @brief Extracts the slot index from an entity id
+    */
+    inline uint32_t
+    entityIndex(
+        EntityId entityId
+    ) {
+        return entityId & ENTITY_INDEX_MASK;
+    }
+
+    /**
+    * @brief Extracts the slot generation from an entity id
+    */
+    inline uint32_t
+    entityGeneration(
+        EntityId entityId
+    ) {
+        return entityId >> ENTITY_INDEX_BITS;
+    }
+
+    /**
+    * @brief Combines slot index and generation into an entity id
+    */
+    inline EntityId
+    makeEntityId(
+        uint32_t index,
+        uint32_t generation
+    ) {
+        return ((generation & ENTITY_GENERATION_MASK) << ENTITY_INDEX_BITS) | (index & ENTITY_INDEX_MASK);
+    }
+
 }
@@ -1,11 +1,18 @@
 #include "game.h"
 
 #include "engine/engine.h"
+#include "engine/profiler.h"
 #include "engine/typedefs.h"
 #include "scripting/luabind.h"
 #include "util/make_unique.h"
 
+#include <algorithm>
+#include <assert.h>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/thread.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
 #include <type_traits>
 #include <unordered_map>
 
@@ -19,14 +26,148 @@ struct Game::Implementation {
     Implementation()
     {
         m_targetFrameDuration = boost::chrono::microseconds(1000000 / m_targetFrameRate);
+        this->setSimulationRate(60);
+    }
+
+    void
+    parseArguments(
+        int argc,
+        char* argv[]
+    ) {
+        static const std::string DURATION_OPTION = "--duration=";
+        static const std::string HEADLESS_OPTION = "--headless";
+        static const std::string PROFILE_OPTION = "--profile";
+        static const std::string SIMULATION_RATE_OPTION = "--simulation-rate=";
+        for (int i = 1; i < argc; ++i) {
+            std::string argument = argv[i];
+            if (boost::starts_with(argument, DURATION_OPTION)) {
+                double seconds = std::atof(argument.c_str() + DURATION_OPTION.size());
+                if (seconds > 0) {
+                    m_headlessDuration = boost::chrono::microseconds(
+                        static_cast<boost::chrono::microseconds::rep>(seconds * 1e6)
+                    );
+                }
+                else {
+                    std::cerr << "Invalid duration: " << argument << std::endl;
+                }
+            }
+            else if (argument == HEADLESS_OPTION) {
+                m_engine.setHeadless(true);
+            }
+            else if (argument == PROFILE_OPTION) {
+                m_profileFile = "profile.json";
+            }
+            else if (boost::starts_with(argument, PROFILE_OPTION + "=")) {
+                m_profileFile = argument.substr(PROFILE_OPTION.size() + 1);
+            }
+            else if (boost::starts_with(argument, SIMULATION_RATE_OPTION)) {
+                int rate = std::atoi(argument.c_str() + SIMULATION_RATE_OPTION.size());
+                if (rate > 0 and rate <= 1000) {
+                    this->setSimulationRate(rate);
+                }
+                else {
+                    std::cerr << "Invalid simulation rate: " << argument << std::endl;
+                }
+            }
+            else {
+                std::cerr << "Ignoring unknown argument: " << argument << std::endl;
+            }
+        }
+    }
+
+    void
+    runHeadless() {
+        Profiler& profiler = m_engine.profiler();
+        const auto tickDuration = m_tickDuration;
+        boost::chrono::microseconds simulatedTime(0);
+        unsigned long ticks = 0;
+        auto start = Clock::now();
+        // Run ticks back to back, without rendering or waiting for the
+        // next frame
+        while (not m_quit and simulatedTime < m_headlessDuration) {
+            profiler.beginFrame();
+            Profiler::Scope scope(&profiler, "Game::tick");
+            m_engine.update(this->nextTickMilliseconds());
+            simulatedTime += tickDuration;
+            ticks += 1;
+        }
+        auto wallTime = boost::chrono::duration_cast<boost::chrono::milliseconds>(
+            Clock::now() - start
+        );
+        double simulatedSeconds = simulatedTime.count() / 1e6;
+        std::cout << "Simulated " << ticks << " ticks (" << simulatedSeconds
+            << " s at " << this->effectiveSimulationRate() << " Hz) in "
+            << wallTime.count() << " ms";
+        if (wallTime.count() > 0) {
+            std::cout << ", " << (1000.0 * ticks / wallTime.count()) << " ticks/s";
+        }
+        std::cout << std::endl;
+    }
+
+    double
+    effectiveSimulationRate() const {
+        return 1e6 / m_tickDuration.count();
+    }
+
+    int
+    nextTickMilliseconds() {
+        // Engine::update() takes whole milliseconds, so carry the
+        // sub-millisecond part of each tick over to the next one. Over
+        // time, the ticks add up to exactly the simulated time.
+        m_tickRemainder += m_tickDuration;
+        auto milliseconds = boost::chrono::duration_cast<boost::chrono::milliseconds>(m_tickRemainder);
+        m_tickRemainder -= milliseconds;
+        return milliseconds.count();
+    }
+
+    void
+    saveProfile() {
+        if (m_profileFile.empty()) {
+            return;
+        }
+        try {
+            m_engine.profiler().saveChromeTrace(m_profileFile);
+            std::cout << "Saved profile to " << m_profileFile << std::endl;
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    void
+    setSimulationRate(
+        unsigned short rate
+    ) {
+        m_simulationRate = rate;
+        // Rounded to whole microseconds, so 60 Hz runs at 59.9988 Hz
+        m_tickDuration = boost::chrono::microseconds(
+            (1000000 + rate / 2) / rate
+        );
+        m_tickRemainder = boost::chrono::microseconds(0);
+        m_engine.setTickDuration(m_tickDuration);
     }
 
     Engine m_engine;
 
+    // Simulated time after which a headless run quits
+    boost::chrono::microseconds m_headlessDuration = boost::chrono::seconds(60);
+
+    // Ticks beyond this are dropped, see Game::run()
+    unsigned int m_maxTicksPerFrame = 5;
+
+    std::string m_profileFile;
+
+    unsigned short m_simulationRate = 0;
+
     boost::chrono::microseconds m_targetFrameDuration;
 
     unsigned short m_targetFrameRate = 60;
 
+    boost::chrono::microseconds m_tickDuration;
+
+    // Simulated time not yet passed to Engine::update()
+    boost::chrono::microseconds m_tickRemainder{0};
+
     bool m_quit = false;
 
 };
@@ -61,20 +202,59 @@ Game::quit() {
 
 
 void
-Game::run() {
+Game::run(
+    int argc,
+    char* argv[]
+) {
+    m_impl->parseArguments(argc, argv);
     try {
         unsigned int fpsCount = 0;
         int fpsTime = 0;
+        Engine& engine = m_impl->m_engine;
+        Profiler& profiler = engine.profiler();
+        engine.init();
+        m_impl->m_quit = false;
+        if (engine.isHeadless()) {
+            m_impl->runHeadless();
+            m_impl->saveProfile();
+            engine.shutdown();
+            return;
+        }
         auto lastUpdate = Implementation::Clock::now();
-        m_impl->m_engine.init();
+        // Simulation time that is due but hasn't been simulated yet
+        boost::chrono::microseconds unsimulatedTime(0);
         // Start game loop
-        m_impl->m_quit = false;
         while (not m_impl->m_quit) {
             auto now = Implementation::Clock::now();
             auto delta = now - lastUpdate;
             int milliSeconds = boost::chrono::duration_cast<boost::chrono::milliseconds>(delta).count();
             lastUpdate = now;
-            m_impl->m_engine.update(milliSeconds);
+            profiler.beginFrame();
+            const auto tickDuration = m_impl->m_tickDuration;
+            unsimulatedTime += boost::chrono::duration_cast<boost::chrono::microseconds>(delta);
+            unsigned int ticks = 0;
+            while (
+                unsimulatedTime >= tickDuration and
+                ticks < m_impl->m_maxTicksPerFrame and
+                not m_impl->m_quit
+            ) {
+                Profiler::Scope scope(&profiler, "Game::tick");
+                engine.update(m_impl->nextTickMilliseconds());
+                unsimulatedTime -= tickDuration;
+                ticks += 1;
+            }
+            if (unsimulatedTime >= tickDuration) {
+                // Catching up would make the next frame slower still, so
+                // drop the backlog and let the simulation fall behind
+                unsimulatedTime = boost::chrono::microseconds(
+                    unsimulatedTime.count() % tickDuration.count()
+                );
+            }
+            float interpolation = float(unsimulatedTime.count()) / float(tickDuration.count());
+            {
+                Profiler::Scope scope(&profiler, "Game::render");
+                engine.render(milliSeconds, interpolation);
+            }
             auto frameDuration = Implementation::Clock::now() - now;
             auto sleepDuration = m_impl->m_targetFrameDuration - frameDuration;
             if (sleepDuration.count() > 0) {
@@ -89,6 +269,7 @@ Game::run() {
                 fpsTime = 0;
             }
         }
+        m_impl->saveProfile();
         m_impl->m_engine.shutdown();
     }
     catch (const luabind::error& e) {
@@ -97,6 +278,27 @@ Game::run() {
 }
 
 
+void
+Game::setSimulationRate(
+    unsigned short rate
+) {
+    assert(rate > 0 && "Simulation rate must be positive");
+    m_impl->setSimulationRate(rate);
+}
+
+
+unsigned short
+Game::simulationRate() const {
+    return m_impl->m_simulationRate;
+}
+
+
+double
+Game::effectiveSimulationRate() const {
+    return m_impl->effectiveSimulationRate();
+}
+
+
 boost::chrono::microseconds
 Game::targetFrameDuration() const {
     return m_impl->m_targetFrameDuration;
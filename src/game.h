@@ -44,9 +44,69 @@ public:
 
     /**
     * @brief Starts all engines
+    *
+    * Recognized arguments:
+    * - \c --duration=SECONDS: How much simulated time a headless run
+    *   lasts (default 60)
+    * - \c --headless: Runs the simulation without window, input and
+    *   rendering (see Engine::setHeadless()). Ticks run back to back
+    *   instead of in real time, and the game quits after the
+    *   \c --duration has been simulated, printing the tick throughput.
+    * - \c --profile[=FILE]: Saves the frame profile in Chrome's trace
+    *   format to \a FILE (default \c profile.json) when the game quits
+    * - \c --simulation-rate=N: See setSimulationRate()
+    *
+    * Each frame runs as many simulation ticks as have become due, but at
+    * most a few. If the simulation can't keep up, it runs slower than real
+    * time rather than making every frame slower still. Rendering then
+    * interpolates between the last two ticks.
+    *
+    * @param argc
+    *   The number of command line arguments
+    * @param argv
+    *   The command line arguments, starting with the program name
+    */
+    void
+    run(
+        int argc,
+        char* argv[]
+    );
+
+    /**
+    * @brief Sets the number of simulation ticks per second
+    *
+    * The simulation advances in ticks of fixed duration, independent of
+    * the frame rate. The tick duration is rounded to whole microseconds,
+    * see effectiveSimulationRate(). Engine::update() is passed whole
+    * milliseconds, with the remainder of one tick carried over to the
+    * next, so a 60 Hz simulation alternates between 16 and 17 ms ticks.
+    * The physics simulation steps with the exact duration, see
+    * Engine::tickDuration().
+    *
+    * @param rate
+    *   The new tick rate, must be greater than 0
     */
     void
-    run();
+    setSimulationRate(
+        unsigned short rate
+    );
+
+    /**
+    * @brief The number of simulation ticks per second
+    *
+    * Defaults to 60.
+    */
+    unsigned short
+    simulationRate() const;
+
+    /**
+    * @brief The tick rate after rounding the tick duration
+    *
+    * Differs slightly from simulationRate() if one million isn't a
+    * multiple of it.
+    */
+    double
+    effectiveSimulationRate() const;
 
     /**
     * @brief The target frame duration
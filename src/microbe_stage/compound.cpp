@@ -5,8 +5,11 @@
 #include "bullet/rigid_body_system.h"
 #include "engine/component_factory.h"
 #include "engine/engine.h"
+#include "engine/entity_command_buffer.h"
 #include "engine/entity_filter.h"
+#include "engine/entity_manager.h"
 #include "engine/game_state.h"
+#include "engine/prefab.h"
 #include "engine/serialization.h"
 #include "engine/rng.h"
 #include "game.h"
@@ -19,6 +22,7 @@
 using namespace thrive;
 
 REGISTER_COMPONENT(CompoundComponent)
+REGISTER_COMPONENT_CLONER(CompoundComponent)
 
 
 luabind::scope
@@ -124,6 +128,7 @@ CompoundEmitterComponent::storage() const {
 }
 
 REGISTER_COMPONENT(CompoundEmitterComponent)
+REGISTER_COMPONENT_CLONER(CompoundEmitterComponent)
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -174,6 +179,7 @@ TimedCompoundEmitterComponent::storage() const {
 }
 
 REGISTER_COMPONENT(TimedCompoundEmitterComponent)
+REGISTER_COMPONENT_CLONER(TimedCompoundEmitterComponent)
 
 ////////////////////////////////////////////////////////////////////////////////
 // CompoundAbsorberComponent
@@ -254,6 +260,7 @@ CompoundAbsorberComponent::setCanAbsorbCompound(
     else {
         m_canAbsorbCompound.erase(id);
     }
+    this->markUnsavedChange();
 }
 
 
@@ -266,9 +273,9 @@ CompoundAbsorberComponent::storage() const {
         StorageContainer container;
         container.set<CompoundId>("compoundId", compoundId);
         container.set<float>("amount", this->absorbedCompoundAmount(compoundId));
-        compounds.append(container);
+        compounds.append(std::move(container));
     }
-    storage.set<StorageList>("compounds", compounds);
+    storage.set<StorageList>("compounds", std::move(compounds));
     return storage;
 }
 
@@ -298,6 +305,8 @@ struct CompoundLifetimeSystem::Implementation {
 CompoundLifetimeSystem::CompoundLifetimeSystem()
   : m_impl(new Implementation())
 {
+    this->setComponentAccess({}, {CompoundComponent::TYPE_ID});
+    this->setRequiresMainThread(false);
 }
 
 
@@ -322,13 +331,17 @@ CompoundLifetimeSystem::shutdown() {
 
 void
 CompoundLifetimeSystem::update(int milliseconds) {
-    for (auto& value : m_impl->m_entities) {
-        CompoundComponent* compoundComponent = std::get<0>(value.second);
-        compoundComponent->m_timeToLive -= milliseconds;
-        if (compoundComponent->m_timeToLive <= 0) {
-            this->entityManager()->removeEntity(value.first);
+    m_impl->m_entities.parallelForEach(
+        this->gameState()->commandBuffer(),
+        [milliseconds] (EntityId entityId, const EntityFilter<CompoundComponent>::ComponentGroup& group, EntityCommandBuffer& changes) {
+            CompoundComponent* compoundComponent = std::get<0>(group);
+            compoundComponent->m_timeToLive -= milliseconds;
+            compoundComponent->markUnsavedChange();
+            if (compoundComponent->m_timeToLive <= 0) {
+                changes.removeEntity(entityId);
+            }
         }
-    }
+    );
 }
 
 
@@ -357,6 +370,11 @@ struct CompoundMovementSystem::Implementation {
 CompoundMovementSystem::CompoundMovementSystem()
   : m_impl(new Implementation())
 {
+    this->setComponentAccess(
+        {CompoundComponent::TYPE_ID},
+        {RigidBodyComponent::TYPE_ID}
+    );
+    this->setRequiresMainThread(false);
 }
 
 
@@ -381,12 +399,15 @@ CompoundMovementSystem::shutdown() {
 
 void
 CompoundMovementSystem::update(int milliseconds) {
-    for (auto& value : m_impl->m_entities) {
-        CompoundComponent* compoundComponent = std::get<0>(value.second);
-        RigidBodyComponent* rigidBodyComponent = std::get<1>(value.second);
-        Ogre::Vector3 delta = compoundComponent->m_velocity * float(milliseconds) / 1000.0f;
-        rigidBodyComponent->m_dynamicProperties.position += delta;
-    }
+    m_impl->m_entities.parallelForEach(
+        [milliseconds] (EntityId, const EntityFilter<CompoundComponent, RigidBodyComponent>::ComponentGroup& group) {
+            CompoundComponent* compoundComponent = std::get<0>(group);
+            RigidBodyComponent* rigidBodyComponent = std::get<1>(group);
+            Ogre::Vector3 delta = compoundComponent->m_velocity * float(milliseconds) / 1000.0f;
+            rigidBodyComponent->m_dynamicProperties.position += delta;
+            rigidBodyComponent->markUnsavedChange();
+        }
+    );
 }
 
 
@@ -405,12 +426,45 @@ CompoundEmitterSystem::luaBindings() {
 
 struct CompoundEmitterSystem::Implementation {
 
+    // Particles of the same compound only differ in their position,
+    // velocity, lifetime and potency
+    const Prefab&
+    particlePrefab(
+        CompoundId compoundId
+    ) {
+        std::unique_ptr<Prefab>& prefab = m_particlePrefabs[compoundId];
+        if (prefab) {
+            return *prefab;
+        }
+        prefab.reset(new Prefab(Game::instance().engine().componentFactory()));
+        // Scene Node
+        auto sceneNodeComponent = prefab->addComponent(make_unique<OgreSceneNodeComponent>());
+        sceneNodeComponent->m_transform.scale = PARTICLE_SCALE;
+        sceneNodeComponent->m_meshName = CompoundRegistry::getCompoundMeshName(compoundId);
+        // Compound Component
+        auto compoundComponent = prefab->addComponent(make_unique<CompoundComponent>());
+        compoundComponent->m_compoundId = compoundId;
+        // Collision Hull, shared by all particles
+        auto rigidBodyComponent = prefab->addComponent(make_unique<RigidBodyComponent>(
+            btBroadphaseProxy::SensorTrigger,
+            btBroadphaseProxy::AllFilter & (~ btBroadphaseProxy::SensorTrigger)
+        ));
+        rigidBodyComponent->m_properties.shape = std::make_shared<SphereShape>(0.01);
+        rigidBodyComponent->m_properties.hasContactResponse = false;
+        rigidBodyComponent->m_properties.kinematic = true;
+        auto collisionHandler = prefab->addComponent(make_unique<CollisionComponent>());
+        collisionHandler->addCollisionGroup("compound");
+        return *prefab;
+    }
+
     EntityFilter<
         CompoundEmitterComponent,
         OgreSceneNodeComponent
 		Optional<TimedCompoundEmitterComponent>
     > m_entities;
 
+    std::unordered_map<CompoundId, std::unique_ptr<Prefab>> m_particlePrefabs;
+
     Ogre::SceneManager* m_sceneManager = nullptr;
 };
 
@@ -443,67 +497,47 @@ CompoundEmitterSystem::shutdown() {
 
 // Helper function for CompoundEmitterSystem to emit compounds
 static void
-emitCompound(
-    CompoundId compoundId,
+emitCompounds(
+    const Prefab& particlePrefab,
+    unsigned int count,
     double amount,
     Ogre::Vector3 emittorPosition,
     CompoundEmitterComponent* emitterComponent
 ) {
-
-    Ogre::Vector3 emissionOffset(0,0,0);
-
-    Ogre::Degree emissionAngle{static_cast<Ogre::Real>(Game::instance().engine().rng().getDouble(
-        emitterComponent->m_minEmissionAngle.valueDegrees(),
-        emitterComponent->m_maxEmissionAngle.valueDegrees()
-    ))};
-    Ogre::Real emissionSpeed = Game::instance().engine().rng().getDouble(
-        emitterComponent->m_minInitialSpeed,
-        emitterComponent->m_maxInitialSpeed
-    );
-    Ogre::Vector3 emissionVelocity(
-        emissionSpeed * Ogre::Math::Sin(emissionAngle),
-        emissionSpeed * Ogre::Math::Cos(emissionAngle),
-        0.0
-    );
-    emissionOffset = Ogre::Vector3(
-        emitterComponent->m_emissionRadius * Ogre::Math::Sin(emissionAngle),
-        emitterComponent->m_emissionRadius * Ogre::Math::Cos(emissionAngle),
-        0.0
-    );
-    EntityId compoundEntityId = Game::instance().engine().currentGameState()->entityManager().generateNewId();
-    // Scene Node
-    auto compoundSceneNodeComponent = make_unique<OgreSceneNodeComponent>();
-    compoundSceneNodeComponent->m_transform.scale = PARTICLE_SCALE;
-    compoundSceneNodeComponent->m_meshName = CompoundRegistry::getCompoundMeshName(compoundId);
-    // Collision Hull
-    auto compoundRigidBodyComponent = make_unique<RigidBodyComponent>(
-        btBroadphaseProxy::SensorTrigger,
-        btBroadphaseProxy::AllFilter & (~ btBroadphaseProxy::SensorTrigger)
+    RNG& rng = Game::instance().engine().rng();
+    // Queue the particles, so that entity filters see them once they're
+    // complete
+    EntityCommandBuffer& commandBuffer = Game::instance().engine().currentGameState()->commandBuffer();
+    particlePrefab.instantiate(
+        commandBuffer,
+        count,
+        [&] (const Prefab::Instance& instance) {
+            Ogre::Degree emissionAngle{static_cast<Ogre::Real>(rng.getDouble(
+                emitterComponent->m_minEmissionAngle.valueDegrees(),
+                emitterComponent->m_maxEmissionAngle.valueDegrees()
+            ))};
+            Ogre::Real emissionSpeed = rng.getDouble(
+                emitterComponent->m_minInitialSpeed,
+                emitterComponent->m_maxInitialSpeed
+            );
+            Ogre::Vector3 emissionVelocity(
+                emissionSpeed * Ogre::Math::Sin(emissionAngle),
+                emissionSpeed * Ogre::Math::Cos(emissionAngle),
+                0.0
+            );
+            Ogre::Vector3 emissionOffset(
+                emitterComponent->m_emissionRadius * Ogre::Math::Sin(emissionAngle),
+                emitterComponent->m_emissionRadius * Ogre::Math::Cos(emissionAngle),
+                0.0
+            );
+            auto rigidBodyComponent = instance.getComponent<RigidBodyComponent>();
+            rigidBodyComponent->m_dynamicProperties.position = emittorPosition + emissionOffset;
+            auto compoundComponent = instance.getComponent<CompoundComponent>();
+            compoundComponent->m_timeToLive = emitterComponent->m_particleLifetime;
+            compoundComponent->m_velocity = emissionVelocity;
+            compoundComponent->m_potency = amount;
+        }
     );
-    compoundRigidBodyComponent->m_properties.shape = std::make_shared<SphereShape>(0.01);
-    compoundRigidBodyComponent->m_properties.hasContactResponse = false;
-    compoundRigidBodyComponent->m_properties.kinematic = true;
-    compoundRigidBodyComponent->m_dynamicProperties.position = emittorPosition + emissionOffset;
-    // Compound Component
-    auto compoundComponent = make_unique<CompoundComponent>();
-    compoundComponent->m_timeToLive = emitterComponent->m_particleLifetime;
-    compoundComponent->m_velocity = emissionVelocity;
-    compoundComponent->m_compoundId = compoundId;
-    compoundComponent->m_potency = amount;
-    auto collisionHandler = make_unique<CollisionComponent>();
-    collisionHandler->addCollisionGroup("compound");
-    // Build component list
-    std::list<std::unique_ptr<Component>> components;
-    components.emplace_back(std::move(compoundSceneNodeComponent));
-    components.emplace_back(std::move(compoundComponent));
-    components.emplace_back(std::move(compoundRigidBodyComponent));
-    components.emplace_back(std::move(collisionHandler));
-    for (auto& component : components) {
-        Game::instance().engine().currentGameState()->entityManager().addComponent(
-            compoundEntityId,
-            std::move(component)
-        );
-    }
 }
 
 
@@ -517,20 +551,25 @@ CompoundEmitterSystem::update(int milliseconds) {
 
         for (auto emission : emitterComponent->m_compoundEmissions)
         {
-            emitCompound(std::get<0>(emission), std::get<1>(emission), sceneNodeComponent->m_transform.position, emitterComponent);
+            emitCompounds(m_impl->particlePrefab(std::get<0>(emission)), 1, std::get<1>(emission), sceneNodeComponent->m_transform.position, emitterComponent);
         }
         emitterComponent->m_compoundEmissions.clear();
         if (timedEmitterComponent)
         {
             timedEmitterComponent->m_timeSinceLastEmission += milliseconds;
+            timedEmitterComponent->markUnsavedChange();
             while (
                 timedEmitterComponent->m_emitInterval > 0 and
                 timedEmitterComponent->m_timeSinceLastEmission >= timedEmitterComponent->m_emitInterval
             ) {
                 timedEmitterComponent->m_timeSinceLastEmission -= timedEmitterComponent->m_emitInterval;
-                for (unsigned int i = 0; i < timedEmitterComponent->m_particlesPerEmission; ++i) {
-                     emitCompound(timedEmitterComponent->m_compoundId, timedEmitterComponent->m_potencyPerParticle, sceneNodeComponent->m_transform.position, emitterComponent);
-                }
+                emitCompounds(
+                    m_impl->particlePrefab(timedEmitterComponent->m_compoundId),
+                    timedEmitterComponent->m_particlesPerEmission,
+                    timedEmitterComponent->m_potencyPerParticle,
+                    sceneNodeComponent->m_transform.position,
+                    emitterComponent
+                );
             }
         }
     }
@@ -640,6 +679,7 @@ CompoundAbsorberSystem::update(int) {
         if (compound and absorber and absorber->canAbsorbCompound(compound->m_compoundId) and compound->m_timeToLive > 0) {
             absorber->m_absorbedCompounds[compound->m_compoundId] += compound->m_potency;
             compound->m_timeToLive = 0;
+            compound->markUnsavedChange();
         }
     }
     m_impl->m_compoundCollisions.clearCollisions();
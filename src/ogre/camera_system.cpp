@@ -1,8 +1,10 @@
 #include "ogre/camera_system.h"
 
+#include "engine/component_collection.h"
 #include "engine/component_factory.h"
 #include "engine/game_state.h"
 #include "engine/entity_filter.h"
+#include "engine/entity_manager.h"
 #include "engine/serialization.h"
 #include "ogre/scene_node_system.h"
 #include "scripting/luabind.h"
@@ -62,6 +64,7 @@ OgreCameraComponent::OgreCameraComponent(
     std::string name
 ) : m_name(name)
 {
+    m_properties.setComponent(this);
 }
 
 OgreCameraComponent::OgreCameraComponent()
@@ -122,6 +125,8 @@ struct OgreCameraSystem::Implementation {
 
     std::unordered_map<EntityId, Ogre::Camera*> m_cameras;
 
+    unsigned int m_changeTracker = 0;
+
     Ogre::SceneManager* m_sceneManager = nullptr;
 
     EntityFilter<
@@ -134,6 +139,11 @@ struct OgreCameraSystem::Implementation {
 OgreCameraSystem::OgreCameraSystem()
   : m_impl(new Implementation())
 {
+    this->setPhase(System::Phase::Render);
+    this->setComponentAccess(
+        {},
+        {OgreCameraComponent::TYPE_ID, OgreSceneNodeComponent::TYPE_ID}
+    );
 }
 
 
@@ -148,11 +158,17 @@ OgreCameraSystem::init(
     assert(m_impl->m_sceneManager == nullptr && "Double init of system");
     m_impl->m_sceneManager = gameState->sceneManager();
     m_impl->m_entities.setEntityManager(&gameState->entityManager());
+    m_impl->m_changeTracker = this->entityManager()->getComponentCollection(
+        OgreCameraComponent::TYPE_ID
+    ).enableChangeTracking();
 }
 
 
 void
 OgreCameraSystem::shutdown() {
+    this->entityManager()->getComponentCollection(
+        OgreCameraComponent::TYPE_ID
+    ).disableChangeTracking(m_impl->m_changeTracker);
     m_impl->m_entities.setEntityManager(nullptr);
     m_impl->m_sceneManager = nullptr;
     System::shutdown();
@@ -181,13 +197,19 @@ OgreCameraSystem::update(int) {
         cameraComponent->m_camera = camera;
         m_impl->m_cameras[entityId] = camera;
         sceneNodeComponent->m_sceneNode->attachObject(camera);
+        // Apply the properties below
+        cameraComponent->m_properties.touch();
     }
     m_impl->m_entities.clearChanges();
-    for (auto& value : m_impl->m_entities) {
-        OgreCameraComponent* cameraComponent = std::get<1>(value.second);
+    auto& collection = this->entityManager()->getComponentCollection(
+        OgreCameraComponent::TYPE_ID
+    );
+    for (Component* component : collection.takeChangedComponents(m_impl->m_changeTracker)) {
+        OgreCameraComponent* cameraComponent = static_cast<OgreCameraComponent*>(component);
         auto& properties = cameraComponent->m_properties;
-        if (properties.hasChanges()) {
-            Ogre::Camera* camera = cameraComponent->m_camera;
+        Ogre::Camera* camera = cameraComponent->m_camera;
+        // Cameras without a scene node yet are touched when they are added
+        if (camera and properties.hasChanges()) {
             // Update camera
             camera->setPolygonMode(properties.polygonMode);
             camera->setFOVy(properties.fovY);
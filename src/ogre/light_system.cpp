@@ -1,8 +1,10 @@
 #include "ogre/light_system.h"
 
+#include "engine/component_collection.h"
 #include "engine/component_factory.h"
 #include "engine/game_state.h"
 #include "engine/entity_filter.h"
+#include "engine/entity_manager.h"
 #include "engine/serialization.h"
 #include "ogre/scene_node_system.h"
 #include "scripting/luabind.h"
@@ -63,6 +65,11 @@ OgreLightComponent::luaBindings() {
 }
 
 
+OgreLightComponent::OgreLightComponent() {
+    m_properties.setComponent(this);
+}
+
+
 void
 OgreLightComponent::load(
     const StorageContainer& storage
@@ -119,6 +126,8 @@ OgreLightSystem::luaBindings() {
 
 struct OgreLightSystem::Implementation {
 
+    unsigned int m_changeTracker = 0;
+
     EntityFilter<
         OgreLightComponent,
         OgreSceneNodeComponent
@@ -134,6 +143,7 @@ struct OgreLightSystem::Implementation {
 OgreLightSystem::OgreLightSystem()
   : m_impl(new Implementation())
 {
+    this->setPhase(System::Phase::Render);
 }
 
 
@@ -148,11 +158,17 @@ OgreLightSystem::init(
     assert(m_impl->m_sceneManager == nullptr && "Double init of system");
     m_impl->m_sceneManager = gameState->sceneManager();
     m_impl->m_entities.setEntityManager(&gameState->entityManager());
+    m_impl->m_changeTracker = this->entityManager()->getComponentCollection(
+        OgreLightComponent::TYPE_ID
+    ).enableChangeTracking();
 }
 
 
 void
 OgreLightSystem::shutdown() {
+    this->entityManager()->getComponentCollection(
+        OgreLightComponent::TYPE_ID
+    ).disableChangeTracking(m_impl->m_changeTracker);
     m_impl->m_entities.setEntityManager(nullptr);
     m_impl->m_sceneManager = nullptr;
     System::shutdown();
@@ -176,15 +192,21 @@ OgreLightSystem::update(int) {
         lightComponent->m_light = light;
         m_impl->m_lights[entityId] = light;
         sceneNodeComponent->m_sceneNode->attachObject(light);
+        // Apply the properties below
+        lightComponent->m_properties.touch();
     }
     m_impl->m_entities.clearChanges();
-    for (const auto& value : m_impl->m_entities) {
-        OgreLightComponent* lightComponent = std::get<0>(value.second);
+    auto& collection = this->entityManager()->getComponentCollection(
+        OgreLightComponent::TYPE_ID
+    );
+    for (Component* component : collection.takeChangedComponents(m_impl->m_changeTracker)) {
+        OgreLightComponent* lightComponent = static_cast<OgreLightComponent*>(component);
         auto& properties = lightComponent->m_properties;
-        if (not properties.hasChanges()) {
+        Ogre::Light* light = lightComponent->m_light;
+        // Lights without a scene node yet are touched when they are added
+        if (not light or not properties.hasChanges()) {
             continue;
         }
-        Ogre::Light* light = lightComponent->m_light;
         light->setType(properties.type);
         light->setDiffuseColour(properties.diffuseColour);
         light->setSpecularColour(properties.specularColour);
@@ -122,6 +122,11 @@ public:
     static luabind::scope
     luaBindings();
 
+    /**
+    * @brief Constructor
+    */
+    OgreLightComponent();
+
     void
     load(
         const StorageContainer& storage
@@ -72,12 +72,18 @@ bool
 Mouse::isButtonDown(
     OIS::MouseButtonID button
 ) const {
+    if (not m_impl->m_mouse) {
+        return false;
+    }
     return m_impl->m_mouse->getMouseState().buttonDown(button);
 }
 
 
 Ogre::Vector3
 Mouse::normalizedPosition() const {
+    if (not m_impl->m_mouse) {
+        return Ogre::Vector3::ZERO;
+    }
     const OIS::MouseState& mouseState = m_impl->m_mouse->getMouseState();
     return Ogre::Vector3(
         double(mouseState.X.abs) / mouseState.width,
@@ -89,6 +95,9 @@ Mouse::normalizedPosition() const {
 
 Ogre::Vector3
 Mouse::position() const {
+    if (not m_impl->m_mouse) {
+        return Ogre::Vector3::ZERO;
+    }
     return Ogre::Vector3(
         m_impl->m_mouse->getMouseState().X.abs,
         m_impl->m_mouse->getMouseState().Y.abs,
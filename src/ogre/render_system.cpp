@@ -27,6 +27,7 @@ struct RenderSystem::Implementation {
 RenderSystem::RenderSystem()
   : m_impl(new Implementation())
 {
+    this->setPhase(System::Phase::Render);
 }
 
 
@@ -1,5 +1,6 @@
 #include "ogre/scene_node_system.h"
 
+#include "engine/component_collection.h"
 #include "engine/component_factory.h"
 #include "engine/entity.h"
 #include "engine/entity_filter.h"
@@ -10,6 +11,7 @@
 
 #include <OgreSceneManager.h>
 #include <OgreEntity.h>
+#include <unordered_set>
 
 using namespace thrive;
 
@@ -72,6 +74,26 @@ OgreSceneNodeComponent::luaBindings() {
 }
 
 
+OgreSceneNodeComponent::OgreSceneNodeComponent() {
+    m_meshName.setComponent(this);
+    m_parentId.setComponent(this);
+    m_transform.setComponent(this);
+}
+
+
+OgreSceneNodeComponent::OgreSceneNodeComponent(
+    const OgreSceneNodeComponent& other
+) : Component(other),
+    m_meshName(other.m_meshName),
+    m_parentId(other.m_parentId),
+    m_transform(other.m_transform)
+{
+    m_meshName.setComponent(this);
+    m_parentId.setComponent(this);
+    m_transform.setComponent(this);
+}
+
+
 void
 OgreSceneNodeComponent::load(
     const StorageContainer& storage
@@ -97,6 +119,7 @@ OgreSceneNodeComponent::storage() const {
 }
 
 REGISTER_COMPONENT(OgreSceneNodeComponent)
+REGISTER_COMPONENT_CLONER(OgreSceneNodeComponent)
 
 ////////////////////////////////////////////////////////////////////////////////
 // OgreAddSceneNodeSystem
@@ -122,6 +145,7 @@ struct OgreAddSceneNodeSystem::Implementation {
 OgreAddSceneNodeSystem::OgreAddSceneNodeSystem()
   : m_impl(new Implementation())
 {
+    this->setPhase(System::Phase::Render);
 }
 
 
@@ -172,6 +196,8 @@ OgreAddSceneNodeSystem::update(int) {
         }
         Ogre::SceneNode* node = parentNode->createChildSceneNode();
         component->m_sceneNode = node;
+        // Have OgreUpdateSceneNodeSystem apply the transform and mesh
+        component->touch();
     }
     m_impl->m_entities.clearChanges();
 }
@@ -205,6 +231,7 @@ struct OgreRemoveSceneNodeSystem::Implementation {
 OgreRemoveSceneNodeSystem::OgreRemoveSceneNodeSystem()
   : m_impl(new Implementation())
 {
+    this->setPhase(System::Phase::Render);
 }
 
 
@@ -272,18 +299,133 @@ OgreUpdateSceneNodeSystem::luaBindings() {
 
 struct OgreUpdateSceneNodeSystem::Implementation {
 
-    EntityFilter<
-        OgreSceneNodeComponent
-    > m_entities;
+    void
+    applyChanges(
+        OgreSceneNodeComponent* component
+    );
+
+    void
+    interpolate(
+        EntityId entityId,
+        OgreSceneNodeComponent* component,
+        float interpolation
+    );
+
+    ComponentCollection* m_collection = nullptr;
+
+    unsigned int m_changeTracker = 0;
+
+    EntityManager* m_entityManager = nullptr;
+
+    // Entities whose interpolated transform hasn't reached its target yet
+    std::unordered_set<EntityId> m_interpolating;
 
     Ogre::SceneManager* m_sceneManager = nullptr;
 
 };
 
 
+void
+OgreUpdateSceneNodeSystem::Implementation::applyChanges(
+    OgreSceneNodeComponent* component
+) {
+    Ogre::SceneNode* sceneNode = component->m_sceneNode;
+    auto& transform = component->m_transform;
+    if (transform.hasChanges()) {
+        if (transform.isInterpolated) {
+            m_interpolating.insert(component->owner());
+        }
+        else {
+            sceneNode->setOrientation(
+                transform.orientation
+            );
+            sceneNode->setPosition(
+                transform.position
+            );
+        }
+        sceneNode->setScale(
+            transform.scale
+        );
+        transform.untouch();
+    }
+    if (component->m_parentId.hasChanges()) {
+        EntityId parentId = component->m_parentId;
+        Ogre::SceneNode* newParentNode = nullptr;
+        if (parentId == NULL_ENTITY) {
+            newParentNode = m_sceneManager->getRootSceneNode();
+            component->m_parentId.untouch();
+        }
+        else {
+            auto parentComponent = m_entityManager->getComponent<OgreSceneNodeComponent>(
+                parentId
+            );
+            if (parentComponent and parentComponent->m_sceneNode) {
+                newParentNode = parentComponent->m_sceneNode;
+                component->m_parentId.untouch();
+            }
+            else {
+                newParentNode = m_sceneManager->getRootSceneNode();
+                // Mark component for later reparenting
+                component->m_parentId.touch();
+            }
+        }
+        Ogre::SceneNode* currentParentNode = sceneNode->getParentSceneNode();
+        currentParentNode->removeChild(sceneNode);
+        newParentNode->addChild(sceneNode);
+    }
+    if (component->m_meshName.hasChanges()) {
+        if (component->m_entity) {
+            sceneNode->detachObject(component->m_entity);
+            m_sceneManager->destroyEntity(component->m_entity);
+            component->m_entity = nullptr;
+        }
+        if (component->m_meshName.get().size() > 0) {
+            component->m_entity = m_sceneManager->createEntity(
+                component->m_meshName
+            );
+            sceneNode->attachObject(component->m_entity);
+        }
+        component->m_meshName.untouch();
+    }
+}
+
+
+void
+OgreUpdateSceneNodeSystem::Implementation::interpolate(
+    EntityId entityId,
+    OgreSceneNodeComponent* component,
+    float interpolation
+) {
+    Ogre::SceneNode* sceneNode = component->m_sceneNode;
+    auto& transform = component->m_transform;
+    sceneNode->setOrientation(
+        Ogre::Quaternion::nlerp(
+            interpolation,
+            transform.previousOrientation,
+            transform.orientation,
+            true
+        )
+    );
+    sceneNode->setPosition(
+        transform.previousPosition + interpolation * (
+            transform.position - transform.previousPosition
+        )
+    );
+    // Once the previous tick's transform is the current one, there is
+    // nothing left to interpolate until the next change
+    if (
+        transform.previousPosition == transform.position and
+        transform.previousOrientation == transform.orientation
+    ) {
+        m_interpolating.erase(entityId);
+    }
+}
+
+
 OgreUpdateSceneNodeSystem::OgreUpdateSceneNodeSystem()
   : m_impl(new Implementation())
 {
+    this->setPhase(System::Phase::Render);
 }
 
 
@@ -296,13 +438,20 @@ OgreUpdateSceneNodeSystem::init(
 ) {
     System::init(gameState);
     m_impl->m_sceneManager = gameState->sceneManager();
-    m_impl->m_entities.setEntityManager(&gameState->entityManager());
+    m_impl->m_entityManager = &gameState->entityManager();
+    m_impl->m_collection = &m_impl->m_entityManager->getComponentCollection(
+        OgreSceneNodeComponent::TYPE_ID
+    );
+    m_impl->m_changeTracker = m_impl->m_collection->enableChangeTracking();
 }
 
 
 void
 OgreUpdateSceneNodeSystem::shutdown() {
-    m_impl->m_entities.setEntityManager(nullptr);
+    m_impl->m_collection->disableChangeTracking(m_impl->m_changeTracker);
+    m_impl->m_collection = nullptr;
+    m_impl->m_interpolating.clear();
+    m_impl->m_entityManager = nullptr;
     m_impl->m_sceneManager = nullptr;
     System::shutdown();
 }
@@ -310,62 +459,28 @@ OgreUpdateSceneNodeSystem::shutdown() {
 
 void
 OgreUpdateSceneNodeSystem::update(int) {
-    for (const auto& entry : m_impl->m_entities) {
-        OgreSceneNodeComponent* component = std::get<0>(entry.second);
-        Ogre::SceneNode* sceneNode = component->m_sceneNode;
-        auto& transform = component->m_transform;
-        if (transform.hasChanges()) {
-            sceneNode->setOrientation(
-                transform.orientation
-            );
-            sceneNode->setPosition(
-                transform.position
-            );
-            sceneNode->setScale(
-                transform.scale
-            );
-            transform.untouch();
-        }
-        if (component->m_parentId.hasChanges()) {
-            EntityId parentId = component->m_parentId;
-            Ogre::SceneNode* newParentNode = nullptr;
-            if (parentId == NULL_ENTITY) {
-                newParentNode = m_impl->m_sceneManager->getRootSceneNode();
-                component->m_parentId.untouch();
-            }
-            else {
-                auto parentComponent = this->entityManager()->getComponent<OgreSceneNodeComponent>(
-                    parentId
-                );
-                if (parentComponent and parentComponent->m_sceneNode) {
-                    newParentNode = parentComponent->m_sceneNode;
-                    component->m_parentId.untouch();
-                }
-                else {
-                    newParentNode = m_impl->m_sceneManager->getRootSceneNode();
-                    // Mark component for later reparenting
-                    component->m_parentId.touch();
-                }
-            }
-            Ogre::SceneNode* currentParentNode = sceneNode->getParentSceneNode();
-            currentParentNode->removeChild(sceneNode);
-            newParentNode->addChild(sceneNode);
+    for (Component* component : m_impl->m_collection->takeChangedComponents(m_impl->m_changeTracker)) {
+        auto sceneNodeComponent = static_cast<OgreSceneNodeComponent*>(component);
+        // Components without a scene node are touched when it is created
+        if (sceneNodeComponent->m_sceneNode) {
+            m_impl->applyChanges(sceneNodeComponent);
         }
-        if (component->m_meshName.hasChanges()) {
-            if (component->m_entity) {
-                sceneNode->detachObject(component->m_entity);
-                m_impl->m_sceneManager->destroyEntity(component->m_entity);
-                component->m_entity = nullptr;
-            }
-            if (component->m_meshName.get().size() > 0) {
-                component->m_entity = m_impl->m_sceneManager->createEntity(
-                    component->m_meshName
-                );
-                sceneNode->attachObject(component->m_entity);
-            }
-            component->m_meshName.untouch();
+    }
+    float interpolation = this->gameState()->interpolation();
+    // Copy, interpolate() may remove entries
+    std::vector<EntityId> interpolating(
+        m_impl->m_interpolating.begin(),
+        m_impl->m_interpolating.end()
+    );
+    for (EntityId entityId : interpolating) {
+        auto component = static_cast<OgreSceneNodeComponent*>(
+            m_impl->m_collection->get(entityId)
+        );
+        // The entity may have been removed in the meantime
+        if (not component or not component->m_sceneNode) {
+            m_impl->m_interpolating.erase(entityId);
+            continue;
         }
+        m_impl->interpolate(entityId, component, interpolation);
     }
 }
-
-
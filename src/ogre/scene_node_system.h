@@ -35,6 +35,15 @@ public:
     */
     struct Transform : public Touchable {
 
+        /**
+        * @brief Whether rendering interpolates between the previous and
+        *   the current orientation and position
+        *
+        * Set by BulletToOgreSystem for scene nodes that follow a rigid
+        * body, which moves once per simulation tick.
+        */
+        bool isInterpolated = false;
+
         /**
         * @brief Rotation
         *
@@ -49,6 +58,20 @@ public:
         */
         Ogre::Vector3 position = {0, 0, 0};
 
+        /**
+        * @brief Rotation at the previous simulation tick
+        *
+        * Only used if isInterpolated is \c true
+        */
+        Ogre::Quaternion previousOrientation = Ogre::Quaternion::IDENTITY;
+
+        /**
+        * @brief Position at the previous simulation tick
+        *
+        * Only used if isInterpolated is \c true
+        */
+        Ogre::Vector3 previousPosition = {0, 0, 0};
+
         /**
         * @brief Scale
         *
@@ -77,6 +100,20 @@ public:
     static luabind::scope
     luaBindings();
 
+    /**
+    * @brief Constructor
+    */
+    OgreSceneNodeComponent();
+
+    /**
+    * @brief Copy constructor
+    *
+    * The copy gets its own scene node once it is added to an entity.
+    */
+    OgreSceneNodeComponent(
+        const OgreSceneNodeComponent& other
+    );
+
     void
     load(
         const StorageContainer& storage
@@ -257,6 +294,9 @@ public:
 
     /**
     * @brief Updates the scene nodes
+    *
+    * Interpolated transforms are applied on every call, see
+    * GameState::interpolation().
     */
     void update(int) override;
 
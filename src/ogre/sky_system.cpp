@@ -106,6 +106,8 @@ struct SkySystem::Implementation {
 SkySystem::SkySystem()
   : m_impl(new Implementation())
 {
+    this->setPhase(System::Phase::Render);
+    this->setComponentAccess({}, {SkyPlaneComponent::TYPE_ID});
 }
 
 
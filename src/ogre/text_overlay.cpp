@@ -207,6 +207,8 @@ struct TextOverlaySystem::Implementation {
 TextOverlaySystem::TextOverlaySystem()
   : m_impl(new Implementation())
 {
+    this->setPhase(System::Phase::Render);
+    this->setComponentAccess({}, {TextOverlayComponent::TYPE_ID});
 }
 
 
@@ -248,7 +250,9 @@ void
 TextOverlaySystem::update(int) {
     for (EntityId entityId : m_impl->m_entities.removedEntities()) {
         Ogre::OverlayElement* textOverlay = m_impl->m_textOverlays[entityId];
-        m_impl->removeOverlayElement(textOverlay->getName());
+        if (textOverlay) {
+            m_impl->removeOverlayElement(textOverlay->getName());
+        }
         m_impl->m_textOverlays.erase(entityId);
     }
     for (auto& value : m_impl->m_entities.addedEntities()) {
@@ -199,6 +199,7 @@ struct OgreViewportSystem::Implementation {
 OgreViewportSystem::OgreViewportSystem()
   : m_impl(new Implementation(*this))
 {
+    this->setPhase(System::Phase::Render);
 }
 
 
@@ -242,7 +243,10 @@ void
 OgreViewportSystem::update(int) {
     for (EntityId id : m_impl->m_entities.removedEntities()) {
         Ogre::Viewport* viewport = m_impl->m_viewports[id];
-        m_impl->removeViewport(viewport);
+        if (viewport) {
+            m_impl->removeViewport(viewport);
+        }
+        m_impl->m_viewports.erase(id);
     }
     for (const auto& item : m_impl->m_entities.addedEntities()) {
         EntityId entityId = item.first;
@@ -0,0 +1,82 @@
+#include "scripting/script_entity_filter.h"
+
+#include "engine/benchmarks/benchmark.h"
+#include "engine/benchmarks/benchmark_components.h"
+#include "engine/entity_manager.h"
+#include "scripting/lua_state.h"
+#include "scripting/luabind.h"
+#include "scripting/script_initializer.h"
+
+#include <luabind/luabind.hpp>
+#include <stdexcept>
+
+using namespace thrive;
+
+
+static void
+doString(
+    LuaState& L,
+    const std::string& string
+) {
+    if (not L.doString(string)) {
+        luabind::object error(luabind::from_stack(L, -1));
+        throw std::runtime_error(luabind::object_cast<std::string>(error));
+    }
+}
+
+
+static ScriptEntityFilter*
+createFilter(
+    LuaState& L
+) {
+    // The filter only needs the component classes' TYPE_ID
+    doString(L, "filter = EntityFilter({BenchmarkPosition, BenchmarkVelocity})");
+    return luabind::object_cast<ScriptEntityFilter*>(luabind::globals(L)["filter"]);
+}
+
+
+static void
+setupLua(
+    LuaState& L
+) {
+    initializeLua(L);
+    luabind::object globals = luabind::globals(L);
+    globals["BenchmarkPosition"] = luabind::newtable(L);
+    globals["BenchmarkPosition"]["TYPE_ID"] = BenchmarkPosition::TYPE_ID;
+    globals["BenchmarkVelocity"] = luabind::newtable(L);
+    globals["BenchmarkVelocity"]["TYPE_ID"] = BenchmarkVelocity::TYPE_ID;
+}
+
+
+BENCHMARK(ScriptEntityFilter, create) {
+    LuaState L;
+    setupLua(L);
+    EntityManager entityManager;
+    populate(entityManager, run.entityCount());
+    ScriptEntityFilter* filter = nullptr;
+    run.measure([&] () {
+        filter = createFilter(L);
+        filter->setEntityManager(&entityManager);
+    });
+    filter->setEntityManager(nullptr);
+}
+
+
+BENCHMARK(ScriptEntityFilter, iterate) {
+    LuaState L;
+    setupLua(L);
+    EntityManager entityManager;
+    populate(entityManager, run.entityCount());
+    ScriptEntityFilter* filter = createFilter(L);
+    filter->setEntityManager(&entityManager);
+    run.measure([&] () {
+        doString(L,
+            "count = 0\n"
+            "for entityId in filter:entities() do\n"
+            "    count = count + 1\n"
+            "end\n"
+        );
+    });
+    run.setCounter("matches", filter->entities().size());
+    filter->setEntityManager(nullptr);
+}
@@ -1,16 +1,105 @@
 #include "scripting/script_entity_filter.h"
 
 #include "engine/component.h"
-#include "engine/component_collection.h"
 #include "engine/entity_manager.h"
 #include "engine/game_state.h"
+#include "engine/query_index.h"
 #include "game.h"
 #include "scripting/luabind.h"
 
+#include <algorithm>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
 #include <luabind/iterator_policy.hpp>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 using namespace thrive;
 
+namespace {
+
+// The shared index of all script filters with the same component types
+class ScriptQueryIndex : public QueryIndex {
+
+public:
+
+    ScriptQueryIndex(
+        EntityManager& entityManager,
+        const std::vector<ComponentType>& componentTypes
+    ) : QueryIndex(entityManager, componentTypes)
+    {
+        this->initEntities();
+    }
+
+    const EntitySet&
+    entities() const {
+        return m_entities;
+    }
+
+    size_t
+    entityCount() const override {
+        return m_entities.size();
+    }
+
+protected:
+
+    void
+    clearEntities() override {
+        m_entities.clear();
+    }
+
+    void
+    collectEntities(
+        EntitySet& entities
+    ) const override {
+        for (EntityId id : m_entities) {
+            entities.insert(id);
+        }
+    }
+
+    bool
+    containsEntity(
+        EntityId id
+    ) const override {
+        return m_entities.count(id) > 0;
+    }
+
+    size_t
+    entityMemoryUsage() const override {
+        return m_entities.memoryUsage();
+    }
+
+    bool
+    eraseEntity(
+        EntityId id
+    ) override {
+        return m_entities.erase(id) > 0;
+    }
+
+    void
+    updateEntity(
+        EntityId id
+    ) override {
+        const ComponentMask& requiredMask = this->requiredMask();
+        const ComponentMask& mask = this->entityManager()->componentMask(id);
+        if (requiredMask.none() or (mask & requiredMask) != requiredMask) {
+            this->removeEntity(id);
+        }
+        else if (m_entities.insert(id)) {
+            this->logChange(id, Change::Type::Added);
+        }
+    }
+
+private:
+
+    EntitySet m_entities;
+
+};
+
+}
+
+
 struct ScriptEntityFilter::Implementation {
 
     Implementation(
@@ -29,109 +118,104 @@ struct ScriptEntityFilter::Implementation {
         }
     }
 
-    void
-    addEntity(
-        EntityId id
-    ) {
-        if (m_recordChanges) {
-            m_addedEntities.insert(id);
-        }
-        m_entities.insert(id);
+    ~Implementation() {
+        this->release();
     }
 
     void
-    initialize() {
-        for (EntityId id : m_entityManager->entities()) {
-            if (this->isEligible(id)) {
-                this->addEntity(id);
-            }
+    acquire(
+        EntityManager& entityManager
+    ) {
+        // Sorted, so that the order in the script doesn't matter
+        std::vector<QueryIndex::ComponentType> componentTypes;
+        for (ComponentTypeId typeId : m_requiredComponents) {
+            componentTypes.emplace_back(typeId, true);
         }
-    }
-
-    bool
-    isEligible(
-        EntityId id
-    ) const {
-        if (not m_entityManager or m_requiredComponents.empty()) {
-            return false;
+        std::sort(componentTypes.begin(), componentTypes.end());
+        std::string key = "ScriptEntityFilter:";
+        for (const auto& componentType : componentTypes) {
+            key += std::to_string(componentType.first) + ",";
         }
-        for (ComponentTypeId typeId : m_requiredComponents) {
-            if (not m_entityManager->getComponent(id, typeId)) {
-                return false;
+        m_index = std::static_pointer_cast<ScriptQueryIndex>(
+            entityManager.getQueryIndex(key)
+        );
+        if (not m_index) {
+            m_index = std::make_shared<ScriptQueryIndex>(entityManager, componentTypes);
+            entityManager.setQueryIndex(key, m_index);
+        }
+        if (m_recordChanges) {
+            m_index->sync();
+            boost::lock_guard<boost::mutex> lock(m_index->mutex());
+            m_changeReader = m_index->changes().addReader();
+            for (EntityId id : m_index->entities()) {
+                m_addedEntities.insert(id);
             }
         }
-        return true;
+    }
+
+    const EntitySet&
+    entities() const {
+        static const EntitySet EMPTY_ENTITIES;
+        return m_index ? m_index->entities() : EMPTY_ENTITIES;
     }
 
     void
-    registerCallbacks() {
-        for (ComponentTypeId typeId : m_requiredComponents) {
-            auto& collection = m_entityManager->getComponentCollection(typeId);
-            auto onAdded = [this] (EntityId id, Component&) {
-                if (this->isEligible(id)) {
-                    this->addEntity(id);
-                }
-            };
-            auto onRemoved = [this] (EntityId id, Component&) {
-                this->removeEntity(id);
-            };
-            unsigned int handle = collection.registerChangeCallbacks(
-                onAdded, 
-                onRemoved
-            );
-            m_registeredCallbacks[typeId] = handle;
+    release() {
+        if (m_index and m_recordChanges) {
+            boost::lock_guard<boost::mutex> lock(m_index->mutex());
+            m_index->changes().removeReader(m_changeReader);
         }
+        m_index.reset();
+        m_addedEntities.clear();
+        m_removedEntities.clear();
     }
 
     void
     setEntityManager(
         EntityManager* entityManager
     ) {
-        if (m_entityManager) {
-            this->unregisterCallbacks();
-        }
+        this->release();
         m_entityManager = entityManager;
-        m_addedEntities.clear();
-        m_removedEntities.clear();
-        m_entities.clear();
         if (entityManager) {
-            this->initialize();
-            this->registerCallbacks();
+            this->acquire(*entityManager);
         }
     }
 
+    // Brings the shared index up to date and follows its changes, see
+    // EntityFilter
     void
-    removeEntity(
-        EntityId id
-    ) {
-        if (m_recordChanges) {
-            m_removedEntities.insert(id);
+    sync() {
+        if (not m_index) {
+            return;
         }
-        m_entities.erase(id);
-    }
-
-    void
-    unregisterCallbacks() {
-        for (const auto& pair : m_registeredCallbacks) {
-            auto& collection = m_entityManager->getComponentCollection(
-                pair.first
-            );
-            collection.unregisterChangeCallbacks(pair.second);
+        m_index->sync();
+        if (not m_recordChanges) {
+            return;
+        }
+        boost::lock_guard<boost::mutex> lock(m_index->mutex());
+        auto changes = m_index->changes().read(m_changeReader);
+        for (auto change = changes.begin; change != changes.end; ++change) {
+            if (change->type == QueryIndex::Change::Type::Removed) {
+                m_addedEntities.erase(change->entityId);
+                m_removedEntities.insert(change->entityId);
+            }
+            else if (change->type == QueryIndex::Change::Type::Added) {
+                m_addedEntities.insert(change->entityId);
+            }
         }
-        m_registeredCallbacks.clear();
     }
 
-    std::unordered_set<EntityId> m_addedEntities;
+    EntitySet m_addedEntities;
 
-    std::unordered_set<EntityId> m_entities;
+    unsigned int m_changeReader = 0;
 
     EntityManager* m_entityManager = nullptr;
 
-    bool m_recordChanges = false;
+    std::shared_ptr<ScriptQueryIndex> m_index;
 
-    std::unordered_map<ComponentTypeId, unsigned int> m_registeredCallbacks;
+    bool m_recordChanges = false;
 
-    std::unordered_set<EntityId> m_removedEntities;
+    EntitySet m_removedEntities;
 
     std::unordered_set<ComponentTypeId> m_requiredComponents;
 
@@ -178,14 +262,16 @@ ScriptEntityFilter::~ScriptEntityFilter() {
 }
 
 
-const std::unordered_set<EntityId>&
+const EntitySet&
 ScriptEntityFilter::addedEntities() {
+    m_impl->sync();
     return m_impl->m_addedEntities;
 }
 
 
 void
 ScriptEntityFilter::clearChanges() {
+    m_impl->sync();
     m_impl->m_addedEntities.clear();
     m_impl->m_removedEntities.clear();
 }
@@ -195,16 +281,18 @@ bool
 ScriptEntityFilter::containsEntity(
     EntityId id
 ) const {
-    return m_impl->m_entities.count(id) > 0;
+    m_impl->sync();
+    return m_impl->entities().count(id) > 0;
 }
 
 
-const std::unordered_set<EntityId>&
+const EntitySet&
 ScriptEntityFilter::entities() {
     if (not m_impl->m_entityManager) {
         throw std::runtime_error("Entity filter is not initialized. Call init() on it.");
     }
-    return m_impl->m_entities;
+    m_impl->sync();
+    return m_impl->entities();
 }
 
 
@@ -218,12 +306,21 @@ ScriptEntityFilter::init(
 }
 
 
-const std::unordered_set<EntityId>&
+const EntitySet&
 ScriptEntityFilter::removedEntities() {
+    m_impl->sync();
     return m_impl->m_removedEntities;
 }
 
 
+void
+ScriptEntityFilter::setEntityManager(
+    EntityManager* entityManager
+) {
+    m_impl->setEntityManager(entityManager);
+}
+
+
 void
 ScriptEntityFilter::shutdown() {
     m_impl->setEntityManager(nullptr);
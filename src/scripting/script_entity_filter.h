@@ -1,14 +1,15 @@
 #pragma once
 
+#include "engine/entity_map.h"
 #include "engine/typedefs.h"
 #include "scripting/luabind.h"
 
 #include <luabind/object.hpp>
 #include <memory>
-#include <unordered_set>
 
 namespace thrive {
 
+class EntityManager;
 class GameState;
 
 /**
@@ -74,7 +75,7 @@ public:
     * removed entities.
     *
     */
-    const std::unordered_set<EntityId>&
+    const EntitySet&
     addedEntities();
 
     /**
@@ -101,7 +102,7 @@ public:
     * @brief The set of entities that are contained in this filter
     *
     */
-    const std::unordered_set<EntityId>&
+    const EntitySet&
     entities();
 
     /**
@@ -118,9 +119,23 @@ public:
     * Be sure to call clearChanges() once you have processed all added and
     * removed entities.
     */
-    const std::unordered_set<EntityId>&
+    const EntitySet&
     removedEntities();
 
+    /**
+    * @brief Initializes this filter with an entity manager directly
+    *
+    * Used where no game state is available, e.g. in benchmarks. Scripts
+    * should use init().
+    *
+    * @param entityManager
+    *   The entity manager to filter, \c nullptr to shut the filter down
+    */
+    void
+    setEntityManager(
+        EntityManager* entityManager
+    );
+
     /**
     * @brief Shuts this filter down
     */